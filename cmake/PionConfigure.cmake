@@ -27,3 +27,13 @@ endif()
 
 # check for required functions
 check_function_exists(malloc_trim PION_HAVE_MALLOC_TRIM)
+
+# check for io_uring support (Linux 5.19 or later headers)
+CHECK_C_SOURCE_COMPILES("#include <linux/io_uring.h>
+int main(void) { return IORING_OP_SOCKET + IORING_ACCEPT_MULTISHOT + IORING_ASYNC_CANCEL_FD + IORING_RSRC_REGISTER_SPARSE; }"
+    PION_HAVE_IO_URING)
+
+# check for kernel TLS support (Linux 5.1 or later headers)
+CHECK_C_SOURCE_COMPILES("#include <linux/tls.h>
+int main(void) { return TLS_TX + TLS_1_3_VERSION + TLS_CIPHER_AES_GCM_256; }"
+    PION_HAVE_KTLS)
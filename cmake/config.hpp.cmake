@@ -25,6 +25,12 @@
 /* Define to 1 if C library supports malloc_trim() */
 #cmakedefine PION_HAVE_MALLOC_TRIM ${PION_HAVE_MALLOC_TRIM}
 
+/* Define to 1 if the Linux io_uring interface is available */
+#cmakedefine PION_HAVE_IO_URING ${PION_HAVE_IO_URING}
+
+/* Define to 1 if Linux kernel TLS is available */
+#cmakedefine PION_HAVE_KTLS ${PION_HAVE_KTLS}
+
 // -----------------------------------------------------------------------
 // hash_map support
 //
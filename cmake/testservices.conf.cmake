@@ -6,6 +6,12 @@
 ##
 path @PION_PLUGIN_PATH@
 
+## Socket options for the listening socket and the connections it accepts
+## (see pion::tcp::socket_options for the names)
+##
+socket nodelay=1
+socket defer_accept=5
+
 ## Hello World Service
 ##
 service /hello HelloService
@@ -0,0 +1,102 @@
+// ---------------------------------------------------------------------
+// pion:  a Boost C++ framework for building lightweight HTTP interfaces
+// ---------------------------------------------------------------------
+// Copyright (C) 2021 Wang Qiang  (https://github.com/dnybz/pion)
+// Copyright (C) 2007-2014 Splunk Inc.  (https://github.com/splunk/pion)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+//
+
+#ifndef __PION_COROUTINE_HEADER__
+#define __PION_COROUTINE_HEADER__
+
+#include <pion/config.hpp>
+
+// C++20 coroutines are only used if the compiler supports them
+#if defined(__cpp_impl_coroutine) && (__cpp_impl_coroutine >= 201902L) && defined(__has_include)
+    #if __has_include(<coroutine>)
+        #define PION_HAVE_COROUTINES
+    #endif
+#endif
+
+#ifdef PION_HAVE_COROUTINES
+
+#include <coroutine>
+#include <exception>
+#include <pion/logger.hpp>
+
+
+namespace pion {    // begin namespace pion
+
+
+///
+/// coroutine: return type of a coroutine that runs on its own once started
+/// (e.g. a request handler written with co_await).  The coroutine starts
+/// running immediately, and its frame is destroyed when it finishes.
+/// Exceptions that escape the coroutine are logged
+///
+class coroutine
+{
+public:
+
+    /// coroutine promise that never suspends at the start or the end
+    struct promise_type {
+        inline coroutine get_return_object(void) { return coroutine(); }
+        inline std::suspend_never initial_suspend(void) const noexcept { return std::suspend_never(); }
+        inline std::suspend_never final_suspend(void) const noexcept { return std::suspend_never(); }
+        inline void return_void(void) {}
+        inline void unhandled_exception(void) {
+            try {
+                throw;
+            } catch (std::exception& e) {
+                PION_LOG_ERROR(PION_GET_LOGGER("pion.coroutine"), e.what());
+            } catch (...) {
+                PION_LOG_ERROR(PION_GET_LOGGER("pion.coroutine"), "caught unrecognized exception");
+            }
+        }
+    };
+};
+
+
+///
+/// resume_handler: completion handler that stores the result of an
+/// asynchronous operation and resumes the coroutine that awaits it
+///
+template <typename Result>
+class resume_handler
+{
+public:
+
+    /**
+     * creates a handler for an operation
+     *
+     * @param result where the operation's result is stored
+     * @param handle the coroutine to resume when the operation finishes
+     */
+    resume_handler(Result *result, std::coroutine_handle<> handle)
+        : m_result(result), m_handle(handle)
+    {}
+
+    /// stores the result of an operation that finished and resumes the coroutine
+    template <typename... Args>
+    inline void operator()(Args&&... args) {
+        m_result->set(std::forward<Args>(args)...);
+        m_handle.resume();
+    }
+
+private:
+
+    /// where the operation's result is stored
+    Result *                    m_result;
+
+    /// the coroutine to resume when the operation finishes
+    std::coroutine_handle<>     m_handle;
+};
+
+
+}   // end namespace pion
+
+#endif  // PION_HAVE_COROUTINES
+
+#endif
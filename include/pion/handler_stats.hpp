@@ -0,0 +1,36 @@
+// ---------------------------------------------------------------------
+// pion:  a Boost C++ framework for building lightweight HTTP interfaces
+// ---------------------------------------------------------------------
+// Copyright (C) 2021 Wang Qiang  (https://github.com/dnybz/pion)
+// Copyright (C) 2007-2014 Splunk Inc.  (https://github.com/splunk/pion)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+//
+
+#ifndef __PION_HANDLER_STATS_HEADER__
+#define __PION_HANDLER_STATS_HEADER__
+
+#include <pion/config.hpp>
+
+
+namespace pion {    // begin namespace pion
+
+
+///
+/// handler_stats: hooks that code running on a scheduler's threads uses to
+/// keep the scheduler's statistics accurate, without depending on the
+/// scheduler itself (implemented in scheduler.cpp)
+///
+struct PION_API handler_stats {
+
+    /// called when a handler starts to run, so that the time a thread spent
+    /// waiting for it is not counted as handler run time (used by
+    /// tcp::alloc_handler; cheap when the thread was not waiting)
+    static void handler_started(void);
+};
+
+
+}   // end namespace pion
+
+#endif
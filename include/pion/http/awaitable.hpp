@@ -0,0 +1,183 @@
+// ---------------------------------------------------------------------
+// pion:  a Boost C++ framework for building lightweight HTTP interfaces
+// ---------------------------------------------------------------------
+// Copyright (C) 2021 Wang Qiang  (https://github.com/dnybz/pion)
+// Copyright (C) 2007-2014 Splunk Inc.  (https://github.com/splunk/pion)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+//
+
+#ifndef __PION_HTTP_AWAITABLE_HEADER__
+#define __PION_HTTP_AWAITABLE_HEADER__
+
+#include <pion/coroutine.hpp>
+
+#ifdef PION_HAVE_COROUTINES
+
+#include <functional>
+#include <pion/tcp/awaitable.hpp>
+#include <pion/http/request_reader.hpp>
+#include <pion/http/writer.hpp>
+
+
+namespace pion {    // begin namespace pion
+namespace http {    // begin namespace http
+
+
+/// coroutine-style request handler: same arguments as
+/// http::server::request_handler_t, but returns a pion::coroutine.  Since the
+/// coroutine starts immediately and then runs on its own, such handlers may
+/// be passed to http::server::add_resource() like any other request handler.
+/// The arguments are taken by value so that the coroutine frame keeps the
+/// request and connection alive (references would dangle after a co_await)
+typedef std::function<pion::coroutine(http::request_ptr, tcp::connection_ptr)>
+    coroutine_handler_t;
+
+
+///
+/// read_result: result of reading an HTTP request (see async_read_request())
+///
+struct read_result {
+
+    /// stores the result of a finished read
+    inline void set(const http::request_ptr& request, const tcp::connection_ptr& /* tcp_conn */,
+                    const asio::error_code& ec)
+    {
+        m_request = request;
+        m_error = ec;
+    }
+
+    /// the request that was read (check is_valid() before using it)
+    http::request_ptr   m_request;
+
+    /// error status of the read operation
+    asio::error_code    m_error;
+};
+
+
+///
+/// read_request_awaitable: reads and parses the next HTTP request from a connection
+///
+class read_request_awaitable
+{
+public:
+
+    explicit read_request_awaitable(const tcp::connection_ptr& tcp_conn)
+        : m_tcp_conn(tcp_conn)
+    {}
+
+    inline bool await_ready(void) const { return false; }
+
+    inline void await_suspend(std::coroutine_handle<> handle) {
+        request_reader::create(m_tcp_conn, resume_handler<read_result>(&m_result, handle))->receive();
+    }
+
+    inline read_result await_resume(void) { return std::move(m_result); }
+
+private:
+
+    /// the connection to read from
+    tcp::connection_ptr     m_tcp_conn;
+
+    /// result of the operation
+    read_result             m_result;
+};
+
+
+///
+/// send_awaitable: sends the data buffered in a writer (see async_send())
+///
+class send_awaitable
+{
+public:
+
+    /// which of the writer's send functions is used
+    enum send_type { SEND_MESSAGE, SEND_CHUNK, SEND_FINAL_CHUNK };
+
+    send_awaitable(const writer_ptr& writer, send_type type)
+        : m_writer(writer), m_type(type)
+    {}
+
+    /// finishes without waiting if the connection has already been lost,
+    /// since the writer would not call the send handler
+    inline bool await_ready(void) {
+        if (m_writer->get_connection()->is_open())
+            return false;
+        m_result.set(make_error_code(asio::error::connection_reset), 0);
+        return true;
+    }
+
+    inline void await_suspend(std::coroutine_handle<> handle) {
+        resume_handler<tcp::io_result> handler(&m_result, handle);
+        switch (m_type) {
+        case SEND_MESSAGE: m_writer->send(handler); break;
+        case SEND_CHUNK: m_writer->send_chunk(handler); break;
+        case SEND_FINAL_CHUNK: m_writer->send_final_chunk(handler); break;
+        }
+    }
+
+    inline tcp::io_result await_resume(void) const { return m_result; }
+
+private:
+
+    /// the writer that sends the data (kept alive until the data has been sent)
+    writer_ptr              m_writer;
+
+    /// which of the writer's send functions is used
+    const send_type         m_type;
+
+    /// result of the operation
+    tcp::io_result          m_result;
+};
+
+
+/**
+ * reads and parses the next HTTP request from a connection: co_await the
+ * result to get a read_result
+ *
+ * @param tcp_conn the connection to read from
+ */
+inline read_request_awaitable async_read_request(const tcp::connection_ptr& tcp_conn) {
+    return read_request_awaitable(tcp_conn);
+}
+
+/**
+ * sends all data buffered in a writer as a single HTTP message: co_await the
+ * result to get a tcp::io_result.  As with writer::send(SendHandler), the
+ * coroutine must then end the connection by calling connection::finish()
+ *
+ * @param writer the writer that sends the data
+ */
+inline send_awaitable async_send(const writer_ptr& writer) {
+    return send_awaitable(writer, send_awaitable::SEND_MESSAGE);
+}
+
+/**
+ * sends all data buffered in a writer as a single HTTP chunk: co_await the
+ * result to get a tcp::io_result, then clear() the writer before writing
+ * the next chunk
+ *
+ * @param writer the writer that sends the data
+ */
+inline send_awaitable async_send_chunk(const writer_ptr& writer) {
+    return send_awaitable(writer, send_awaitable::SEND_CHUNK);
+}
+
+/**
+ * sends all data buffered in a writer (if any) and the final HTTP chunk:
+ * co_await the result to get a tcp::io_result
+ *
+ * @param writer the writer that sends the data
+ */
+inline send_awaitable async_send_final_chunk(const writer_ptr& writer) {
+    return send_awaitable(writer, send_awaitable::SEND_FINAL_CHUNK);
+}
+
+
+}   // end namespace http
+}   // end namespace pion
+
+#endif  // PION_HAVE_COROUTINES
+
+#endif
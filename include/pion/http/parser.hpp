@@ -272,6 +272,11 @@ public:
     /// returns true if the parser is being used to parse an HTTP request
     inline bool is_parsing_request(void) const { return m_is_request; }
 
+    /// returns true until the parser has finished parsing the HTTP headers
+    inline bool is_parsing_headers(void) const {
+        return m_message_parse_state == PARSE_START || m_message_parse_state == PARSE_HEADERS;
+    }
+
     /// returns true if the parser is being used to parse an HTTP response
     inline bool is_parsing_response(void) const { return ! m_is_request; }
 
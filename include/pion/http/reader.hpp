@@ -15,7 +15,6 @@
 #include <pion/http/parser.hpp>
 #include <pion/http/message.hpp>
 #include <pion/tcp/connection.hpp>
-#include <pion/tcp/timer.hpp>
 #include <asio.hpp>
 
 namespace pion {    // begin namespace pion
@@ -39,9 +38,27 @@ public:
     /// returns a shared pointer to the TCP connection
     inline tcp::connection_ptr& get_connection(void) { return m_tcp_conn; }
     
+    /// default maximum number of seconds for read operations
+    static const uint32_t            DEFAULT_READ_TIMEOUT;
+
+
     /// sets the maximum number of seconds for read operations
     inline void set_timeout(uint32_t seconds) { m_read_timeout = seconds; }
 
+    /// sets the maximum number of seconds for receiving the message headers
+    /// (0 = unlimited); unlike the read timeout, it does not restart when
+    /// data arrives
+    inline void set_header_timeout(uint32_t seconds) { m_header_timeout = seconds; }
+
+    /**
+     * sets the minimum rate at which the message body must arrive: it may take
+     * the read timeout, plus one second for every bytes_per_second bytes
+     * received.  The connection's timeout reason is set if a limit is exceeded
+     *
+     * @param bytes_per_second the minimum rate (0 = no minimum)
+     */
+    inline void set_min_body_rate(uint32_t bytes_per_second) { m_min_body_rate = bytes_per_second; }
+
     
 protected:
 
@@ -54,7 +71,9 @@ protected:
      */
     reader(const bool is_request, const tcp::connection_ptr& tcp_conn)
         : http::parser(is_request), m_tcp_conn(tcp_conn),
-        m_read_timeout(DEFAULT_READ_TIMEOUT)
+        m_read_timeout(DEFAULT_READ_TIMEOUT), m_header_timeout(0), m_min_body_rate(0),
+        m_header_deadline(0), m_body_start(0), m_limit(tcp::connection::TIMEOUT_NONE),
+        m_limit_deadline(0)
         {}  
     
     /**
@@ -92,18 +111,29 @@ private:
     void handle_read_error(const asio::error_code& read_error);
 
 
-    /// default maximum number of seconds for read operations
-    static const uint32_t            DEFAULT_READ_TIMEOUT;
-
-
     /// The HTTP connection that has a new HTTP message to parse
     tcp::connection_ptr                        m_tcp_conn;
     
-    /// pointer to a tcp::timer object if read timeouts are enabled
-    tcp::timer_ptr                             m_timer_ptr;
-
     /// maximum number of seconds for read operations
     uint32_t                         m_read_timeout;
+
+    /// maximum number of seconds for receiving the message headers (0 = unlimited)
+    uint32_t                         m_header_timeout;
+
+    /// minimum rate at which the message body must arrive (0 = no minimum)
+    uint32_t                         m_min_body_rate;
+
+    /// steady clock milliseconds by which the headers must have arrived (0 = none)
+    uint64_t                         m_header_deadline;
+
+    /// steady clock milliseconds when the body started to arrive (0 = not yet)
+    uint64_t                         m_body_start;
+
+    /// limit whose deadline is armed for the pending read (if any)
+    tcp::connection::timeout_type    m_limit;
+
+    /// steady clock milliseconds when the armed limit is exceeded
+    uint64_t                         m_limit_deadline;
 };
 
 
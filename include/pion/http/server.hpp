@@ -20,6 +20,7 @@
 #include <pion/http/request.hpp>
 #include <pion/http/auth.hpp>
 #include <pion/http/parser.hpp>
+#include <pion/http/reader.hpp>
 
 
 namespace pion {    // begin namespace pion
@@ -56,7 +57,10 @@ public:
         m_bad_request_handler(server::handle_bad_request),
         m_not_found_handler(server::handle_not_found_request),
         m_server_error_handler(server::handle_server_error),
-        m_max_content_length(http::parser::DEFAULT_CONTENT_MAX)
+        m_max_content_length(http::parser::DEFAULT_CONTENT_MAX),
+        m_keep_alive_timeout(DEFAULT_KEEP_ALIVE_TIMEOUT), m_max_keep_alive_requests(0),
+        m_read_timeout(http::reader::DEFAULT_READ_TIMEOUT),
+        m_header_timeout(DEFAULT_HEADER_TIMEOUT), m_min_body_rate(DEFAULT_MIN_BODY_RATE)
     { 
         set_logger(PION_GET_LOGGER("pion.http.server"));
     }
@@ -71,7 +75,10 @@ public:
         m_bad_request_handler(server::handle_bad_request),
         m_not_found_handler(server::handle_not_found_request),
         m_server_error_handler(server::handle_server_error),
-        m_max_content_length(http::parser::DEFAULT_CONTENT_MAX)
+        m_max_content_length(http::parser::DEFAULT_CONTENT_MAX),
+        m_keep_alive_timeout(DEFAULT_KEEP_ALIVE_TIMEOUT), m_max_keep_alive_requests(0),
+        m_read_timeout(http::reader::DEFAULT_READ_TIMEOUT),
+        m_header_timeout(DEFAULT_HEADER_TIMEOUT), m_min_body_rate(DEFAULT_MIN_BODY_RATE)
     { 
         set_logger(PION_GET_LOGGER("pion.http.server"));
     }
@@ -87,7 +94,10 @@ public:
         m_bad_request_handler(server::handle_bad_request),
         m_not_found_handler(server::handle_not_found_request),
         m_server_error_handler(server::handle_server_error),
-        m_max_content_length(http::parser::DEFAULT_CONTENT_MAX)
+        m_max_content_length(http::parser::DEFAULT_CONTENT_MAX),
+        m_keep_alive_timeout(DEFAULT_KEEP_ALIVE_TIMEOUT), m_max_keep_alive_requests(0),
+        m_read_timeout(http::reader::DEFAULT_READ_TIMEOUT),
+        m_header_timeout(DEFAULT_HEADER_TIMEOUT), m_min_body_rate(DEFAULT_MIN_BODY_RATE)
     { 
         set_logger(PION_GET_LOGGER("pion.http.server"));
     }
@@ -103,11 +113,53 @@ public:
         m_bad_request_handler(server::handle_bad_request),
         m_not_found_handler(server::handle_not_found_request),
         m_server_error_handler(server::handle_server_error),
-        m_max_content_length(http::parser::DEFAULT_CONTENT_MAX)
+        m_max_content_length(http::parser::DEFAULT_CONTENT_MAX),
+        m_keep_alive_timeout(DEFAULT_KEEP_ALIVE_TIMEOUT), m_max_keep_alive_requests(0),
+        m_read_timeout(http::reader::DEFAULT_READ_TIMEOUT),
+        m_header_timeout(DEFAULT_HEADER_TIMEOUT), m_min_body_rate(DEFAULT_MIN_BODY_RATE)
     { 
         set_logger(PION_GET_LOGGER("pion.http.server"));
     }
 
+#ifdef ASIO_HAS_LOCAL_SOCKETS
+    /**
+     * creates a new server object
+     * 
+     * @param endpoint Unix domain socket used to listen for new connections
+     */
+    explicit server(const asio::local::stream_protocol::endpoint& endpoint)
+        : tcp::server(endpoint),
+        m_bad_request_handler(server::handle_bad_request),
+        m_not_found_handler(server::handle_not_found_request),
+        m_server_error_handler(server::handle_server_error),
+        m_max_content_length(http::parser::DEFAULT_CONTENT_MAX),
+        m_keep_alive_timeout(DEFAULT_KEEP_ALIVE_TIMEOUT), m_max_keep_alive_requests(0),
+        m_read_timeout(http::reader::DEFAULT_READ_TIMEOUT),
+        m_header_timeout(DEFAULT_HEADER_TIMEOUT), m_min_body_rate(DEFAULT_MIN_BODY_RATE)
+    { 
+        set_logger(PION_GET_LOGGER("pion.http.server"));
+    }
+
+    /**
+     * creates a new server object
+     * 
+     * @param sched the scheduler that will be used to manage worker threads
+     * @param endpoint Unix domain socket used to listen for new connections
+     */
+    server(scheduler& sched, const asio::local::stream_protocol::endpoint& endpoint)
+        : tcp::server(sched, endpoint),
+        m_bad_request_handler(server::handle_bad_request),
+        m_not_found_handler(server::handle_not_found_request),
+        m_server_error_handler(server::handle_server_error),
+        m_max_content_length(http::parser::DEFAULT_CONTENT_MAX),
+        m_keep_alive_timeout(DEFAULT_KEEP_ALIVE_TIMEOUT), m_max_keep_alive_requests(0),
+        m_read_timeout(http::reader::DEFAULT_READ_TIMEOUT),
+        m_header_timeout(DEFAULT_HEADER_TIMEOUT), m_min_body_rate(DEFAULT_MIN_BODY_RATE)
+    { 
+        set_logger(PION_GET_LOGGER("pion.http.server"));
+    }
+#endif
+
     /**
      * adds a new web service to the HTTP server
      *
@@ -219,6 +271,56 @@ public:
     /// sets the maximum length for HTTP request payload content
     inline void set_max_content_length(std::size_t n) { m_max_content_length = n; }
 
+    /**
+     * sets the number of seconds that a kept-alive connection may stay idle
+     * waiting for its next request before it is closed
+     *
+     * @param seconds the idle timeout (0 = wait forever)
+     */
+    inline void set_keep_alive_timeout(uint32_t seconds) { m_keep_alive_timeout = seconds; }
+
+    /// returns the number of seconds that a kept-alive connection may stay idle
+    inline uint32_t get_keep_alive_timeout(void) const { return m_keep_alive_timeout; }
+
+    /**
+     * sets the maximum number of requests that are handled on one connection;
+     * the response to the last one closes the connection
+     *
+     * @param n the maximum number of requests per connection (0 = unlimited)
+     */
+    inline void set_max_keep_alive_requests(std::size_t n) { m_max_keep_alive_requests = n; }
+
+    /// returns the maximum number of requests that are handled on one connection
+    inline std::size_t get_max_keep_alive_requests(void) const { return m_max_keep_alive_requests; }
+
+    /// sets the maximum number of seconds that reading a request may wait for data
+    inline void set_read_timeout(uint32_t seconds) { m_read_timeout = seconds; }
+
+    /// returns the maximum number of seconds that reading a request may wait for data
+    inline uint32_t get_read_timeout(void) const { return m_read_timeout; }
+
+    /**
+     * sets the number of seconds within which a request's headers must have
+     * arrived, however often data trickles in (see get_header_timeouts())
+     *
+     * @param seconds the header timeout (0 = unlimited)
+     */
+    inline void set_header_timeout(uint32_t seconds) { m_header_timeout = seconds; }
+
+    /// returns the number of seconds within which a request's headers must arrive
+    inline uint32_t get_header_timeout(void) const { return m_header_timeout; }
+
+    /**
+     * sets the minimum rate at which request bodies must arrive, after an
+     * allowance of the read timeout (see get_body_rate_timeouts())
+     *
+     * @param bytes_per_second the minimum rate (0 = no minimum)
+     */
+    inline void set_min_body_rate(uint32_t bytes_per_second) { m_min_body_rate = bytes_per_second; }
+
+    /// returns the minimum rate at which request bodies must arrive
+    inline uint32_t get_min_body_rate(void) const { return m_min_body_rate; }
+
 protected:
 
     /**
@@ -228,6 +330,16 @@ protected:
      */
     virtual void handle_connection(const tcp::connection_ptr& tcp_conn);
 
+    /**
+     * called when a kept-alive connection becomes readable or its idle
+     * timeout expires
+     *
+     * @param tcp_conn the idle TCP connection
+     * @param ec error_code set if the connection was lost or timed out
+     */
+    virtual void handle_keep_alive_wait(const tcp::connection_ptr& tcp_conn,
+                                        const asio::error_code& ec);
+
     /**
      * handles a new HTTP request
      *
@@ -238,6 +350,14 @@ protected:
     virtual void handle_request(const http::request_ptr& http_request_ptr,
                                 const tcp::connection_ptr& tcp_conn, const asio::error_code& ec);
 
+    /**
+     * refuses a connection or request because the server is overloaded by
+     * sending a "503 Service Unavailable" response and closing the connection
+     *
+     * @param tcp_conn the TCP connection to refuse
+     */
+    virtual void handle_overload(const tcp::connection_ptr& tcp_conn);
+
     /**
      * searches for the appropriate request handler to use for a given resource
      *
@@ -250,9 +370,26 @@ protected:
 
 private:
 
+    /**
+     * reads the next HTTP request from a connection
+     *
+     * @param tcp_conn the TCP connection to read from
+     */
+    void read_request(const tcp::connection_ptr& tcp_conn);
+
+
     /// maximum number of redirections
     static const unsigned int   MAX_REDIRECTS;
 
+    /// default number of seconds that a kept-alive connection may stay idle
+    static const uint32_t       DEFAULT_KEEP_ALIVE_TIMEOUT;
+
+    /// default number of seconds within which a request's headers must arrive
+    static const uint32_t       DEFAULT_HEADER_TIMEOUT;
+
+    /// default minimum rate in bytes per second at which request bodies must arrive
+    static const uint32_t       DEFAULT_MIN_BODY_RATE;
+
     /// data type for a map of resources to request handlers
     typedef std::map<std::string, request_handler_t>    resource_map_t;
 
@@ -283,6 +420,21 @@ private:
 
     /// maximum length for HTTP request payload content
     std::size_t                 m_max_content_length;
+
+    /// number of seconds that a kept-alive connection may stay idle (0 = forever)
+    uint32_t                    m_keep_alive_timeout;
+
+    /// maximum number of requests that are handled on one connection (0 = unlimited)
+    std::size_t                 m_max_keep_alive_requests;
+
+    /// maximum number of seconds that reading a request may wait for data
+    uint32_t                    m_read_timeout;
+
+    /// number of seconds within which a request's headers must arrive (0 = unlimited)
+    uint32_t                    m_header_timeout;
+
+    /// minimum rate in bytes per second at which request bodies must arrive (0 = none)
+    uint32_t                    m_min_body_rate;
 };
 
 
@@ -51,7 +51,7 @@ protected:
         : m_logger(PION_GET_LOGGER("pion.http.writer")),
         m_tcp_conn(tcp_conn), m_content_length(0), m_stream_is_empty(true), 
         m_client_supports_chunks(true), m_sending_chunks(false),
-        m_sent_headers(false), m_finished(handler)
+        m_sent_headers(false), m_send_timeout(DEFAULT_SEND_TIMEOUT), m_finished(handler)
     {}
     
     /**
@@ -73,6 +73,9 @@ protected:
                                       
     /// returns a function bound to writer::handle_write()
     virtual write_handler_t bind_to_write_handler(void) = 0;
+
+    /// default number of seconds that sending may make no progress
+    static const uint32_t   DEFAULT_SEND_TIMEOUT;
     
     /// called after we have finished sending the HTTP message
     inline void finished_writing(const asio::error_code& ec) {
@@ -246,6 +249,18 @@ public:
     /// returns true if we are sending a chunked message to the client
     inline bool sending_chunked_message() const { return m_sending_chunks; }
     
+    /**
+     * sets the number of seconds that sending may make no progress because
+     * the peer stopped accepting data; the send then fails with
+     * asio::error::timed_out (see connection::arm_send_deadline())
+     *
+     * @param seconds the send-stall timeout (0 = wait forever)
+     */
+    inline void set_send_timeout(uint32_t seconds) { m_send_timeout = seconds; }
+
+    /// returns the number of seconds that sending may make no progress
+    inline uint32_t get_send_timeout(void) const { return m_send_timeout; }
+
     /// sets the logger to be used
     inline void set_logger(logger log_ptr) { m_logger = log_ptr; }
     
@@ -255,6 +270,36 @@ public:
     
 private:
 
+    ///
+    /// send_deadline_handler: disarms the connection's send deadline before
+    /// calling a send handler
+    ///
+    template <typename SendHandler>
+    class send_deadline_handler {
+    public:
+        send_deadline_handler(const tcp::connection_ptr& tcp_conn, SendHandler& handler)
+            : m_tcp_conn(tcp_conn), m_handler(handler)
+        {}
+        inline void operator()(const asio::error_code& write_error, std::size_t bytes_written) {
+            m_tcp_conn->disarm_send_deadline();
+            if (write_error == asio::error::operation_aborted
+                && m_tcp_conn->get_timeout_reason() == tcp::connection::TIMEOUT_SEND_STALL)
+            {
+                // the peer stopped accepting data: the connection is unusable
+                m_tcp_conn->set_lifecycle(tcp::connection::LIFECYCLE_CLOSE);
+                m_handler(asio::error_code(asio::error::timed_out), bytes_written);
+            } else {
+                m_handler(write_error, bytes_written);
+            }
+        }
+    private:
+        /// the connection that sends the data
+        tcp::connection_ptr     m_tcp_conn;
+        /// the send handler
+        SendHandler             m_handler;
+    };
+
+
     /**
      * sends all of the buffered data to the client
      *
@@ -272,7 +317,13 @@ private:
             http::message::write_buffers_t write_buffers;
             prepare_write_buffers(write_buffers, send_final_chunk);
             // send data in the write buffers
-            m_tcp_conn->async_write(write_buffers, send_handler);
+            if (m_send_timeout > 0) {
+                m_tcp_conn->arm_send_deadline(m_send_timeout * 1000);
+                m_tcp_conn->async_write(write_buffers,
+                                        send_deadline_handler<SendHandler>(m_tcp_conn, send_handler));
+            } else {
+                m_tcp_conn->async_write(write_buffers, send_handler);
+            }
         } else {
             finished_writing(asio::error::connection_reset);
         }
@@ -361,6 +412,9 @@ private:
     /// true if the HTTP message headers have already been sent
     bool                                    m_sent_headers;
 
+    /// number of seconds that sending may make no progress (0 = wait forever)
+    uint32_t                                m_send_timeout;
+
     /// function called after the HTTP message has been sent
     finished_handler_t                      m_finished;
 };
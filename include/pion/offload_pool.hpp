@@ -0,0 +1,174 @@
+// ---------------------------------------------------------------------
+// pion:  a Boost C++ framework for building lightweight HTTP interfaces
+// ---------------------------------------------------------------------
+// Copyright (C) 2021 Wang Qiang  (https://github.com/dnybz/pion)
+// Copyright (C) 2007-2014 Splunk Inc.  (https://github.com/splunk/pion)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+//
+
+#ifndef __PION_OFFLOAD_POOL_HEADER__
+#define __PION_OFFLOAD_POOL_HEADER__
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+#include <pion/config.hpp>
+#include <pion/logger.hpp>
+#include <pion/noncopyable.hpp>
+#include <pion/task.hpp>
+#include <asio.hpp>
+
+
+namespace pion {    // begin namespace pion
+
+
+///
+/// offload_pool: a bounded pool of threads for blocking work (disk I/O,
+/// hashing, slow computations), so that it does not stall the threads that
+/// run I/O services.  When the work has finished, its completion is posted
+/// back to the I/O service that the work came from
+///
+class PION_API offload_pool
+    : private pion::noncopyable
+{
+public:
+
+    /// function called on an I/O service after offloaded work; its argument
+    /// is asio::error::operation_aborted if the pool was stopped before the
+    /// work could run
+    typedef std::function<void(const asio::error_code&)>    completion_handler_t;
+
+    /// constructs a new offload pool (threads are started when first needed)
+    offload_pool(void);
+
+    /// stops the pool's threads
+    virtual ~offload_pool() { stop(); }
+
+    /**
+     * runs blocking work on one of the pool's threads, then posts its
+     * completion to an I/O service.  The completion runs even if the work
+     * throws an exception (which is logged); an empty completion is not posted
+     *
+     * @param service the I/O service that runs the completion (it must
+     *                outlive the work, or the pool must be stopped first)
+     * @param work the blocking work to be executed
+     * @param completion function called on the I/O service after the work
+     *
+     * @return false if the work was rejected because the queue is full (in
+     *         which case neither the work nor the completion will run)
+     */
+    bool offload(asio::io_service& service, task work, completion_handler_t completion);
+
+    /// stops the pool's threads after they finish the work that they are
+    /// running.  Work still waiting in the queue is discarded, and its
+    /// completion is posted with asio::error::operation_aborted
+    void stop(void);
+
+    /// sets the number of threads used for blocking work
+    inline void set_num_threads(const uint32_t n) { m_num_threads = n; }
+
+    /// returns the number of threads used for blocking work
+    inline uint32_t get_num_threads(void) const { return m_num_threads; }
+
+    /// sets the maximum number of tasks that may wait in the queue
+    inline void set_max_queue_size(const uint32_t n) { m_max_queue_size = n; }
+
+    /// returns the maximum number of tasks that may wait in the queue
+    inline uint32_t get_max_queue_size(void) const { return m_max_queue_size; }
+
+    /// returns the number of tasks waiting in the queue
+    inline uint32_t get_queue_depth(void) const { return m_queue_depth; }
+
+    /// returns the number of tasks that are running
+    inline uint32_t get_num_active(void) const { return m_num_active; }
+
+    /// returns the number of tasks that have finished
+    inline uint64_t get_num_completed(void) const { return m_num_completed; }
+
+    /// returns the number of tasks rejected because the queue was full
+    inline uint64_t get_num_rejected(void) const { return m_num_rejected; }
+
+    /// sets the logger to be used
+    inline void set_logger(logger log_ptr) { m_logger = log_ptr; }
+
+    /// returns the logger currently in use
+    inline logger get_logger(void) { return m_logger; }
+
+
+    /// default number of threads in the pool
+    static const uint32_t   DEFAULT_NUM_THREADS;
+
+    /// default maximum number of tasks waiting in the queue
+    static const uint32_t   DEFAULT_MAX_QUEUE_SIZE;
+
+
+private:
+
+    /// blocking work waiting to run
+    struct job_type {
+        /// the blocking work to be executed
+        task                    m_work;
+
+        /// function called on the I/O service after the work
+        completion_handler_t    m_completion;
+
+        /// the I/O service that runs the completion
+        asio::io_service *      m_service;
+    };
+
+    /// starts the pool's threads (assumes the pool lock is held)
+    void start(void);
+
+    /// thread function that runs blocking work until the pool is stopped
+    void run_jobs(void);
+
+
+    /// primary logging interface used by this class
+    logger                                      m_logger;
+
+    /// number of threads used for blocking work
+    uint32_t                                    m_num_threads;
+
+    /// maximum number of tasks that may wait in the queue
+    uint32_t                                    m_max_queue_size;
+
+    /// blocking work waiting to run
+    std::deque<job_type>                        m_jobs;
+
+    /// threads used for blocking work
+    std::vector<std::shared_ptr<std::thread> >  m_threads;
+
+    /// true while the pool's threads are running
+    bool                                        m_is_running;
+
+    /// number of tasks waiting in the queue
+    std::atomic<uint32_t>                       m_queue_depth;
+
+    /// number of tasks that are running
+    std::atomic<uint32_t>                       m_num_active;
+
+    /// number of tasks that have finished
+    std::atomic<uint64_t>                       m_num_completed;
+
+    /// number of tasks rejected because the queue was full
+    std::atomic<uint64_t>                       m_num_rejected;
+
+    /// mutex used to protect the queue and threads
+    std::mutex                                  m_mutex;
+
+    /// condition triggered when work is queued or the pool is stopped
+    std::condition_variable                     m_job_queued;
+};
+
+
+}   // end namespace pion
+
+#endif
@@ -12,7 +12,9 @@
 #define __PION_PROCESS_HEADER__
 
 #include <string>
+#include <vector>
 #include <mutex>
+#include <condition_variable>
 #include <pion/noncopyable.hpp>
 #include <pion/config.hpp>
 
@@ -56,6 +58,16 @@ public:
     /// fork process and run as a background daemon
     static void daemonize(void);
 
+    /**
+     * returns the listening sockets passed to the process by its service
+     * manager (systemd socket activation: LISTEN_FDS sockets from descriptor
+     * 3 on, if LISTEN_PID is this process).  The variables are removed so
+     * that child processes do not take the sockets as well
+     *
+     * @return std::vector<int> the listening sockets (empty if there are none)
+     */
+    static std::vector<int> get_listen_fds(void);
+
 #ifdef PION_WIN32
 
     class dumpfile_init_exception : public std::exception
@@ -12,11 +12,18 @@
 #define __PION_SCHEDULER_HEADER__
 
 #include <vector>
+#include <deque>
+#include <atomic>
+#include <functional>
+#include <memory>
 #include <stdint.h>
 #include <thread>
 #include <pion/noncopyable.hpp>
 #include <pion/config.hpp>
+#include <pion/handler_stats.hpp>
 #include <pion/logger.hpp>
+#include <pion/offload_pool.hpp>
+#include <pion/task.hpp>
 #include <asio.hpp>
 
 namespace pion {    // begin namespace pion
@@ -29,10 +36,191 @@ class PION_API scheduler :
 {
 public:
 
+    /// priority classes for posted work
+    enum priority_type {
+        PRIORITY_HIGH = 0,      ///< latency-sensitive control work (health checks, cleanup timers)
+        PRIORITY_NORMAL,        ///< ordinary work (the default)
+        PRIORITY_LOW,           ///< bulk work (file streaming, CPU-heavy plugin callbacks)
+        NUM_PRIORITIES          ///< number of priority classes
+    };
+
+    /// I/O engines used by the servers and connections of a scheduler
+    enum io_engine_type {
+        IO_ENGINE_REACTOR = 0,  ///< asio's reactor (epoll on Linux; the default)
+        IO_ENGINE_URING         ///< io_uring (Linux only; the reactor is used if it is unavailable)
+    };
+
+    ///
+    /// histogram: distribution of durations, counted in power-of-two buckets of
+    /// microseconds.  Bucket 0 counts durations of less than 1 microsecond, and
+    /// bucket n counts durations from 2^(n-1) up to 2^n microseconds (the last
+    /// bucket also counts anything longer)
+    ///
+    struct PION_API histogram {
+
+        /// number of buckets in the histogram
+        enum { NUM_BUCKETS = 24 };
+
+        /// constructs an empty histogram
+        histogram(void) { for (int n = 0; n < NUM_BUCKETS; ++n) m_buckets[n] = 0; }
+
+        /// returns the bucket that counts a duration
+        static uint32_t get_bucket(uint64_t usec);
+
+        /// returns the shortest duration counted by a bucket, in microseconds
+        static inline uint64_t get_bucket_min(uint32_t n) { return n == 0 ? 0 : (1ULL << (n - 1)); }
+
+        /// returns the total number of durations counted
+        uint64_t get_count(void) const;
+
+        /**
+         * returns an upper bound for a percentile of the durations
+         *
+         * @param percent the percentile to find (e.g. 99 for the 99th percentile)
+         *
+         * @return microseconds, or 0 if the histogram is empty
+         */
+        uint64_t get_percentile(double percent) const;
+
+        /// adds the counts of another histogram to this one
+        histogram& operator+=(const histogram& h);
+
+        /// number of durations counted in each bucket
+        uint64_t    m_buckets[NUM_BUCKETS];
+    };
+
+    ///
+    /// stats_type: snapshot of the work done by one scheduler thread, or by
+    /// all the threads that run one I/O service
+    ///
+    struct PION_API stats_type {
+
+        /// constructs empty statistics
+        stats_type(void)
+            : m_service(0), m_num_threads(0), m_queue_depth(0),
+            m_num_handlers(0), m_busy_nsec(0), m_idle_nsec(0)
+        {
+            for (int n = 0; n < NUM_PRIORITIES; ++n)
+                m_lane_tasks[n] = 0;
+        }
+
+        /// returns the fraction of time (0 to 1) that the threads spent running handlers
+        inline double get_utilization(void) const {
+            const uint64_t total = m_busy_nsec + m_idle_nsec;
+            return (total == 0 ? 0.0 : static_cast<double>(m_busy_nsec) / total);
+        }
+
+        /// adds another thread's statistics to this one
+        stats_type& operator+=(const stats_type& s);
+
+        /// number of the I/O service run by the threads
+        uint32_t        m_service;
+
+        /// number of threads included in the statistics
+        uint32_t        m_num_threads;
+
+        /// posted work that is waiting to run on the I/O service
+        uint32_t        m_queue_depth;
+
+        /// number of handlers executed (I/O completions and posted work)
+        uint64_t        m_num_handlers;
+
+        /// nanoseconds spent running handlers
+        uint64_t        m_busy_nsec;
+
+        /// nanoseconds spent waiting for something to do
+        uint64_t        m_idle_nsec;
+
+        /// time that posted work spent waiting before it started to run
+        histogram       m_queue_wait;
+
+        /// time taken to run each handler
+        histogram       m_run_time;
+
+        /// number of posted tasks run from each priority lane
+        uint64_t        m_lane_tasks[NUM_PRIORITIES];
+
+        /// time that posted work in each priority lane spent waiting
+        histogram       m_lane_wait[NUM_PRIORITIES];
+    };
+
+    ///
+    /// task_queue: posted work that is waiting to run, in one FIFO lane per
+    /// priority class.  Lanes are served in weighted round-robin order, but
+    /// once the oldest task of a lane has waited for longer than MAX_WAIT_MSEC,
+    /// the oldest of those tasks is served before anything else, so that lower
+    /// priority lanes never starve
+    ///
+    class PION_API task_queue
+        : private pion::noncopyable
+    {
+    public:
+
+        /// a task that has been posted
+        struct task_type {
+            /// work function to be executed
+            task                    m_work_func;
+
+            /// priority class of the task
+            priority_type           m_priority;
+
+            /// steady clock time (in nanoseconds) when the task was posted
+            int64_t                 m_posted;
+        };
+
+        /// constructs an empty queue
+        task_queue(void);
+
+        /**
+         * adds a task to the end of its priority lane
+         *
+         * @param work_func work function to be executed
+         * @param priority priority class of the work
+         */
+        void push(task&& work_func, priority_type priority);
+
+        /**
+         * removes the next task to run
+         *
+         * @param task assigned the task if there was one
+         *
+         * @return true if a task was removed from the queue
+         */
+        bool pop(task_type& task);
+
+        /// returns the number of tasks waiting in the queue
+        inline uint32_t size(void) const { return m_size.load(std::memory_order_relaxed); }
+
+        /// share of the tasks taken from each lane while all lanes are busy
+        static const uint32_t   LANE_WEIGHTS[NUM_PRIORITIES];
+
+        /// tasks that have waited this long are served before any others
+        static const uint32_t   MAX_WAIT_MSEC;
+
+    private:
+
+        /// mutex used to protect the lanes
+        std::mutex                  m_mutex;
+
+        /// tasks waiting in each priority lane
+        std::deque<task_type>       m_lanes[NUM_PRIORITIES];
+
+        /// weighted round-robin credit of each lane
+        int32_t                     m_credits[NUM_PRIORITIES];
+
+        /// number of tasks in all lanes (readable without locking)
+        std::atomic<uint32_t>       m_size;
+    };
+
+    /// counters updated by each scheduler thread (defined in scheduler.cpp)
+    struct thread_counters;
+
+
     /// constructs a new scheduler
     scheduler(void)
         : m_logger(PION_GET_LOGGER("pion.scheduler")),
-        m_num_threads(DEFAULT_NUM_THREADS), m_active_users(0), m_is_running(false)
+        m_num_threads(DEFAULT_NUM_THREADS), m_io_engine(IO_ENGINE_REACTOR),
+        m_active_users(0), m_is_running(false)
     {}
     
     /// virtual destructor
@@ -64,6 +252,41 @@ public:
     /// returns the number of threads currently in use
     inline uint32_t get_num_threads(void) const { return m_num_threads; }
 
+    /**
+     * pins the scheduler's threads to CPUs: thread n runs on cpus[n % cpus.size()].
+     * The per-thread state (each thread's I/O service with its reactor and
+     * run queue, and its statistics) is created on the thread's CPU, and so
+     * is the memory that a pinned thread touches first (asio's per-thread
+     * handler caches, and anything created by handlers running on it), so
+     * that the kernel allocates it on the thread's local NUMA node.  Takes
+     * effect for services created and threads started afterwards; an empty
+     * list disables pinning
+     *
+     * @param cpus list of CPU numbers to use for the threads
+     */
+    inline void set_cpu_affinity(const std::vector<uint32_t>& cpus) { m_cpu_affinity = cpus; }
+
+    /// returns the list of CPU numbers used for the threads (empty if not pinned)
+    inline const std::vector<uint32_t>& get_cpu_affinity(void) const { return m_cpu_affinity; }
+
+    /// sets the I/O engine used by tcp::server objects created afterwards
+    /// (and by their connections), so that engines can be compared on the
+    /// same workload
+    inline void set_io_engine(io_engine_type engine) { m_io_engine = engine; }
+
+    /// returns the I/O engine used by new tcp::server objects
+    inline io_engine_type get_io_engine(void) const { return m_io_engine; }
+
+    /// returns a snapshot of the statistics of each thread (indexed by thread number)
+    std::vector<stats_type> get_thread_stats(void) const;
+
+    /// returns a snapshot of the statistics of each I/O service (indexed by
+    /// service number), combining all the threads that run the service
+    std::vector<stats_type> get_service_stats(void) const;
+
+    /// resets the statistics of all threads to zero
+    void reset_stats(void);
+
     /// sets the logger to be used
     inline void set_logger(logger log_ptr) { m_logger = log_ptr; }
 
@@ -73,14 +296,80 @@ public:
     /// returns an async I/O service used to schedule work
     virtual asio::io_service& get_io_service(void) = 0;
     
+    /// returns the number of distinct async I/O services used to schedule work
+    virtual uint32_t get_num_services(void) const { return 1; }
+
     /**
-     * schedules work to be performed by one of the pooled threads
+     * returns a specific async I/O service used to schedule work
+     *
+     * @param n integer number representing the service object (< get_num_services())
+     */
+    virtual asio::io_service& get_io_service(uint32_t n) {
+        assert(n < get_num_services());
+        (void)n;
+        return get_io_service();
+    }
+    
+    /**
+     * schedules work to be performed by one of the pooled threads (with
+     * PRIORITY_NORMAL).  Work posted with a priority does not pass through
+     * this function, so a subclass that changes how work is scheduled must
+     * override both overloads
+     *
+     * @param work_func work function to be executed
+     */
+    virtual void post(task work_func) {
+        post(std::move(work_func), PRIORITY_NORMAL);
+    }
+
+    /**
+     * schedules work to be performed by one of the pooled threads, ahead of
+     * (or after) work of other priority classes that is already waiting
      *
      * @param work_func work function to be executed
+     * @param priority priority class of the work
      */
-    virtual void post(std::function<void()> work_func) {
-        get_io_service().post(work_func);
+    virtual void post(task work_func, priority_type priority) {
+        post_task(get_io_service(), m_task_queue, std::move(work_func), priority);
     }
+
+    /**
+     * runs blocking work on the offload pool, so that it does not stall an
+     * I/O service, then resumes with the completion on a specific I/O
+     * service (usually a connection's, so that its handlers stay on one thread)
+     *
+     * @param service the I/O service that runs the completion
+     * @param work the blocking work to be executed
+     * @param completion function called on the I/O service after the work
+     *                   (with asio::error::operation_aborted if the scheduler
+     *                   shuts down before the work runs)
+     *
+     * @return false if the work was rejected because the offload queue is full
+     */
+    inline bool offload(asio::io_service& service, task work,
+                        offload_pool::completion_handler_t completion)
+    {
+        return m_offload_pool.offload(service, std::move(work), std::move(completion));
+    }
+
+    /// returns the pool of threads used for blocking work (to configure its
+    /// size and queue limit, and to read its queue depth and rejections)
+    inline offload_pool& get_offload_pool(void) { return m_offload_pool; }
+
+    /**
+     * notifies the scheduler that a connection is now using an I/O service,
+     * so that it may be taken into account when balancing new work
+     *
+     * @param service the I/O service used by the connection
+     */
+    virtual void connection_opened(asio::io_service& service) { (void)service; }
+
+    /**
+     * notifies the scheduler that a connection is no longer using an I/O service
+     *
+     * @param service the I/O service that was used by the connection
+     */
+    virtual void connection_closed(asio::io_service& service) { (void)service; }
     
     /**
      * thread function used to keep the io_service running
@@ -123,6 +412,35 @@ public:
     /// processes work passed to the asio service & handles uncaught exceptions
     void process_service_work(asio::io_service& service);
 
+    /**
+     * runs one handler that is ready, without blocking, and counts it in the
+     * current thread's statistics
+     *
+     * @param service the I/O service to run
+     *
+     * @return the number of handlers executed (0 or 1)
+     */
+    static std::size_t poll_one_handler(asio::io_service& service);
+
+    /**
+     * waits until a handler is ready and runs it, counting the waiting time
+     * and the handler in the current thread's statistics
+     *
+     * @param service the I/O service to run
+     *
+     * @return the number of handlers executed (0 if the service was stopped)
+     */
+    static std::size_t run_one_handler(asio::io_service& service);
+
+    /**
+     * pins the calling thread to the CPU configured for a scheduler thread
+     *
+     * @param n integer number representing the scheduler thread
+     *
+     * @return true if the thread was pinned to a CPU
+     */
+    bool set_thread_affinity(uint32_t n);
+
 
 protected:
     /// stops all services used to schedule work
@@ -136,6 +454,58 @@ protected:
 
     /// finishes all threads used to perform work
     virtual void finish_threads(void) {}
+
+    /**
+     * returns the number of posted tasks that are waiting to run
+     *
+     * @param n integer number representing the service object
+     */
+    virtual uint32_t get_queue_depth(uint32_t n) const { (void)n; return m_task_queue.size(); }
+
+    /**
+     * runs a function on a temporary thread that is pinned to the CPU of a
+     * scheduler thread, so that the memory it touches first is allocated on
+     * that CPU's NUMA node (the function runs on the calling thread if the
+     * threads are not pinned)
+     *
+     * @param n integer number representing the scheduler thread
+     * @param func the function to run
+     */
+    void run_pinned(uint32_t n, const std::function<void()>& func);
+
+    /**
+     * makes the calling thread update the statistics of a scheduler thread
+     *
+     * @param n integer number representing the scheduler thread
+     */
+    void attach_thread_counters(uint32_t n);
+
+    /**
+     * adds work to a task queue, and posts a handler to an I/O service that
+     * will run the queue's next task (which may be a different one, if work
+     * with a higher priority was posted in the meantime)
+     *
+     * @param service the I/O service that runs the work
+     * @param queue the queue that holds the work until it runs
+     * @param work_func work function to be executed
+     * @param priority priority class of the work
+     */
+    static void post_task(asio::io_service& service, task_queue& queue,
+                          task&& work_func, priority_type priority);
+
+    /**
+     * runs the next task from a queue, if there is one
+     *
+     * @param queue the queue to take the task from
+     */
+    static void run_next_task(task_queue *queue);
+
+    /**
+     * runs a posted task, counting its queue wait in the current thread's statistics
+     *
+     * @param task the task to run
+     */
+    static void run_task(task_queue::task_type& task);
     
     
     /// default number of worker threads in the thread pool
@@ -166,9 +536,27 @@ protected:
     /// total number of worker threads in the pool
     uint32_t                 m_num_threads;
 
+    /// CPUs that the worker threads are pinned to (empty if not pinned)
+    std::vector<uint32_t>    m_cpu_affinity;
+
+    /// I/O engine used by new tcp::server objects
+    io_engine_type           m_io_engine;
+
     /// the scheduler will not shutdown until there are no more active users
     uint32_t                 m_active_users;
 
+    /// posted work that is waiting to run (for schedulers with one service)
+    task_queue               m_task_queue;
+
+    /// pool of threads used for blocking work
+    offload_pool             m_offload_pool;
+
+    /// mutex used to protect the thread counters
+    mutable std::mutex       m_stats_mutex;
+
+    /// counters for each thread, indexed by thread number
+    std::vector<std::shared_ptr<thread_counters> >  m_thread_counters;
+
     /// true if the thread scheduler is running
     bool                            m_is_running;
 };
@@ -211,6 +599,27 @@ protected:
     /// finishes all threads used to perform work
     virtual void finish_threads(void) { m_thread_pool.clear(); }
 
+    /**
+     * starts a new worker thread, which is placed on its CPU (if any) before
+     * running the thread function
+     *
+     * @param n integer number representing the thread
+     * @param thread_func function executed by the new thread
+     */
+    inline void create_thread(uint32_t n, const std::function<void()>& thread_func) {
+        std::shared_ptr<std::thread> new_thread(new std::thread( std::bind(&multi_thread_scheduler::run_thread,
+                                                                           this, n, thread_func) ));
+        m_thread_pool.push_back(new_thread);
+    }
+
+    /// pins the current thread to its CPU and attaches its statistics, then
+    /// runs the thread function
+    inline void run_thread(uint32_t n, const std::function<void()>& thread_func) {
+        set_thread_affinity(n);
+        attach_thread_counters(n);
+        thread_func();
+    }
+
     
     /// typedef for a pool of worker threads
     typedef std::vector<std::shared_ptr<std::thread> >  ThreadPool;
@@ -271,25 +680,20 @@ public:
     
     /// constructs a new one_to_one_scheduler
     one_to_one_scheduler(void)
-        : m_service_pool(), m_next_service(0)
+        : m_service_pool()
     {}
     
     /// virtual destructor
     virtual ~one_to_one_scheduler() { shutdown(); }
     
-    /// returns an async I/O service used to schedule work
+    /// returns the least loaded of two randomly chosen async I/O services
     virtual asio::io_service& get_io_service(void) {
-        std::unique_lock<std::mutex> scheduler_lock(m_mutex);
-        while (m_service_pool.size() < m_num_threads) {
-            std::shared_ptr<service_pair_type>  service_ptr(new service_pair_type());
-            m_service_pool.push_back(service_ptr);
-        }
-        if (++m_next_service >= m_num_threads)
-            m_next_service = 0;
-        assert(m_next_service < m_num_threads);
-        return m_service_pool[m_next_service]->first;
+        return select_service()->first;
     }
     
+    /// returns the number of distinct async I/O services used to schedule work
+    virtual uint32_t get_num_services(void) const { return m_num_threads; }
+
     /**
      * returns an async I/O service used to schedule work (provides direct
      * access to avoid locking when possible)
@@ -298,10 +702,32 @@ public:
      */
     virtual asio::io_service& get_io_service(uint32_t n) {
         assert(n < m_num_threads);
-        assert(n < m_service_pool.size());
-        return m_service_pool[n]->first;
+        service_pool_ptr pool_ptr(get_service_pool());
+        if (! pool_ptr || n >= pool_ptr->size()) {
+            std::unique_lock<std::mutex> scheduler_lock(m_mutex);
+            pool_ptr = create_services();
+        }
+        assert(n < pool_ptr->size());
+        return (*pool_ptr)[n]->first;
     }
 
+    using scheduler::post;
+
+    /**
+     * schedules work to be performed by the thread of the least loaded
+     * of two randomly chosen I/O services
+     *
+     * @param work_func work function to be executed
+     * @param priority priority class of the work
+     */
+    virtual void post(task work_func, priority_type priority);
+
+    /// counts a connection against the load of an I/O service
+    virtual void connection_opened(asio::io_service& service);
+
+    /// stops counting a connection against the load of an I/O service
+    virtual void connection_closed(asio::io_service& service);
+
     /// Starts the thread scheduler (this is called automatically when necessary)
     virtual void startup(void);
     
@@ -310,33 +736,223 @@ protected:
     
     /// stops all services used to schedule work
     virtual void stop_services(void) {
-        for (service_pool_type::iterator i = m_service_pool.begin(); i != m_service_pool.end(); ++i) {
-            (*i)->first.stop();
+        const service_pool_ptr pool_ptr(get_service_pool());
+        if (pool_ptr) {
+            for (service_pool_type::const_iterator i = pool_ptr->begin(); i != pool_ptr->end(); ++i)
+                (*i)->first.stop();
         }
     }
         
-    /// finishes all services used to schedule work
-    virtual void finish_services(void) { m_service_pool.clear(); }
+    /// finishes all services used to schedule work (they are destroyed once
+    /// no lock-free reader is using them any more)
+    virtual void finish_services(void) {
+        std::atomic_store(&m_service_pool, service_pool_ptr());
+    }
+
+    /// returns the number of posted tasks that are waiting to run on a service
+    virtual uint32_t get_queue_depth(uint32_t n) const {
+        const service_pool_ptr pool_ptr(get_service_pool());
+        return (pool_ptr && n < pool_ptr->size() ? (*pool_ptr)[n]->m_tasks.size() : 0);
+    }
     
 
-    /// typedef for a pair object where first is an IO service and second is a deadline timer
+    /// typedef for a pair object where first is an IO service and second is a
+    /// deadline timer, along with the work posted to the service and a counter
+    /// used to estimate the service's load
     struct service_pair_type {
-        service_pair_type(void) : first(), second(first) {}
+        service_pair_type(void) : m_tasks(), first(), second(first), m_num_connections(0) {}
+        inline uint32_t get_load(void) const { return m_num_connections + m_tasks.size(); }
+        task_queue               m_tasks;
         asio::io_service         first;
 		asio::steady_timer     second;
+        std::atomic<uint32_t>    m_num_connections;
     };
     
     /// typedef for a pool of IO services
     typedef std::vector<std::shared_ptr<service_pair_type> >        service_pool_type;
 
+    /// typedef for a pool of IO services that is shared with lock-free readers
+    typedef std::shared_ptr<const service_pool_type>                service_pool_ptr;
+
     
-    /// pool of IO services used to schedule work
-    service_pool_type   m_service_pool;
+    /// returns the pool of IO services (empty if there is none) without locking
+    inline service_pool_ptr get_service_pool(void) const {
+        return std::atomic_load(&m_service_pool);
+    }
 
-    /// the next service to use for scheduling work
-    uint32_t     m_next_service;
+    /// makes sure there is one service per thread, and returns the pool
+    /// (assumes the scheduler lock is held)
+    service_pool_ptr create_services(void);
+
+    /// returns the less loaded of two randomly chosen services ("power of two choices")
+    std::shared_ptr<service_pair_type> select_service(void);
+
+    /// returns the pool entry for an I/O service, or an empty pointer if it is not one of ours
+    std::shared_ptr<service_pair_type> find_service(const asio::io_service& service);
+
+    
+    /// pool of IO services used to schedule work.  A pool is never changed
+    /// once it has been published: it is replaced as a whole (holding the
+    /// scheduler lock), so that threads that read it without locking always
+    /// see a complete pool, which stays alive while they use it
+    service_pool_ptr        m_service_pool;
 };
     
+
+
+///
+/// work_stealing_scheduler: uses a single IO service for each thread, plus a
+/// local run queue per thread for work that is posted to the scheduler.  Idle
+/// threads steal posted work from busy threads, while I/O completions always
+/// run on the thread that owns the socket's IO service
+/// 
+class PION_API work_stealing_scheduler :
+    public multi_thread_scheduler
+{
+public:
+    
+    /// constructs a new work_stealing_scheduler
+    work_stealing_scheduler(void)
+        : m_worker_pool(), m_next_service(0)
+    {}
+    
+    /// virtual destructor
+    virtual ~work_stealing_scheduler() { shutdown(); }
+    
+    /// returns an async I/O service used to schedule work
+    virtual asio::io_service& get_io_service(void) {
+        const uint32_t n = m_next_service.fetch_add(1, std::memory_order_relaxed);
+        return get_io_service(n % m_num_threads);
+    }
+    
+    /// returns the number of distinct async I/O services used to schedule work
+    virtual uint32_t get_num_services(void) const { return m_num_threads; }
+
+    /**
+     * returns an async I/O service used to schedule work (provides direct
+     * access to avoid locking when possible)
+     *
+     * @param n integer number representing the service object
+     */
+    virtual asio::io_service& get_io_service(uint32_t n) {
+        assert(n < m_num_threads);
+        return get_worker(n)->m_service;
+    }
+
+    /**
+     * schedules work to be performed by one of the pooled threads.  Work
+     * posted from a worker thread is queued locally to that thread, and
+     * may be stolen by other threads that have nothing else to do
+     *
+     * @param work_func work function to be executed
+     * @param priority priority class of the work
+     */
+    virtual void post(task work_func, priority_type priority);
+
+    using scheduler::post;
+
+    /// Starts the thread scheduler (this is called automatically when necessary)
+    virtual void startup(void);
+    
+    
+protected:
+    
+    /// stops all services used to schedule work
+    virtual void stop_services(void);
+        
+    /// finishes all services used to schedule work (they are destroyed once
+    /// no lock-free reader is using them any more)
+    virtual void finish_services(void) {
+        std::atomic_store(&m_worker_pool, worker_pool_ptr());
+    }
+
+    /// returns the number of posted tasks that are waiting in a worker's run queue
+    virtual uint32_t get_queue_depth(uint32_t n) const {
+        const worker_pool_ptr pool_ptr(get_worker_pool());
+        return (pool_ptr && n < pool_ptr->size() ? (*pool_ptr)[n]->m_tasks.size() : 0);
+    }
+    
+    
+    /// state for each worker thread: its IO service and local run queue
+    struct worker_type {
+        worker_type(void)
+            : m_service(), m_timer(m_service), m_is_idle(false)
+        {}
+
+        /// service used to manage async I/O events for this thread
+        asio::io_service                    m_service;
+
+        /// timer used to keep the IO service active while running
+        asio::steady_timer                  m_timer;
+
+        /// work that has been posted to this thread
+        task_queue                          m_tasks;
+
+        /// true while the thread is blocked waiting for I/O events
+        std::atomic<bool>                   m_is_idle;
+    };
+
+    /// data type for a pool of worker threads' state
+    typedef std::vector<std::shared_ptr<worker_type> >    worker_pool_type;
+
+    /// data type for a pool of worker threads' state that is shared with lock-free readers
+    typedef std::shared_ptr<const worker_pool_type>       worker_pool_ptr;
+
+
+    /// returns the pool of worker thread state (empty if there is none) without locking
+    inline worker_pool_ptr get_worker_pool(void) const {
+        return std::atomic_load(&m_worker_pool);
+    }
+
+    /// makes sure there is one worker per thread, and returns the pool
+    /// (assumes the scheduler lock is held)
+    worker_pool_ptr create_workers(void);
+
+    /**
+     * returns a worker's state, creating the workers if necessary
+     *
+     * @param n integer number representing the worker
+     */
+    std::shared_ptr<worker_type> get_worker(uint32_t n);
+
+    /**
+     * thread function that runs I/O events and posted work for one worker
+     *
+     * @param n integer number representing the worker
+     */
+    void process_worker_work(uint32_t n);
+
+    /**
+     * steals a task that was posted to another worker
+     *
+     * @param pool the pool of workers to steal from
+     * @param n integer number representing the worker that is stealing
+     * @param task assigned the task if one was found
+     *
+     * @return true if a task was stolen
+     */
+    static bool steal_task(const worker_pool_type& pool, uint32_t n, task_queue::task_type& task);
+
+    /// returns true if there is posted work waiting in any of a pool's run queues
+    static bool has_queued_tasks(const worker_pool_type& pool);
+
+    /**
+     * runs a posted task, counting it and its run time in the current
+     * thread's statistics
+     *
+     * @param task the task to run
+     */
+    static void run_worker_task(task_queue::task_type& task);
+
+    
+    /// pool of worker thread state (IO services and run queues).  As with
+    /// one_to_one_scheduler's pool, it is never changed once it has been
+    /// published, but replaced as a whole while holding the scheduler lock
+    worker_pool_ptr         m_worker_pool;
+
+    /// the next service to use for scheduling work
+    std::atomic<uint32_t>   m_next_service;
+};
     
 }   // end namespace pion
 
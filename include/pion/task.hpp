@@ -0,0 +1,242 @@
+// ---------------------------------------------------------------------
+// pion:  a Boost C++ framework for building lightweight HTTP interfaces
+// ---------------------------------------------------------------------
+// Copyright (C) 2021 Wang Qiang  (https://github.com/dnybz/pion)
+// Copyright (C) 2007-2014 Splunk Inc.  (https://github.com/splunk/pion)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+//
+
+#ifndef __PION_TASK_HEADER__
+#define __PION_TASK_HEADER__
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+
+namespace pion {    // begin namespace pion
+
+
+///
+/// task: a move-only function object that takes no arguments, used for work
+/// that is deferred to a scheduler.  Function objects of up to INLINE_SIZE
+/// bytes are stored inside the task, so wrapping a lambda never allocates
+/// memory; and since tasks are moved rather than copied, captures may be
+/// move-only (e.g. unique_ptr) and captured shared_ptrs are never copied
+///
+class task
+{
+public:
+
+    /// maximum size of a function object that is stored without allocating memory
+    enum { INLINE_SIZE = 64 };
+
+
+    /// constructs an empty task
+    task(void) : m_ops(NULL) {}
+
+    /// constructs an empty task
+    task(std::nullptr_t) : m_ops(NULL) {}
+
+    /**
+     * constructs a task that calls a function object
+     *
+     * @param f function object (or function pointer) called by the task
+     */
+    template <typename Function,
+              typename = typename std::enable_if<
+                  ! std::is_same<typename std::decay<Function>::type, task>::value>::type>
+    task(Function&& f) : m_ops(NULL) {
+        typedef typename std::decay<Function>::type function_type;
+        store<function_type>(std::forward<Function>(f),
+                             std::integral_constant<bool, fits_inline<function_type>::value>());
+    }
+
+    /// move constructor (never throws: function objects are only stored
+    /// inside the task if moving them cannot throw)
+    task(task&& t) noexcept : m_ops(t.m_ops) {
+        if (m_ops) {
+            m_ops->move(&m_storage, &t.m_storage);
+            t.m_ops = NULL;
+        }
+    }
+
+    /// move assignment operator (never throws)
+    task& operator=(task&& t) noexcept {
+        if (this != &t) {
+            reset();
+            if (t.m_ops) {
+                t.m_ops->move(&m_storage, &t.m_storage);
+                m_ops = t.m_ops;
+                t.m_ops = NULL;
+            }
+        }
+        return *this;
+    }
+
+    /// makes the task empty
+    task& operator=(std::nullptr_t) {
+        reset();
+        return *this;
+    }
+
+    /// destroys the function object
+    ~task() { reset(); }
+
+    /// calls the function object (throws std::bad_function_call if empty)
+    inline void operator()(void) {
+        if (m_ops == NULL)
+            throw std::bad_function_call();
+        m_ops->invoke(&m_storage);
+    }
+
+    /// returns true if the task has a function object
+    inline explicit operator bool(void) const { return m_ops != NULL; }
+
+    /// destroys the function object, making the task empty
+    inline void reset(void) {
+        if (m_ops) {
+            m_ops->destroy(&m_storage);
+            m_ops = NULL;
+        }
+    }
+
+
+private:
+
+    /// tasks are not copyable
+    task(const task&);
+    task& operator=(const task&);
+
+    /// data type used to store the function object (or a pointer to it)
+    typedef std::aligned_storage<INLINE_SIZE>::type     storage_type;
+
+    /// operations on the stored function object
+    struct ops_type {
+        void (*invoke)(void *storage);
+        void (*move)(void *to, void *from);
+        void (*destroy)(void *storage);
+    };
+
+    /// true if a function object type can be stored inside the task
+    template <typename Function>
+    struct fits_inline : std::integral_constant<bool,
+        sizeof(Function) <= sizeof(storage_type)
+        && std::alignment_of<storage_type>::value % std::alignment_of<Function>::value == 0
+        && std::is_nothrow_move_constructible<Function>::value>
+    {};
+
+    /// operations on a function object that is stored inside the task
+    template <typename Function>
+    struct inline_ops {
+        static void invoke(void *storage) { (*static_cast<Function*>(storage))(); }
+        static void move(void *to, void *from) {
+            new (to) Function(std::move(*static_cast<Function*>(from)));
+            static_cast<Function*>(from)->~Function();
+        }
+        static void destroy(void *storage) { static_cast<Function*>(storage)->~Function(); }
+        static const ops_type *get(void) {
+            static const ops_type ops = { &invoke, &move, &destroy };
+            return &ops;
+        }
+    };
+
+    /// true if a function object type needs more alignment than operator new
+    /// provides (before C++17, new ignores extended alignment)
+    template <typename Function>
+    struct is_over_aligned : std::integral_constant<bool,
+        (std::alignment_of<Function>::value > std::alignment_of<std::max_align_t>::value)>
+    {};
+
+    /// operations on a function object that is allocated on the heap
+    template <typename Function>
+    struct heap_ops {
+        static Function *& ptr(void *storage) { return *static_cast<Function**>(storage); }
+        static void invoke(void *storage) { (*ptr(storage))(); }
+        static void move(void *to, void *from) { new (to) Function*(ptr(from)); }
+        static void destroy(void *storage) { delete ptr(storage); }
+        static const ops_type *get(void) {
+            static const ops_type ops = { &invoke, &move, &destroy };
+            return &ops;
+        }
+    };
+
+    /// operations on an over-aligned function object that is constructed
+    /// inside a larger block of heap memory, at an address aligned for it
+    template <typename Function>
+    struct aligned_heap_ops {
+        struct holder_type {
+            Function *  m_ptr;
+            void *      m_memory;
+        };
+        static holder_type& holder(void *storage) { return *static_cast<holder_type*>(storage); }
+        static void invoke(void *storage) { (*holder(storage).m_ptr)(); }
+        static void move(void *to, void *from) { new (to) holder_type(holder(from)); }
+        static void destroy(void *storage) {
+            holder(storage).m_ptr->~Function();
+            ::operator delete(holder(storage).m_memory);
+        }
+        static const ops_type *get(void) {
+            static const ops_type ops = { &invoke, &move, &destroy };
+            return &ops;
+        }
+    };
+
+    /// stores a function object inside the task
+    template <typename Function, typename Arg>
+    inline void store(Arg&& f, std::true_type) {
+        new (&m_storage) Function(std::forward<Arg>(f));
+        m_ops = inline_ops<Function>::get();
+    }
+
+    /// stores a function object on the heap
+    template <typename Function, typename Arg>
+    inline void store(Arg&& f, std::false_type) {
+        store_on_heap<Function>(std::forward<Arg>(f),
+                                std::integral_constant<bool, is_over_aligned<Function>::value>());
+    }
+
+    /// stores a function object that needs no extended alignment on the heap
+    template <typename Function, typename Arg>
+    inline void store_on_heap(Arg&& f, std::false_type) {
+        new (&m_storage) Function*(new Function(std::forward<Arg>(f)));
+        m_ops = heap_ops<Function>::get();
+    }
+
+    /// stores an over-aligned function object on the heap
+    template <typename Function, typename Arg>
+    inline void store_on_heap(Arg&& f, std::true_type) {
+        typedef typename aligned_heap_ops<Function>::holder_type holder_type;
+        std::size_t space = sizeof(Function) + std::alignment_of<Function>::value - 1;
+        void *memory = ::operator new(space);
+        void *aligned = memory;
+        std::align(std::alignment_of<Function>::value, sizeof(Function), aligned, space);
+        holder_type h;
+        try {
+            h.m_ptr = new (aligned) Function(std::forward<Arg>(f));
+        } catch (...) {
+            ::operator delete(memory);
+            throw;
+        }
+        h.m_memory = memory;
+        new (&m_storage) holder_type(h);
+        m_ops = aligned_heap_ops<Function>::get();
+    }
+
+
+    /// storage for the function object (or a pointer to it)
+    storage_type            m_storage;
+
+    /// operations on the stored function object (NULL if empty)
+    const ops_type *        m_ops;
+};
+
+
+}   // end namespace pion
+
+#endif
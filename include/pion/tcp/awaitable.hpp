@@ -0,0 +1,138 @@
+// ---------------------------------------------------------------------
+// pion:  a Boost C++ framework for building lightweight HTTP interfaces
+// ---------------------------------------------------------------------
+// Copyright (C) 2021 Wang Qiang  (https://github.com/dnybz/pion)
+// Copyright (C) 2007-2014 Splunk Inc.  (https://github.com/splunk/pion)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+//
+
+#ifndef __PION_TCP_AWAITABLE_HEADER__
+#define __PION_TCP_AWAITABLE_HEADER__
+
+#include <pion/coroutine.hpp>
+
+#ifdef PION_HAVE_COROUTINES
+
+#include <pion/tcp/connection.hpp>
+
+
+namespace pion {    // begin namespace pion
+namespace tcp {     // begin namespace tcp
+
+
+///
+/// io_result: result of a read or write operation awaited by a coroutine
+///
+struct io_result {
+    io_result(void) : m_bytes(0) {}
+
+    /// stores the result of a finished operation
+    inline void set(const asio::error_code& ec, std::size_t bytes) {
+        m_error = ec;
+        m_bytes = bytes;
+    }
+
+    /// error status of the operation
+    asio::error_code    m_error;
+
+    /// number of bytes read or written
+    std::size_t         m_bytes;
+};
+
+
+///
+/// read_some_awaitable: reads some bytes into a connection's read buffer
+/// (see async_read_some())
+///
+class read_some_awaitable
+{
+public:
+
+    explicit read_some_awaitable(connection& tcp_conn) : m_tcp_conn(tcp_conn) {}
+
+    inline bool await_ready(void) const { return false; }
+
+    inline void await_suspend(std::coroutine_handle<> handle) {
+        m_tcp_conn.async_read_some(resume_handler<io_result>(&m_result, handle));
+    }
+
+    inline io_result await_resume(void) const { return m_result; }
+
+private:
+
+    /// the connection to read from
+    connection &    m_tcp_conn;
+
+    /// result of the operation
+    io_result       m_result;
+};
+
+
+///
+/// write_awaitable: writes buffers to a connection (see async_write())
+///
+template <typename ConstBufferSequence>
+class write_awaitable
+{
+public:
+
+    write_awaitable(connection& tcp_conn, const ConstBufferSequence& buffers)
+        : m_tcp_conn(tcp_conn), m_buffers(buffers)
+    {}
+
+    inline bool await_ready(void) const { return false; }
+
+    inline void await_suspend(std::coroutine_handle<> handle) {
+        m_tcp_conn.async_write(m_buffers, resume_handler<io_result>(&m_result, handle));
+    }
+
+    inline io_result await_resume(void) const { return m_result; }
+
+private:
+
+    /// the connection to write to
+    connection &            m_tcp_conn;
+
+    /// the data to write (the memory must stay valid until the write finishes)
+    ConstBufferSequence     m_buffers;
+
+    /// result of the operation
+    io_result               m_result;
+};
+
+
+/**
+ * reads some bytes into a connection's read buffer: co_await the result to
+ * get an io_result.  The operation's state is allocated from the connection's
+ * handler arena, and the coroutine frame holds everything else, so awaiting
+ * it does not allocate memory
+ *
+ * @param tcp_conn the connection to read from
+ */
+inline read_some_awaitable async_read_some(connection& tcp_conn) {
+    return read_some_awaitable(tcp_conn);
+}
+
+/**
+ * writes all of the data in buffers to a connection: co_await the result to
+ * get an io_result
+ *
+ * @param tcp_conn the connection to write to
+ * @param buffers the data to write (must stay valid until the write finishes)
+ */
+template <typename ConstBufferSequence>
+inline write_awaitable<ConstBufferSequence> async_write(connection& tcp_conn,
+                                                        const ConstBufferSequence& buffers)
+{
+    return write_awaitable<ConstBufferSequence>(tcp_conn, buffers);
+}
+
+
+}   // end namespace tcp
+}   // end namespace pion
+
+#endif  // PION_HAVE_COROUTINES
+
+#endif
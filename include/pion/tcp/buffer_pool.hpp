@@ -0,0 +1,107 @@
+// ---------------------------------------------------------------------
+// pion:  a Boost C++ framework for building lightweight HTTP interfaces
+// ---------------------------------------------------------------------
+// Copyright (C) 2021 Wang Qiang  (https://github.com/dnybz/pion)
+// Copyright (C) 2007-2014 Splunk Inc.  (https://github.com/splunk/pion)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+//
+
+#ifndef __PION_TCP_BUFFER_POOL_HEADER__
+#define __PION_TCP_BUFFER_POOL_HEADER__
+
+#include <atomic>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include <pion/config.hpp>
+#include <asio.hpp>
+
+
+namespace pion {    // begin namespace pion
+namespace tcp {     // begin namespace tcp
+
+
+///
+/// buffer_pool: recycles the read buffers of the connections handled by one
+/// I/O service (use asio::use_service<tcp::buffer_pool>() to get it), so
+/// that idle connections can give their buffers back and take one again
+/// when data arrives.  A limited number of free buffers is kept; they stay
+/// registered with the I/O service's io_uring engine (if any) while free, so
+/// that reusing them does not require registering them again
+///
+class PION_API buffer_pool
+    : public asio::io_service::service
+{
+public:
+
+    /// size of each buffer in bytes
+    enum { BUFFER_SIZE = 8192 };
+
+    /// identifies the service within an I/O service
+    static asio::io_service::id     id;
+
+    /// maximum number of free buffers that are kept for reuse
+    static const std::size_t        MAX_FREE_BUFFERS;
+
+
+    /**
+     * creates a buffer pool for an I/O service
+     *
+     * @param io_service the I/O service whose connections use the pool
+     */
+    explicit buffer_pool(asio::io_service& io_service);
+
+    /// virtual destructor releases the free buffers
+    virtual ~buffer_pool() { shutdown(); }
+
+    /**
+     * returns a buffer of BUFFER_SIZE bytes, reusing a free one if possible
+     *
+     * @param index set to the index of the buffer among the io_uring engine's
+     *              registered buffers (-1 if it is not registered)
+     */
+    void *allocate(int& index);
+
+    /**
+     * gives a buffer back to the pool
+     *
+     * @param buffer a buffer returned by allocate()
+     * @param index index of the buffer among the io_uring engine's registered
+     *              buffers (-1 if it is not registered)
+     */
+    void deallocate(void *buffer, int index);
+
+    /// returns the number of buffers that are in use
+    inline std::size_t get_num_in_use(void) const { return m_num_in_use; }
+
+    /// returns the number of free buffers kept for reuse
+    std::size_t get_num_free(void) const;
+
+
+private:
+
+    /// releases the free buffers when the I/O service shuts down
+    virtual void shutdown(void);
+
+
+    /// data type for a free buffer and its registration index
+    typedef std::pair<void*, int>       free_buffer_type;
+
+
+    /// free buffers kept for reuse
+    std::vector<free_buffer_type>       m_free_buffers;
+
+    /// number of buffers that are in use
+    std::atomic<std::size_t>            m_num_in_use;
+
+    /// mutex used to protect the free buffers
+    mutable std::mutex                  m_mutex;
+};
+
+
+}   // end namespace tcp
+}   // end namespace pion
+
+#endif
@@ -20,15 +20,33 @@
 #endif
 
 #include <pion/noncopyable.hpp>
+#include <pion/scheduler.hpp>
+#include <pion/tcp/buffer_pool.hpp>
+#include <pion/tcp/handler_allocator.hpp>
+#include <pion/tcp/ktls.hpp>
+#include <pion/tcp/socket_options.hpp>
+#include <pion/tcp/timing_wheel.hpp>
+#include <pion/tcp/uring_service.hpp>
 #include <asio.hpp>
+#include <algorithm>
+#include <atomic>
+#include <iterator>
 #include <memory>
+#include <new>
 #include <string>
+#ifdef __linux__
+    #include <sys/ioctl.h>
+    #include <linux/sockios.h>
+#endif
 
 
 namespace pion {    // begin namespace pion
 namespace tcp {     // begin namespace tcp
 
 
+class uring_service;
+
+
 ///
 /// connection: represents a single tcp connection
 /// 
@@ -43,8 +61,23 @@ public:
         LIFECYCLE_CLOSE, LIFECYCLE_KEEPALIVE, LIFECYCLE_PIPELINED
     };
     
+    /// limits of the connection that may cut it off
+    enum timeout_type {
+        TIMEOUT_NONE,           ///< no limit was exceeded
+        TIMEOUT_HEADER,         ///< the message headers took too long to arrive
+        TIMEOUT_BODY_RATE,      ///< the message body arrived too slowly
+        TIMEOUT_SEND_STALL      ///< the peer stopped accepting sent data
+    };
+
     /// size of the read buffer
-    enum { READ_BUFFER_SIZE = 8192 };
+    enum { READ_BUFFER_SIZE = buffer_pool::BUFFER_SIZE };
+
+    /// sizes of the records that data written to SSL connections is sent in
+    enum {
+        SSL_MAX_RECORD_SIZE = 16384,    ///< largest record that TLS allows
+        SSL_SMALL_RECORD_SIZE = 1369,   ///< record that fits in one TCP segment (IPv6 with timestamps)
+        SSL_SMALL_RECORD_BYTES = 16384  ///< data at the start of each response sent in small records
+    };
     
     /// data type for a function that handles TCP connection objects
     typedef std::function<void(std::shared_ptr<connection>) >   connection_handler;
@@ -56,22 +89,22 @@ public:
     typedef asio::ip::tcp::socket            socket_type;
 
 #ifdef PION_HAVE_SSL
-    /// data type for an SSL socket connection
-    typedef asio::ssl::stream<asio::ip::tcp::socket>  ssl_socket_type;
+    /// data type for an SSL socket connection (layered on top of the connection's socket)
+    typedef asio::ssl::stream<asio::ip::tcp::socket&>  ssl_socket_type;
 
     /// data type for SSL configuration context
     typedef asio::ssl::context                               ssl_context_type;
 #else
     class ssl_socket_type {
     public:
-        ssl_socket_type(asio::io_service& io_service) : m_socket(io_service) {}
+        ssl_socket_type(socket_type& s) : m_socket(s) {}
         inline socket_type& next_layer(void) { return m_socket; }
         inline const socket_type& next_layer(void) const { return m_socket; }
         inline socket_type::lowest_layer_type& lowest_layer(void) { return m_socket.lowest_layer(); }
         inline const socket_type::lowest_layer_type& lowest_layer(void) const { return m_socket.lowest_layer(); }
         inline void shutdown(void) {}
     private:
-        socket_type  m_socket;
+        socket_type &  m_socket;
     };
     typedef int     ssl_context_type;
 #endif
@@ -85,14 +118,16 @@ public:
      * @param ssl_flag if true then the connection will be encrypted using SSL 
      * @param finished_handler function called when a server has finished
      *                         handling the connection
+     * @param engine I/O engine used for reads and writes (see set_io_engine())
      */
     static inline std::shared_ptr<connection> create(asio::io_service& io_service,
                                                           ssl_context_type& ssl_context,
                                                           const bool ssl_flag,
-                                                          connection_handler finished_handler)
+                                                          connection_handler finished_handler,
+                                                          scheduler::io_engine_type engine = scheduler::IO_ENGINE_REACTOR)
     {
         return std::shared_ptr<connection>(new connection(io_service, ssl_context,
-                                                                  ssl_flag, finished_handler));
+                                                                  ssl_flag, finished_handler, engine));
     }
     
     /**
@@ -102,21 +137,19 @@ public:
      * @param ssl_flag if true then the connection will be encrypted using SSL 
      */
     explicit connection(asio::io_service& io_service, const bool ssl_flag = false)
-        :
+        : m_socket(io_service), m_deadline(*this), m_send_deadline(*this),
+        m_uring_ptr(NULL), m_buffer_pool_ptr(NULL), m_read_buffer_ptr(NULL),
+        m_read_buffer_index(-1),
+        m_ssl_context_ptr(NULL), m_handler_memory_ptr(new handler_memory),
 #ifdef PION_HAVE_SSL
-#if ASIO_VERSION >= 101009
-		m_ssl_context(asio::ssl::context::tls),
-#else
-		m_ssl_context(asio::ssl::context::sslv23),
-#endif
-        m_ssl_socket(io_service, m_ssl_context),
         m_ssl_flag(ssl_flag),
 #else
-        m_ssl_context(0),
-        m_ssl_socket(io_service),
         m_ssl_flag(false),
 #endif
-        m_lifecycle(LIFECYCLE_CLOSE)
+        m_ktls_flag(false), m_local_flag(false), m_ssl_bytes_sent(0),
+        m_lifecycle(LIFECYCLE_CLOSE), m_in_flight(false), m_num_requests(0),
+        m_send_timeout(0), m_send_queue_size(-1), m_send_deadline_generation(0),
+        m_timeout_reason(TIMEOUT_NONE)
     {
         save_read_pos(NULL, NULL);
     }
@@ -128,26 +161,26 @@ public:
      * @param ssl_context asio ssl context associated with the connection
      */
     connection(asio::io_service& io_service, ssl_context_type& ssl_context)
-        :
+        : m_socket(io_service), m_deadline(*this), m_send_deadline(*this),
+        m_uring_ptr(NULL), m_buffer_pool_ptr(NULL), m_read_buffer_ptr(NULL),
+        m_read_buffer_index(-1),
+        m_ssl_context_ptr(&ssl_context), m_handler_memory_ptr(new handler_memory),
 #ifdef PION_HAVE_SSL
-#if ASIO_VERSION >= 101009
-		m_ssl_context(asio::ssl::context::tls),
+        m_ssl_flag(true),
 #else
-		m_ssl_context(asio::ssl::context::sslv23),
+        m_ssl_flag(false), 
 #endif
-        m_ssl_socket(io_service, ssl_context), m_ssl_flag(true),
-#else
-        m_ssl_context(0),
-        m_ssl_socket(io_service), m_ssl_flag(false), 
-#endif
-        m_lifecycle(LIFECYCLE_CLOSE)
+        m_ktls_flag(false), m_local_flag(false), m_ssl_bytes_sent(0),
+        m_lifecycle(LIFECYCLE_CLOSE), m_in_flight(false), m_num_requests(0),
+        m_send_timeout(0), m_send_queue_size(-1), m_send_deadline_generation(0),
+        m_timeout_reason(TIMEOUT_NONE)
     {
         save_read_pos(NULL, NULL);
     }
     
     /// returns true if the connection is currently open
     inline bool is_open(void) const {
-        return const_cast<ssl_socket_type&>(m_ssl_socket).lowest_layer().is_open();
+        return m_socket.is_open();
     }
     
     /// closes the tcp socket and cancels any pending asynchronous operations
@@ -157,17 +190,27 @@ public:
 
                 // shutting down SSL will wait forever for a response from the remote end,
                 // which causes it to hang indefinitely if the other end died unexpectedly
-                // if (get_ssl_flag()) m_ssl_socket.shutdown();
+                // if (get_ssl_flag()) get_ssl_socket().shutdown();
+#ifdef PION_HAVE_SSL
+                // instead, mark the SSL connection as shut down without sending
+                // anything: OpenSSL does not resume sessions of connections that
+                // end without a shutdown, and would drop them from the cache
+                if (m_ssl_socket_ptr && SSL_is_init_finished(m_ssl_socket_ptr->native_handle()))
+                    SSL_set_shutdown(m_ssl_socket_ptr->native_handle(), SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
+#endif
 
                 // windows seems to require this otherwise it doesn't
                 // recognize that connections have been closed
-                m_ssl_socket.next_layer().shutdown(asio::ip::tcp::socket::shutdown_both);
+                m_socket.shutdown(asio::ip::tcp::socket::shutdown_both);
                 
             } catch (...) {}    // ignore exceptions
             
+            // shutting down the socket also completes any io_uring operations,
+            // which hold their own reference to it
+            
             // close the underlying socket (ignore errors)
             asio::error_code ec;
-            m_ssl_socket.next_layer().close(ec);
+            m_socket.close(ec);
         }
     }
 
@@ -179,12 +222,116 @@ public:
     inline void cancel(void) {
 #if !defined(_MSC_VER) || (_WIN32_WINNT >= 0x0600)
         asio::error_code ec;
-        m_ssl_socket.next_layer().cancel(ec);
+        m_socket.cancel(ec);
+#endif
+#ifdef PION_HAVE_IO_URING
+        if (m_uring_ptr != NULL && is_open())
+            m_uring_ptr->cancel(m_socket.native_handle());
 #endif
     }
     
     /// virtual destructor
-    virtual ~connection() { close(); }
+    virtual ~connection() {
+        disarm_deadline();
+        disarm_send_deadline();
+        close();
+#ifdef PION_HAVE_IO_URING
+        release_uring();
+#endif
+        return_read_buffer();
+    }
+
+    /**
+     * selects the I/O engine used for the connection's reads and writes.
+     * io_uring is only used if the kernel supports it, and not for SSL
+     * (which is layered on asio's reactor); the connection's read buffer is
+     * registered with the ring when it is taken from the buffer pool.  Must
+     * not be called while operations are pending
+     *
+     * @param engine the I/O engine to use
+     * @return true if the engine is available
+     */
+    inline bool set_io_engine(scheduler::io_engine_type engine) {
+#ifdef PION_HAVE_IO_URING
+        if (engine == scheduler::IO_ENGINE_URING) {
+            if (m_uring_ptr == NULL) {
+                uring_service& uring = asio::use_service<uring_service>(get_io_service());
+                if (! uring.is_available())
+                    return false;
+                m_uring_ptr = &uring;
+                if (m_read_buffer_ptr != NULL && m_read_buffer_index < 0)
+                    m_read_buffer_index = uring.register_buffer(m_read_buffer_ptr->data(), m_read_buffer_ptr->size());
+            }
+            return true;
+        }
+        release_uring();
+#endif
+        return engine == scheduler::IO_ENGINE_REACTOR;
+    }
+
+    /// returns the I/O engine used for the connection's reads and writes
+    inline scheduler::io_engine_type get_io_engine(void) const {
+        return (m_uring_ptr != NULL ? scheduler::IO_ENGINE_URING : scheduler::IO_ENGINE_REACTOR);
+    }
+
+    /**
+     * applies socket options to the connection (the socket must be open);
+     * options that only apply to listening sockets are ignored
+     *
+     * @param opts the socket options to apply
+     * @return asio::error_code contains error code if an option could not be set
+     */
+    inline asio::error_code set_socket_options(const socket_options& opts) {
+        asio::error_code ec;
+        opts.apply(m_socket, ec);
+        return ec;
+    }
+
+    /**
+     * arms the connection's deadline: pending asynchronous operations are
+     * cancelled if it has not been disarmed before it expires.  Deadlines
+     * are kept by the I/O service's timing wheel, so arming one is cheap
+     *
+     * @param milliseconds time until the deadline expires
+     */
+    inline void arm_deadline(uint32_t milliseconds) {
+        get_timing_wheel().arm(m_deadline, milliseconds);
+    }
+
+    /// disarms the connection's deadline if it is armed
+    inline void disarm_deadline(void) {
+        m_deadline.cancel();
+    }
+
+    /**
+     * arms the connection's send deadline: pending asynchronous operations are
+     * cancelled if the peer stops accepting data, i.e. if the data queued in
+     * the kernel has not changed for at least milliseconds (where the
+     * platform cannot tell, if it has not been disarmed within milliseconds).
+     * The timeout reason is then set to TIMEOUT_SEND_STALL
+     *
+     * @param milliseconds time that sending may make no progress
+     */
+    inline void arm_send_deadline(uint32_t milliseconds) {
+        if (m_weak_self.expired())
+            m_weak_self = shared_from_this();
+        ++m_send_deadline_generation;
+        m_send_timeout = milliseconds;
+        m_send_queue_size = -1;
+        get_timing_wheel().arm(m_send_deadline, milliseconds);
+    }
+
+    /// disarms the connection's send deadline if it is armed
+    inline void disarm_send_deadline(void) {
+        ++m_send_deadline_generation;
+        m_send_deadline.cancel();
+    }
+
+    /// records which of the connection's limits cut it off
+    inline void set_timeout_reason(timeout_type reason) { m_timeout_reason = reason; }
+
+    /// returns which of the connection's limits cut it off (if any)
+    inline timeout_type get_timeout_reason(void) const { return m_timeout_reason; }
     
     /**
      * asynchronously accepts a new tcp connection
@@ -198,7 +345,7 @@ public:
     inline void async_accept(asio::ip::tcp::acceptor& tcp_acceptor,
                              AcceptHandler handler)
     {
-        tcp_acceptor.async_accept(m_ssl_socket.lowest_layer(), handler);
+        tcp_acceptor.async_accept(m_socket, make_alloc_handler(m_handler_memory_ptr, handler));
     }
 
     /**
@@ -212,7 +359,25 @@ public:
     inline asio::error_code accept(asio::ip::tcp::acceptor& tcp_acceptor)
     {
         asio::error_code ec;
-        tcp_acceptor.accept(m_ssl_socket.lowest_layer(), ec);
+        tcp_acceptor.accept(m_socket, ec);
+        return ec;
+    }
+
+    /**
+     * takes ownership of a socket that has already been accepted (which is a
+     * Unix domain socket if the local flag is set)
+     *
+     * @param protocol the protocol that the socket is labelled with
+     * @param fd the socket's descriptor
+     * @return asio::error_code contains error code if the socket cannot be used
+     *
+     * @see asio::basic_socket::assign()
+     */
+    inline asio::error_code assign(const asio::ip::tcp& protocol,
+                                   const socket_type::native_handle_type fd)
+    {
+        asio::error_code ec;
+        m_socket.assign(protocol, fd, ec);
         return ec;
     }
     
@@ -228,7 +393,7 @@ public:
     inline void async_connect(const asio::ip::tcp::endpoint& tcp_endpoint,
                               ConnectHandler handler)
     {
-        m_ssl_socket.lowest_layer().async_connect(tcp_endpoint, handler);
+        m_socket.async_connect(tcp_endpoint, make_alloc_handler(m_handler_memory_ptr, handler));
     }
 
     /**
@@ -260,7 +425,7 @@ public:
     inline asio::error_code connect(asio::ip::tcp::endpoint& tcp_endpoint)
     {
         asio::error_code ec;
-        m_ssl_socket.lowest_layer().connect(tcp_endpoint, ec);
+        m_socket.connect(tcp_endpoint, ec);
         return ec;
     }
 
@@ -294,7 +459,7 @@ public:
     {
         // query a list of matching endpoints
         asio::error_code ec;
-        asio::ip::tcp::resolver resolver(m_ssl_socket.lowest_layer().get_io_service());
+        asio::ip::tcp::resolver resolver(m_socket.get_io_service());
         asio::ip::tcp::resolver::query query(remote_server,
             std::to_string(remote_port),
             asio::ip::tcp::resolver::query::numeric_service);
@@ -326,7 +491,8 @@ public:
     template <typename SSLHandshakeHandler>
     inline void async_handshake_client(SSLHandshakeHandler handler) {
 #ifdef PION_HAVE_SSL
-        m_ssl_socket.async_handshake(asio::ssl::stream_base::client, handler);
+        get_ssl_socket().async_handshake(asio::ssl::stream_base::client,
+                                         make_alloc_handler(m_handler_memory_ptr, handler));
         m_ssl_flag = true;
 #endif
     }
@@ -341,7 +507,8 @@ public:
     template <typename SSLHandshakeHandler>
     inline void async_handshake_server(SSLHandshakeHandler handler) {
 #ifdef PION_HAVE_SSL
-        m_ssl_socket.async_handshake(asio::ssl::stream_base::server, handler);
+        get_ssl_socket().async_handshake(asio::ssl::stream_base::server,
+                                         make_alloc_handler(m_handler_memory_ptr, handler));
         m_ssl_flag = true;
 #endif
     }
@@ -356,7 +523,7 @@ public:
     inline asio::error_code handshake_client(void) {
         asio::error_code ec;
 #ifdef PION_HAVE_SSL
-        m_ssl_socket.handshake(asio::ssl::stream_base::client, ec);
+        get_ssl_socket().handshake(asio::ssl::stream_base::client, ec);
         m_ssl_flag = true;
 #endif
         return ec;
@@ -372,11 +539,30 @@ public:
     inline asio::error_code handshake_server(void) {
         asio::error_code ec;
 #ifdef PION_HAVE_SSL
-        m_ssl_socket.handshake(asio::ssl::stream_base::server, ec);
+        get_ssl_socket().handshake(asio::ssl::stream_base::server, ec);
         m_ssl_flag = true;
 #endif
         return ec;
     }
+
+#ifdef PION_HAVE_SSL
+    /**
+     * switches sending data to kernel TLS once the SSL handshake has finished
+     * (received data is still decrypted by the SSL stream); the connection
+     * keeps using the SSL stream if the switch is not possible
+     *
+     * @param k kernel TLS support attached to the connection's SSL context
+     *
+     * @return bool true if data written to the connection is encrypted by the kernel
+     *
+     * @see ktls::enable()
+     */
+    inline bool enable_ktls(ktls& k) {
+        if (m_ssl_flag && m_ssl_socket_ptr && ! m_ktls_flag && ! m_local_flag)
+            m_ktls_flag = k.enable(m_ssl_socket_ptr->native_handle(), m_socket.native_handle());
+        return m_ktls_flag;
+    }
+#endif
     
     /**
      * asynchronously reads some data into the connection's read buffer 
@@ -387,14 +573,21 @@ public:
      */
     template <typename ReadHandler>
     inline void async_read_some(ReadHandler handler) {
+#ifdef PION_HAVE_IO_URING
+        if (use_uring())
+            m_uring_ptr->async_receive(m_socket.native_handle(), asio::buffer(get_read_buffer()),
+                                       m_read_buffer_index,
+                                       make_alloc_handler(m_handler_memory_ptr, handler));
+        else
+#endif
 #ifdef PION_HAVE_SSL
         if (get_ssl_flag())
-            m_ssl_socket.async_read_some(asio::buffer(m_read_buffer),
-                                         handler);
+            get_ssl_socket().async_read_some(asio::buffer(get_read_buffer()),
+                                         make_alloc_handler(m_handler_memory_ptr, handler));
         else
 #endif      
-            m_ssl_socket.next_layer().async_read_some(asio::buffer(m_read_buffer),
-                                         handler);
+            m_socket.async_read_some(asio::buffer(get_read_buffer()),
+                                         make_alloc_handler(m_handler_memory_ptr, handler));
     }
     
     /**
@@ -408,14 +601,45 @@ public:
     template <typename ReadBufferType, typename ReadHandler>
     inline void async_read_some(ReadBufferType read_buffer,
                                 ReadHandler handler) {
+#ifdef PION_HAVE_IO_URING
+        if (use_uring())
+            m_uring_ptr->async_receive(m_socket.native_handle(),
+                                       asio::detail::buffer_sequence_adapter<asio::mutable_buffer,
+                                           ReadBufferType>::first(read_buffer),
+                                       -1, make_alloc_handler(m_handler_memory_ptr, handler));
+        else
+#endif
 #ifdef PION_HAVE_SSL
         if (get_ssl_flag())
-            m_ssl_socket.async_read_some(read_buffer, handler);
+            get_ssl_socket().async_read_some(read_buffer,
+                                             make_alloc_handler(m_handler_memory_ptr, handler));
         else
 #endif      
-            m_ssl_socket.next_layer().async_read_some(read_buffer, handler);
+            m_socket.async_read_some(read_buffer, make_alloc_handler(m_handler_memory_ptr, handler));
     }
     
+    /**
+     * asynchronously waits until data can be read from the connection without
+     * reading it (a zero-byte read), so that an idle connection need not hold
+     * a read buffer.  Not suitable for SSL connections, whose data may already
+     * have been decrypted into the SSL stream's buffers
+     *
+     * @param handler called with an error code once data is available
+     *
+     * @see asio::basic_socket::async_wait()
+     */
+    template <typename WaitHandler>
+    inline void async_wait_readable(WaitHandler handler) {
+#ifdef PION_HAVE_IO_URING
+        if (use_uring())
+            m_uring_ptr->async_wait_readable(m_socket.native_handle(),
+                                             make_alloc_handler(m_handler_memory_ptr, handler));
+        else
+#endif
+            m_socket.async_wait(asio::ip::tcp::socket::wait_read,
+                                make_alloc_handler(m_handler_memory_ptr, handler));
+    }
+
     /**
      * reads some data into the connection's read buffer (blocks until finished)
      *
@@ -427,10 +651,10 @@ public:
     inline std::size_t read_some(asio::error_code& ec) {
 #ifdef PION_HAVE_SSL
         if (get_ssl_flag())
-            return m_ssl_socket.read_some(asio::buffer(m_read_buffer), ec);
+            return get_ssl_socket().read_some(asio::buffer(get_read_buffer()), ec);
         else
 #endif      
-            return m_ssl_socket.next_layer().read_some(asio::buffer(m_read_buffer), ec);
+            return m_socket.read_some(asio::buffer(get_read_buffer()), ec);
     }
     
     /**
@@ -448,10 +672,10 @@ public:
     {
 #ifdef PION_HAVE_SSL
         if (get_ssl_flag())
-            return m_ssl_socket.read_some(read_buffer, ec);
+            return get_ssl_socket().read_some(read_buffer, ec);
         else
 #endif      
-            return m_ssl_socket.next_layer().read_some(read_buffer, ec);
+            return m_socket.read_some(read_buffer, ec);
     }
     
     /**
@@ -469,12 +693,12 @@ public:
     {
 #ifdef PION_HAVE_SSL
         if (get_ssl_flag())
-            asio::async_read(m_ssl_socket, asio::buffer(m_read_buffer),
-                                    completion_condition, handler);
+            asio::async_read(get_ssl_socket(), asio::buffer(get_read_buffer()),
+                                    completion_condition, make_alloc_handler(m_handler_memory_ptr, handler));
         else
 #endif      
-            asio::async_read(m_ssl_socket.next_layer(), asio::buffer(m_read_buffer),
-                                    completion_condition, handler);
+            asio::async_read(m_socket, asio::buffer(get_read_buffer()),
+                                    completion_condition, make_alloc_handler(m_handler_memory_ptr, handler));
     }
             
     /**
@@ -494,12 +718,12 @@ public:
     {
 #ifdef PION_HAVE_SSL
         if (get_ssl_flag())
-            asio::async_read(m_ssl_socket, buffers,
-                                    completion_condition, handler);
+            asio::async_read(get_ssl_socket(), buffers,
+                                    completion_condition, make_alloc_handler(m_handler_memory_ptr, handler));
         else
 #endif      
-            asio::async_read(m_ssl_socket.next_layer(), buffers,
-                                    completion_condition, handler);
+            asio::async_read(m_socket, buffers,
+                                    completion_condition, make_alloc_handler(m_handler_memory_ptr, handler));
     }
     
     /**
@@ -518,11 +742,11 @@ public:
     {
 #ifdef PION_HAVE_SSL
         if (get_ssl_flag())
-            return asio::async_read(m_ssl_socket, asio::buffer(m_read_buffer),
+            return asio::read(get_ssl_socket(), asio::buffer(get_read_buffer()),
                                            completion_condition, ec);
         else
 #endif      
-            return asio::async_read(m_ssl_socket.next_layer(), asio::buffer(m_read_buffer),
+            return asio::read(m_socket, asio::buffer(get_read_buffer()),
                                            completion_condition, ec);
     }
     
@@ -544,11 +768,11 @@ public:
     {
 #ifdef PION_HAVE_SSL
         if (get_ssl_flag())
-            return asio::read(m_ssl_socket, buffers,
+            return asio::read(get_ssl_socket(), buffers,
                                      completion_condition, ec);
         else
 #endif      
-            return asio::read(m_ssl_socket.next_layer(), buffers,
+            return asio::read(m_socket, buffers,
                                      completion_condition, ec);
     }
     
@@ -562,12 +786,19 @@ public:
      */
     template <typename ConstBufferSequence, typename write_handler_t>
     inline void async_write(const ConstBufferSequence& buffers, write_handler_t handler) {
+#ifdef PION_HAVE_IO_URING
+        if (use_uring())
+            m_uring_ptr->async_send(m_socket.native_handle(), buffers,
+                                    make_alloc_handler(m_handler_memory_ptr, handler));
+        else
+#endif
 #ifdef PION_HAVE_SSL
-        if (get_ssl_flag())
-            asio::async_write(m_ssl_socket, buffers, handler);
+        if (get_ssl_flag() && ! m_ktls_flag)
+            ssl_write_op<ConstBufferSequence, write_handler_t>(*this, buffers, handler).start();
         else
 #endif      
-            asio::async_write(m_ssl_socket.next_layer(), buffers, handler);
+            asio::async_write(m_socket, buffers,
+                              make_alloc_handler(m_handler_memory_ptr, handler));
     }   
         
     /**
@@ -584,12 +815,23 @@ public:
                              asio::error_code& ec)
     {
 #ifdef PION_HAVE_SSL
-        if (get_ssl_flag())
-            return asio::write(m_ssl_socket, buffers,
-                                      asio::transfer_all(), ec);
-        else
+        if (get_ssl_flag() && ! m_ktls_flag) {
+            ec.clear();
+            std::size_t bytes_written = 0;
+            ssl_write_position position;
+            asio::const_buffer record(prepare_ssl_write(buffers, position));
+            while (record.size() > 0) {
+                const std::size_t n = get_ssl_socket().write_some(record, ec);
+                consume_ssl_write(buffers, position, n);
+                bytes_written += n;
+                if (ec)
+                    break;
+                record = prepare_ssl_write(buffers, position);
+            }
+            return bytes_written;
+        } else
 #endif      
-            return asio::write(m_ssl_socket.next_layer(), buffers,
+            return asio::write(m_socket, buffers,
                                       asio::transfer_all(), ec);
     }   
     
@@ -601,12 +843,39 @@ public:
     /// returns true if the connection is encrypted using SSL
     inline bool get_ssl_flag(void) const { return m_ssl_flag; }
 
+    /// returns true if data written to the connection is encrypted by the kernel
+    inline bool get_ktls_flag(void) const { return m_ktls_flag; }
+
+    /**
+     * sets whether the socket is a Unix domain socket rather than a tcp one
+     * (it is still handled as a tcp socket, but has no IP endpoints or tcp options)
+     *
+     * @param b true if the socket is a Unix domain socket
+     */
+    inline void set_local_flag(bool b = true) { m_local_flag = b; }
+
+    /// returns true if the socket is a Unix domain socket
+    inline bool get_local_flag(void) const { return m_local_flag; }
+
     /// sets the lifecycle type for the connection
     inline void set_lifecycle(lifecycle_type t) { m_lifecycle = t; }
     
     /// returns the lifecycle type for the connection
     inline lifecycle_type get_lifecycle(void) const { return m_lifecycle; }
     
+    /// marks the start of a request that a server counts as in flight
+    /// (its response starts again with small SSL records)
+    inline void begin_request(void) { m_in_flight = true; ++m_num_requests; m_ssl_bytes_sent = 0; }
+
+    /// marks the end of the request that a server counts as in flight
+    inline void end_request(void) { m_in_flight = false; }
+
+    /// returns true if a server counts a request on the connection as in flight
+    inline bool get_in_flight(void) const { return m_in_flight; }
+
+    /// returns the number of requests that have been started on the connection
+    inline std::size_t get_num_requests(void) const { return m_num_requests; }
+
     /// returns true if the connection should be kept alive
     inline bool get_keep_alive(void) const { return m_lifecycle != LIFECYCLE_CLOSE; }
     
@@ -614,7 +883,29 @@ public:
     inline bool get_pipelined(void) const { return m_lifecycle == LIFECYCLE_PIPELINED; }
 
     /// returns the buffer used for reading data from the TCP connection
-    inline read_buffer_type& get_read_buffer(void) { return m_read_buffer; }
+    /// (taken from the I/O service's buffer pool if the connection has none)
+    inline read_buffer_type& get_read_buffer(void) {
+        if (m_read_buffer_ptr == NULL)
+            acquire_read_buffer();
+        return *m_read_buffer_ptr;
+    }
+
+    /// returns true if the connection holds a read buffer
+    inline bool has_read_buffer(void) const { return m_read_buffer_ptr != NULL; }
+
+    /**
+     * gives the read buffer back to the I/O service's buffer pool, so that an
+     * idle connection does not hold one; the next read takes a buffer again.
+     * Does nothing while pipelined requests remain in the buffer, and must not
+     * be called while a read into it is pending
+     */
+    inline void release_read_buffer(void) {
+        if (! get_pipelined())
+            return_read_buffer();
+    }
+
+    /// returns the arena used to allocate the connection's asynchronous operations
+    inline const handler_memory& get_handler_memory(void) const { return *m_handler_memory_ptr; }
     
     /**
      * saves a read position bookmark
@@ -638,12 +929,15 @@ public:
         read_end_ptr = m_read_position.second;
     }
 
-    /// returns an ASIO endpoint for the client connection
+    /// returns an ASIO endpoint for the client connection (an unspecified
+    /// one for Unix domain sockets, whose clients have no address or port)
     inline asio::ip::tcp::endpoint get_remote_endpoint(void) const {
         asio::ip::tcp::endpoint remote_endpoint;
+        if (m_local_flag)
+            return remote_endpoint;
         try {
             // const_cast is required since lowest_layer() is only defined non-const in asio
-            remote_endpoint = const_cast<ssl_socket_type&>(m_ssl_socket).lowest_layer().remote_endpoint();
+            remote_endpoint = m_socket.remote_endpoint();
         } catch (asio::system_error& /* e */) {
             // do nothing
         }
@@ -663,23 +957,63 @@ public:
     /// returns reference to the io_service used for async operations
     inline asio::io_service& get_io_service(void) {
 #if ASIO_VERSION >= 101400
-		return static_cast<asio::io_service&>(ssl_socket.lowest_layer().get_executor().context());
+		return static_cast<asio::io_service&>(m_socket.get_executor().context());
 #else
-        return m_ssl_socket.lowest_layer().get_io_service();
+        return m_socket.get_io_service();
 #endif
     }
 
-    /// returns non-const reference to underlying TCP socket object
-    inline socket_type& get_socket(void) { return m_ssl_socket.next_layer(); }
+    /**
+     * returns non-const reference to underlying TCP socket object.  A Unix
+     * domain socket (see get_local_flag()) is held by a tcp socket object, but
+     * has no IP endpoints and does not support tcp options, so its socket
+     * object is not exposed: use the connection's own functions, or
+     * get_native_handle() for system calls
+     *
+     * @throw asio::system_error (operation_not_supported) for Unix domain sockets
+     */
+    inline socket_type& get_socket(void) {
+        check_not_local();
+        return m_socket;
+    }
+
+    /// returns the socket's descriptor (for tcp and Unix domain sockets)
+    inline socket_type::native_handle_type get_native_handle(void) {
+        return m_socket.native_handle();
+    }
     
-    /// returns non-const reference to underlying SSL socket object
-    inline ssl_socket_type& get_ssl_socket(void) { return m_ssl_socket; }
+    /// returns non-const reference to underlying SSL socket object (the SSL
+    /// stream and, if necessary, its context are created on first use)
+    inline ssl_socket_type& get_ssl_socket(void) {
+        if (! m_ssl_socket_ptr) {
+#ifdef PION_HAVE_SSL
+            if (m_ssl_context_ptr == NULL) {
+#if ASIO_VERSION >= 101009
+                m_own_ssl_context_ptr.reset(new ssl_context_type(asio::ssl::context::tls));
+#else
+                m_own_ssl_context_ptr.reset(new ssl_context_type(asio::ssl::context::sslv23));
+#endif
+                m_ssl_context_ptr = m_own_ssl_context_ptr.get();
+            }
+            m_ssl_socket_ptr.reset(new ssl_socket_type(m_socket, *m_ssl_context_ptr));
+#else
+            m_ssl_socket_ptr.reset(new ssl_socket_type(m_socket));
+#endif
+        }
+        return *m_ssl_socket_ptr;
+    }
 
-    /// returns const reference to underlying TCP socket object
-    inline const socket_type& get_socket(void) const { return const_cast<ssl_socket_type&>(m_ssl_socket).next_layer(); }
+    /// returns const reference to underlying TCP socket object (throws
+    /// asio::system_error for Unix domain sockets, as does the non-const one)
+    inline const socket_type& get_socket(void) const {
+        check_not_local();
+        return m_socket;
+    }
     
     /// returns const reference to underlying SSL socket object
-    inline const ssl_socket_type& get_ssl_socket(void) const { return m_ssl_socket; }
+    inline const ssl_socket_type& get_ssl_socket(void) const {
+        return const_cast<connection*>(this)->get_ssl_socket();
+    }
 
     
 protected:
@@ -692,54 +1026,413 @@ protected:
      * @param ssl_flag if true then the connection will be encrypted using SSL 
      * @param finished_handler function called when a server has finished
      *                         handling the connection
+     * @param engine I/O engine used for reads and writes (see set_io_engine())
      */
     connection(asio::io_service& io_service,
                   ssl_context_type& ssl_context,
                   const bool ssl_flag,
-                  connection_handler finished_handler)
-        :
+                  connection_handler finished_handler,
+                  scheduler::io_engine_type engine = scheduler::IO_ENGINE_REACTOR)
+        : m_socket(io_service), m_deadline(*this), m_send_deadline(*this),
+        m_uring_ptr(NULL), m_buffer_pool_ptr(NULL), m_read_buffer_ptr(NULL),
+        m_read_buffer_index(-1),
+        m_ssl_context_ptr(&ssl_context), m_handler_memory_ptr(new handler_memory),
 #ifdef PION_HAVE_SSL
-#if ASIO_VERSION >= 101009
-		m_ssl_context(asio::ssl::context::tls),
-#else
-		m_ssl_context(asio::ssl::context::sslv23),
-#endif
-        m_ssl_socket(io_service, ssl_context), m_ssl_flag(ssl_flag),
+        m_ssl_flag(ssl_flag),
 #else
-        m_ssl_context(0),
-        m_ssl_socket(io_service), m_ssl_flag(false), 
+        m_ssl_flag(false), 
 #endif
-        m_lifecycle(LIFECYCLE_CLOSE),
+        m_ktls_flag(false), m_local_flag(false), m_ssl_bytes_sent(0),
+        m_lifecycle(LIFECYCLE_CLOSE), m_in_flight(false), m_num_requests(0),
+        m_send_timeout(0), m_send_queue_size(-1), m_send_deadline_generation(0),
+        m_timeout_reason(TIMEOUT_NONE),
         m_finished_handler(finished_handler)
     {
         save_read_pos(NULL, NULL);
+        set_io_engine(engine);
     }
     
 
 private:
 
+    /// connection_pool allocates and recycles connection objects
+    friend class connection_pool;
+
+#ifdef PION_HAVE_IO_URING
+    /// returns true if reads and writes use io_uring
+    inline bool use_uring(void) const { return m_uring_ptr != NULL && ! m_ssl_flag; }
+
+    /// stops using io_uring (the read buffer stays registered while the
+    /// buffer pool keeps it)
+    inline void release_uring(void) { m_uring_ptr = NULL; }
+#endif
+
+    /// gives the read buffer (if any) back to the I/O service's buffer pool
+    inline void return_read_buffer(void) {
+        if (m_read_buffer_ptr != NULL) {
+            m_read_buffer_ptr->~read_buffer_type();
+            m_buffer_pool_ptr->deallocate(m_read_buffer_ptr, m_read_buffer_index);
+            m_read_buffer_ptr = NULL;
+            m_read_buffer_index = -1;
+        }
+    }
+
+    /// takes a read buffer from the I/O service's buffer pool
+    inline void acquire_read_buffer(void) {
+        if (m_buffer_pool_ptr == NULL)
+            m_buffer_pool_ptr = &asio::use_service<buffer_pool>(get_io_service());
+        void *memory = m_buffer_pool_ptr->allocate(m_read_buffer_index);
+        m_read_buffer_ptr = new (memory) read_buffer_type;
+#ifdef PION_HAVE_IO_URING
+        if (m_uring_ptr != NULL && m_read_buffer_index < 0)
+            m_read_buffer_index = m_uring_ptr->register_buffer(m_read_buffer_ptr->data(), m_read_buffer_ptr->size());
+#endif
+    }
+
+    /// returns the timing wheel of the socket's I/O service (which is not
+    /// cached, since the deadlines may outlive it; see timing_wheel::entry)
+    inline timing_wheel& get_timing_wheel(void) {
+        return asio::use_service<timing_wheel>(get_io_service());
+    }
+
+    /**
+     * called when the send deadline expires: cancels the pending operations
+     * if sending has stalled, or arms the deadline again
+     *
+     * @param weak_conn the connection
+     * @param generation identifies the send deadline that expired
+     */
+    static void check_send_progress(const std::weak_ptr<connection>& weak_conn,
+                                    uint32_t generation)
+    {
+        std::shared_ptr<connection> conn(weak_conn.lock());
+        if (! conn || conn->m_send_deadline_generation != generation)
+            return;     // the send deadline was disarmed or armed again
+        const int queue_size = conn->get_send_queue_size();
+        if (queue_size < 0 || (queue_size > 0 && queue_size == conn->m_send_queue_size)) {
+            conn->m_timeout_reason = TIMEOUT_SEND_STALL;
+            conn->cancel();
+        } else {
+            conn->m_send_queue_size = queue_size;
+            conn->get_timing_wheel().arm(conn->m_send_deadline, conn->m_send_timeout);
+        }
+    }
+
+    /// returns the number of bytes queued in the kernel that the peer has not
+    /// acknowledged yet, or -1 if the platform cannot tell
+    inline int get_send_queue_size(void) {
+#if defined(__linux__) && defined(SIOCOUTQ)
+        int queue_size = 0;
+        if (::ioctl(m_socket.native_handle(), SIOCOUTQ, &queue_size) == 0)
+            return queue_size;
+#endif
+        return -1;
+    }
+
+#ifdef PION_HAVE_SSL
+    /// position reached in the buffers being written to the SSL stream
+    struct ssl_write_position {
+        ssl_write_position(void) : m_index(0), m_offset(0) {}
+        std::size_t     m_index;    ///< buffer that is being written
+        std::size_t     m_offset;   ///< bytes of the buffer that have been written
+    };
+
+    /**
+     * picks the data to write to the SSL stream next, which OpenSSL sends in
+     * one record: a response starts with records that fit in one TCP segment,
+     * so that the peer can decrypt them as soon as they arrive, and continues
+     * with the largest records; small buffers are gathered into the
+     * connection's write buffer rather than sent in records of their own
+     *
+     * @param buffers the buffers being written
+     * @param position position reached in the buffers (empty buffers are skipped)
+     *
+     * @return asio::const_buffer the data of the next record (empty once all
+     *                            data has been written)
+     */
+    template <typename ConstBufferSequence>
+    inline asio::const_buffer prepare_ssl_write(const ConstBufferSequence& buffers,
+                                                ssl_write_position& position)
+    {
+        std::size_t record_size = SSL_MAX_RECORD_SIZE;
+        if (m_ssl_bytes_sent < SSL_SMALL_RECORD_BYTES)
+            record_size = (std::min)(static_cast<std::size_t>(SSL_SMALL_RECORD_SIZE),
+                                     SSL_SMALL_RECORD_BYTES - m_ssl_bytes_sent);
+        auto it = asio::buffer_sequence_begin(buffers);
+        const auto end = asio::buffer_sequence_end(buffers);
+        std::advance(it, position.m_index);
+        for (; it != end; ++it, ++position.m_index, position.m_offset = 0) {
+            if (asio::buffer_size(*it) > position.m_offset)
+                break;
+        }
+        if (it == end)
+            return asio::const_buffer();
+        // a buffer that fills the record, or the last one, needs no copy
+        asio::const_buffer first(asio::const_buffer(*it) + position.m_offset);
+        auto next = it;
+        if (first.size() >= record_size || ++next == end)
+            return asio::buffer(first, record_size);
+        if (! m_ssl_write_buffer_ptr)
+            m_ssl_write_buffer_ptr.reset(new char[SSL_MAX_RECORD_SIZE]);
+        std::size_t offset = position.m_offset;
+        std::size_t record_used = 0;
+        for (; it != end && record_used < record_size; ++it, offset = 0) {
+            record_used += asio::buffer_copy(asio::buffer(m_ssl_write_buffer_ptr.get() + record_used,
+                                                          record_size - record_used),
+                                             asio::const_buffer(*it) + offset);
+        }
+        return asio::buffer(m_ssl_write_buffer_ptr.get(), record_used);
+    }
+
+    /**
+     * moves the position in the buffers being written to the SSL stream
+     *
+     * @param buffers the buffers being written
+     * @param position position reached in the buffers
+     * @param bytes_written number of bytes that have been written from the position
+     */
+    template <typename ConstBufferSequence>
+    inline void consume_ssl_write(const ConstBufferSequence& buffers,
+                                  ssl_write_position& position,
+                                  std::size_t bytes_written)
+    {
+        m_ssl_bytes_sent += bytes_written;
+        auto it = asio::buffer_sequence_begin(buffers);
+        const auto end = asio::buffer_sequence_end(buffers);
+        std::advance(it, position.m_index);
+        while (bytes_written > 0 && it != end) {
+            const std::size_t left = asio::buffer_size(*it) - position.m_offset;
+            if (bytes_written < left) {
+                position.m_offset += bytes_written;
+                break;
+            }
+            bytes_written -= left;
+            ++it;
+            ++position.m_index;
+            position.m_offset = 0;
+        }
+    }
+
+    ///
+    /// ssl_write_op: writes buffers to the SSL stream one record at a time
+    /// (see prepare_ssl_write()), then calls the completion handler
+    ///
+    template <typename ConstBufferSequence, typename Handler>
+    class ssl_write_op {
+    public:
+
+        /**
+         * creates the operation
+         *
+         * @param conn the connection (kept alive by the handler)
+         * @param buffers the buffers to write
+         * @param handler called after the data has been written
+         */
+        ssl_write_op(connection& conn, const ConstBufferSequence& buffers, const Handler& handler)
+            : m_conn(conn), m_buffers(buffers), m_handler(handler),
+            m_bytes_written(0), m_continuation(false)
+        {}
+
+        /// writes the first record (the handler is not called from here, even
+        /// if there is no data to write)
+        inline void start(void) {
+            const asio::const_buffer record(m_conn.prepare_ssl_write(m_buffers, m_position));
+            m_conn.get_ssl_socket().async_write_some(record,
+                make_alloc_handler(m_conn.m_handler_memory_ptr, *this));
+        }
+
+        /// called after a record has been written: writes the next one, or
+        /// calls the handler once all data has been written
+        inline void operator()(const asio::error_code& ec, std::size_t bytes_written) {
+            m_conn.consume_ssl_write(m_buffers, m_position, bytes_written);
+            m_bytes_written += bytes_written;
+            if (! ec) {
+                const asio::const_buffer record(m_conn.prepare_ssl_write(m_buffers, m_position));
+                if (record.size() > 0) {
+                    m_continuation = true;
+                    m_conn.get_ssl_socket().async_write_some(record,
+                        make_alloc_handler(m_conn.m_handler_memory_ptr, *this));
+                    return;
+                }
+            }
+            m_handler(ec, m_bytes_written);
+        }
+
+        /// asio hook used to invoke the handler (keeps the handler's behavior)
+        template <typename Function>
+        friend inline void asio_handler_invoke(Function& function, ssl_write_op *this_handler) {
+            asio_handler_invoke_helpers::invoke(function, this_handler->m_handler);
+        }
+
+        /// asio hook used to invoke the handler (keeps the handler's behavior)
+        template <typename Function>
+        friend inline void asio_handler_invoke(const Function& function, ssl_write_op *this_handler) {
+            asio_handler_invoke_helpers::invoke(function, this_handler->m_handler);
+        }
+
+        /// asio hook that tells if the handler continues the current operation
+        friend inline bool asio_handler_is_continuation(ssl_write_op *this_handler) {
+            return this_handler->m_continuation
+                || asio_handler_cont_helpers::is_continuation(this_handler->m_handler);
+        }
+
+    private:
+
+        /// the connection being written to
+        connection &            m_conn;
+
+        /// the buffers being written
+        ConstBufferSequence     m_buffers;
+
+        /// position reached in the buffers
+        ssl_write_position      m_position;
+
+        /// called after the data has been written
+        Handler                 m_handler;
+
+        /// number of bytes that have been written
+        std::size_t             m_bytes_written;
+
+        /// true once a record has been written
+        bool                    m_continuation;
+    };
+#endif
+
+    /// closes the connection and clears its state so that it may be reused
+    /// (an io_uring engine is kept; the read buffer goes back to the pool)
+    inline void reset(void) {
+        disarm_deadline();
+        disarm_send_deadline();
+        close();
+        m_ssl_socket_ptr.reset();
+        m_ssl_write_buffer_ptr.reset();
+        m_ktls_flag = false;
+        m_ssl_bytes_sent = 0;
+        m_lifecycle = LIFECYCLE_CLOSE;
+        return_read_buffer();
+        save_read_pos(NULL, NULL);
+        m_in_flight = false;
+        m_num_requests = 0;
+        m_timeout_reason = TIMEOUT_NONE;
+    }
+
+    /// throws asio::system_error if the socket is a Unix domain socket, whose
+    /// tcp socket object must not be used directly (see get_socket())
+    inline void check_not_local(void) const {
+        if (m_local_flag)
+            throw asio::system_error(make_error_code(asio::error::operation_not_supported),
+                                     "tcp socket of a Unix domain socket connection");
+    }
+
+
     /// data type for a read position bookmark
     typedef std::pair<const char*, const char*>     read_pos_type;
 
+    /// deadline that cancels the connection's operations when it expires
+    class deadline_type : public timing_wheel::entry {
+    public:
+        explicit deadline_type(connection& conn) : m_conn(conn) {}
+    protected:
+        virtual void expired(void) { m_conn.cancel(); }
+    private:
+        connection &    m_conn;
+    };
+
+    /// deadline that checks whether sending has stalled when it expires
+    /// (the check runs outside of the timing wheel, which is locked here)
+    class send_deadline_type : public timing_wheel::entry {
+    public:
+        explicit send_deadline_type(connection& conn) : m_conn(conn) {}
+    protected:
+        virtual void expired(void) {
+            m_conn.get_io_service().post(std::bind(&connection::check_send_progress,
+                                                   m_conn.m_weak_self,
+                                                   static_cast<uint32_t>(m_conn.m_send_deadline_generation)));
+        }
+    private:
+        connection &    m_conn;
+    };
+
     
-    /// context object for the SSL connection socket
-    ssl_context_type        m_ssl_context;
+    /// TCP connection socket
+    socket_type                         m_socket;
+
+    /// deadline for the pending operations (armed by set_timeout() users)
+    deadline_type                       m_deadline;
+
+    /// refers to the connection itself while its send deadline may expire
+    /// (declared before the deadline, which is destroyed first)
+    std::weak_ptr<connection>           m_weak_self;
+
+    /// deadline for the pending write operations (see arm_send_deadline())
+    send_deadline_type                  m_send_deadline;
+
+    /// io_uring engine of the socket's I/O service (NULL if the reactor is used)
+    uring_service *                     m_uring_ptr;
+
+    /// buffer pool of the socket's I/O service (looked up on first use)
+    buffer_pool *                       m_buffer_pool_ptr;
+
+    /// buffer used for reading data from the TCP connection (NULL while the
+    /// connection does not hold one)
+    read_buffer_type *                  m_read_buffer_ptr;
+
+    /// index of the read buffer among the ring's registered buffers (-1 if none)
+    int                                 m_read_buffer_index;
 
-    /// SSL connection socket
-    ssl_socket_type         m_ssl_socket;
+    /// shared context used to configure SSL (NULL if a private one is needed)
+    ssl_context_type *                  m_ssl_context_ptr;
+
+    /// private SSL context, only for connections created without a shared one
+    std::unique_ptr<ssl_context_type>   m_own_ssl_context_ptr;
+
+    /// SSL stream layered on the socket (created when SSL is first used)
+    std::unique_ptr<ssl_socket_type>    m_ssl_socket_ptr;
+
+    /// arena used to allocate asynchronous operations (shared with the
+    /// handlers, so it stays valid until all operations have been released)
+    handler_memory_ptr                  m_handler_memory_ptr;
 
     /// true if the connection is encrypted using SSL
     bool                    m_ssl_flag;
 
-    /// buffer used for reading data from the TCP connection
-    read_buffer_type        m_read_buffer;
-    
+    /// true if data written to the connection is encrypted by the kernel
+    bool                    m_ktls_flag;
+
+    /// true if the socket is a Unix domain socket
+    bool                    m_local_flag;
+
+    /// buffer that small buffers written to the SSL stream are gathered in
+    /// (allocated when first needed)
+    std::unique_ptr<char[]> m_ssl_write_buffer_ptr;
+
+    /// bytes of the current response that have been sent in SSL records
+    std::size_t             m_ssl_bytes_sent;
+
     /// saved read position bookmark
     read_pos_type           m_read_position;
     
     /// lifecycle state for the connection
     lifecycle_type          m_lifecycle;
 
+    /// true while a server counts a request on the connection as in flight
+    bool                    m_in_flight;
+
+    /// number of requests that have been started on the connection
+    std::size_t             m_num_requests;
+
+    /// milliseconds that sending may make no progress
+    uint32_t                m_send_timeout;
+
+    /// bytes queued in the kernel when the send deadline last expired (-1 if unknown)
+    int                     m_send_queue_size;
+
+    /// changes whenever the send deadline is armed or disarmed
+    std::atomic<uint32_t>   m_send_deadline_generation;
+
+    /// which of the connection's limits cut it off (if any)
+    timeout_type            m_timeout_reason;
+
     /// function called when a server has finished handling the connection
     connection_handler      m_finished_handler;
 };
@@ -0,0 +1,143 @@
+// ---------------------------------------------------------------------
+// pion:  a Boost C++ framework for building lightweight HTTP interfaces
+// ---------------------------------------------------------------------
+// Copyright (C) 2021 Wang Qiang  (https://github.com/dnybz/pion)
+// Copyright (C) 2007-2014 Splunk Inc.  (https://github.com/splunk/pion)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+//
+
+#ifndef __PION_TCP_CONNECTION_POOL_HEADER__
+#define __PION_TCP_CONNECTION_POOL_HEADER__
+
+#include <vector>
+#include <mutex>
+#include <pion/config.hpp>
+#include <pion/noncopyable.hpp>
+#include <pion/tcp/connection.hpp>
+
+
+namespace pion {    // begin namespace pion
+namespace tcp {     // begin namespace tcp
+
+
+///
+/// connection_pool: free list of closed connection objects (including their
+/// sockets and read buffers) that are recycled for new connections on one
+/// I/O service
+///
+class PION_API connection_pool
+    : public std::enable_shared_from_this<connection_pool>,
+    private pion::noncopyable
+{
+public:
+
+    /**
+     * creates a new connection pool
+     *
+     * @param io_service asio service used by the pooled connections
+     * @param ssl_context asio ssl context associated with the connections
+     * @param ssl_flag if true then the connections will be encrypted using SSL
+     * @param finished_handler function called when a server has finished
+     *                         handling a connection
+     * @param max_size maximum number of idle connections kept in the pool
+     * @param engine I/O engine used by the connections
+     */
+    connection_pool(asio::io_service& io_service,
+                    connection::ssl_context_type& ssl_context,
+                    const bool ssl_flag,
+                    connection::connection_handler finished_handler,
+                    std::size_t max_size,
+                    scheduler::io_engine_type engine = scheduler::IO_ENGINE_REACTOR);
+
+    /// deletes all of the idle connections
+    ~connection_pool() { close(); }
+
+    /**
+     * returns a connection that is ready to accept a new socket: a recycled
+     * one if available, or else a newly allocated one.  The connection goes
+     * back to the pool when its last reference is released
+     */
+    connection_ptr create(void);
+
+    /**
+     * allocates idle connections in advance
+     *
+     * @param n number of idle connections that the pool should contain
+     */
+    void reserve(std::size_t n);
+
+    /// deletes all of the idle connections and stops recycling
+    void close(void);
+
+    /// returns the number of idle connections in the pool
+    std::size_t size(void) const;
+
+    /// returns the maximum number of idle connections kept in the pool
+    inline std::size_t get_max_size(void) const { return m_max_size; }
+
+    /// returns the I/O service used by the pooled connections
+    inline asio::io_service& get_io_service(void) { return m_io_service; }
+
+
+private:
+
+    /// returns a connection to the pool (used as the shared_ptr deleter)
+    class recycler {
+    public:
+        explicit recycler(const std::shared_ptr<connection_pool>& pool_ptr)
+            : m_pool_ptr(pool_ptr) {}
+        inline void operator()(connection *conn_ptr) const { m_pool_ptr->recycle(conn_ptr); }
+    private:
+        std::shared_ptr<connection_pool>   m_pool_ptr;
+    };
+
+    /// allocates a new connection object
+    connection *allocate(void);
+
+    /**
+     * keeps a connection for reuse if there is room, or else deletes it
+     *
+     * @param conn_ptr the connection that is no longer referenced
+     */
+    void recycle(connection *conn_ptr);
+
+
+    /// asio service used by the pooled connections
+    asio::io_service &                  m_io_service;
+
+    /// context used for SSL configuration
+    connection::ssl_context_type &      m_ssl_context;
+
+    /// true if the connections are encrypted using SSL
+    const bool                          m_ssl_flag;
+
+    /// function called when a server has finished handling a connection
+    connection::connection_handler      m_finished_handler;
+
+    /// maximum number of idle connections kept in the pool
+    const std::size_t                   m_max_size;
+
+    /// I/O engine used by the connections
+    const scheduler::io_engine_type     m_io_engine;
+
+    /// closed connections that are ready to be reused
+    std::vector<connection*>            m_idle;
+
+    /// true after close() has been called
+    bool                                m_is_closed;
+
+    /// mutex used to protect the free list
+    mutable std::mutex                  m_mutex;
+};
+
+
+/// data type for a connection_pool pointer
+typedef std::shared_ptr<connection_pool>    connection_pool_ptr;
+
+
+}   // end namespace tcp
+}   // end namespace pion
+
+#endif
@@ -0,0 +1,196 @@
+// ---------------------------------------------------------------------
+// pion:  a Boost C++ framework for building lightweight HTTP interfaces
+// ---------------------------------------------------------------------
+// Copyright (C) 2021 Wang Qiang  (https://github.com/dnybz/pion)
+// Copyright (C) 2007-2014 Splunk Inc.  (https://github.com/splunk/pion)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+//
+
+#ifndef __PION_TCP_HANDLER_ALLOCATOR_HEADER__
+#define __PION_TCP_HANDLER_ALLOCATOR_HEADER__
+
+#include <atomic>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <pion/handler_stats.hpp>
+#include <pion/noncopyable.hpp>
+#include <asio.hpp>
+
+
+namespace pion {    // begin namespace pion
+namespace tcp {     // begin namespace tcp
+
+
+///
+/// handler_memory: a small arena of fixed-size blocks that asio uses to store
+/// the state of pending asynchronous operations, so that a connection can
+/// start new operations without allocating memory from the heap
+///
+class handler_memory
+    : private pion::noncopyable
+{
+public:
+
+    /// number of blocks, which limits the number of concurrent operations
+    /// (e.g. a read, a write and an SSL handshake) that use the arena
+    enum { NUM_BLOCKS = 3 };
+
+    /// size of each block (SSL reads and writes, which nest several asio
+    /// operations, need a little over 512 bytes)
+    enum { BLOCK_SIZE = 768 };
+
+    /// constructs an arena with all blocks available
+    handler_memory(void) : m_num_heap_allocations(0) {
+        for (int n = 0; n < NUM_BLOCKS; ++n)
+            m_in_use[n] = false;
+    }
+
+    /**
+     * allocates memory for an asynchronous operation: a free block if the
+     * operation fits in one, or else memory from the heap
+     *
+     * @param size number of bytes required
+     */
+    inline void *allocate(std::size_t size) {
+        if (size <= BLOCK_SIZE) {
+            for (int n = 0; n < NUM_BLOCKS; ++n) {
+                bool expected = false;
+                if (m_in_use[n].compare_exchange_strong(expected, true, std::memory_order_acquire))
+                    return &m_blocks[n];
+            }
+        }
+        ++m_num_heap_allocations;
+        return ::operator new(size);
+    }
+
+    /**
+     * releases memory that was returned by allocate()
+     *
+     * @param pointer memory to release
+     */
+    inline void deallocate(void *pointer) {
+        for (int n = 0; n < NUM_BLOCKS; ++n) {
+            if (pointer == &m_blocks[n]) {
+                m_in_use[n].store(false, std::memory_order_release);
+                return;
+            }
+        }
+        ::operator delete(pointer);
+    }
+
+    /// returns the number of operations that did not fit in the arena
+    inline std::size_t get_heap_allocations(void) const { return m_num_heap_allocations; }
+
+
+private:
+
+    /// data type for a block of memory
+    typedef std::aligned_storage<BLOCK_SIZE>::type      block_type;
+
+    /// memory blocks used for asynchronous operations
+    block_type                  m_blocks[NUM_BLOCKS];
+
+    /// true for each block that is currently in use
+    std::atomic<bool>           m_in_use[NUM_BLOCKS];
+
+    /// number of operations that had to be allocated from the heap
+    std::atomic<std::size_t>    m_num_heap_allocations;
+};
+
+
+/// data type for a handler_memory pointer
+typedef std::shared_ptr<handler_memory>     handler_memory_ptr;
+
+
+///
+/// alloc_handler: wraps a completion handler so that asio allocates the
+/// operation's state from a handler_memory arena.  The arena is kept alive
+/// until every operation that uses it has been released
+///
+template <typename Handler>
+class alloc_handler
+{
+public:
+
+    /**
+     * wraps a completion handler
+     *
+     * @param memory_ptr arena used for the operation's state
+     * @param handler the completion handler
+     */
+    alloc_handler(const handler_memory_ptr& memory_ptr, const Handler& handler)
+        : m_memory_ptr(memory_ptr), m_handler(handler)
+    {}
+
+    /// calls the wrapped completion handler
+    template <typename... Args>
+    inline void operator()(Args&&... args) {
+        m_handler(std::forward<Args>(args)...);
+    }
+
+    /// asio hook used to allocate memory for an operation
+    friend inline void *asio_handler_allocate(std::size_t size, alloc_handler *this_handler) {
+        return this_handler->m_memory_ptr->allocate(size);
+    }
+
+    /// asio hook used to release memory for an operation
+    friend inline void asio_handler_deallocate(void *pointer, std::size_t /* size */,
+                                               alloc_handler *this_handler)
+    {
+        this_handler->m_memory_ptr->deallocate(pointer);
+    }
+
+    /// asio hook used to invoke the handler (keeps the wrapped handler's
+    /// behavior, and tells the scheduler's statistics that a handler is running)
+    template <typename Function>
+    friend inline void asio_handler_invoke(Function& function, alloc_handler *this_handler) {
+        pion::handler_stats::handler_started();
+        asio_handler_invoke_helpers::invoke(function, this_handler->m_handler);
+    }
+
+    /// asio hook used to invoke the handler (keeps the wrapped handler's
+    /// behavior, and tells the scheduler's statistics that a handler is running)
+    template <typename Function>
+    friend inline void asio_handler_invoke(const Function& function, alloc_handler *this_handler) {
+        pion::handler_stats::handler_started();
+        asio_handler_invoke_helpers::invoke(function, this_handler->m_handler);
+    }
+
+    /// asio hook that tells if the handler continues the current operation
+    friend inline bool asio_handler_is_continuation(alloc_handler *this_handler) {
+        return asio_handler_cont_helpers::is_continuation(this_handler->m_handler);
+    }
+
+
+private:
+
+    /// arena used for the operation's state
+    handler_memory_ptr      m_memory_ptr;
+
+    /// the wrapped completion handler
+    Handler                 m_handler;
+};
+
+
+/**
+ * wraps a completion handler so that asio uses an arena for the operation
+ *
+ * @param memory_ptr arena used for the operation's state
+ * @param handler the completion handler
+ */
+template <typename Handler>
+inline alloc_handler<Handler> make_alloc_handler(const handler_memory_ptr& memory_ptr,
+                                                 const Handler& handler)
+{
+    return alloc_handler<Handler>(memory_ptr, handler);
+}
+
+
+}   // end namespace tcp
+}   // end namespace pion
+
+#endif
@@ -0,0 +1,116 @@
+// ---------------------------------------------------------------------
+// pion:  a Boost C++ framework for building lightweight HTTP interfaces
+// ---------------------------------------------------------------------
+// Copyright (C) 2021 Wang Qiang  (https://github.com/dnybz/pion)
+// Copyright (C) 2007-2014 Splunk Inc.  (https://github.com/splunk/pion)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+//
+
+#ifndef __PION_TCP_KTLS_HEADER__
+#define __PION_TCP_KTLS_HEADER__
+
+#include <pion/config.hpp>
+
+#ifdef PION_HAVE_SSL
+
+#include <atomic>
+#include <cstddef>
+#include <pion/noncopyable.hpp>
+#include <openssl/ssl.h>
+
+
+namespace pion {    // begin namespace pion
+namespace tcp {     // begin namespace tcp
+
+
+///
+/// ktls: moves the encryption of data that SSL connections send into the
+/// kernel (Linux kernel TLS).  Once a connection's handshake has finished,
+/// its sending keys and record sequence number are installed on the socket,
+/// and data written to the socket is encrypted by the kernel; received data
+/// is still decrypted by OpenSSL, which may already have read ahead of the
+/// handshake.  Connections whose kernel, protocol version or cipher is not
+/// supported keep using OpenSSL for both directions
+///
+class PION_API ktls
+    : private pion::noncopyable
+{
+public:
+
+    /// constructs an object that has not switched any connections yet
+    ktls(void) : m_num_enabled(0), m_num_fallbacks(0) {}
+
+    /// returns true if pion was built with kernel TLS support
+    static bool is_supported(void);
+
+    /**
+     * configures an SSL context so that its connections track what they
+     * need to switch to kernel TLS (the context's key log callback is used
+     * for this, and renegotiation is disabled)
+     *
+     * @param ctx the SSL context used to accept connections
+     */
+    void attach(SSL_CTX *ctx);
+
+    /**
+     * switches sending on a connection whose handshake has finished to
+     * kernel TLS; OpenSSL must not write to the connection afterwards (if it
+     * has to, e.g. to answer a key update, the socket is shut down)
+     *
+     * @param ssl the connection's SSL object (from a context passed to attach())
+     * @param fd the connection's socket
+     *
+     * @return bool true if data written to the socket is now encrypted by the kernel
+     */
+    bool enable(SSL *ssl, int fd);
+
+    /// returns the number of connections that were switched to kernel TLS
+    inline uint64_t get_num_enabled(void) const { return m_num_enabled; }
+
+    /// returns the number of connections that kept using OpenSSL to send data
+    inline uint64_t get_num_fallbacks(void) const { return m_num_fallbacks; }
+
+
+private:
+
+    /// what an SSL connection needs to know to switch to kernel TLS
+    struct tx_state;
+
+    /**
+     * returns the state of an SSL connection
+     *
+     * @param ssl the SSL connection
+     * @param create if true, the state is created if the connection has none
+     *
+     * @return tx_state* the state, or NULL if there is none
+     */
+    static tx_state *get_state(const SSL *ssl, bool create);
+
+    /// OpenSSL callback: frees the state of an SSL connection
+    static void free_state_callback(void *parent, void *ptr, CRYPTO_EX_DATA *ad,
+                                    int idx, long argl, void *argp);
+
+    /// OpenSSL callback: a secret of an SSL connection has been derived
+    static void keylog_callback(const SSL *ssl, const char *line);
+
+    /// OpenSSL callback: a protocol message or record header has been sent or received
+    static void msg_callback(int write_p, int version, int content_type,
+                             const void *buf, std::size_t len, SSL *ssl, void *arg);
+
+
+    /// number of connections that were switched to kernel TLS
+    std::atomic<uint64_t>           m_num_enabled;
+
+    /// number of connections that kept using OpenSSL to send data
+    std::atomic<uint64_t>           m_num_fallbacks;
+};
+
+
+}   // end namespace tcp
+}   // end namespace pion
+
+#endif  // PION_HAVE_SSL
+
+#endif
@@ -0,0 +1,122 @@
+// ---------------------------------------------------------------------
+// pion:  a Boost C++ framework for building lightweight HTTP interfaces
+// ---------------------------------------------------------------------
+// Copyright (C) 2021 Wang Qiang  (https://github.com/dnybz/pion)
+// Copyright (C) 2007-2014 Splunk Inc.  (https://github.com/splunk/pion)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+//
+
+#ifndef __PION_TCP_LISTEN_HANDOFF_HEADER__
+#define __PION_TCP_LISTEN_HANDOFF_HEADER__
+
+#include <pion/config.hpp>
+#include <pion/noncopyable.hpp>
+#include <string>
+#include <vector>
+
+
+namespace pion {    // begin namespace pion
+namespace tcp {     // begin namespace tcp
+
+
+///
+/// listen_handoff: passes the listening sockets of a running process to a
+/// new one over a Unix domain socket, so that a server can be restarted
+/// without refusing a single connection.  The running process offers its
+/// sockets at a path; the new process takes them, starts accepting from them
+/// and confirms, after which the running process may stop and let its open
+/// connections finish.  Connections that arrive in between wait in the
+/// sockets' backlogs, which both processes share (POSIX only)
+///
+class PION_API listen_handoff
+    : private pion::noncopyable
+{
+public:
+
+    /// most listening sockets that can be handed off at once
+    enum { MAX_FDS = 64 };
+
+    /**
+     * creates a handoff at a path; the socket file is only accessible to the
+     * user that runs the process
+     *
+     * @param path file system path of the Unix domain socket used for the handoff
+     */
+    explicit listen_handoff(const std::string& path);
+
+    /// closes the handoff (without confirming sockets that were taken)
+    ~listen_handoff();
+
+    /// returns true if listening sockets can be handed off on this platform
+    static bool is_supported(void);
+
+    /**
+     * connects to a running process that offers its listening sockets at the
+     * path and receives them; confirm() tells it when they are accepted from
+     *
+     * @param fds receives the listening sockets (the caller owns them)
+     *
+     * @return bool true if sockets were received, false if no process offers them
+     */
+    bool take(std::vector<int>& fds);
+
+    /// tells the process that the sockets were taken from that they are
+    /// accepted from now (does nothing if no sockets were taken)
+    void confirm(void);
+
+    /**
+     * offers listening sockets at the path until a new process has taken them
+     * and confirmed (blocks); if a new process goes away before confirming,
+     * the sockets are offered again
+     *
+     * @param fds the listening sockets (the caller still owns them)
+     *
+     * @return bool true if a new process took the sockets, false if cancel() was called
+     */
+    bool offer(const std::vector<int>& fds);
+
+    /// makes offer() return false (may be called from any thread)
+    void cancel(void);
+
+    /// returns the path of the Unix domain socket used for the handoff
+    inline const std::string& get_path(void) const { return m_path; }
+
+
+private:
+
+    /// binds and listens on the handoff path, replacing a stale socket file
+    void open_listener(void);
+
+    /// closes the handoff socket that offer() listens on, and removes its file
+    void close_listener(void);
+
+    /**
+     * waits until a socket has data or a connection to accept
+     *
+     * @param fd the socket to wait for
+     *
+     * @return bool false if cancel() was called
+     */
+    bool wait_readable(int fd);
+
+
+    /// file system path of the Unix domain socket used for the handoff
+    const std::string       m_path;
+
+    /// socket that offer() listens on (-1 if none)
+    int                     m_listen_fd;
+
+    /// connection to the process that sockets were taken from (-1 if none)
+    int                     m_taken_fd;
+
+    /// pipe written to by cancel(), which wakes offer() up
+    int                     m_cancel_fds[2];
+};
+
+
+}   // end namespace tcp
+}   // end namespace pion
+
+#endif
@@ -16,7 +16,15 @@
 #include <pion/scheduler.hpp>
 #include <pion/noncopyable.hpp>
 #include <pion/tcp/connection.hpp>
-#include <set>
+#include <pion/tcp/connection_pool.hpp>
+#include <pion/tcp/socket_options.hpp>
+#include <pion/tcp/ktls.hpp>
+#include <pion/tcp/ssl_session_cache.hpp>
+#include <array>
+#include <string>
+#include <atomic>
+#include <unordered_set>
+#include <vector>
 #include <asio.hpp>
 
 namespace pion {    // begin namespace pion
@@ -31,6 +39,12 @@ class PION_API server :
 {
 public:
 
+    /// what the server does when a connection or request limit is reached
+    enum overload_policy_type {
+        OVERLOAD_PAUSE,     ///< stop accepting (the kernel queues new connections)
+        OVERLOAD_REJECT     ///< refuse new connections and requests (see handle_overload())
+    };
+
     /// default destructor
     virtual ~server() { if (m_is_listening) stop(false); }
     
@@ -72,8 +86,63 @@ public:
     /// returns tcp endpoint that the server listens for connections on
     inline const asio::ip::tcp::endpoint& get_endpoint(void) const { return m_endpoint; }
     
-    /// sets tcp endpoint that the server listens for connections on
-    inline void set_endpoint(const asio::ip::tcp::endpoint& ep) { m_endpoint = ep; }
+    /// sets tcp endpoint that the server listens for connections on (instead
+    /// of a Unix domain socket)
+    inline void set_endpoint(const asio::ip::tcp::endpoint& ep) {
+        m_endpoint = ep;
+        m_local_path.clear();
+    }
+
+#ifdef ASIO_HAS_LOCAL_SOCKETS
+    /**
+     * sets a Unix domain socket that the server listens on instead of its tcp
+     * endpoint (an empty path switches back to TCP).  A stale socket file
+     * left at the path is replaced, and the file is removed when the server
+     * stops; paths that start with a null character are abstract sockets
+     *
+     * @param ep the Unix domain socket endpoint to listen on
+     */
+    inline void set_local_endpoint(const asio::local::stream_protocol::endpoint& ep) {
+        m_local_path = ep.path();
+    }
+
+    /// returns the Unix domain socket endpoint that the server listens on
+    inline asio::local::stream_protocol::endpoint get_local_endpoint(void) const {
+        return asio::local::stream_protocol::endpoint(m_local_path);
+    }
+#endif
+
+    /// returns true if the server listens on a Unix domain socket
+    inline bool is_local(void) const { return ! m_local_path.empty(); }
+
+    /**
+     * sets listening sockets that the server adopts the next time it is
+     * started, instead of binding its endpoint: sockets passed by the service
+     * manager (see process::get_listen_fds()) or taken over from a running
+     * process (see listen_handoff).  The server's endpoint or Unix domain
+     * socket path is taken from the sockets, and with several sockets each
+     * accepts for its own I/O service, as in multi-acceptor mode.  The server
+     * owns the sockets from then on
+     *
+     * @param fds the listening sockets to adopt
+     */
+    inline void set_listen_fds(const std::vector<int>& fds) { m_adopted_fds = fds; }
+
+    /// returns the listening sockets that are accepting connections, e.g. to
+    /// hand them to a new process (the server still owns them)
+    std::vector<int> get_listen_fds(void) const;
+
+    /**
+     * sets whether stopping the server leaves its Unix domain socket file in
+     * place, e.g. because another process took over the socket (adopted
+     * sockets are always left in place)
+     *
+     * @param b true to leave the socket file in place
+     */
+    inline void set_keep_local_socket(bool b = true) { m_keep_local_socket = b; }
+
+    /// returns true if stopping the server leaves its Unix domain socket file in place
+    inline bool get_keep_local_socket(void) const { return m_keep_local_socket; }
 
     /// returns true if the server uses SSL to encrypt connections
     inline bool get_ssl_flag(void) const { return m_ssl_flag; }
@@ -83,10 +152,188 @@ public:
     
     /// returns the SSL context for configuration
     inline connection::ssl_context_type& get_ssl_context_type(void) { return m_ssl_context; }
+
+#ifdef PION_HAVE_SSL
+    /// returns the cache used to resume SSL sessions (its settings take
+    /// effect the next time the server is started)
+    inline ssl_session_cache& get_ssl_session_cache(void) { return m_ssl_session_cache; }
+
+    /// returns the cache used to resume SSL sessions
+    inline const ssl_session_cache& get_ssl_session_cache(void) const { return m_ssl_session_cache; }
+
+    /// returns kernel TLS support, which counts the connections that were switched to it
+    inline const ktls& get_ktls(void) const { return m_ktls; }
+#endif
+
+    /**
+     * sets whether SSL connections should send data using kernel TLS (Linux
+     * only): once a connection's handshake has finished, the kernel encrypts
+     * the data that it sends, while received data is still decrypted by
+     * OpenSSL.  Connections whose kernel or cipher is not supported keep
+     * using OpenSSL.  Takes effect the next time the server is started
+     *
+     * @param b true to switch SSL connections to kernel TLS
+     */
+    inline void set_ktls_flag(bool b = true) { m_ktls_flag = b; }
+
+    /// returns true if SSL connections should send data using kernel TLS
+    inline bool get_ktls_flag(void) const { return m_ktls_flag; }
+
+    /**
+     * sets the number of threads that run the CPU-heavy steps of SSL
+     * handshakes (key exchange, signatures), so that a burst of new
+     * connections does not hold up the requests of established ones.  The
+     * I/O for the handshakes still runs on the connections' I/O services,
+     * and the connections go back to them once their handshakes have
+     * finished.  If the pool's queue is full, a step runs on the I/O service
+     * instead.  Takes effect the next time the server is started
+     *
+     * @param n number of threads (0 = run handshakes on the I/O services)
+     */
+    inline void set_handshake_threads(uint32_t n) { m_handshake_threads = n; }
+
+    /// returns the number of threads that run SSL handshakes (0 = the I/O services)
+    inline uint32_t get_handshake_threads(void) const { return m_handshake_threads; }
+
+    /// returns the pool that runs SSL handshakes (for its queue limit and counters)
+    inline offload_pool& get_handshake_pool(void) { return m_handshake_pool; }
+
+    /// returns the time that SSL handshakes spent waiting for the handshake
+    /// pool (the total for each handshake)
+    scheduler::histogram get_handshake_queue_wait(void) const;
+
+    /// returns the time that SSL handshakes took, from the first step until
+    /// the connection was handed back to its I/O service
+    scheduler::histogram get_handshake_duration(void) const;
     
     /// returns true if the server is listening for connections
     inline bool is_listening(void) const { return m_is_listening; }
     
+    /**
+     * enables or disables multi-acceptor mode: when enabled, start() opens one
+     * SO_REUSEPORT listening socket for each of the scheduler's I/O services,
+     * and each accepts and handles its own connections so that the kernel
+     * spreads new connections across threads (ignored if not supported)
+     *
+     * @param b true to use one acceptor per I/O service
+     */
+    inline void set_multi_acceptor(bool b = true) { m_multi_acceptor = b; }
+
+    /// returns true if multi-acceptor mode is enabled
+    inline bool get_multi_acceptor(void) const { return m_multi_acceptor; }
+
+    /// returns the number of listening sockets that are accepting connections
+    inline std::size_t get_num_acceptors(void) const { return m_listeners.size(); }
+
+    /**
+     * sets the number of closed connection objects that are kept for reuse
+     * by each I/O service; this many are allocated when the server starts.
+     * Connections are not pooled if the size is zero
+     *
+     * @param n maximum number of idle connections per I/O service
+     */
+    inline void set_connection_pool_size(std::size_t n) { m_connection_pool_size = n; }
+
+    /// returns the number of closed connection objects kept for reuse by each I/O service
+    inline std::size_t get_connection_pool_size(void) const { return m_connection_pool_size; }
+
+    /// returns the number of closed connection objects that are currently
+    /// waiting to be reused (for all I/O services)
+    std::size_t get_idle_connections(void) const;
+
+    /**
+     * sets the I/O engine used to accept connections and for their reads and
+     * writes (the default is the scheduler's engine).  Takes effect the next
+     * time the server is started; io_uring falls back to the reactor if the
+     * kernel does not support it
+     *
+     * @param engine the I/O engine to use
+     */
+    inline void set_io_engine(scheduler::io_engine_type engine) { m_io_engine = engine; }
+
+    /// returns the I/O engine used by the server
+    inline scheduler::io_engine_type get_io_engine(void) const { return m_io_engine; }
+
+    /**
+     * sets the options for the listening sockets and the connections that
+     * they accept.  Takes effect the next time the server is started
+     *
+     * @param opts the socket options to use
+     */
+    inline void set_socket_options(const socket_options& opts) { m_socket_options = opts; }
+
+    /// returns the options for the listening sockets and accepted connections
+    inline const socket_options& get_socket_options(void) const { return m_socket_options; }
+
+    /**
+     * sets the maximum number of open connections
+     *
+     * @param n maximum number of connections (0 = no limit)
+     */
+    inline void set_max_connections(std::size_t n) { m_max_connections = n; }
+
+    /// returns the maximum number of open connections (0 = no limit)
+    inline std::size_t get_max_connections(void) const { return m_max_connections; }
+
+    /**
+     * sets the maximum number of requests in flight, i.e. received but not
+     * yet finished (derived servers count them with begin_request())
+     *
+     * @param n maximum number of requests (0 = no limit)
+     */
+    inline void set_max_requests(std::size_t n) { m_max_requests = n; }
+
+    /// returns the maximum number of requests in flight (0 = no limit)
+    inline std::size_t get_max_requests(void) const { return m_max_requests; }
+
+    /**
+     * sets the maximum number of connections accepted per second
+     *
+     * @param n maximum accept rate (0 = no limit)
+     */
+    inline void set_max_accept_rate(std::size_t n) { m_max_accept_rate = n; }
+
+    /// returns the maximum number of connections accepted per second (0 = no limit)
+    inline std::size_t get_max_accept_rate(void) const { return m_max_accept_rate; }
+
+    /**
+     * sets what the server does when a limit is reached: OVERLOAD_PAUSE stops
+     * accepting until the server is below its limits again, leaving new
+     * connections in the kernel's backlog; OVERLOAD_REJECT keeps accepting,
+     * but refuses connections and requests over the limits
+     *
+     * @param policy the overload policy to use
+     */
+    inline void set_overload_policy(overload_policy_type policy) { m_overload_policy = policy; }
+
+    /// returns what the server does when a limit is reached
+    inline overload_policy_type get_overload_policy(void) const { return m_overload_policy; }
+
+    /// returns the number of requests in flight
+    inline std::size_t get_requests_in_flight(void) const { return m_requests_in_flight; }
+
+    /// returns the number of connections refused because a limit was reached
+    inline uint64_t get_rejected_connections(void) const { return m_num_rejected_connections; }
+
+    /// returns the number of requests refused because a limit was reached
+    inline uint64_t get_rejected_requests(void) const { return m_num_rejected_requests; }
+
+    /// returns the number of times that a listening socket stopped accepting
+    /// because a limit was reached
+    inline uint64_t get_accept_pauses(void) const { return m_num_accept_pauses; }
+
+    /// returns the number of connections cut off because their message
+    /// headers took too long to arrive
+    inline uint64_t get_header_timeouts(void) const { return m_num_header_timeouts; }
+
+    /// returns the number of connections cut off because their message body
+    /// arrived too slowly
+    inline uint64_t get_body_rate_timeouts(void) const { return m_num_body_rate_timeouts; }
+
+    /// returns the number of connections cut off because the peer stopped
+    /// accepting sent data
+    inline uint64_t get_send_stalls(void) const { return m_num_send_stalls; }
+    
     /// sets the logger to be used
     inline void set_logger(logger log_ptr) { m_logger = log_ptr; }
     
@@ -131,6 +378,23 @@ protected:
      * @param endpoint TCP endpoint used to listen for new connections (see ASIO docs)
      */
     server(scheduler& sched, const asio::ip::tcp::endpoint& endpoint);
+
+#ifdef ASIO_HAS_LOCAL_SOCKETS
+    /**
+     * protected constructor so that only derived objects may be created
+     * 
+     * @param endpoint Unix domain socket used to listen for new connections
+     */
+    explicit server(const asio::local::stream_protocol::endpoint& endpoint);
+
+    /**
+     * protected constructor so that only derived objects may be created
+     * 
+     * @param sched the scheduler that will be used to manage worker threads
+     * @param endpoint Unix domain socket used to listen for new connections
+     */
+    server(scheduler& sched, const asio::local::stream_protocol::endpoint& endpoint);
+#endif
     
     /**
      * handles a new TCP connection; derived classes SHOULD override this
@@ -143,6 +407,27 @@ protected:
         tcp_conn->finish();
     }
     
+    /**
+     * refuses a connection or request because the server is overloaded;
+     * derived classes may override this to send a response first
+     *
+     * @param tcp_conn the TCP connection to refuse
+     */
+    virtual void handle_overload(const tcp::connection_ptr& tcp_conn) {
+        tcp_conn->set_lifecycle(connection::LIFECYCLE_CLOSE); // make sure it will get closed
+        tcp_conn->finish();
+    }
+
+    /**
+     * counts a request received on a connection as in flight until the
+     * connection is finished
+     *
+     * @param tcp_conn the TCP connection that received the request
+     *
+     * @return bool false if the request must be refused (see handle_overload())
+     */
+    bool begin_request(const tcp::connection_ptr& tcp_conn);
+
     /// called before the TCP server starts listening for new connections
     virtual void before_starting(void) {}
 
@@ -151,6 +436,9 @@ protected:
     
     /// returns an async I/O service used to schedule work
     inline asio::io_service& get_io_service(void) { return m_active_scheduler.get_io_service(); }
+
+    /// returns a description of where the server listens, for log messages
+    std::string get_listen_name(void) const;
     
     
     /// primary logging interface used by this class
@@ -158,22 +446,199 @@ protected:
     
     
 private:
+
+    /**
+     * constructor that the others delegate to
+     *
+     * @param sched_ptr the scheduler that will be used to manage worker threads
+     *                  (NULL = the server's own single_service_scheduler)
+     * @param endpoint TCP endpoint used to listen for new connections
+     * @param local_path Unix domain socket used instead of the endpoint (empty = TCP)
+     */
+    server(scheduler *sched_ptr, const asio::ip::tcp::endpoint& endpoint,
+           const std::string& local_path);
         
+    /// a listening socket and the I/O service that handles its connections
+    struct listener_type {
+        /// constructs a listener for the server's primary acceptor
+        explicit listener_type(asio::ip::tcp::acceptor& acceptor)
+            : m_acceptor(acceptor), m_service(NULL), m_uring_ptr(NULL), m_paused(false) {}
+
+        /// constructs a listener that owns an acceptor bound to an I/O service
+        explicit listener_type(asio::io_service& service)
+            : m_acceptor_ptr(new asio::ip::tcp::acceptor(service)),
+            m_acceptor(*m_acceptor_ptr), m_service(&service), m_uring_ptr(NULL),
+            m_paused(false) {}
+
+        /// owns the acceptor (only for listeners other than the primary one)
+        std::unique_ptr<asio::ip::tcp::acceptor>  m_acceptor_ptr;
+
+        /// manages async TCP connections
+        asio::ip::tcp::acceptor &        m_acceptor;
+
+        /// I/O service used for new connections (NULL = ask the scheduler)
+        asio::io_service *               m_service;
+
+        /// io_uring engine that accepts connections (NULL if the reactor is used)
+        uring_service *                  m_uring_ptr;
+
+        /// true if the listener has stopped accepting because a limit was reached
+        std::atomic<bool>                m_paused;
+
+        /// protects the acceptor from being closed while accepting
+        std::mutex                       m_mutex;
+    };
+
+    /// data type for a pointer to a listener
+    typedef std::shared_ptr<listener_type>  listener_ptr;
+
+    /// data type for a collection of listeners
+    typedef std::vector<listener_ptr>       listener_pool_type;
+
+
     /// handles a request to stop the server
     void handle_stop_request(void);
     
-    /// listens for a new connection
-    void listen(void);
+    /**
+     * creates, binds and opens the listening sockets (assumes the server lock is held)
+     *
+     * @param reuse_port if true, SO_REUSEPORT is set on each listening socket
+     */
+    void open_listeners(bool reuse_port);
+
+    /// adopts the listening sockets set by set_listen_fds() (assumes the server lock is held)
+    void adopt_listeners(void);
+
+    /**
+     * makes an acceptor use a listening socket that is already open, and
+     * takes the server's endpoint or Unix domain socket path from it
+     *
+     * @param acceptor the acceptor that adopts the socket
+     * @param fd the listening socket (closed if it cannot be adopted)
+     */
+    void adopt_acceptor(asio::ip::tcp::acceptor& acceptor, int fd);
+
+    /**
+     * opens a listening socket on the server's endpoint
+     *
+     * @param acceptor the acceptor to open
+     * @param reuse_port if true, SO_REUSEPORT is set before binding
+     */
+    void open_acceptor(asio::ip::tcp::acceptor& acceptor, bool reuse_port);
+
+    /**
+     * opens a listening Unix domain socket on the server's local path; the
+     * acceptor adopts it so that connections are handled like tcp ones
+     *
+     * @param acceptor the acceptor to open
+     */
+    void open_local_acceptor(asio::ip::tcp::acceptor& acceptor);
+
+    /// removes the Unix domain socket file that the server listened on (if any)
+    void remove_local_socket(void);
+
+    /// creates a pool of reusable connections for each I/O service (assumes the server lock is held)
+    void open_connection_pools(void);
+
+    /// releases the pools of reusable connections (assumes the server lock is held)
+    void close_connection_pools(void);
+
+    /**
+     * returns a new connection object, recycled from a pool if possible
+     *
+     * @param service the I/O service that will handle the connection
+     */
+    tcp::connection_ptr create_connection(asio::io_service& service);
+
+    /**
+     * listens for a new connection
+     *
+     * @param listener the listening socket that will accept the connection
+     */
+    void listen(const listener_ptr& listener);
 
     /**
      * handles new connections (checks if there was an accept error)
      *
+     * @param listener the listening socket that accepted the connection
      * @param tcp_conn the new TCP connection (if no error occurred)
      * @param accept_error true if an error occurred while accepting connections
      */
-    void handle_accept(const tcp::connection_ptr& tcp_conn,
+    void handle_accept(const listener_ptr& listener,
+                      const tcp::connection_ptr& tcp_conn,
                       const asio::error_code& accept_error);
 
+    /**
+     * handles new connections accepted by io_uring (checks if there was an
+     * accept error)
+     *
+     * @param listener the listening socket that accepted the connection
+     * @param accept_error true if an error occurred while accepting connections
+     * @param fd the new socket (if no error occurred)
+     * @param more true if the listener will keep accepting connections
+     */
+    void handle_uring_accept(const listener_ptr& listener,
+                             const asio::error_code& accept_error,
+                             int fd, bool more);
+
+    /**
+     * counts a new connection against the accept rate and checks whether it
+     * must be refused (without locking)
+     *
+     * @return bool true if the connection may be handled
+     */
+    bool admit_connection(void);
+
+    /// returns true if the current one-second window has no accepts left
+    bool accept_rate_exhausted(void) const;
+
+    /// returns true if the server has reached one of its limits
+    inline bool limits_reached(void) const {
+        return (m_max_connections > 0 && m_num_connections >= m_max_connections)
+            || (m_max_requests > 0 && m_requests_in_flight >= m_max_requests)
+            || (m_max_accept_rate > 0 && accept_rate_exhausted());
+    }
+
+    /**
+     * stops a listening socket from accepting until the server is below its limits
+     *
+     * @param listener the listening socket to pause
+     */
+    void pause_listener(const listener_ptr& listener);
+
+    /// starts accepting again on paused listening sockets if the server is below its limits
+    void resume_listeners(void);
+
+    /**
+     * resumes paused listening sockets when a new accept rate window starts
+     *
+     * @param ec deadline timer error status code
+     */
+    void handle_resume_timer(const asio::error_code& ec);
+
+    /**
+     * refuses a connection that was accepted while the server was overloaded
+     *
+     * @param tcp_conn the new TCP connection
+     */
+    void reject_connection(const tcp::connection_ptr& tcp_conn);
+
+    /**
+     * applies the socket options that accepted connections do not inherit
+     * from the listening socket
+     *
+     * @param tcp_conn the new TCP connection
+     */
+    void apply_socket_options(const tcp::connection_ptr& tcp_conn);
+
+    /**
+     * starts handling a connection that was just accepted (after an SSL
+     * handshake, if necessary)
+     *
+     * @param tcp_conn the new TCP connection
+     */
+    void start_connection(const tcp::connection_ptr& tcp_conn);
+
     /**
      * handles new connections following an SSL handshake (checks for errors)
      *
@@ -182,6 +647,29 @@ private:
      */
     void handle_ssl_handshake(const tcp::connection_ptr& tcp_conn,
                             const asio::error_code& handshake_error);
+
+    /// completion handler for SSL handshakes that runs their steps on the
+    /// handshake pool (if there is one) and records their timing
+    class handshake_handler;
+
+    /**
+     * runs a step of an SSL handshake on the handshake pool, or right away if
+     * its queue is full (or on the connection's I/O service if the pool is
+     * stopped before the step runs)
+     *
+     * @param tcp_conn the connection that is doing the handshake
+     * @param step the step to run
+     */
+    void offload_handshake_step(const tcp::connection_ptr& tcp_conn, task step);
+
+    /**
+     * records the timing of an SSL handshake
+     *
+     * @param offloaded true if the handshake's steps ran on the handshake pool
+     * @param queue_usec microseconds that the handshake waited for the handshake pool
+     * @param duration_usec microseconds that the handshake took
+     */
+    void record_handshake(bool offloaded, uint64_t queue_usec, uint64_t duration_usec);
     
     /// This will be called by connection::finish() after a server has
     /// finished handling a connection.  If the keep_alive flag is true,
@@ -193,11 +681,56 @@ private:
     /// and returns the remaining number of connections in the pool
     std::size_t prune_connections(void);
     
+    /// adds a connection to the server's management pool
+    void add_connection(const tcp::connection_ptr& tcp_conn);
+
+    /// removes a connection from the server's management pool
+    void remove_connection(const tcp::connection_ptr& tcp_conn);
+
+    /// closes all of the connections in the server's management pool
+    void close_connections(void);
+
+    /// schedules the next periodic scan for orphaned connections
+    void schedule_prune_timer(void);
+
+    /**
+     * periodically prunes orphaned connections (keeps them off the accept path)
+     *
+     * @param ec deadline timer error status code
+     */
+    void handle_prune_timer(const asio::error_code& ec);
+    
     
     /// data type for a pool of TCP connections
-    typedef std::set<tcp::connection_ptr>   ConnectionPool;
+    typedef std::unordered_set<tcp::connection_ptr>   ConnectionPool;
     
+    /// a partition of the connection pool that is protected by its own mutex
+    struct connection_shard {
+        std::mutex          m_mutex;
+        ConnectionPool      m_conns;
+    };
+
+    /// number of partitions used for the connection pool (must be a power of 2)
+    enum { NUM_CONNECTION_SHARDS = 16 };
+
+    /// data type for a partitioned pool of TCP connections
+    typedef std::array<connection_shard, NUM_CONNECTION_SHARDS>    ShardedConnectionPool;
+
+    /// returns the connection pool partition that manages a connection
+    inline connection_shard& get_shard(const tcp::connection_ptr& tcp_conn) {
+        // skip the low-order bits, which are the same for every heap object
+        const std::size_t n = reinterpret_cast<std::size_t>(tcp_conn.get()) >> 6;
+        return m_conn_pool[(n ^ (n >> 4)) & (NUM_CONNECTION_SHARDS - 1)];
+    }
+
+
+    /// number of seconds between scans for orphaned connections
+    static const uint32_t                   PRUNE_TIMER_SECONDS;
+
+    /// default number of idle connections kept for reuse by each I/O service
+    static const std::size_t                DEFAULT_CONNECTION_POOL_SIZE;
     
+
     /// the default scheduler object used to manage worker threads
     single_service_scheduler                m_default_scheduler;
 
@@ -207,6 +740,18 @@ private:
     /// manages async TCP connections
     asio::ip::tcp::acceptor          m_tcp_acceptor;
 
+    /// listening sockets that are accepting connections (the first uses m_tcp_acceptor)
+    listener_pool_type                      m_listeners;
+
+#ifdef PION_HAVE_SSL
+    /// resumes SSL sessions for all of the server's connections (declared
+    /// before the SSL context, which refers to it, so that it outlives it)
+    ssl_session_cache                       m_ssl_session_cache;
+
+    /// switches SSL connections to kernel TLS
+    ktls                                    m_ktls;
+#endif
+
     /// context used for SSL configuration
     connection::ssl_context_type            m_ssl_context;
         
@@ -217,16 +762,111 @@ private:
     std::condition_variable                        m_no_more_connections;
 
     /// pool of active connections associated with this server 
-    ConnectionPool                          m_conn_pool;
+    ShardedConnectionPool                   m_conn_pool;
+
+    /// number of connections in the pool (kept separately so it can be read without locking)
+    std::atomic<std::size_t>                m_num_connections;
+
+    /// timer used to periodically prune orphaned connections
+    asio::steady_timer                      m_prune_timer;
+
+    /// timer used to resume accepting when the next accept rate window starts
+    asio::steady_timer                      m_resume_timer;
+
+    /// true while the resume timer is waiting
+    std::atomic<bool>                       m_resume_timer_armed;
+
+    /// pools of reusable connection objects (one for each I/O service)
+    std::vector<connection_pool_ptr>        m_free_connections;
+
+    /// number of idle connections kept for reuse by each I/O service
+    std::size_t                             m_connection_pool_size;
 
     /// tcp endpoint used to listen for new connections
     asio::ip::tcp::endpoint          m_endpoint;
 
+    /// path of the Unix domain socket used instead of m_endpoint (empty = TCP)
+    std::string                             m_local_path;
+
+    /// listening sockets to adopt the next time the server is started
+    std::vector<int>                        m_adopted_fds;
+
     /// true if the server uses SSL to encrypt connections
     bool                                    m_ssl_flag;
 
+    /// true if SSL connections should send data using kernel TLS
+    bool                                    m_ktls_flag;
+
+    /// true if stopping the server leaves the Unix domain socket file in place
+    bool                                    m_keep_local_socket;
+
+    /// true if one SO_REUSEPORT acceptor should be used per I/O service
+    bool                                    m_multi_acceptor;
+
+    /// I/O engine used to accept connections and for their reads and writes
+    scheduler::io_engine_type               m_io_engine;
+
+    /// options for the listening sockets and accepted connections
+    socket_options                          m_socket_options;
+
+    /// maximum number of open connections (0 = no limit)
+    std::size_t                             m_max_connections;
+
+    /// maximum number of requests in flight (0 = no limit)
+    std::size_t                             m_max_requests;
+
+    /// maximum number of connections accepted per second (0 = no limit)
+    std::size_t                             m_max_accept_rate;
+
+    /// what the server does when a limit is reached
+    overload_policy_type                    m_overload_policy;
+
+    /// number of requests received but not yet finished
+    std::atomic<std::size_t>                m_requests_in_flight;
+
+    /// second (of the steady clock) in which connections are being counted, in
+    /// the upper 32 bits, and the number accepted in it, in the lower 32 bits
+    /// (one atomic, so that starting a new second cannot lose concurrent counts)
+    std::atomic<uint64_t>                   m_accept_window;
+
+    /// number of listening sockets that have stopped accepting
+    std::atomic<std::size_t>                m_num_paused_listeners;
+
+    /// number of connections refused because a limit was reached
+    std::atomic<uint64_t>                   m_num_rejected_connections;
+
+    /// number of requests refused because a limit was reached
+    std::atomic<uint64_t>                   m_num_rejected_requests;
+
+    /// number of times that a listening socket stopped accepting
+    std::atomic<uint64_t>                   m_num_accept_pauses;
+
+    /// number of connections cut off because their headers took too long
+    std::atomic<uint64_t>                   m_num_header_timeouts;
+
+    /// number of connections cut off because their body arrived too slowly
+    std::atomic<uint64_t>                   m_num_body_rate_timeouts;
+
+    /// number of connections cut off because the peer stopped accepting data
+    std::atomic<uint64_t>                   m_num_send_stalls;
+
+    /// number of threads that run SSL handshakes (0 = the I/O services)
+    uint32_t                                m_handshake_threads;
+
+    /// runs the CPU-heavy steps of SSL handshakes
+    offload_pool                            m_handshake_pool;
+
+    /// time that SSL handshakes spent waiting for the handshake pool
+    scheduler::histogram                    m_handshake_queue_wait;
+
+    /// time that SSL handshakes took
+    scheduler::histogram                    m_handshake_duration;
+
+    /// protects the SSL handshake histograms
+    mutable std::mutex                      m_handshake_mutex;
+
     /// set to true when the server is listening for new connections
-    bool                                    m_is_listening;
+    std::atomic<bool>                       m_is_listening;
 
     /// mutex to make class thread-safe
     mutable std::mutex                    m_mutex;
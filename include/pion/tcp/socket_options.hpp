@@ -0,0 +1,129 @@
+// ---------------------------------------------------------------------
+// pion:  a Boost C++ framework for building lightweight HTTP interfaces
+// ---------------------------------------------------------------------
+// Copyright (C) 2021 Wang Qiang  (https://github.com/dnybz/pion)
+// Copyright (C) 2007-2014 Splunk Inc.  (https://github.com/splunk/pion)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+//
+
+#ifndef __PION_TCP_SOCKET_OPTIONS_HEADER__
+#define __PION_TCP_SOCKET_OPTIONS_HEADER__
+
+#include <string>
+#include <pion/config.hpp>
+#include <asio.hpp>
+
+
+namespace pion {    // begin namespace pion
+namespace tcp {     // begin namespace tcp
+
+
+///
+/// socket_options: options for a listening socket and the connections it
+/// accepts.  Zero or false leaves the operating system's default in place,
+/// and options that the platform does not support are ignored
+///
+struct PION_API socket_options
+{
+    /// constructs options that keep the operating system's defaults
+    socket_options(void)
+        : m_backlog(0), m_reuse_address(true), m_no_delay(false),
+        m_send_buffer_size(0), m_receive_buffer_size(0),
+        m_keep_alive(false), m_keep_alive_idle(0), m_keep_alive_interval(0),
+        m_keep_alive_count(0), m_user_timeout(0), m_defer_accept(0),
+        m_fast_open(0), m_quick_ack(false)
+    {}
+
+    /**
+     * sets an option by name (used for configuration files).  The names are
+     * backlog, reuse_address, nodelay, send_buffer, receive_buffer, keepalive,
+     * keepalive_idle, keepalive_interval, keepalive_count, user_timeout,
+     * defer_accept, fast_open and quickack
+     *
+     * @param name the name of the option
+     * @param value the option's value (a number; booleans are 0 or 1)
+     *
+     * @return bool true if the option was recognized and the value is valid
+     */
+    bool set(const std::string& name, const std::string& value);
+
+    /**
+     * applies the options to a listening socket before it is bound; the
+     * connections that it accepts inherit most of them
+     *
+     * @param acceptor the listening socket (must be open)
+     */
+    void apply(asio::ip::tcp::acceptor& acceptor) const;
+
+    /**
+     * applies the per-connection options to a socket
+     *
+     * @param sock the connected socket
+     * @param ec set if an option could not be applied
+     */
+    void apply(asio::ip::tcp::socket& sock, asio::error_code& ec) const;
+
+    /**
+     * applies the per-connection options that an accepted socket does not
+     * inherit from the listening socket (most are inherited on Linux)
+     *
+     * @param sock the accepted socket
+     * @param ec set if an option could not be applied
+     */
+    void apply_accepted(asio::ip::tcp::socket& sock, asio::error_code& ec) const;
+
+    /// returns the length of the queue of pending connections used by listen()
+    inline int get_backlog(void) const {
+        return m_backlog > 0 ? m_backlog : static_cast<int>(asio::socket_base::max_listen_connections);
+    }
+
+
+    /// length of the queue of pending connections (0 = SOMAXCONN)
+    int         m_backlog;
+
+    /// true to set SO_REUSEADDR on the listening socket (except on Windows)
+    bool        m_reuse_address;
+
+    /// true to disable Nagle's algorithm (TCP_NODELAY)
+    bool        m_no_delay;
+
+    /// size of the kernel's send buffer in bytes (SO_SNDBUF)
+    int         m_send_buffer_size;
+
+    /// size of the kernel's receive buffer in bytes (SO_RCVBUF)
+    int         m_receive_buffer_size;
+
+    /// true to send keep-alive probes on idle connections (SO_KEEPALIVE)
+    bool        m_keep_alive;
+
+    /// seconds that a connection is idle before the first keep-alive probe
+    int         m_keep_alive_idle;
+
+    /// seconds between keep-alive probes
+    int         m_keep_alive_interval;
+
+    /// number of unanswered keep-alive probes before a connection is dropped
+    int         m_keep_alive_count;
+
+    /// milliseconds that sent data may stay unacknowledged before a connection
+    /// is dropped (TCP_USER_TIMEOUT)
+    int         m_user_timeout;
+
+    /// seconds that an accepted connection may wait for data before the
+    /// listening socket wakes up for it (TCP_DEFER_ACCEPT; listening only)
+    int         m_defer_accept;
+
+    /// length of the queue of pending TCP Fast Open requests (listening only)
+    int         m_fast_open;
+
+    /// true to acknowledge received data immediately (TCP_QUICKACK)
+    bool        m_quick_ack;
+};
+
+
+}   // end namespace tcp
+}   // end namespace pion
+
+#endif
@@ -0,0 +1,285 @@
+// ---------------------------------------------------------------------
+// pion:  a Boost C++ framework for building lightweight HTTP interfaces
+// ---------------------------------------------------------------------
+// Copyright (C) 2021 Wang Qiang  (https://github.com/dnybz/pion)
+// Copyright (C) 2007-2014 Splunk Inc.  (https://github.com/splunk/pion)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+//
+
+#ifndef __PION_TCP_SSL_SESSION_CACHE_HEADER__
+#define __PION_TCP_SSL_SESSION_CACHE_HEADER__
+
+#include <pion/config.hpp>
+
+#ifdef PION_HAVE_SSL
+
+#include <array>
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <pion/noncopyable.hpp>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/ssl.h>
+
+
+namespace pion {    // begin namespace pion
+namespace tcp {     // begin namespace tcp
+
+
+///
+/// ssl_session_cache: server-side SSL session resumption.  Sessions are kept
+/// in a size-bounded cache that is split into partitions, each protected by
+/// its own mutex, and session tickets are encrypted with keys that are
+/// replaced periodically (tickets issued with the previous key are still
+/// accepted).  One cache is shared by all of the threads that handle a
+/// server's connections
+///
+class PION_API ssl_session_cache
+    : private pion::noncopyable
+{
+public:
+
+    /// default maximum number of cached sessions
+    static const std::size_t    DEFAULT_MAX_SESSIONS;
+
+    /// default number of seconds that a session may be resumed
+    static const uint32_t       DEFAULT_SESSION_TIMEOUT;
+
+    /// default number of seconds that a session ticket key is used to issue tickets
+    static const uint32_t       DEFAULT_TICKET_KEY_LIFETIME;
+
+
+    /// constructs an empty cache with the default settings
+    ssl_session_cache(void);
+
+    /**
+     * sets the maximum number of cached sessions; when it is reached, the
+     * least recently used sessions are dropped
+     *
+     * @param n maximum number of sessions (0 = no cache)
+     */
+    inline void set_max_sessions(std::size_t n) { m_max_sessions = n; }
+
+    /// returns the maximum number of cached sessions (0 = no cache)
+    inline std::size_t get_max_sessions(void) const { return m_max_sessions; }
+
+    /**
+     * sets the number of seconds that a session may be resumed (both from
+     * the cache and from a session ticket)
+     *
+     * @param seconds session lifetime
+     */
+    inline void set_session_timeout(uint32_t seconds) { m_session_timeout = seconds; }
+
+    /// returns the number of seconds that a session may be resumed
+    inline uint32_t get_session_timeout(void) const { return m_session_timeout; }
+
+    /**
+     * enables or disables session tickets, which let clients resume sessions
+     * without the server keeping any state
+     *
+     * @param b true to issue and accept session tickets
+     */
+    inline void set_tickets(bool b = true) { m_tickets = b; }
+
+    /// returns true if session tickets are issued and accepted
+    inline bool get_tickets(void) const { return m_tickets; }
+
+    /**
+     * sets the number of seconds that a session ticket key is used to issue
+     * tickets before it is replaced by a new one; tickets are accepted for
+     * twice as long
+     *
+     * @param seconds ticket key lifetime (0 = keys are never replaced)
+     */
+    inline void set_ticket_key_lifetime(uint32_t seconds) { m_ticket_key_lifetime = seconds; }
+
+    /// returns the number of seconds that a session ticket key is used to issue tickets
+    inline uint32_t get_ticket_key_lifetime(void) const { return m_ticket_key_lifetime; }
+
+    /**
+     * configures an SSL context to resume sessions using this cache (call
+     * again after changing the settings); the cache must outlive the context
+     *
+     * @param ctx the SSL context used to accept connections
+     */
+    void attach(SSL_CTX *ctx);
+
+    /// removes all cached sessions and ticket keys
+    void clear(void);
+
+    /// returns the number of cached sessions
+    std::size_t get_num_sessions(void) const;
+
+    /// returns the number of sessions that were resumed from the cache
+    inline uint64_t get_hits(void) const { return m_hits; }
+
+    /// returns the number of sessions that clients asked for but were not in the cache
+    inline uint64_t get_misses(void) const { return m_misses; }
+
+    /// returns the number of session tickets that were accepted
+    inline uint64_t get_ticket_hits(void) const { return m_ticket_hits; }
+
+    /// returns the number of session tickets that could not be used
+    inline uint64_t get_ticket_misses(void) const { return m_ticket_misses; }
+
+    /// returns the number of times that a new session ticket key was created
+    inline uint64_t get_ticket_key_rotations(void) const { return m_ticket_key_rotations; }
+
+
+private:
+
+    /// a cached session
+    struct session_entry {
+        /// the session in DER format (each resumption gets its own copy)
+        std::string                         m_data;
+        /// steady clock second after which the session is not resumed
+        uint64_t                            m_expires;
+        /// position in the partition's least recently used list
+        std::list<std::string>::iterator    m_lru_pos;
+    };
+
+    /// a partition of the cache that is protected by its own mutex
+    struct session_shard {
+        mutable std::mutex                                  m_mutex;
+        std::unordered_map<std::string, session_entry>      m_sessions;
+        /// session ids, most recently used first
+        std::list<std::string>                              m_lru;
+    };
+
+    /// a key used to encrypt and authenticate session tickets
+    struct ticket_key {
+        unsigned char   m_name[16];
+        unsigned char   m_aes_key[32];
+        unsigned char   m_hmac_key[32];
+        /// steady clock second at which the key was created
+        uint64_t        m_created;
+    };
+
+    /// number of partitions used for the cache (must be a power of 2)
+    enum { NUM_SESSION_SHARDS = 16 };
+
+
+    /// returns the partition that holds a session id
+    inline session_shard& get_shard(const std::string& id) {
+        return m_shards[std::hash<std::string>()(id) & (NUM_SESSION_SHARDS - 1)];
+    }
+
+    /**
+     * stores a new session
+     *
+     * @param session the session to store
+     */
+    void store(SSL_SESSION *session);
+
+    /**
+     * looks up a session that a client wants to resume
+     *
+     * @param id the session id
+     *
+     * @return SSL_SESSION* a new session object, or NULL if it is not cached
+     */
+    SSL_SESSION *find(const std::string& id);
+
+    /**
+     * removes a session that can no longer be resumed
+     *
+     * @param id the session id
+     */
+    void remove(const std::string& id);
+
+    /**
+     * returns a copy of the key used to issue a session ticket, creating a
+     * new one if the current one is too old
+     *
+     * @param key receives the key
+     *
+     * @return bool true if a key is available
+     */
+    bool get_encrypt_key(ticket_key& key);
+
+    /**
+     * returns a copy of the key that a session ticket was issued with
+     *
+     * @param name the name of the key
+     * @param key receives the key
+     * @param renew set to true if the client should get a ticket with the current key
+     *
+     * @return bool true if the key is still accepted
+     */
+    bool get_decrypt_key(const unsigned char *name, ticket_key& key, bool& renew);
+
+    /// returns the cache attached to the context of an SSL connection (or NULL)
+    static ssl_session_cache *get_cache(SSL *ssl);
+
+    /// OpenSSL callback: a new session has been established
+    static int new_session_callback(SSL *ssl, SSL_SESSION *session);
+
+    /// OpenSSL callback: a client wants to resume a session
+    static SSL_SESSION *get_session_callback(SSL *ssl, const unsigned char *id,
+                                             int id_length, int *copy);
+
+    /// OpenSSL callback: a session can no longer be resumed
+    static void remove_session_callback(SSL_CTX *ctx, SSL_SESSION *session);
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    /// OpenSSL callback: encrypts or decrypts a session ticket
+    static int ticket_key_callback(SSL *ssl, unsigned char *name, unsigned char *iv,
+                                   EVP_CIPHER_CTX *cipher_ctx, EVP_MAC_CTX *mac_ctx, int enc);
+#else
+    /// OpenSSL callback: encrypts or decrypts a session ticket
+    static int ticket_key_callback(SSL *ssl, unsigned char *name, unsigned char *iv,
+                                   EVP_CIPHER_CTX *cipher_ctx, HMAC_CTX *hmac_ctx, int enc);
+#endif
+
+
+    /// partitions of the cache
+    std::array<session_shard, NUM_SESSION_SHARDS>   m_shards;
+
+    /// session ticket keys, newest first
+    std::vector<ticket_key>         m_ticket_keys;
+
+    /// protects the session ticket keys
+    std::mutex                      m_ticket_mutex;
+
+    /// maximum number of cached sessions (0 = no cache)
+    std::size_t                     m_max_sessions;
+
+    /// number of seconds that a session may be resumed
+    uint32_t                        m_session_timeout;
+
+    /// true if session tickets are issued and accepted
+    bool                            m_tickets;
+
+    /// number of seconds that a session ticket key is used to issue tickets
+    uint32_t                        m_ticket_key_lifetime;
+
+    /// number of sessions that were resumed from the cache
+    std::atomic<uint64_t>           m_hits;
+
+    /// number of sessions that clients asked for but were not in the cache
+    std::atomic<uint64_t>           m_misses;
+
+    /// number of session tickets that were accepted
+    std::atomic<uint64_t>           m_ticket_hits;
+
+    /// number of session tickets that could not be used
+    std::atomic<uint64_t>           m_ticket_misses;
+
+    /// number of times that a new session ticket key was created
+    std::atomic<uint64_t>           m_ticket_key_rotations;
+};
+
+
+}   // end namespace tcp
+}   // end namespace pion
+
+#endif  // PION_HAVE_SSL
+
+#endif
@@ -0,0 +1,216 @@
+// ---------------------------------------------------------------------
+// pion:  a Boost C++ framework for building lightweight HTTP interfaces
+// ---------------------------------------------------------------------
+// Copyright (C) 2021 Wang Qiang  (https://github.com/dnybz/pion)
+// Copyright (C) 2007-2014 Splunk Inc.  (https://github.com/splunk/pion)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+//
+
+#ifndef __PION_TCP_TIMING_WHEEL_HEADER__
+#define __PION_TCP_TIMING_WHEEL_HEADER__
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <stdint.h>
+#include <pion/config.hpp>
+#include <pion/noncopyable.hpp>
+#include <asio.hpp>
+
+
+namespace pion {    // begin namespace pion
+namespace tcp {     // begin namespace tcp
+
+
+///
+/// timing_wheel: hierarchical timing wheel that manages connection deadlines
+/// for one I/O service (use asio::use_service<tcp::timing_wheel>() to get
+/// it).  Deadlines are intrusive entries, so arming and cancelling them takes
+/// constant time and never allocates memory.  The wheel only keeps a timer
+/// running while it has deadlines armed
+///
+class PION_API timing_wheel
+    : public asio::io_service::service
+{
+public:
+
+    ///
+    /// entry: a deadline that may be armed with a timing wheel
+    ///
+    class entry
+        : private pion::noncopyable
+    {
+    public:
+
+        /// constructs a deadline that is not armed
+        entry(void)
+            : m_wheel(NULL), m_slot(NULL), m_prev(NULL), m_next(NULL), m_expires(0)
+        {}
+
+        /// virtual destructor cancels the deadline if it is armed
+        virtual ~entry() { cancel(); }
+
+        /// cancels the deadline if it is armed, and waits for expired() to
+        /// return if the deadline is expiring on another thread (it is safe to
+        /// call this after the wheel's I/O service has been destroyed)
+        inline void cancel(void) {
+            timing_wheel *wheel = m_wheel.load(std::memory_order_acquire);
+            if (wheel)
+                wheel->cancel(*this);
+        }
+
+        /// returns true if the deadline is armed
+        inline bool is_armed(void) const {
+            return m_wheel.load(std::memory_order_acquire) != NULL;
+        }
+
+    protected:
+
+        /// called when the deadline expires; runs while the timing wheel is
+        /// locked, so it must not arm or cancel any deadlines
+        virtual void expired(void) = 0;
+
+    private:
+
+        friend class timing_wheel;
+
+        /// the wheel that the deadline is armed with (NULL if it is not armed,
+        /// has expired, or the wheel has shut down; an expiring deadline keeps
+        /// it until expired() has returned)
+        std::atomic<timing_wheel*>  m_wheel;
+
+        /// the wheel slot containing the deadline (NULL if not armed)
+        entry **                    m_slot;
+
+        /// previous deadline in the same slot
+        entry *                     m_prev;
+
+        /// next deadline in the same slot
+        entry *                     m_next;
+
+        /// tick at which the deadline expires
+        uint64_t                    m_expires;
+    };
+
+
+    /// identifies the service within an I/O service
+    static asio::io_service::id     id;
+
+    /// granularity of the wheel in milliseconds
+    static const uint32_t           TICK_MILLISECONDS;
+
+
+    /**
+     * creates a timing wheel for an I/O service
+     *
+     * @param io_service the I/O service that runs expired deadlines
+     */
+    explicit timing_wheel(asio::io_service& io_service);
+
+    /// virtual destructor
+    virtual ~timing_wheel() {}
+
+    /**
+     * arms a deadline, replacing the deadline's previous expiration time (and
+     * cancelling it first if it is armed with another wheel)
+     *
+     * @param e the deadline to arm
+     * @param milliseconds time until the deadline expires (rounded up to
+     *                     the next tick, so it never expires early)
+     */
+    void arm(entry& e, uint32_t milliseconds);
+
+    /**
+     * cancels a deadline if it is armed
+     *
+     * @param e the deadline to cancel
+     */
+    void cancel(entry& e);
+
+    /// returns the number of deadlines that are armed
+    std::size_t size(void) const;
+
+
+protected:
+
+    /// returns the number of ticks since the wheel was created
+    virtual uint64_t get_current_tick(void) const {
+        return static_cast<uint64_t>((std::chrono::steady_clock::now() - m_start)
+                                     / std::chrono::milliseconds(TICK_MILLISECONDS));
+    }
+
+    /**
+     * expires the deadlines of all ticks that have passed
+     *
+     * @param ec timer error status code
+     */
+    void handle_tick(const asio::error_code& ec);
+
+
+private:
+
+    /// destroys the wheel's state when the I/O service shuts down
+    virtual void shutdown(void);
+
+    /// adds an armed deadline to the slot for its expiration time
+    void add(entry& e);
+
+    /// removes a deadline from its slot
+    void remove(entry& e);
+
+    /**
+     * moves the deadlines from a higher level slot into lower levels
+     *
+     * @param level wheel level (0 for the first level above the ticks)
+     * @param index slot index within the level
+     *
+     * @return the slot index
+     */
+    std::size_t cascade(std::size_t level, std::size_t index);
+
+    /// schedules the timer for the next tick
+    void schedule_tick(void);
+
+
+    /// number of bits and slots in the first level of the wheel (one tick each)
+    enum { TICK_BITS = 8, TICK_SLOTS = 1 << TICK_BITS };
+
+    /// number of bits and slots in each of the higher levels of the wheel
+    enum { LEVEL_BITS = 6, LEVEL_SLOTS = 1 << LEVEL_BITS };
+
+    /// number of levels above the first one
+    enum { NUM_LEVELS = 3 };
+
+
+    /// time when the wheel was created (tick zero)
+    const std::chrono::steady_clock::time_point     m_start;
+
+    /// timer used to advance the wheel
+    asio::steady_timer                  m_timer;
+
+    /// true while the timer is scheduled
+    bool                                m_timer_running;
+
+    /// next tick that will be processed
+    uint64_t                            m_base;
+
+    /// number of deadlines that are armed
+    std::size_t                         m_num_entries;
+
+    /// slots of deadlines that expire within TICK_SLOTS ticks
+    entry *                             m_ticks[TICK_SLOTS];
+
+    /// slots of deadlines that expire further in the future
+    entry *                             m_levels[NUM_LEVELS][LEVEL_SLOTS];
+
+    /// mutex used to protect the wheel
+    mutable std::mutex                  m_mutex;
+};
+
+
+}   // end namespace tcp
+}   // end namespace pion
+
+#endif
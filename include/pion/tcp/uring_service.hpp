@@ -0,0 +1,595 @@
+// ---------------------------------------------------------------------
+// pion:  a Boost C++ framework for building lightweight HTTP interfaces
+// ---------------------------------------------------------------------
+// Copyright (C) 2021 Wang Qiang  (https://github.com/dnybz/pion)
+// Copyright (C) 2007-2014 Splunk Inc.  (https://github.com/splunk/pion)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+//
+
+#ifndef __PION_TCP_URING_SERVICE_HEADER__
+#define __PION_TCP_URING_SERVICE_HEADER__
+
+#include <pion/config.hpp>
+
+#ifdef PION_HAVE_IO_URING
+
+#include <mutex>
+#include <vector>
+#include <stdint.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <pion/noncopyable.hpp>
+#include <asio.hpp>
+
+
+// io_uring structures are only used by the implementation
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+
+namespace pion {    // begin namespace pion
+namespace tcp {     // begin namespace tcp
+
+
+///
+/// uring_service: an I/O engine that uses Linux io_uring (through raw system
+/// calls) for socket accepts, receives and sends, and for file reads.  There
+/// is one ring for each I/O service (use asio::use_service<tcp::uring_service>()
+/// to get it).  Completions are reaped by the I/O service's own threads, which
+/// are woken through an eventfd, and handlers run on the I/O service just like
+/// asio's.  If the kernel does not support the required operations (Linux
+/// 5.19 or later), is_available() returns false and the reactor should be used
+///
+class PION_API uring_service
+    : public asio::io_service::service
+{
+public:
+
+    ///
+    /// operation: an operation submitted to the ring
+    ///
+    class operation
+        : private pion::noncopyable
+    {
+    public:
+
+        /// constructs an operation that has not been submitted
+        operation(void) : m_prev(NULL), m_next(NULL) {}
+
+    protected:
+
+        /// virtual destructor (operations are released by complete() or destroy())
+        virtual ~operation() {}
+
+        /**
+         * called for each completion of the operation
+         *
+         * @param service the service that submitted the operation
+         * @param res result of the operation (a negative errno if it failed)
+         * @param more true if the operation will complete again (multishot)
+         */
+        virtual void complete(uring_service& service, int32_t res, bool more) = 0;
+
+        /// releases an operation that will never complete (the I/O service
+        /// is shutting down)
+        virtual void destroy(void) = 0;
+
+        /**
+         * returns an error code for the result of an operation
+         *
+         * @param res result of the operation (a negative errno if it failed)
+         * @param eof_on_zero if true then a zero result means end of file
+         */
+        static inline asio::error_code make_error(int32_t res, bool eof_on_zero) {
+            if (res == -ECANCELED)
+                return asio::error::operation_aborted;
+            if (res < 0)
+                return asio::error_code(-res, asio::error::get_system_category());
+            if (res == 0 && eof_on_zero)
+                return asio::error::eof;
+            return asio::error_code();
+        }
+
+    private:
+
+        friend class uring_service;
+
+        /// previous operation in the list of submitted operations
+        operation *     m_prev;
+
+        /// next operation in the list of submitted operations
+        operation *     m_next;
+    };
+
+
+    /// identifies the service within an I/O service
+    static asio::io_service::id     id;
+
+    /// number of submission queue entries in each ring
+    static const uint32_t           SUBMIT_QUEUE_SIZE;
+
+    /// number of completion queue entries in each ring
+    static const uint32_t           COMPLETION_QUEUE_SIZE;
+
+    /// number of slots in each ring's table of registered buffers
+    static const uint32_t           MAX_REGISTERED_BUFFERS;
+
+
+    /**
+     * creates a ring for an I/O service
+     *
+     * @param io_service the I/O service that runs completion handlers
+     */
+    explicit uring_service(asio::io_service& io_service);
+
+    /// virtual destructor
+    virtual ~uring_service() {}
+
+    /// returns true if io_uring can be used
+    inline bool is_available(void) const { return m_ring_fd >= 0; }
+
+    /// returns true if the kernel supports the io_uring operations that are
+    /// used (the kernel is only probed the first time)
+    static bool is_supported(void);
+
+    /**
+     * registers a buffer with the ring, so that reads into it do not need to
+     * map its pages for every operation (e.g. a connection's read buffer)
+     *
+     * @param data start of the buffer (must stay valid until unregistered)
+     * @param size size of the buffer in bytes
+     *
+     * @return index of the registered buffer, or -1 if it could not be registered
+     */
+    int register_buffer(void *data, std::size_t size);
+
+    /**
+     * unregisters a buffer
+     *
+     * @param index index returned by register_buffer()
+     */
+    void unregister_buffer(int index);
+
+    /**
+     * cancels all operations pending on a file descriptor; their handlers
+     * are called with asio::error::operation_aborted
+     *
+     * @param fd the file descriptor
+     */
+    void cancel(int fd);
+
+    /**
+     * asynchronously receives some data from a socket
+     *
+     * @param fd the socket
+     * @param buffer the buffer to read data into
+     * @param buffer_index index of the registered buffer that contains
+     *                     buffer, or -1 if it is not registered
+     * @param handler called after the operation with (error_code, bytes)
+     */
+    template <typename ReadHandler>
+    inline void async_receive(int fd, const asio::mutable_buffer& buffer, int buffer_index,
+                              ReadHandler handler)
+    {
+        typedef receive_op<ReadHandler> op_type;
+        void *memory = asio_handler_alloc_helpers::allocate(sizeof(op_type), handler);
+        start_receive(*new (memory) op_type(handler, fd, buffer, buffer_index));
+    }
+
+    /**
+     * asynchronously waits until a socket is readable, without reading
+     *
+     * @param fd the socket
+     * @param handler called after the operation with (error_code)
+     */
+    template <typename WaitHandler>
+    inline void async_wait_readable(int fd, WaitHandler handler) {
+        typedef wait_op<WaitHandler> op_type;
+        void *memory = asio_handler_alloc_helpers::allocate(sizeof(op_type), handler);
+        start_wait_readable(*new (memory) op_type(handler), fd);
+    }
+
+    /**
+     * asynchronously sends all of the data in buffers to a socket
+     *
+     * @param fd the socket
+     * @param buffers one or more buffers containing the data to be sent
+     * @param handler called after the operation with (error_code, bytes)
+     */
+    template <typename ConstBufferSequence, typename WriteHandler>
+    inline void async_send(int fd, const ConstBufferSequence& buffers, WriteHandler handler) {
+        typedef send_op<ConstBufferSequence, WriteHandler> op_type;
+        void *memory = asio_handler_alloc_helpers::allocate(sizeof(op_type), handler);
+        op_type *op = new (memory) op_type(handler, fd, buffers);
+        op->start(*this);
+    }
+
+    /**
+     * asynchronously accepts connections on a listening socket, until the
+     * operation fails or is cancelled.  The handler is called with
+     * (error_code, fd, more) for each new connection, where more is false for
+     * the last call (the ring stops accepting, e.g. if the kernel does not
+     * support multishot accept, and the operation must be started again)
+     *
+     * @param fd the listening socket
+     * @param handler called for each accepted connection
+     */
+    template <typename AcceptHandler>
+    inline void async_accept(int fd, AcceptHandler handler) {
+        typedef accept_op<AcceptHandler> op_type;
+        void *memory = asio_handler_alloc_helpers::allocate(sizeof(op_type), handler);
+        start_accept(*new (memory) op_type(handler), fd);
+    }
+
+    /**
+     * asynchronously reads data from a file
+     *
+     * @param fd the file
+     * @param buffer the buffer to read data into
+     * @param offset position in the file to read from
+     * @param handler called after the operation with (error_code, bytes)
+     */
+    template <typename ReadHandler>
+    inline void async_read_file(int fd, const asio::mutable_buffer& buffer, uint64_t offset,
+                                ReadHandler handler)
+    {
+        typedef read_file_op<ReadHandler> op_type;
+        void *memory = asio_handler_alloc_helpers::allocate(sizeof(op_type), handler);
+        start_read_file(*new (memory) op_type(handler), fd, buffer, offset);
+    }
+
+    /// returns the number of operations that have been submitted and have not
+    /// completed yet
+    std::size_t size(void) const;
+
+
+private:
+
+    ///
+    /// handler_op: operation that calls a completion handler
+    ///
+    template <typename Handler>
+    class handler_op : public operation {
+    public:
+        explicit handler_op(Handler& handler) : m_handler(std::move(handler)) {}
+    protected:
+        /// releases the operation and posts its handler with the given arguments
+        template <typename Op, typename... Args>
+        static inline void finish(Op *op, uring_service& service, Args... args) {
+            Handler handler(std::move(op->m_handler));
+            op->~Op();
+            asio_handler_alloc_helpers::deallocate(op, sizeof(Op), handler);
+            service.m_io_service.post(asio::detail::bind_handler(handler, args...));
+        }
+        /// releases the operation without calling its handler
+        template <typename Op>
+        static inline void release(Op *op) {
+            Handler handler(std::move(op->m_handler));
+            op->~Op();
+            asio_handler_alloc_helpers::deallocate(op, sizeof(Op), handler);
+        }
+        /// the completion handler
+        Handler     m_handler;
+    };
+
+    ///
+    /// receive_op: receives some data from a socket
+    ///
+    template <typename Handler>
+    class receive_op : public handler_op<Handler> {
+    public:
+        receive_op(Handler& handler, int fd, const asio::mutable_buffer& buffer, int buffer_index)
+            : handler_op<Handler>(handler), m_fd(fd), m_buffer(buffer), m_buffer_index(buffer_index)
+        {}
+        virtual void complete(uring_service& service, int32_t res, bool /* more */) {
+            if (res == -EAGAIN) {
+                // non-blocking sockets make fixed buffer reads fail instead
+                // of waiting; receives wait for the socket to be readable
+                m_buffer_index = -1;
+                service.start_receive(*this);
+                return;
+            }
+            this->finish(this, service, operation::make_error(res, m_buffer.size() > 0),
+                         static_cast<std::size_t>(res > 0 ? res : 0));
+        }
+        virtual void destroy(void) { this->release(this); }
+    private:
+        friend class uring_service;
+        /// the socket
+        int                     m_fd;
+        /// the buffer to read data into
+        asio::mutable_buffer    m_buffer;
+        /// index of the registered buffer, or -1 if it is not registered
+        int                     m_buffer_index;
+    };
+
+    ///
+    /// send_op: sends all of the data in a buffer sequence to a socket, using
+    /// as few system calls as possible
+    ///
+    template <typename ConstBufferSequence, typename Handler>
+    class send_op : public handler_op<Handler> {
+    public:
+        send_op(Handler& handler, int fd, const ConstBufferSequence& buffers)
+            : handler_op<Handler>(handler), m_fd(fd), m_buffers(buffers),
+            m_next(asio::buffer_sequence_begin(m_buffers)), m_offset(0), m_bytes_sent(0)
+        {}
+        /// sends as much of the remaining data as fits in the I/O vector
+        void start(uring_service& service) {
+            const typename buffer_sequence_iterator::type end = asio::buffer_sequence_end(m_buffers);
+            std::size_t num_vectors = 0;
+            std::size_t offset = m_offset;
+            for (typename buffer_sequence_iterator::type i = m_next;
+                 i != end && num_vectors < MAX_VECTORS; ++i)
+            {
+                const asio::const_buffer buffer(*i);
+                if (buffer.size() <= offset) {
+                    offset -= buffer.size();
+                    continue;
+                }
+                m_vectors[num_vectors].iov_base = const_cast<char*>(static_cast<const char*>(buffer.data()) + offset);
+                m_vectors[num_vectors].iov_len = buffer.size() - offset;
+                ++num_vectors;
+                offset = 0;
+            }
+            if (num_vectors == 0) {
+                // nothing (left) to send
+                this->finish(this, service, asio::error_code(), m_bytes_sent);
+                return;
+            }
+            m_message = msghdr();
+            m_message.msg_iov = m_vectors;
+            m_message.msg_iovlen = num_vectors;
+            service.start_send(*this, m_fd, m_message);
+        }
+        virtual void complete(uring_service& service, int32_t res, bool /* more */) {
+            if (res == -EAGAIN) {
+                start(service);
+                return;
+            }
+            if (res <= 0) {
+                this->finish(this, service, (res == 0 ? asio::error_code(asio::error::broken_pipe)
+                                             : operation::make_error(res, false)), m_bytes_sent);
+                return;
+            }
+            // skip the data that was sent, then send the rest
+            m_bytes_sent += res;
+            std::size_t consumed = m_offset + static_cast<std::size_t>(res);
+            const typename buffer_sequence_iterator::type end = asio::buffer_sequence_end(m_buffers);
+            while (m_next != end && asio::const_buffer(*m_next).size() <= consumed) {
+                consumed -= asio::const_buffer(*m_next).size();
+                ++m_next;
+            }
+            m_offset = consumed;
+            start(service);
+        }
+        virtual void destroy(void) { this->release(this); }
+    private:
+        /// data type for an iterator over the buffer sequence
+        struct buffer_sequence_iterator {
+            typedef decltype(asio::buffer_sequence_begin(std::declval<const ConstBufferSequence&>())) type;
+        };
+        /// maximum number of buffers sent by each system call
+        enum { MAX_VECTORS = 32 };
+        /// the socket
+        int                                         m_fd;
+        /// the data to send
+        const ConstBufferSequence                   m_buffers;
+        /// first buffer that has not been sent completely
+        typename buffer_sequence_iterator::type     m_next;
+        /// number of bytes of *m_next that have been sent
+        std::size_t                                 m_offset;
+        /// total number of bytes sent
+        std::size_t                                 m_bytes_sent;
+        /// message header passed to sendmsg
+        msghdr                                      m_message;
+        /// I/O vector passed to sendmsg
+        iovec                                       m_vectors[MAX_VECTORS];
+    };
+
+    ///
+    /// accept_op: accepts connections on a listening socket (multishot)
+    ///
+    template <typename Handler>
+    class accept_op : public handler_op<Handler> {
+    public:
+        explicit accept_op(Handler& handler) : handler_op<Handler>(handler) {}
+        virtual void complete(uring_service& service, int32_t res, bool more) {
+            const asio::error_code ec(operation::make_error(res, false));
+            const int fd = (res >= 0 ? res : -1);
+            if (more)
+                service.m_io_service.post(asio::detail::bind_handler(this->m_handler, ec, fd, true));
+            else
+                this->finish(this, service, ec, fd, false);
+        }
+        virtual void destroy(void) { this->release(this); }
+    };
+
+    ///
+    /// wait_op: waits until a socket is readable
+    ///
+    template <typename Handler>
+    class wait_op : public handler_op<Handler> {
+    public:
+        explicit wait_op(Handler& handler) : handler_op<Handler>(handler) {}
+        virtual void complete(uring_service& service, int32_t res, bool /* more */) {
+            this->finish(this, service, operation::make_error(res, false));
+        }
+        virtual void destroy(void) { this->release(this); }
+    };
+
+    ///
+    /// read_file_op: reads data from a file
+    ///
+    template <typename Handler>
+    class read_file_op : public handler_op<Handler> {
+    public:
+        explicit read_file_op(Handler& handler) : handler_op<Handler>(handler) {}
+        virtual void complete(uring_service& service, int32_t res, bool /* more */) {
+            this->finish(this, service, operation::make_error(res, true),
+                         static_cast<std::size_t>(res > 0 ? res : 0));
+        }
+        virtual void destroy(void) { this->release(this); }
+    };
+
+
+    /// closes the ring and releases all pending operations when the I/O
+    /// service shuts down
+    virtual void shutdown(void);
+
+    /// sets up the ring (leaves m_ring_fd at -1 if io_uring is unavailable)
+    void open_ring(void);
+
+    /// unmaps and closes the ring (assumes the service lock is held)
+    void close_ring(void);
+
+    /**
+     * returns a cleared submission queue entry, or NULL if the ring is
+     * unavailable (assumes the service lock is held)
+     *
+     * @param op operation that the entry submits (NULL for internal entries)
+     */
+    io_uring_sqe *get_sqe(operation *op);
+
+    /// submits the entries in the submission queue (assumes the service lock is held)
+    void submit(void);
+
+    /**
+     * adds an entry that cancels operations (assumes the service lock is held)
+     *
+     * @param fd file descriptor whose operations are cancelled (if flags
+     *           include IORING_ASYNC_CANCEL_FD)
+     * @param flags IORING_ASYNC_CANCEL_* flags
+     */
+    void prepare_cancel(int fd, uint32_t flags);
+
+    /**
+     * completes an operation with an error when it could not be submitted
+     * (assumes the service lock is held, and releases it)
+     *
+     * @param op the operation
+     * @param service_lock the service lock
+     */
+    void fail(operation& op, std::unique_lock<std::mutex>& service_lock);
+
+    /// submits a receive_op (as a fixed buffer read if its buffer is registered)
+    template <typename Handler>
+    inline void start_receive(receive_op<Handler>& op) {
+        start_receive(op, op.m_fd, op.m_buffer, op.m_buffer_index);
+    }
+
+    /// submits a receive operation
+    void start_receive(operation& op, int fd, const asio::mutable_buffer& buffer, int buffer_index);
+
+    /// submits a sendmsg operation
+    void start_send(operation& op, int fd, const msghdr& message);
+
+    /// submits a multishot accept operation
+    void start_accept(operation& op, int fd);
+
+    /// submits a poll operation that waits for a socket to be readable
+    void start_wait_readable(operation& op, int fd);
+
+    /// submits a file read operation
+    void start_read_file(operation& op, int fd, const asio::mutable_buffer& buffer, uint64_t offset);
+
+    /// waits for the ring's eventfd, if not already waiting (assumes the service lock is held)
+    void wait_for_completions(void);
+
+    /**
+     * reaps completions and runs their operations
+     *
+     * @param ec eventfd wait error status code
+     */
+    void handle_completions(const asio::error_code& ec);
+
+    /**
+     * removes an operation from the list of submitted operations, unless
+     * it will complete again (assumes the service lock is held)
+     *
+     * @param op the operation
+     * @param more true if the operation will complete again (multishot)
+     */
+    void remove(operation& op, bool more);
+
+
+    /// the I/O service that runs completion handlers
+    asio::io_service &                  m_io_service;
+
+    /// file descriptor of the ring (-1 if io_uring is unavailable)
+    int                                 m_ring_fd;
+
+    /// memory mapped submission queue ring
+    void *                              m_sq_ring;
+
+    /// size of the memory mapped submission queue ring
+    std::size_t                         m_sq_ring_size;
+
+    /// memory mapped completion queue ring (may be the same as m_sq_ring)
+    void *                              m_cq_ring;
+
+    /// size of the memory mapped completion queue ring
+    std::size_t                         m_cq_ring_size;
+
+    /// memory mapped submission queue entries
+    io_uring_sqe *                      m_sqes;
+
+    /// size of the memory mapped submission queue entries
+    std::size_t                         m_sqes_size;
+
+    /// pointers into the submission queue ring
+    uint32_t *                          m_sq_head;
+    uint32_t *                          m_sq_tail;
+    uint32_t *                          m_sq_mask;
+    uint32_t *                          m_sq_flags;
+    uint32_t *                          m_sq_array;
+
+    /// pointers into the completion queue ring
+    uint32_t *                          m_cq_head;
+    uint32_t *                          m_cq_tail;
+    uint32_t *                          m_cq_mask;
+    io_uring_cqe *                      m_cqes;
+
+    /// number of entries in the submission queue
+    uint32_t                            m_sq_entries;
+
+    /// tail of the submission queue, including entries not yet passed to the kernel
+    uint32_t                            m_sq_local_tail;
+
+    /// entries added to the submission queue that have not been submitted
+    uint32_t                            m_num_unsubmitted;
+
+    /// eventfd signalled by the kernel when completions are posted
+    asio::posix::stream_descriptor      m_eventfd;
+
+    /// true while waiting for the eventfd
+    bool                                m_is_waiting;
+
+    /// operations that have been submitted and have not completed yet
+    operation *                         m_operations;
+
+    /// number of operations that have been submitted and have not completed yet
+    std::size_t                         m_num_operations;
+
+    /// number of cancellations whose completions have not been reaped yet
+    std::size_t                         m_num_cancels;
+
+    /// true if buffers can be registered with the ring
+    bool                                m_has_buffer_table;
+
+    /// indexes of the registered buffer slots that are free
+    std::vector<int>                    m_free_buffers;
+
+    /// mutex used to protect the submission queue and the lists
+    mutable std::mutex                  m_mutex;
+};
+
+
+}   // end namespace tcp
+}   // end namespace pion
+
+#endif  // PION_HAVE_IO_URING
+
+#endif
@@ -99,7 +99,8 @@ void plugin_server::load_service_config(const std::string& config_name)
             // parsing command portion (or beginning of line)
             if (c == ' ' || c == '\t') {
                 // command finished -> check if valid
-                if (command_string=="path" || command_string=="auth" || command_string=="restrict") {
+                if (command_string=="path" || command_string=="auth" || command_string=="restrict"
+                    || command_string=="socket") {
                     value_string.clear();
                     parse_state = PARSE_VALUE;
                 } else if (command_string=="service" || command_string=="option") {
@@ -215,6 +216,17 @@ void plugin_server::load_service_config(const std::string& config_name)
                     option_value_string = value_string.substr(pos + 1);
                     set_service_option(resource_string, option_name_string,
                                      option_value_string);
+                } else if (command_string == "socket") {
+                    // finished socket command
+                    std::string::size_type pos = value_string.find('=');
+                    tcp::socket_options opts(get_socket_options());
+                    if (pos == std::string::npos
+                        || ! opts.set(value_string.substr(0, pos), value_string.substr(pos + 1)))
+                    {
+                        std::cout << "bad config: " << config_name << " socket " << value_string << std::endl;
+                    } else {
+                        set_socket_options(opts);
+                    }
                 }
                 command_string.clear();
                 parse_state = PARSE_NEWLINE;
@@ -8,9 +8,23 @@
 // See http://www.boost.org/LICENSE_1_0.txt
 //
 
+#include <chrono>
 #include <pion/http/reader.hpp>
 #include <pion/http/request.hpp>
 
+
+namespace {
+
+/// returns the number of milliseconds on the steady clock
+inline uint64_t get_steady_milliseconds(void)
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}
+
+
 namespace pion {    // begin namespace pion
 namespace http {    // begin namespace http
 
@@ -24,6 +38,9 @@ const uint32_t       reader::DEFAULT_READ_TIMEOUT = 10;
 
 void reader::receive(void)
 {
+    m_header_deadline = (m_header_timeout > 0 ? get_steady_milliseconds() + m_header_timeout * 1000ULL : 0);
+    m_body_start = 0;
+
     if (m_tcp_conn->get_pipelined()) {
         // there are pipelined messages available in the connection's read buffer
         m_tcp_conn->set_lifecycle(tcp::connection::LIFECYCLE_CLOSE);   // default to close the connection
@@ -39,13 +56,18 @@ void reader::receive(void)
 void reader::consume_bytes(const asio::error_code& read_error,
                               std::size_t bytes_read)
 {
-    // cancel read timer if operation didn't time-out
-    if (m_timer_ptr) {
-        m_timer_ptr->cancel();
-        m_timer_ptr.reset();
-    }
+    // disarm the read deadline if operation didn't time-out
+    m_tcp_conn->disarm_deadline();
 
     if (read_error) {
+        if (read_error == asio::error::operation_aborted && m_limit != tcp::connection::TIMEOUT_NONE
+            && get_steady_milliseconds() >= m_limit_deadline)
+        {
+            // the deadline of the header timeout or minimum body rate expired
+            m_tcp_conn->set_timeout_reason(m_limit);
+            handle_read_error(asio::error::timed_out);
+            return;
+        }
         // a read error occured
         handle_read_error(read_error);
         return;
@@ -124,12 +146,42 @@ void reader::consume_bytes(void)
 
 void reader::read_bytes_with_timeout(void)
 {
-    if (m_read_timeout > 0) {
-        m_timer_ptr.reset(new tcp::timer(m_tcp_conn));
-        m_timer_ptr->start(m_read_timeout);
-    } else if (m_timer_ptr) {
-        m_timer_ptr.reset();
+    // the read timeout restarts for each read, while the header timeout and
+    // the minimum body rate limit the time taken by the whole message
+    uint64_t timeout = m_read_timeout * 1000ULL;
+    m_limit = tcp::connection::TIMEOUT_NONE;
+    if (m_header_deadline > 0 || m_min_body_rate > 0) {
+        tcp::connection::timeout_type limit = tcp::connection::TIMEOUT_NONE;
+        uint64_t limit_deadline = 0;
+        const uint64_t now = get_steady_milliseconds();
+        if (is_parsing_headers()) {
+            if (m_header_deadline > 0) {
+                limit = tcp::connection::TIMEOUT_HEADER;
+                limit_deadline = m_header_deadline;
+            }
+        } else if (m_min_body_rate > 0) {
+            if (m_body_start == 0)
+                m_body_start = now;
+            limit = tcp::connection::TIMEOUT_BODY_RATE;
+            limit_deadline = m_body_start + m_read_timeout * 1000ULL
+                + get_content_bytes_read() * 1000ULL / m_min_body_rate;
+        }
+        if (limit != tcp::connection::TIMEOUT_NONE) {
+            if (limit_deadline <= now) {
+                m_tcp_conn->set_timeout_reason(limit);
+                handle_read_error(asio::error::timed_out);
+                return;
+            }
+            if (timeout == 0 || limit_deadline - now < timeout) {
+                timeout = limit_deadline - now;
+                m_limit = limit;
+                m_limit_deadline = limit_deadline;
+            }
+        }
     }
+
+    if (timeout > 0)
+        m_tcp_conn->arm_deadline(static_cast<uint32_t>(timeout));
     read_bytes();
 }
 
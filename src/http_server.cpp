@@ -22,16 +22,55 @@ namespace http {    // begin namespace http
 // static members of server
 
 const unsigned int          server::MAX_REDIRECTS = 10;
+const uint32_t              server::DEFAULT_KEEP_ALIVE_TIMEOUT = 10;
+const uint32_t              server::DEFAULT_HEADER_TIMEOUT = 20;
+const uint32_t              server::DEFAULT_MIN_BODY_RATE = 500;
 
 
 // server member functions
 
 void server::handle_connection(const tcp::connection_ptr& tcp_conn)
+{
+    if (tcp_conn->get_num_requests() > 0 && ! tcp_conn->get_pipelined() && ! tcp_conn->get_ssl_flag()) {
+        // the connection is kept alive between requests: give its read buffer
+        // back while it is idle and wait for the next request without one.
+        // SSL connections keep reading, since the SSL stream may already hold
+        // the next request's data
+        tcp_conn->release_read_buffer();
+        if (m_keep_alive_timeout > 0)
+            tcp_conn->arm_deadline(m_keep_alive_timeout * 1000);
+        tcp_conn->async_wait_readable(std::bind(&server::handle_keep_alive_wait,
+                                                this, tcp_conn, std::placeholders::_1));
+        return;
+    }
+
+    read_request(tcp_conn);
+}
+
+void server::handle_keep_alive_wait(const tcp::connection_ptr& tcp_conn,
+                                    const asio::error_code& ec)
+{
+    tcp_conn->disarm_deadline();
+    if (ec) {
+        // the idle timeout cancels the wait
+        PION_LOG_DEBUG(m_logger, "Closing idle connection on " << get_listen_name() << " (" << ec.message() << ")");
+        tcp_conn->set_lifecycle(tcp::connection::LIFECYCLE_CLOSE);
+        tcp_conn->finish();
+        return;
+    }
+
+    read_request(tcp_conn);
+}
+
+void server::read_request(const tcp::connection_ptr& tcp_conn)
 {
     request_reader_ptr my_reader_ptr;
     my_reader_ptr = request_reader::create(tcp_conn, std::bind(&server::handle_request,
                                            this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
     my_reader_ptr->set_max_content_length(m_max_content_length);
+    my_reader_ptr->set_timeout(m_read_timeout);
+    my_reader_ptr->set_header_timeout(m_header_timeout);
+    my_reader_ptr->set_min_body_rate(m_min_body_rate);
     my_reader_ptr->receive();
 }
 
@@ -51,9 +90,9 @@ void server::handle_request(const http::request_ptr& http_request_ptr,
 
             if (ec == ERRCOND_CANCELED || ec == ERRCOND_EOF) {
                 // don't spam the log with common (non-)errors that happen during normal operation
-                PION_LOG_DEBUG(m_logger, "Lost connection on port " << get_port() << " (" << ec.message() << ")");
+                PION_LOG_DEBUG(m_logger, "Lost connection on " << get_listen_name() << " (" << ec.message() << ")");
             } else {
-                PION_LOG_INFO(m_logger, "Lost connection on port " << get_port() << " (" << ec.message() << ")");
+                PION_LOG_INFO(m_logger, "Lost connection on " << get_listen_name() << " (" << ec.message() << ")");
             }
 
             tcp_conn->finish();
@@ -63,6 +102,17 @@ void server::handle_request(const http::request_ptr& http_request_ptr,
         
     PION_LOG_DEBUG(m_logger, "Received a valid HTTP request");
 
+    // shed load if too many requests are in flight
+    if (! begin_request(tcp_conn)) {
+        PION_LOG_DEBUG(m_logger, "Too many requests in flight; refusing request on " << get_listen_name());
+        handle_overload(tcp_conn);
+        return;
+    }
+
+    // close the connection after its last allowed request
+    if (m_max_keep_alive_requests > 0 && tcp_conn->get_num_requests() >= m_max_keep_alive_requests)
+        tcp_conn->set_lifecycle(tcp::connection::LIFECYCLE_CLOSE);
+
     // strip off trailing slash if the request has one
     std::string resource_requested(strip_trailing_slash(http_request_ptr->get_resource()));
 
@@ -127,6 +177,20 @@ void server::handle_request(const http::request_ptr& http_request_ptr,
     }
 }
     
+void server::handle_overload(const tcp::connection_ptr& tcp_conn)
+{
+    // serialized in advance since the server is already busy when it is sent
+    static const std::string SERVICE_UNAVAILABLE_RESPONSE =
+        "HTTP/1.1 503 Service Unavailable\r\n"
+        "Content-Length: 0\r\n"
+        "Retry-After: 1\r\n"
+        "Connection: close\r\n"
+        "\r\n";
+    tcp_conn->set_lifecycle(tcp::connection::LIFECYCLE_CLOSE); // make sure it will get closed
+    tcp_conn->async_write(asio::buffer(SERVICE_UNAVAILABLE_RESPONSE),
+                          std::bind(&tcp::connection::finish, tcp_conn));
+}
+
 bool server::find_request_handler(const std::string& resource,
                                     request_handler_t& request_handler) const
 {
@@ -15,6 +15,11 @@ namespace pion {    // begin namespace pion
 namespace http {    // begin namespace http
 
 
+// writer static members
+
+const uint32_t      writer::DEFAULT_SEND_TIMEOUT = 60;
+
+
 // writer member functions
 
 void writer::prepare_write_buffers(http::message::write_buffers_t& write_buffers,
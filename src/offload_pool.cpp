@@ -0,0 +1,153 @@
+// ---------------------------------------------------------------------
+// pion:  a Boost C++ framework for building lightweight HTTP interfaces
+// ---------------------------------------------------------------------
+// Copyright (C) 2021 Wang Qiang  (https://github.com/dnybz/pion)
+// Copyright (C) 2007-2014 Splunk Inc.  (https://github.com/splunk/pion)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include <pion/offload_pool.hpp>
+#include <pion/scheduler.hpp>
+
+namespace pion {    // begin namespace pion
+
+
+namespace {
+
+/// runs the completion of offloaded work on its I/O service
+class completion_handler {
+public:
+    completion_handler(offload_pool::completion_handler_t&& completion, const asio::error_code& ec)
+        : m_completion(std::move(completion)), m_ec(ec) {}
+    void operator()(void) {
+        handler_stats::handler_started();
+        m_completion(m_ec);
+    }
+private:
+    offload_pool::completion_handler_t  m_completion;
+    asio::error_code                    m_ec;
+};
+
+}
+
+
+// static members of offload_pool
+
+const uint32_t  offload_pool::DEFAULT_NUM_THREADS = 4;
+const uint32_t  offload_pool::DEFAULT_MAX_QUEUE_SIZE = 1024;
+
+
+// offload_pool member functions
+
+offload_pool::offload_pool(void)
+    : m_logger(PION_GET_LOGGER("pion.offload_pool")),
+    m_num_threads(DEFAULT_NUM_THREADS), m_max_queue_size(DEFAULT_MAX_QUEUE_SIZE),
+    m_is_running(false), m_queue_depth(0), m_num_active(0),
+    m_num_completed(0), m_num_rejected(0)
+{}
+
+bool offload_pool::offload(asio::io_service& service, task work, completion_handler_t completion)
+{
+    std::unique_lock<std::mutex> pool_lock(m_mutex);
+    if (m_jobs.size() >= m_max_queue_size) {
+        ++m_num_rejected;
+        PION_LOG_DEBUG(m_logger, "Rejected blocking work (" << m_jobs.size() << " tasks queued)");
+        return false;
+    }
+    if (! m_is_running)
+        start();
+
+    job_type job;
+    job.m_work = std::move(work);
+    job.m_completion = std::move(completion);
+    job.m_service = &service;
+    m_jobs.push_back(std::move(job));
+    ++m_queue_depth;
+    pool_lock.unlock();
+
+    m_job_queued.notify_one();
+    return true;
+}
+
+void offload_pool::stop(void)
+{
+    std::vector<std::shared_ptr<std::thread> > threads;
+    std::deque<job_type> discarded;
+    {
+        std::unique_lock<std::mutex> pool_lock(m_mutex);
+        if (! m_is_running)
+            return;
+        PION_LOG_DEBUG(m_logger, "Stopping the offload pool");
+        m_is_running = false;
+        threads.swap(m_threads);
+        discarded.swap(m_jobs);
+        m_queue_depth = 0;
+    }
+    m_job_queued.notify_all();
+
+    // make sure we do not join the current thread
+    for (std::vector<std::shared_ptr<std::thread> >::iterator i = threads.begin(); i != threads.end(); ++i) {
+        if ((*i)->get_id() != std::this_thread::get_id())
+            (*i)->join();
+        else
+            (*i)->detach();
+    }
+
+    // the work will never run, but its completion still has to, so that
+    // whatever waits for it can clean up
+    const asio::error_code aborted(make_error_code(asio::error::operation_aborted));
+    for (std::deque<job_type>::iterator i = discarded.begin(); i != discarded.end(); ++i) {
+        if (i->m_completion)
+            i->m_service->post(completion_handler(std::move(i->m_completion), aborted));
+    }
+    if (! discarded.empty())
+        PION_LOG_DEBUG(m_logger, "Cancelled " << discarded.size() << " queued tasks");
+}
+
+void offload_pool::start(void)
+{
+    // assumes that the pool lock has already been acquired
+    PION_LOG_DEBUG(m_logger, "Starting " << m_num_threads << " offload threads");
+    m_is_running = true;
+    const uint32_t num_threads = (m_num_threads > 0 ? m_num_threads : 1);
+    for (uint32_t n = 0; n < num_threads; ++n) {
+        std::shared_ptr<std::thread> new_thread(new std::thread(std::bind(&offload_pool::run_jobs, this)));
+        m_threads.push_back(new_thread);
+    }
+}
+
+void offload_pool::run_jobs(void)
+{
+    std::unique_lock<std::mutex> pool_lock(m_mutex);
+    while (m_is_running) {
+        if (m_jobs.empty()) {
+            m_job_queued.wait(pool_lock);
+            continue;
+        }
+
+        job_type job(std::move(m_jobs.front()));
+        m_jobs.pop_front();
+        --m_queue_depth;
+        ++m_num_active;
+        pool_lock.unlock();
+
+        try {
+            job.m_work();
+        } catch (std::exception& e) {
+            PION_LOG_ERROR(m_logger, e.what());
+        } catch (...) {
+            PION_LOG_ERROR(m_logger, "caught unrecognized exception");
+        }
+        if (job.m_completion)
+            job.m_service->post(completion_handler(std::move(job.m_completion), asio::error_code()));
+
+        --m_num_active;
+        ++m_num_completed;
+        pool_lock.lock();
+    }
+}
+
+
+}   // end namespace pion
@@ -13,6 +13,7 @@
 #include <pion/logger.hpp>
 #include <sstream>
 #include <iostream>
+#include <cstdlib>
 #include <signal.h>
 #include <time.h>
 #ifndef PION_WIN32
@@ -215,6 +216,12 @@ void process::daemonize(void)
     // not supported
 }
 
+std::vector<int> process::get_listen_fds(void)
+{
+    // not supported
+    return std::vector<int>();
+}
+
 #else   // NOT #ifdef PION_WIN32
 
 void handle_signal(int /* sig */)
@@ -266,6 +273,30 @@ void process::daemonize(void)
     umask(027);
 }
 
+std::vector<int> process::get_listen_fds(void)
+{
+    // the first descriptor passed by systemd (SD_LISTEN_FDS_START)
+    static const int LISTEN_FDS_START = 3;
+
+    std::vector<int> fds;
+    const char *pid_str = getenv("LISTEN_PID");
+    const char *num_fds_str = getenv("LISTEN_FDS");
+    if (pid_str != NULL && num_fds_str != NULL
+        && strtol(pid_str, NULL, 10) == static_cast<long>(getpid()))
+    {
+        const long num_fds = strtol(num_fds_str, NULL, 10);
+        for (long n = 0; n < num_fds; ++n) {
+            const int fd = LISTEN_FDS_START + static_cast<int>(n);
+            fcntl(fd, F_SETFD, FD_CLOEXEC);
+            fds.push_back(fd);
+        }
+    }
+    unsetenv("LISTEN_PID");
+    unsetenv("LISTEN_FDS");
+    unsetenv("LISTEN_FDNAMES");
+    return fds;
+}
+
 #endif  // #ifdef PION_WIN32
 
 }   // end namespace pion
@@ -8,17 +8,281 @@
 // See http://www.boost.org/LICENSE_1_0.txt
 //
 
+#include <atomic>
+#include <chrono>
 #include <pion/scheduler.hpp>
 
+#ifdef __linux__
+    #include <pthread.h>
+    #include <sched.h>
+#endif
+
 namespace pion {    // begin namespace pion
 
 
+///
+/// scheduler::thread_counters: statistics updated by one scheduler thread
+///
+struct scheduler::thread_counters {
+    thread_counters(void) { reset(); }
+
+    /// sets all counters to zero
+    void reset(void) {
+        m_num_handlers = 0;
+        m_busy_nsec = 0;
+        m_idle_nsec = 0;
+        for (int n = 0; n < histogram::NUM_BUCKETS; ++n) {
+            m_queue_wait[n] = 0;
+            m_run_time[n] = 0;
+        }
+        for (int lane = 0; lane < NUM_PRIORITIES; ++lane) {
+            m_lane_tasks[lane] = 0;
+            for (int n = 0; n < histogram::NUM_BUCKETS; ++n)
+                m_lane_wait[lane][n] = 0;
+        }
+    }
+
+    /// copies the counters into a statistics snapshot
+    void get(stats_type& stats) const {
+        stats.m_num_handlers = m_num_handlers.load(std::memory_order_relaxed);
+        stats.m_busy_nsec = m_busy_nsec.load(std::memory_order_relaxed);
+        stats.m_idle_nsec = m_idle_nsec.load(std::memory_order_relaxed);
+        for (int n = 0; n < histogram::NUM_BUCKETS; ++n) {
+            stats.m_queue_wait.m_buckets[n] = m_queue_wait[n].load(std::memory_order_relaxed);
+            stats.m_run_time.m_buckets[n] = m_run_time[n].load(std::memory_order_relaxed);
+        }
+        for (int lane = 0; lane < NUM_PRIORITIES; ++lane) {
+            stats.m_lane_tasks[lane] = m_lane_tasks[lane].load(std::memory_order_relaxed);
+            for (int n = 0; n < histogram::NUM_BUCKETS; ++n)
+                stats.m_lane_wait[lane].m_buckets[n] = m_lane_wait[lane][n].load(std::memory_order_relaxed);
+        }
+    }
+
+    /// counts a handler that ran for a number of nanoseconds
+    inline void add_handler(uint64_t nsec) {
+        m_num_handlers.fetch_add(1, std::memory_order_relaxed);
+        m_busy_nsec.fetch_add(nsec, std::memory_order_relaxed);
+        m_run_time[histogram::get_bucket(nsec / 1000)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    std::atomic<uint64_t>   m_num_handlers;
+    std::atomic<uint64_t>   m_busy_nsec;
+    std::atomic<uint64_t>   m_idle_nsec;
+    std::atomic<uint64_t>   m_queue_wait[histogram::NUM_BUCKETS];
+    std::atomic<uint64_t>   m_run_time[histogram::NUM_BUCKETS];
+    std::atomic<uint64_t>   m_lane_tasks[NUM_PRIORITIES];
+    std::atomic<uint64_t>   m_lane_wait[NUM_PRIORITIES][histogram::NUM_BUCKETS];
+
+    /// keeps other threads' counters out of the same cache line
+    char                    m_padding[64];
+};
+
+
+namespace {
+
+/// statistics state of the current thread
+struct current_thread_type {
+    /// counters updated by the thread (NULL if not a scheduler thread)
+    scheduler::thread_counters *    m_counters;
+
+    /// true while the thread is blocked waiting for a handler to run
+    bool                            m_is_waiting;
+
+    /// time when the first handler after waiting started to run
+    int64_t                         m_handler_start;
+};
+
+#if defined(_MSC_VER) && (_MSC_VER < 1900)
+__declspec(thread) current_thread_type  current_thread = { NULL, false, 0 };
+#else
+thread_local current_thread_type        current_thread = { NULL, false, 0 };
+#endif
+
+/// returns the current time of the steady clock, in nanoseconds
+inline int64_t get_nsec(void) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+/// identifies the work_stealing_scheduler worker that owns the current thread
+struct current_worker_type {
+    const work_stealing_scheduler *     m_scheduler;
+    uint32_t                            m_worker;
+};
+
+#if defined(_MSC_VER) && (_MSC_VER < 1900)
+__declspec(thread) current_worker_type  current_worker = { NULL, 0 };
+#else
+thread_local current_worker_type        current_worker = { NULL, 0 };
+#endif
+
+/// posted to wake up a worker thread that is waiting for I/O events
+void wake_up_worker(void) {}
+
+/// returns the next number from a per-thread xorshift generator
+uint32_t next_random(void) {
+#if defined(_MSC_VER) && (_MSC_VER < 1900)
+    __declspec(thread) static uint32_t state = 0;
+#else
+    thread_local static uint32_t state = 0;
+#endif
+    if (state == 0)
+        state = static_cast<uint32_t>(std::hash<std::thread::id>()(std::this_thread::get_id())) | 1;
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+}
+
+
 // static members of scheduler
     
 const uint32_t   scheduler::DEFAULT_NUM_THREADS = 8;
 const uint32_t   scheduler::NSEC_IN_SECOND = 1000000000; // (10^9)
 const uint32_t   scheduler::MICROSEC_IN_SECOND = 1000000;    // (10^6)
 const uint32_t   scheduler::KEEP_RUNNING_TIMER_SECONDS = 5;
+const uint32_t   scheduler::task_queue::LANE_WEIGHTS[scheduler::NUM_PRIORITIES] = { 16, 4, 1 };
+const uint32_t   scheduler::task_queue::MAX_WAIT_MSEC = 100;
+
+
+// handler_stats member functions
+
+void handler_stats::handler_started(void)
+{
+    if (current_thread.m_is_waiting) {
+        current_thread.m_is_waiting = false;
+        current_thread.m_handler_start = get_nsec();
+    }
+}
+
+
+// scheduler::histogram member functions
+
+uint32_t scheduler::histogram::get_bucket(uint64_t usec)
+{
+    uint32_t n = 0;
+    while (usec != 0 && n < NUM_BUCKETS - 1) {
+        usec >>= 1;
+        ++n;
+    }
+    return n;
+}
+
+uint64_t scheduler::histogram::get_count(void) const
+{
+    uint64_t count = 0;
+    for (int n = 0; n < NUM_BUCKETS; ++n)
+        count += m_buckets[n];
+    return count;
+}
+
+uint64_t scheduler::histogram::get_percentile(double percent) const
+{
+    const uint64_t count = get_count();
+    if (count == 0)
+        return 0;
+    const double rank = count * percent / 100.0;
+    uint64_t seen = 0;
+    for (uint32_t n = 0; n < NUM_BUCKETS - 1; ++n) {
+        seen += m_buckets[n];
+        if (seen >= rank)
+            return get_bucket_min(n + 1);
+    }
+    return get_bucket_min(NUM_BUCKETS - 1);
+}
+
+scheduler::histogram& scheduler::histogram::operator+=(const histogram& h)
+{
+    for (int n = 0; n < NUM_BUCKETS; ++n)
+        m_buckets[n] += h.m_buckets[n];
+    return *this;
+}
+
+
+// scheduler::task_queue member functions
+
+scheduler::task_queue::task_queue(void)
+    : m_size(0)
+{
+    for (int lane = 0; lane < NUM_PRIORITIES; ++lane)
+        m_credits[lane] = 0;
+}
+
+void scheduler::task_queue::push(task&& work_func, priority_type priority)
+{
+    if (priority < PRIORITY_HIGH || priority >= NUM_PRIORITIES)
+        priority = PRIORITY_NORMAL;
+    task_type task;
+    task.m_work_func = std::move(work_func);
+    task.m_priority = priority;
+    task.m_posted = get_nsec();
+    std::unique_lock<std::mutex> queue_lock(m_mutex);
+    m_lanes[priority].push_back(std::move(task));
+    ++m_size;
+}
+
+bool scheduler::task_queue::pop(task_type& task)
+{
+    if (size() == 0)
+        return false;
+    std::unique_lock<std::mutex> queue_lock(m_mutex);
+
+    // among the lanes whose oldest task has waited too long, serve the one
+    // that has waited longest (the higher priority lane if they are equal)
+    const int64_t starved = get_nsec() - static_cast<int64_t>(MAX_WAIT_MSEC) * 1000000;
+    int lane = -1;
+    for (int n = 0; n < NUM_PRIORITIES; ++n) {
+        if (! m_lanes[n].empty() && m_lanes[n].front().m_posted < starved
+            && (lane < 0 || m_lanes[n].front().m_posted < m_lanes[lane].front().m_posted))
+            lane = n;
+    }
+
+    if (lane < 0) {
+        // smooth weighted round-robin among the lanes that have work
+        int32_t total_weight = 0;
+        for (int n = 0; n < NUM_PRIORITIES; ++n) {
+            if (m_lanes[n].empty())
+                continue;
+            m_credits[n] += LANE_WEIGHTS[n];
+            total_weight += LANE_WEIGHTS[n];
+            if (lane < 0 || m_credits[n] > m_credits[lane])
+                lane = n;
+        }
+        if (lane < 0)
+            return false;
+        m_credits[lane] -= total_weight;
+    }
+
+    task = std::move(m_lanes[lane].front());
+    m_lanes[lane].pop_front();
+    --m_size;
+
+    // idle lanes do not save up credit
+    if (m_lanes[lane].empty())
+        m_credits[lane] = 0;
+    return true;
+}
+
+
+// scheduler::stats_type member functions
+
+scheduler::stats_type& scheduler::stats_type::operator+=(const stats_type& s)
+{
+    m_num_threads += s.m_num_threads;
+    m_num_handlers += s.m_num_handlers;
+    m_busy_nsec += s.m_busy_nsec;
+    m_idle_nsec += s.m_idle_nsec;
+    m_queue_wait += s.m_queue_wait;
+    m_run_time += s.m_run_time;
+    for (int n = 0; n < NUM_PRIORITIES; ++n) {
+        m_lane_tasks[n] += s.m_lane_tasks[n];
+        m_lane_wait[n] += s.m_lane_wait[n];
+    }
+    return *this;
+}
 
 
 // scheduler member functions
@@ -40,6 +304,7 @@ void scheduler::shutdown(void)
 
         // shut everything down
         m_is_running = false;
+        m_offload_pool.stop();
         stop_services();
         stop_threads();
         finish_services();
@@ -53,6 +318,7 @@ void scheduler::shutdown(void)
     } else {
         
         // stop and finish everything to be certain that no events are pending
+        m_offload_pool.stop();
         stop_services();
         stop_threads();
         finish_services();
@@ -101,7 +367,8 @@ void scheduler::remove_active_user(void)
 void scheduler::process_service_work(asio::io_service& service) {
     while (m_is_running) {
         try {
-            service.run();
+            // same as service.run(), but counts each handler in the statistics
+            while (poll_one_handler(service) > 0 || run_one_handler(service) > 0) ;
         } catch (std::exception& e) {
             PION_LOG_ERROR(m_logger, e.what());
         } catch (...) {
@@ -109,6 +376,158 @@ void scheduler::process_service_work(asio::io_service& service) {
         }
     }   
 }
+
+std::size_t scheduler::poll_one_handler(asio::io_service& service)
+{
+    thread_counters *counters = current_thread.m_counters;
+    if (counters == NULL)
+        return service.poll_one();
+    const int64_t start = get_nsec();
+    const std::size_t num_handlers = service.poll_one();
+    if (num_handlers > 0)
+        counters->add_handler(get_nsec() - start);
+    return num_handlers;
+}
+
+std::size_t scheduler::run_one_handler(asio::io_service& service)
+{
+    thread_counters *counters = current_thread.m_counters;
+    if (counters == NULL)
+        return service.run_one();
+
+    // the thread stops waiting when a handler calls handler_stats::handler_started();
+    // the time taken by handlers that do not (e.g. timers) counts as waiting
+    const int64_t start = get_nsec();
+    current_thread.m_is_waiting = true;
+    const std::size_t num_handlers = service.run_one();
+    const int64_t finish = get_nsec();
+    if (current_thread.m_is_waiting) {
+        current_thread.m_is_waiting = false;
+        counters->m_idle_nsec.fetch_add(finish - start, std::memory_order_relaxed);
+        if (num_handlers > 0)
+            counters->m_num_handlers.fetch_add(num_handlers, std::memory_order_relaxed);
+    } else {
+        counters->m_idle_nsec.fetch_add(current_thread.m_handler_start - start, std::memory_order_relaxed);
+        counters->add_handler(finish - current_thread.m_handler_start);
+    }
+    return num_handlers;
+}
+
+void scheduler::attach_thread_counters(uint32_t n)
+{
+    std::unique_lock<std::mutex> stats_lock(m_stats_mutex);
+    if (n >= m_thread_counters.size())
+        m_thread_counters.resize(n + 1);
+    if (! m_thread_counters[n])
+        m_thread_counters[n].reset(new thread_counters());
+    current_thread.m_counters = m_thread_counters[n].get();
+}
+
+void scheduler::post_task(asio::io_service& service, task_queue& queue,
+                          task&& work_func, priority_type priority)
+{
+    queue.push(std::move(work_func), priority);
+    service.post(std::bind(&scheduler::run_next_task, &queue));
+}
+
+void scheduler::run_next_task(task_queue *queue)
+{
+    task_queue::task_type task;
+    if (queue->pop(task))
+        run_task(task);
+}
+
+void scheduler::run_task(task_queue::task_type& task)
+{
+    handler_stats::handler_started();
+    thread_counters *counters = current_thread.m_counters;
+    if (counters) {
+        const int64_t wait_nsec = get_nsec() - task.m_posted;
+        const uint32_t bucket = histogram::get_bucket(wait_nsec > 0 ? wait_nsec / 1000 : 0);
+        counters->m_queue_wait[bucket].fetch_add(1, std::memory_order_relaxed);
+        counters->m_lane_wait[task.m_priority][bucket].fetch_add(1, std::memory_order_relaxed);
+        counters->m_lane_tasks[task.m_priority].fetch_add(1, std::memory_order_relaxed);
+    }
+    task.m_work_func();
+}
+
+std::vector<scheduler::stats_type> scheduler::get_thread_stats(void) const
+{
+    const uint32_t num_services = get_num_services();
+    std::unique_lock<std::mutex> stats_lock(m_stats_mutex);
+    std::vector<stats_type> stats(m_thread_counters.size());
+    for (uint32_t n = 0; n < stats.size(); ++n) {
+        stats[n].m_service = n % num_services;
+        if (m_thread_counters[n]) {
+            stats[n].m_num_threads = 1;
+            m_thread_counters[n]->get(stats[n]);
+        }
+    }
+    return stats;
+}
+
+std::vector<scheduler::stats_type> scheduler::get_service_stats(void) const
+{
+    // threads are assigned to services in turn (thread n runs service n % size)
+    const std::vector<stats_type> thread_stats(get_thread_stats());
+    std::vector<stats_type> stats(get_num_services());
+    for (uint32_t n = 0; n < stats.size(); ++n) {
+        stats[n].m_service = n;
+        stats[n].m_queue_depth = get_queue_depth(n);
+    }
+    for (std::vector<stats_type>::const_iterator i = thread_stats.begin(); i != thread_stats.end(); ++i) {
+        if (i->m_service < stats.size())
+            stats[i->m_service] += *i;
+    }
+    return stats;
+}
+
+void scheduler::reset_stats(void)
+{
+    std::unique_lock<std::mutex> stats_lock(m_stats_mutex);
+    for (std::vector<std::shared_ptr<thread_counters> >::iterator i = m_thread_counters.begin();
+         i != m_thread_counters.end(); ++i)
+    {
+        if (*i)
+            (*i)->reset();
+    }
+}
+
+bool scheduler::set_thread_affinity(uint32_t n)
+{
+    if (m_cpu_affinity.empty())
+        return false;
+    const uint32_t cpu = m_cpu_affinity[n % m_cpu_affinity.size()];
+#ifdef __linux__
+    if (cpu < CPU_SETSIZE) {
+        cpu_set_t cpu_set;
+        CPU_ZERO(&cpu_set);
+        CPU_SET(cpu, &cpu_set);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set) == 0) {
+            PION_LOG_DEBUG(m_logger, "Pinned scheduler thread " << n << " to CPU " << cpu);
+            return true;
+        }
+    }
+    PION_LOG_WARN(m_logger, "Unable to pin scheduler thread " << n << " to CPU " << cpu);
+#else
+    PION_LOG_WARN(m_logger, "CPU affinity is not supported on this platform (thread "
+                  << n << ", CPU " << cpu << ")");
+#endif
+    return false;
+}
+
+void scheduler::run_pinned(uint32_t n, const std::function<void()>& func)
+{
+    if (m_cpu_affinity.empty()) {
+        func();
+        return;
+    }
+    std::thread pinned_thread([this, n, &func]() {
+        set_thread_affinity(n);
+        func();
+    });
+    pinned_thread.join();
+}
                      
 
 // single_service_scheduler member functions
@@ -128,9 +547,8 @@ void single_service_scheduler::startup(void)
         
         // start multiple threads to handle async tasks
         for (uint32_t n = 0; n < m_num_threads; ++n) {
-            std::shared_ptr<std::thread> new_thread(new std::thread( std::bind(&scheduler::process_service_work,
-                                                                                       this, std::ref(m_service)) ));
-            m_thread_pool.push_back(new_thread);
+            create_thread(n, std::bind(&scheduler::process_service_work,
+                                       this, std::ref(m_service)));
         }
     }
 }
@@ -148,24 +566,285 @@ void one_to_one_scheduler::startup(void)
         m_is_running = true;
         
         // make sure there are enough services initialized
-        while (m_service_pool.size() < m_num_threads) {
-            std::shared_ptr<service_pair_type>  service_ptr(new service_pair_type());
-            m_service_pool.push_back(service_ptr);
-        }
+        const service_pool_ptr pool_ptr(create_services());
 
         // schedule a work item for each service to make sure that it doesn't complete
-        for (service_pool_type::iterator i = m_service_pool.begin(); i != m_service_pool.end(); ++i) {
+        for (service_pool_type::const_iterator i = pool_ptr->begin(); i != pool_ptr->end(); ++i) {
             keep_running((*i)->first, (*i)->second);
         }
         
         // start multiple threads to handle async tasks
         for (uint32_t n = 0; n < m_num_threads; ++n) {
-            std::shared_ptr<std::thread> new_thread(new std::thread( std::bind(&scheduler::process_service_work,
-                                                                                       this, std::ref(m_service_pool[n]->first)) ));
-            m_thread_pool.push_back(new_thread);
+            create_thread(n, std::bind(&scheduler::process_service_work,
+                                       this, std::ref((*pool_ptr)[n]->first)));
+        }
+    }
+}
+
+
+one_to_one_scheduler::service_pool_ptr one_to_one_scheduler::create_services(void)
+{
+    service_pool_ptr pool_ptr(get_service_pool());
+    if (pool_ptr && pool_ptr->size() >= m_num_threads)
+        return pool_ptr;
+
+    // lock-free readers may be using the current pool, so a new one replaces it
+    std::shared_ptr<service_pool_type> new_pool_ptr(pool_ptr ? new service_pool_type(*pool_ptr)
+                                                             : new service_pool_type());
+    while (new_pool_ptr->size() < m_num_threads) {
+        // created on the CPU of the thread that will run the service (the
+        // timer also creates the service's reactor)
+        std::shared_ptr<service_pair_type>  service_ptr;
+        run_pinned(static_cast<uint32_t>(new_pool_ptr->size()),
+                   [&service_ptr]() { service_ptr.reset(new service_pair_type()); });
+        new_pool_ptr->push_back(service_ptr);
+    }
+    pool_ptr = new_pool_ptr;
+    std::atomic_store(&m_service_pool, pool_ptr);
+    return pool_ptr;
+}
+
+std::shared_ptr<one_to_one_scheduler::service_pair_type> one_to_one_scheduler::select_service(void)
+{
+    service_pool_ptr pool_ptr(get_service_pool());
+    if (! pool_ptr || pool_ptr->size() < m_num_threads) {
+        std::unique_lock<std::mutex> scheduler_lock(m_mutex);
+        pool_ptr = create_services();
+    }
+    const uint32_t num_services = static_cast<uint32_t>(pool_ptr->size());
+    assert(num_services > 0);
+    if (num_services == 1)
+        return (*pool_ptr)[0];
+
+    // pick two distinct services at random and use the one with less load
+    const uint32_t r = next_random();
+    const uint32_t a = r % num_services;
+    const uint32_t b = (a + 1 + (r >> 16) % (num_services - 1)) % num_services;
+    const std::shared_ptr<service_pair_type>& first_choice = (*pool_ptr)[a];
+    const std::shared_ptr<service_pair_type>& second_choice = (*pool_ptr)[b];
+    return (second_choice->get_load() < first_choice->get_load() ? second_choice : first_choice);
+}
+
+std::shared_ptr<one_to_one_scheduler::service_pair_type> one_to_one_scheduler::find_service(const asio::io_service& service)
+{
+    const service_pool_ptr pool_ptr(get_service_pool());
+    if (pool_ptr) {
+        for (service_pool_type::const_iterator i = pool_ptr->begin(); i != pool_ptr->end(); ++i) {
+            if (&(*i)->first == &service)
+                return *i;
+        }
+    }
+    return std::shared_ptr<service_pair_type>();
+}
+
+void one_to_one_scheduler::post(task work_func, priority_type priority)
+{
+    const std::shared_ptr<service_pair_type> service_pair(select_service());
+    post_task(service_pair->first, service_pair->m_tasks, std::move(work_func), priority);
+}
+
+void one_to_one_scheduler::connection_opened(asio::io_service& service)
+{
+    const std::shared_ptr<service_pair_type> service_pair(find_service(service));
+    if (service_pair)
+        ++service_pair->m_num_connections;
+}
+
+void one_to_one_scheduler::connection_closed(asio::io_service& service)
+{
+    const std::shared_ptr<service_pair_type> service_pair(find_service(service));
+    if (! service_pair)
+        return;
+    // never drops below zero, even if a connection that was opened before
+    // the count started is closed at the same time as another one
+    uint32_t num_connections = service_pair->m_num_connections.load(std::memory_order_relaxed);
+    while (num_connections > 0
+           && ! service_pair->m_num_connections.compare_exchange_weak(num_connections, num_connections - 1,
+                                                                        std::memory_order_relaxed))
+    {}
+}
+
+
+// work_stealing_scheduler member functions
+
+void work_stealing_scheduler::startup(void)
+{
+    // lock mutex for thread safety
+    std::unique_lock<std::mutex> scheduler_lock(m_mutex);
+    
+    if (! m_is_running) {
+        PION_LOG_INFO(m_logger, "Starting thread scheduler");
+        m_is_running = true;
+        
+        // make sure there are enough workers initialized
+        const worker_pool_ptr pool_ptr(create_workers());
+
+        // schedule a work item for each service to make sure that it doesn't complete
+        for (worker_pool_type::const_iterator i = pool_ptr->begin(); i != pool_ptr->end(); ++i) {
+            (*i)->m_service.reset();
+            keep_running((*i)->m_service, (*i)->m_timer);
+        }
+        
+        // start multiple threads to handle async tasks
+        for (uint32_t n = 0; n < m_num_threads; ++n) {
+            create_thread(n, std::bind(&work_stealing_scheduler::process_worker_work,
+                                       this, n));
+        }
+    }
+}
+
+void work_stealing_scheduler::stop_services(void)
+{
+    const worker_pool_ptr pool_ptr(get_worker_pool());
+    if (pool_ptr) {
+        for (worker_pool_type::const_iterator i = pool_ptr->begin(); i != pool_ptr->end(); ++i) {
+            (*i)->m_service.stop();
+        }
+    }
+}
+
+work_stealing_scheduler::worker_pool_ptr work_stealing_scheduler::create_workers(void)
+{
+    // assumes that a scheduler lock has already been acquired
+    worker_pool_ptr pool_ptr(get_worker_pool());
+    if (pool_ptr && pool_ptr->size() >= m_num_threads)
+        return pool_ptr;
+
+    // lock-free readers may be using the current pool, so a new one replaces it
+    std::shared_ptr<worker_pool_type> new_pool_ptr(pool_ptr ? new worker_pool_type(*pool_ptr)
+                                                            : new worker_pool_type());
+    while (new_pool_ptr->size() < m_num_threads) {
+        // created on the CPU of the worker's thread
+        std::shared_ptr<worker_type>  worker_ptr;
+        run_pinned(static_cast<uint32_t>(new_pool_ptr->size()),
+                   [&worker_ptr]() { worker_ptr.reset(new worker_type()); });
+        new_pool_ptr->push_back(worker_ptr);
+    }
+    pool_ptr = new_pool_ptr;
+    std::atomic_store(&m_worker_pool, pool_ptr);
+    return pool_ptr;
+}
+
+std::shared_ptr<work_stealing_scheduler::worker_type> work_stealing_scheduler::get_worker(uint32_t n)
+{
+    worker_pool_ptr pool_ptr(get_worker_pool());
+    if (! pool_ptr || n >= pool_ptr->size()) {
+        std::unique_lock<std::mutex> scheduler_lock(m_mutex);
+        pool_ptr = create_workers();
+    }
+    assert(n < pool_ptr->size());
+    return (*pool_ptr)[n];
+}
+
+void work_stealing_scheduler::post(task work_func, priority_type priority)
+{
+    // work posted by one of our own threads stays local to that thread
+    const uint32_t n = (current_worker.m_scheduler == this ? current_worker.m_worker
+                        : m_next_service.fetch_add(1, std::memory_order_relaxed) % m_num_threads);
+
+    // a snapshot of the pool that stays valid while it is used here, even if
+    // the scheduler is started or stopped at the same time
+    worker_pool_ptr pool_ptr(get_worker_pool());
+    if (! pool_ptr || n >= pool_ptr->size()) {
+        std::unique_lock<std::mutex> scheduler_lock(m_mutex);
+        pool_ptr = create_workers();
+    }
+    worker_type& w = *(*pool_ptr)[n];
+    w.m_tasks.push(std::move(work_func), priority);
+
+    // wake up the owner if it is waiting for I/O, or else any idle
+    // thread that can steal the work.  The fence pairs with the one in
+    // process_worker_work(): either the idle thread sees the task that was
+    // queued, or this sees that it is idle (without them, both the queue
+    // size and idle flag could be read before the other side's store)
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (w.m_is_idle) {
+        w.m_service.post(&wake_up_worker);
+    } else {
+        for (worker_pool_type::const_iterator i = pool_ptr->begin(); i != pool_ptr->end(); ++i) {
+            if ((*i)->m_is_idle) {
+                (*i)->m_service.post(&wake_up_worker);
+                break;
+            }
         }
     }
 }
 
+bool work_stealing_scheduler::steal_task(const worker_pool_type& pool, uint32_t n, task_queue::task_type& task)
+{
+    const uint32_t num_workers = static_cast<uint32_t>(pool.size());
+    for (uint32_t i = 1; i < num_workers; ++i) {
+        if (pool[(n + i) % num_workers]->m_tasks.pop(task))
+            return true;
+    }
+    return false;
+}
+
+bool work_stealing_scheduler::has_queued_tasks(const worker_pool_type& pool)
+{
+    for (worker_pool_type::const_iterator i = pool.begin(); i != pool.end(); ++i) {
+        if ((*i)->m_tasks.size() > 0)
+            return true;
+    }
+    return false;
+}
+
+void work_stealing_scheduler::run_worker_task(task_queue::task_type& task)
+{
+    thread_counters *counters = current_thread.m_counters;
+    if (counters == NULL) {
+        run_task(task);
+        return;
+    }
+    const int64_t start = get_nsec();
+    // counts the task even if it throws an exception
+    struct finished_type {
+        thread_counters *m_counters;
+        int64_t m_start;
+        ~finished_type() { m_counters->add_handler(get_nsec() - m_start); }
+    } finished = { counters, start };
+    run_task(task);
+}
+
+void work_stealing_scheduler::process_worker_work(uint32_t n)
+{
+    current_worker.m_scheduler = this;
+    current_worker.m_worker = n;
+
+    // the pool that the thread was started with (kept alive until it exits)
+    const worker_pool_ptr pool_ptr(get_worker_pool());
+    worker_type& w = *(*pool_ptr)[n];
+    task_queue::task_type task;
+    while (m_is_running) {
+        try {
+            // run any I/O completions that are ready without blocking, since
+            // those can only be handled by this thread
+            while (poll_one_handler(w.m_service) > 0) ;
+
+            // then run posted work, stealing it from other threads if necessary
+            if (w.m_tasks.pop(task) || steal_task(*pool_ptr, n, task)) {
+                run_worker_task(task);
+                task.m_work_func = nullptr;
+                continue;
+            }
+
+            // nothing left to do: wait for an I/O event or a wake-up.  The idle
+            // flag is set before checking the queues, so that anyone posting
+            // work afterwards will see it and wake this thread up
+            w.m_is_idle = true;
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (! has_queued_tasks(*pool_ptr))
+                run_one_handler(w.m_service);
+        } catch (std::exception& e) {
+            PION_LOG_ERROR(m_logger, e.what());
+        } catch (...) {
+            PION_LOG_ERROR(m_logger, "caught unrecognized exception");
+        }
+        w.m_is_idle = false;
+        task.m_work_func = nullptr;
+    }
+
+    current_worker.m_scheduler = NULL;
+}
     
 }   // end namespace pion
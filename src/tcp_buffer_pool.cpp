@@ -0,0 +1,80 @@
+// ---------------------------------------------------------------------
+// pion:  a Boost C++ framework for building lightweight HTTP interfaces
+// ---------------------------------------------------------------------
+// Copyright (C) 2021 Wang Qiang  (https://github.com/dnybz/pion)
+// Copyright (C) 2007-2014 Splunk Inc.  (https://github.com/splunk/pion)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include <new>
+#include <pion/tcp/buffer_pool.hpp>
+#include <pion/tcp/uring_service.hpp>
+
+namespace pion {    // begin namespace pion
+namespace tcp {     // begin namespace tcp
+
+
+// static members of buffer_pool
+
+asio::io_service::id    buffer_pool::id;
+const std::size_t       buffer_pool::MAX_FREE_BUFFERS = 1024;
+
+
+// buffer_pool member functions
+
+buffer_pool::buffer_pool(asio::io_service& io_service)
+    : asio::io_service::service(io_service), m_num_in_use(0)
+{}
+
+void *buffer_pool::allocate(int& index)
+{
+    ++m_num_in_use;
+    std::unique_lock<std::mutex> pool_lock(m_mutex);
+    if (! m_free_buffers.empty()) {
+        const free_buffer_type buffer = m_free_buffers.back();
+        m_free_buffers.pop_back();
+        index = buffer.second;
+        return buffer.first;
+    }
+    pool_lock.unlock();
+    index = -1;
+    return ::operator new(BUFFER_SIZE);
+}
+
+void buffer_pool::deallocate(void *buffer, int index)
+{
+    --m_num_in_use;
+    std::unique_lock<std::mutex> pool_lock(m_mutex);
+    if (m_free_buffers.size() < MAX_FREE_BUFFERS) {
+        m_free_buffers.push_back(free_buffer_type(buffer, index));
+        return;
+    }
+    pool_lock.unlock();
+#ifdef PION_HAVE_IO_URING
+    if (index >= 0)
+        asio::use_service<uring_service>(get_io_service()).unregister_buffer(index);
+#endif
+    ::operator delete(buffer);
+}
+
+std::size_t buffer_pool::get_num_free(void) const
+{
+    std::unique_lock<std::mutex> pool_lock(m_mutex);
+    return m_free_buffers.size();
+}
+
+void buffer_pool::shutdown(void)
+{
+    // registered buffers are not unregistered: no more operations are started
+    // once the I/O service shuts down, and the io_uring engine closes its ring
+    std::unique_lock<std::mutex> pool_lock(m_mutex);
+    for (std::vector<free_buffer_type>::iterator i = m_free_buffers.begin(); i != m_free_buffers.end(); ++i)
+        ::operator delete(i->first);
+    m_free_buffers.clear();
+}
+
+
+}   // end namespace tcp
+}   // end namespace pion
@@ -0,0 +1,96 @@
+// ---------------------------------------------------------------------
+// pion:  a Boost C++ framework for building lightweight HTTP interfaces
+// ---------------------------------------------------------------------
+// Copyright (C) 2021 Wang Qiang  (https://github.com/dnybz/pion)
+// Copyright (C) 2007-2014 Splunk Inc.  (https://github.com/splunk/pion)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include <pion/tcp/connection_pool.hpp>
+
+namespace pion {    // begin namespace pion
+namespace tcp {     // begin namespace tcp
+
+
+// connection_pool member functions
+
+connection_pool::connection_pool(asio::io_service& io_service,
+                                 connection::ssl_context_type& ssl_context,
+                                 const bool ssl_flag,
+                                 connection::connection_handler finished_handler,
+                                 std::size_t max_size,
+                                 scheduler::io_engine_type engine)
+    : m_io_service(io_service), m_ssl_context(ssl_context), m_ssl_flag(ssl_flag),
+    m_finished_handler(finished_handler), m_max_size(max_size), m_io_engine(engine),
+    m_is_closed(false)
+{
+    m_idle.reserve(max_size);
+}
+
+connection_ptr connection_pool::create(void)
+{
+    connection *conn_ptr = NULL;
+    {
+        std::unique_lock<std::mutex> pool_lock(m_mutex);
+        if (! m_idle.empty()) {
+            conn_ptr = m_idle.back();
+            m_idle.pop_back();
+        }
+    }
+    if (conn_ptr == NULL)
+        conn_ptr = allocate();
+    return connection_ptr(conn_ptr, recycler(shared_from_this()));
+}
+
+void connection_pool::reserve(std::size_t n)
+{
+    if (n > m_max_size)
+        n = m_max_size;
+    std::unique_lock<std::mutex> pool_lock(m_mutex);
+    while (! m_is_closed && m_idle.size() < n)
+        m_idle.push_back(allocate());
+}
+
+void connection_pool::close(void)
+{
+    std::vector<connection*> idle;
+    {
+        std::unique_lock<std::mutex> pool_lock(m_mutex);
+        m_is_closed = true;
+        idle.swap(m_idle);
+    }
+    for (std::vector<connection*>::iterator i = idle.begin(); i != idle.end(); ++i)
+        delete *i;
+}
+
+std::size_t connection_pool::size(void) const
+{
+    std::unique_lock<std::mutex> pool_lock(m_mutex);
+    return m_idle.size();
+}
+
+connection *connection_pool::allocate(void)
+{
+    return new connection(m_io_service, m_ssl_context, m_ssl_flag, m_finished_handler, m_io_engine);
+}
+
+void connection_pool::recycle(connection *conn_ptr)
+{
+    // close the socket and forget any state (including the SSL session)
+    // left over from the last client
+    conn_ptr->reset();
+    {
+        std::unique_lock<std::mutex> pool_lock(m_mutex);
+        if (! m_is_closed && m_idle.size() < m_max_size) {
+            m_idle.push_back(conn_ptr);
+            return;
+        }
+    }
+    delete conn_ptr;
+}
+
+
+}   // end namespace tcp
+}   // end namespace pion
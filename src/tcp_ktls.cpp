@@ -0,0 +1,405 @@
+// ---------------------------------------------------------------------
+// pion:  a Boost C++ framework for building lightweight HTTP interfaces
+// ---------------------------------------------------------------------
+// Copyright (C) 2021 Wang Qiang  (https://github.com/dnybz/pion)
+// Copyright (C) 2007-2014 Splunk Inc.  (https://github.com/splunk/pion)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include <pion/tcp/ktls.hpp>
+
+#ifdef PION_HAVE_SSL
+
+#include <algorithm>
+#include <cstring>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+
+// TLS 1.3 secrets are only available from OpenSSL 1.1.1 on
+#if defined(PION_HAVE_KTLS) && OPENSSL_VERSION_NUMBER >= 0x10101000L
+#define PION_USE_KTLS
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <linux/tls.h>
+#ifndef SOL_TLS
+#define SOL_TLS     282
+#endif
+#ifndef TCP_ULP
+#define TCP_ULP     31
+#endif
+#endif
+
+
+namespace {
+
+#ifdef PION_USE_KTLS
+
+/// longest key used by a supported cipher
+const std::size_t MAX_KEY_SIZE = 32;
+
+/// length of the implicit nonce used with AES-GCM in TLS 1.2
+const std::size_t TLS12_GCM_SALT_SIZE = 4;
+
+/// length of the per-connection nonce used with TLS 1.3 and ChaCha20-Poly1305
+const std::size_t AEAD_IV_SIZE = 12;
+
+/// converts a hexadecimal digit (returns -1 if it is not one)
+inline int from_hex(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+/**
+ * derives a TLS 1.3 traffic key or nonce from a traffic secret
+ * (HKDF-Expand-Label with an empty context, RFC 8446 section 7.1)
+ *
+ * @param md the hash used by the cipher suite
+ * @param secret the traffic secret
+ * @param secret_len length of the secret
+ * @param label "key" or "iv"
+ * @param out receives the key or nonce
+ * @param out_len length of the key or nonce (at most one hash block)
+ *
+ * @return bool true if the key or nonce was derived
+ */
+bool hkdf_expand_label(const EVP_MD *md, const unsigned char *secret, std::size_t secret_len,
+                       const char *label, unsigned char *out, std::size_t out_len)
+{
+    unsigned char info[32];
+    const std::size_t label_len = strlen(label);
+    std::size_t n = 0;
+    info[n++] = static_cast<unsigned char>(out_len >> 8);
+    info[n++] = static_cast<unsigned char>(out_len);
+    info[n++] = static_cast<unsigned char>(6 + label_len);
+    memcpy(info + n, "tls13 ", 6);
+    n += 6;
+    memcpy(info + n, label, label_len);
+    n += label_len;
+    info[n++] = 0;      // context
+    info[n++] = 1;      // block counter
+
+    unsigned char block[EVP_MAX_MD_SIZE];
+    unsigned int block_len = 0;
+    if (HMAC(md, secret, static_cast<int>(secret_len), info, n, block, &block_len) == NULL
+        || block_len < out_len)
+        return false;
+    memcpy(out, block, out_len);
+    OPENSSL_cleanse(block, sizeof(block));
+    return true;
+}
+
+/**
+ * derives the TLS 1.2 key block from a session's master secret
+ * (the "key expansion" PRF, RFC 5246 sections 5 and 6.3)
+ *
+ * @param md the hash used by the cipher suite's PRF
+ * @param ssl the SSL connection
+ * @param out receives the key block
+ * @param out_len length of the key block
+ *
+ * @return bool true if the key block was derived
+ */
+bool tls12_key_expansion(const EVP_MD *md, SSL *ssl, unsigned char *out, std::size_t out_len)
+{
+    unsigned char secret[SSL_MAX_MASTER_KEY_LENGTH];
+    const std::size_t secret_len = SSL_SESSION_get_master_key(SSL_get_session(ssl),
+                                                              secret, sizeof(secret));
+    if (secret_len == 0)
+        return false;
+
+    // seed = label + server random + client random
+    static const char LABEL[] = "key expansion";
+    unsigned char seed[sizeof(LABEL) - 1 + 2 * SSL3_RANDOM_SIZE];
+    std::size_t seed_len = sizeof(LABEL) - 1;
+    memcpy(seed, LABEL, seed_len);
+    seed_len += SSL_get_server_random(ssl, seed + seed_len, SSL3_RANDOM_SIZE);
+    seed_len += SSL_get_client_random(ssl, seed + seed_len, SSL3_RANDOM_SIZE);
+
+    // P_hash: A(i) = HMAC(secret, A(i-1)), output = HMAC(secret, A(i) + seed)...
+    unsigned char a[EVP_MAX_MD_SIZE + sizeof(seed)];
+    unsigned char block[EVP_MAX_MD_SIZE];
+    unsigned int a_len = 0;
+    unsigned int block_len = 0;
+    bool ok = (HMAC(md, secret, static_cast<int>(secret_len), seed, seed_len, a, &a_len) != NULL);
+    for (std::size_t n = 0; ok && n < out_len; n += block_len) {
+        memcpy(a + a_len, seed, seed_len);
+        ok = (HMAC(md, secret, static_cast<int>(secret_len), a, a_len + seed_len, block, &block_len) != NULL);
+        if (ok) {
+            memcpy(out + n, block, std::min<std::size_t>(block_len, out_len - n));
+            ok = (HMAC(md, secret, static_cast<int>(secret_len), a, a_len, block, &a_len) != NULL);
+            memcpy(a, block, a_len);
+        }
+    }
+    OPENSSL_cleanse(secret, sizeof(secret));
+    OPENSSL_cleanse(a, sizeof(a));
+    OPENSSL_cleanse(block, sizeof(block));
+    return ok;
+}
+
+/**
+ * installs the sending keys of a connection on its socket
+ *
+ * @param fd the connection's socket
+ * @param info the kernel's parameters for the cipher
+ * @param cipher_type the kernel's identifier for the cipher
+ * @param version TLS1_2_VERSION or TLS1_3_VERSION
+ * @param key the sending key
+ * @param iv the sending nonce (implicit part only for AES-GCM in TLS 1.2)
+ * @param seq sequence number of the next record
+ *
+ * @return bool true if the kernel accepted the keys
+ */
+template <typename crypto_info_type>
+bool install_tx_keys(int fd, crypto_info_type& info, unsigned short cipher_type, int version,
+                     const unsigned char *key, const unsigned char *iv, uint64_t seq)
+{
+    unsigned char rec_seq[8];
+    for (std::size_t n = 0; n < sizeof(rec_seq); ++n)
+        rec_seq[n] = static_cast<unsigned char>(seq >> (56 - 8 * n));
+
+    memset(&info, 0, sizeof(info));
+    info.info.version = (version == TLS1_3_VERSION ? TLS_1_3_VERSION : TLS_1_2_VERSION);
+    info.info.cipher_type = cipher_type;
+    memcpy(info.key, key, sizeof(info.key));
+    memcpy(info.salt, iv, sizeof(info.salt));
+    if (version == TLS1_2_VERSION && sizeof(info.salt) != 0) {
+        // OpenSSL sends the sequence number as the explicit nonce
+        memcpy(info.iv, rec_seq, sizeof(info.iv));
+    } else {
+        memcpy(info.iv, iv + sizeof(info.salt), sizeof(info.iv));
+    }
+    memcpy(info.rec_seq, rec_seq, sizeof(info.rec_seq));
+
+    const bool ok = (::setsockopt(fd, SOL_TLS, TLS_TX, &info, sizeof(info)) == 0);
+    OPENSSL_cleanse(&info, sizeof(info));
+    return ok;
+}
+
+#endif  // PION_USE_KTLS
+
+}
+
+
+namespace pion {    // begin namespace pion
+namespace tcp {     // begin namespace tcp
+
+
+/// what an SSL connection needs to know to switch to kernel TLS
+struct ktls::tx_state {
+    tx_state(void) : m_seq(0), m_secret_len(0), m_fd(-1) {}
+
+    /// number of records sent with the current sending keys
+    uint64_t        m_seq;
+    /// the server's TLS 1.3 application traffic secret
+    unsigned char   m_secret[EVP_MAX_MD_SIZE];
+    /// length of the traffic secret (0 if it is not known)
+    std::size_t     m_secret_len;
+    /// the socket, once data written to it is encrypted by the kernel (-1 before)
+    int             m_fd;
+};
+
+
+// ktls member functions
+
+bool ktls::is_supported(void)
+{
+#ifdef PION_USE_KTLS
+    return true;
+#else
+    return false;
+#endif
+}
+
+void ktls::attach(SSL_CTX *ctx)
+{
+#ifdef PION_USE_KTLS
+    // the kernel could not answer a renegotiation, and is not told about new keys
+    SSL_CTX_set_options(ctx, SSL_OP_NO_RENEGOTIATION);
+    SSL_CTX_set_keylog_callback(ctx, &ktls::keylog_callback);
+    SSL_CTX_set_msg_callback(ctx, &ktls::msg_callback);
+#else
+    (void)ctx;
+#endif
+}
+
+bool ktls::enable(SSL *ssl, int fd)
+{
+#ifdef PION_USE_KTLS
+    tx_state *state = get_state(ssl, false);
+    const SSL_CIPHER *cipher = SSL_get_current_cipher(ssl);
+    const int version = SSL_version(ssl);
+    // everything that OpenSSL has encrypted must have been sent
+    if (state == NULL || state->m_fd >= 0 || cipher == NULL || ! SSL_is_init_finished(ssl)
+        || BIO_ctrl_pending(SSL_get_wbio(ssl)) != 0
+        || (version != TLS1_2_VERSION && version != TLS1_3_VERSION)
+        || (version == TLS1_3_VERSION && state->m_secret_len == 0))
+    {
+        ++m_num_fallbacks;
+        return false;
+    }
+
+    // find out how the cipher is used
+    const int cipher_nid = SSL_CIPHER_get_cipher_nid(cipher);
+    std::size_t key_len = 0;
+    std::size_t iv_len = AEAD_IV_SIZE;
+    switch (cipher_nid) {
+    case NID_aes_128_gcm:
+        key_len = TLS_CIPHER_AES_GCM_128_KEY_SIZE;
+        break;
+    case NID_aes_256_gcm:
+        key_len = TLS_CIPHER_AES_GCM_256_KEY_SIZE;
+        break;
+#ifdef TLS_CIPHER_CHACHA20_POLY1305
+    case NID_chacha20_poly1305:
+        key_len = TLS_CIPHER_CHACHA20_POLY1305_KEY_SIZE;
+        break;
+#endif
+    }
+    if (version == TLS1_2_VERSION && cipher_nid != NID_chacha20_poly1305)
+        iv_len = TLS12_GCM_SALT_SIZE;
+    const EVP_MD *md = SSL_CIPHER_get_handshake_digest(cipher);
+
+    // derive the server's sending key and nonce
+    unsigned char key[MAX_KEY_SIZE];
+    unsigned char iv[AEAD_IV_SIZE];
+    bool ok = (key_len != 0 && md != NULL);
+    if (ok && version == TLS1_3_VERSION) {
+        ok = hkdf_expand_label(md, state->m_secret, state->m_secret_len, "key", key, key_len)
+            && hkdf_expand_label(md, state->m_secret, state->m_secret_len, "iv", iv, iv_len);
+    } else if (ok) {
+        // key block = client key, server key, client nonce, server nonce (AEAD
+        // ciphers have no MAC keys)
+        unsigned char key_block[2 * (MAX_KEY_SIZE + AEAD_IV_SIZE)];
+        ok = tls12_key_expansion(md, ssl, key_block, 2 * (key_len + iv_len));
+        memcpy(key, key_block + key_len, key_len);
+        memcpy(iv, key_block + 2 * key_len + iv_len, iv_len);
+        OPENSSL_cleanse(key_block, sizeof(key_block));
+    }
+
+    // attach the kernel's TLS layer to the socket and install the keys
+    static const char ULP_NAME[] = "tls";
+    if (ok)
+        ok = (::setsockopt(fd, IPPROTO_TCP, TCP_ULP, ULP_NAME, sizeof(ULP_NAME) - 1) == 0);
+    if (ok) {
+        switch (cipher_nid) {
+        case NID_aes_128_gcm: {
+            tls12_crypto_info_aes_gcm_128 info;
+            ok = install_tx_keys(fd, info, TLS_CIPHER_AES_GCM_128, version, key, iv, state->m_seq);
+            break;
+        }
+        case NID_aes_256_gcm: {
+            tls12_crypto_info_aes_gcm_256 info;
+            ok = install_tx_keys(fd, info, TLS_CIPHER_AES_GCM_256, version, key, iv, state->m_seq);
+            break;
+        }
+#ifdef TLS_CIPHER_CHACHA20_POLY1305
+        case NID_chacha20_poly1305: {
+            tls12_crypto_info_chacha20_poly1305 info;
+            ok = install_tx_keys(fd, info, TLS_CIPHER_CHACHA20_POLY1305, version, key, iv, state->m_seq);
+            break;
+        }
+#endif
+        }
+    }
+    OPENSSL_cleanse(key, sizeof(key));
+    OPENSSL_cleanse(iv, sizeof(iv));
+    OPENSSL_cleanse(state->m_secret, sizeof(state->m_secret));
+    state->m_secret_len = 0;
+
+    // without TLS_TX, the kernel's TLS layer passes data through unchanged
+    if (! ok) {
+        ++m_num_fallbacks;
+        return false;
+    }
+    state->m_fd = fd;
+    ++m_num_enabled;
+    return true;
+#else
+    (void)ssl;
+    (void)fd;
+    ++m_num_fallbacks;
+    return false;
+#endif
+}
+
+ktls::tx_state *ktls::get_state(const SSL *ssl, bool create)
+{
+    static const int index = SSL_get_ex_new_index(0, NULL, NULL, NULL, &ktls::free_state_callback);
+    tx_state *state = static_cast<tx_state*>(SSL_get_ex_data(ssl, index));
+    if (state == NULL && create) {
+        state = new tx_state;
+        SSL_set_ex_data(const_cast<SSL*>(ssl), index, state);
+    }
+    return state;
+}
+
+void ktls::free_state_callback(void * /* parent */, void *ptr, CRYPTO_EX_DATA * /* ad */,
+                               int /* idx */, long /* argl */, void * /* argp */)
+{
+    tx_state *state = static_cast<tx_state*>(ptr);
+    if (state != NULL) {
+        OPENSSL_cleanse(state->m_secret, sizeof(state->m_secret));
+        delete state;
+    }
+}
+
+void ktls::keylog_callback(const SSL *ssl, const char *line)
+{
+    // "SERVER_TRAFFIC_SECRET_0 <client random> <secret>", logged when the
+    // server starts sending with its application keys
+    static const char LABEL[] = "SERVER_TRAFFIC_SECRET_0 ";
+    if (strncmp(line, LABEL, sizeof(LABEL) - 1) != 0)
+        return;
+    const char *secret = strchr(line + sizeof(LABEL) - 1, ' ');
+    if (secret == NULL)
+        return;
+    ++secret;
+
+    tx_state *state = get_state(ssl, true);
+    std::size_t n = 0;
+    for (; n < sizeof(state->m_secret) && secret[2 * n] != '\0'; ++n) {
+        const int hi = from_hex(secret[2 * n]);
+        const int lo = (hi < 0 ? -1 : from_hex(secret[2 * n + 1]));
+        if (lo < 0) {
+            n = 0;
+            break;
+        }
+        state->m_secret[n] = static_cast<unsigned char>((hi << 4) | lo);
+    }
+    state->m_secret_len = n;
+    state->m_seq = 0;
+}
+
+void ktls::msg_callback(int write_p, int /* version */, int content_type,
+                        const void *buf, std::size_t len, SSL *ssl, void * /* arg */)
+{
+    if (! write_p || content_type != SSL3_RT_HEADER || len == 0)
+        return;
+    tx_state *state = get_state(ssl, true);
+    if (state->m_fd >= 0) {
+#ifdef PION_USE_KTLS
+        // the kernel would wrap the record in one of its own and its sequence
+        // numbers would no longer match the peer's: give up on the connection
+        ::shutdown(state->m_fd, SHUT_RDWR);
+#endif
+        return;
+    }
+    // in TLS 1.2, records sent after ChangeCipherSpec use new keys (in TLS
+    // 1.3 the compatibility ChangeCipherSpec is followed by a key log line)
+    if (static_cast<const unsigned char*>(buf)[0] == SSL3_RT_CHANGE_CIPHER_SPEC)
+        state->m_seq = 0;
+    else
+        ++state->m_seq;
+}
+
+
+}   // end namespace tcp
+}   // end namespace pion
+
+#endif  // PION_HAVE_SSL
@@ -0,0 +1,370 @@
+// ---------------------------------------------------------------------
+// pion:  a Boost C++ framework for building lightweight HTTP interfaces
+// ---------------------------------------------------------------------
+// Copyright (C) 2021 Wang Qiang  (https://github.com/dnybz/pion)
+// Copyright (C) 2007-2014 Splunk Inc.  (https://github.com/splunk/pion)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include <pion/tcp/listen_handoff.hpp>
+#include <asio/error.hpp>
+#include <asio/system_error.hpp>
+#include <cerrno>
+#include <cstring>
+#ifndef PION_WIN32
+    #include <fcntl.h>
+    #include <poll.h>
+    #include <unistd.h>
+    #include <sys/socket.h>
+    #include <sys/stat.h>
+    #include <sys/un.h>
+    #ifndef MSG_NOSIGNAL
+        #define MSG_NOSIGNAL 0
+    #endif
+#endif
+
+
+namespace {
+
+/// message that carries the listening sockets
+const char HANDOFF_MESSAGE = 'L';
+
+/// reply of a new process that accepts from the sockets
+const char CONFIRM_MESSAGE = 'C';
+
+/// throws the error of the last system call
+inline void throw_system_error(void)
+{
+    throw asio::system_error(asio::error_code(errno, asio::error::get_system_category()));
+}
+
+#ifndef PION_WIN32
+
+/**
+ * returns the address of a Unix domain socket
+ *
+ * @param path file system path of the socket
+ * @param addr receives the address
+ *
+ * @return socklen_t length of the address
+ */
+inline socklen_t get_local_address(const std::string& path, sockaddr_un& addr)
+{
+    if (path.empty() || path.size() >= sizeof(addr.sun_path))
+        throw asio::system_error(make_error_code(asio::error::invalid_argument));
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, path.data(), path.size());
+    return static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + path.size() + 1);
+}
+
+/// opens a Unix domain stream socket that is not inherited by child processes
+inline int open_local_socket(void)
+{
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        throw_system_error();
+    ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+    return fd;
+}
+
+/**
+ * connects to a Unix domain socket
+ *
+ * @param path file system path of the socket
+ *
+ * @return int the connected socket, or -1 if nothing listens at the path
+ */
+inline int connect_local_socket(const std::string& path)
+{
+    sockaddr_un addr;
+    const socklen_t addr_len = get_local_address(path, addr);
+    const int fd = open_local_socket();
+    if (::connect(fd, reinterpret_cast<const sockaddr*>(&addr), addr_len) != 0) {
+        const int error = errno;
+        ::close(fd);
+        if (error == ENOENT || error == ECONNREFUSED)
+            return -1;
+        errno = error;
+        throw_system_error();
+    }
+    return fd;
+}
+
+#endif
+
+}
+
+
+namespace pion {    // begin namespace pion
+namespace tcp {     // begin namespace tcp
+
+
+// listen_handoff member functions
+
+#ifndef PION_WIN32
+
+listen_handoff::listen_handoff(const std::string& path)
+    : m_path(path), m_listen_fd(-1), m_taken_fd(-1)
+{
+    if (::pipe(m_cancel_fds) != 0)
+        throw_system_error();
+    ::fcntl(m_cancel_fds[0], F_SETFD, FD_CLOEXEC);
+    ::fcntl(m_cancel_fds[1], F_SETFD, FD_CLOEXEC);
+    ::fcntl(m_cancel_fds[0], F_SETFL, O_NONBLOCK);
+}
+
+listen_handoff::~listen_handoff()
+{
+    close_listener();
+    if (m_taken_fd >= 0)
+        ::close(m_taken_fd);
+    ::close(m_cancel_fds[0]);
+    ::close(m_cancel_fds[1]);
+}
+
+bool listen_handoff::is_supported(void)
+{
+    return true;
+}
+
+bool listen_handoff::take(std::vector<int>& fds)
+{
+    fds.clear();
+    const int fd = connect_local_socket(m_path);
+    if (fd < 0)
+        return false;
+
+    // the sockets arrive as ancillary data of a one-byte message
+    char message = 0;
+    iovec data = { &message, sizeof(message) };
+    union {
+        cmsghdr     header;
+        char        space[CMSG_SPACE(sizeof(int) * MAX_FDS)];
+    } control;
+    msghdr msg;
+    std::memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &data;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.space;
+    msg.msg_controllen = sizeof(control.space);
+    ssize_t bytes_read;
+    do {
+        bytes_read = ::recvmsg(fd, &msg, 0);
+    } while (bytes_read < 0 && errno == EINTR);
+    if (bytes_read < 0) {
+        const int error = errno;
+        ::close(fd);
+        errno = error;
+        throw_system_error();
+    }
+    if (bytes_read == 0) {
+        // the process went away before offering its sockets
+        ::close(fd);
+        return false;
+    }
+    for (cmsghdr *header = CMSG_FIRSTHDR(&msg); header != NULL; header = CMSG_NXTHDR(&msg, header)) {
+        if (header->cmsg_level == SOL_SOCKET && header->cmsg_type == SCM_RIGHTS) {
+            const std::size_t num_fds = (header->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            for (std::size_t n = 0; n < num_fds; ++n) {
+                int received_fd;
+                std::memcpy(&received_fd, CMSG_DATA(header) + n * sizeof(int), sizeof(int));
+                ::fcntl(received_fd, F_SETFD, FD_CLOEXEC);
+                fds.push_back(received_fd);
+            }
+        }
+    }
+    if (bytes_read != sizeof(message) || message != HANDOFF_MESSAGE
+        || (msg.msg_flags & MSG_CTRUNC) != 0 || fds.empty())
+    {
+        for (std::size_t n = 0; n < fds.size(); ++n)
+            ::close(fds[n]);
+        fds.clear();
+        ::close(fd);
+        throw asio::system_error(make_error_code(asio::error::invalid_argument));
+    }
+
+    // the running process keeps accepting until confirm() is called
+    if (m_taken_fd >= 0)
+        ::close(m_taken_fd);
+    m_taken_fd = fd;
+    return true;
+}
+
+void listen_handoff::confirm(void)
+{
+    if (m_taken_fd < 0)
+        return;
+    ssize_t bytes_written;
+    do {
+        bytes_written = ::send(m_taken_fd, &CONFIRM_MESSAGE, sizeof(CONFIRM_MESSAGE), MSG_NOSIGNAL);
+    } while (bytes_written < 0 && errno == EINTR);
+    ::close(m_taken_fd);
+    m_taken_fd = -1;
+}
+
+bool listen_handoff::offer(const std::vector<int>& fds)
+{
+    if (fds.empty() || fds.size() > MAX_FDS)
+        throw asio::system_error(make_error_code(asio::error::invalid_argument));
+    open_listener();
+    while (wait_readable(m_listen_fd)) {
+        const int fd = ::accept(m_listen_fd, NULL, NULL);
+        if (fd < 0)
+            continue;
+        ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+        // the new process listens on the path once it has confirmed, so the
+        // file is removed before the sockets are sent
+        close_listener();
+
+        char message = HANDOFF_MESSAGE;
+        iovec data = { &message, sizeof(message) };
+        union {
+            cmsghdr     header;
+            char        space[CMSG_SPACE(sizeof(int) * MAX_FDS)];
+        } control;
+        std::memset(&control, 0, sizeof(control));
+        msghdr msg;
+        std::memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &data;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control.space;
+        msg.msg_controllen = CMSG_SPACE(sizeof(int) * fds.size());
+        cmsghdr *header = CMSG_FIRSTHDR(&msg);
+        header->cmsg_level = SOL_SOCKET;
+        header->cmsg_type = SCM_RIGHTS;
+        header->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+        std::memcpy(CMSG_DATA(header), &fds[0], sizeof(int) * fds.size());
+        ssize_t bytes_written;
+        do {
+            bytes_written = ::sendmsg(fd, &msg, MSG_NOSIGNAL);
+        } while (bytes_written < 0 && errno == EINTR);
+
+        // wait until the new process accepts from the sockets, or goes away
+        char reply = 0;
+        ssize_t bytes_read = -1;
+        if (bytes_written == sizeof(message) && wait_readable(fd)) {
+            do {
+                bytes_read = ::recv(fd, &reply, sizeof(reply), 0);
+            } while (bytes_read < 0 && errno == EINTR);
+        }
+        ::close(fd);
+        if (bytes_read == sizeof(reply) && reply == CONFIRM_MESSAGE)
+            return true;
+
+        // offer the sockets again (unless cancel() was called)
+        char cancelled;
+        if (::read(m_cancel_fds[0], &cancelled, sizeof(cancelled)) == sizeof(cancelled))
+            return false;
+        open_listener();
+    }
+    close_listener();
+    return false;
+}
+
+void listen_handoff::cancel(void)
+{
+    const char message = 0;
+    if (::write(m_cancel_fds[1], &message, sizeof(message)) < 0) {}
+}
+
+void listen_handoff::open_listener(void)
+{
+    sockaddr_un addr;
+    const socklen_t addr_len = get_local_address(m_path, addr);
+
+    // replace a socket file left behind by a process that did not stop
+    // cleanly, but not one that a running process still offers sockets at
+    struct stat file_info;
+    if (::stat(m_path.c_str(), &file_info) == 0 && S_ISSOCK(file_info.st_mode)) {
+        const int fd = connect_local_socket(m_path);
+        if (fd >= 0) {
+            ::close(fd);
+            throw asio::system_error(make_error_code(asio::error::address_in_use));
+        }
+        ::unlink(m_path.c_str());
+    }
+
+    m_listen_fd = open_local_socket();
+    if (::bind(m_listen_fd, reinterpret_cast<const sockaddr*>(&addr), addr_len) != 0
+        || ::chmod(m_path.c_str(), S_IRUSR | S_IWUSR) != 0
+        || ::listen(m_listen_fd, 1) != 0)
+    {
+        const int error = errno;
+        close_listener();
+        errno = error;
+        throw_system_error();
+    }
+}
+
+void listen_handoff::close_listener(void)
+{
+    if (m_listen_fd >= 0) {
+        ::close(m_listen_fd);
+        ::unlink(m_path.c_str());
+        m_listen_fd = -1;
+    }
+}
+
+bool listen_handoff::wait_readable(int fd)
+{
+    pollfd fds[2];
+    fds[0].fd = fd;
+    fds[0].events = POLLIN;
+    fds[1].fd = m_cancel_fds[0];
+    fds[1].events = POLLIN;
+    for (;;) {
+        fds[0].revents = fds[1].revents = 0;
+        if (::poll(fds, 2, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            throw_system_error();
+        }
+        if (fds[1].revents != 0)
+            return false;
+        if (fds[0].revents != 0)
+            return true;
+    }
+}
+
+#else   // PION_WIN32
+
+listen_handoff::listen_handoff(const std::string& path)
+    : m_path(path), m_listen_fd(-1), m_taken_fd(-1)
+{
+    m_cancel_fds[0] = m_cancel_fds[1] = -1;
+}
+
+listen_handoff::~listen_handoff() {}
+
+bool listen_handoff::is_supported(void) { return false; }
+
+bool listen_handoff::take(std::vector<int>& fds)
+{
+    fds.clear();
+    return false;
+}
+
+void listen_handoff::confirm(void) {}
+
+bool listen_handoff::offer(const std::vector<int>& /* fds */)
+{
+    throw asio::system_error(make_error_code(asio::error::operation_not_supported));
+}
+
+void listen_handoff::cancel(void) {}
+
+void listen_handoff::open_listener(void) {}
+
+void listen_handoff::close_listener(void) {}
+
+bool listen_handoff::wait_readable(int /* fd */) { return false; }
+
+#endif  // PION_WIN32
+
+
+}   // end namespace tcp
+}   // end namespace pion
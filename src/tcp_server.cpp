@@ -10,65 +10,187 @@
 
 #include <pion/admin_rights.hpp>
 #include <pion/tcp/server.hpp>
+#include <pion/tcp/uring_service.hpp>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifndef PION_WIN32
+    #include <sys/socket.h>
+    #include <sys/un.h>
+#endif
+
+
+namespace {
+
+#if defined(SO_REUSEPORT) && !defined(PION_WIN32)
+/// socket option used to share a listening port between multiple sockets
+typedef asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>    reuse_port_option;
+#define PION_HAVE_REUSEPORT 1
+#endif
+
+/// returns the number of milliseconds on the steady clock
+inline uint64_t get_steady_milliseconds(void)
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/// lower 32 bits of server::m_accept_window, which count the connections
+/// accepted in the second kept in its upper 32 bits
+const uint64_t ACCEPT_COUNT_MASK = 0xFFFFFFFF;
+
+/// returns the current second of the steady clock, as kept in server::m_accept_window
+inline uint64_t get_accept_second(void)
+{
+    return (get_steady_milliseconds() / 1000) % (uint64_t(1) << 32);
+}
+
+/// returns the number of microseconds on the steady clock
+inline uint64_t get_steady_microseconds(void)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}
 
 
 namespace pion {    // begin namespace pion
 namespace tcp {     // begin namespace tcp
 
+
+// static members of tcp::server
+
+const uint32_t   server::PRUNE_TIMER_SECONDS = 1;
+const std::size_t   server::DEFAULT_CONNECTION_POOL_SIZE = 32;
+
+
+///
+/// server::handshake_handler: completion handler for SSL handshakes.  asio
+/// runs each step of a handshake (processing what the peer sent, and
+/// producing what is sent back) through the handler's invocation hook, which
+/// moves the step to the handshake pool; the socket I/O in between still
+/// completes on the connection's I/O service
+///
+class server::handshake_handler {
+public:
+
+    /**
+     * constructs a handler for a connection's handshake
+     *
+     * @param s the server that accepted the connection
+     * @param tcp_conn the connection that is doing the handshake
+     * @param offload true to run the handshake's steps on the handshake pool
+     */
+    handshake_handler(server& s, const tcp::connection_ptr& tcp_conn, bool offload)
+        : m_server(s), m_conn(tcp_conn), m_timing_ptr(std::make_shared<timing_type>(offload))
+    {}
+
+    /// called when the handshake has finished (on the handshake pool if it is
+    /// used, in which case the connection goes back to its I/O service)
+    void operator()(const asio::error_code& ec) {
+        m_server.record_handshake(m_timing_ptr->m_offload, m_timing_ptr->m_queue_usec,
+                                  get_steady_microseconds() - m_timing_ptr->m_started);
+        if (m_timing_ptr->m_offload)
+            m_conn->get_io_service().post(std::bind(&server::handle_ssl_handshake,
+                                                    &m_server, m_conn, ec));
+        else
+            m_server.handle_ssl_handshake(m_conn, ec);
+    }
+
+    /// asio hook used to run the steps of the handshake
+    template <typename Function>
+    friend inline void asio_handler_invoke(Function& function, handshake_handler *this_handler) {
+        this_handler->run_step(function);
+    }
+
+    /// asio hook used to run the steps of the handshake
+    template <typename Function>
+    friend inline void asio_handler_invoke(const Function& function, handshake_handler *this_handler) {
+        this_handler->run_step(function);
+    }
+
+
+private:
+
+    /// timing of the handshake (shared by the copies of the handler)
+    struct timing_type {
+        explicit timing_type(bool offload)
+            : m_offload(offload), m_started(get_steady_microseconds()), m_queue_usec(0) {}
+        /// true if the handshake's steps run on the handshake pool
+        const bool      m_offload;
+        /// steady clock microsecond at which the handshake started
+        const uint64_t  m_started;
+        /// microseconds that the handshake's steps waited for the handshake pool
+        uint64_t        m_queue_usec;
+    };
+
+    /// runs a step of the handshake (the steps never run concurrently)
+    template <typename Function>
+    void run_step(const Function& function) {
+        if (! m_timing_ptr->m_offload) {
+            Function step(function);
+            step();
+            return;
+        }
+        std::shared_ptr<timing_type> timing_ptr(m_timing_ptr);
+        const uint64_t queued = get_steady_microseconds();
+        Function step(function);
+        m_server.offload_handshake_step(m_conn, [timing_ptr, queued, step]() mutable {
+            timing_ptr->m_queue_usec += get_steady_microseconds() - queued;
+            step();
+        });
+    }
+
+
+    /// the server that accepted the connection
+    server &                        m_server;
+
+    /// the connection that is doing the handshake
+    tcp::connection_ptr             m_conn;
+
+    /// timing of the handshake
+    std::shared_ptr<timing_type>    m_timing_ptr;
+};
+
     
 // tcp::server member functions
 
 server::server(scheduler& sched, const unsigned int tcp_port)
-    : m_logger(PION_GET_LOGGER("pion.tcp.server")),
-    m_active_scheduler(sched),
-    m_tcp_acceptor(m_active_scheduler.get_io_service()),
-#ifdef PION_HAVE_SSL
-#if ASIO_VERSION >= 101009
-	m_ssl_context(asio::ssl::context::tls),
-#else
-	m_ssl_context(asio::ssl::context::sslv23),
-#endif
-#else
-    m_ssl_context(0),
-#endif
-    m_endpoint(asio::ip::tcp::v4(), tcp_port), m_ssl_flag(false), m_is_listening(false)
+    : server(&sched, asio::ip::tcp::endpoint(asio::ip::tcp::v4(), tcp_port), std::string())
 {}
     
 server::server(scheduler& sched, const asio::ip::tcp::endpoint& endpoint)
-    : m_logger(PION_GET_LOGGER("pion.tcp.server")),
-    m_active_scheduler(sched),
-    m_tcp_acceptor(m_active_scheduler.get_io_service()),
-#ifdef PION_HAVE_SSL
-#if ASIO_VERSION >= 101009
-	m_ssl_context(asio::ssl::context::tls),
-#else
-	m_ssl_context(asio::ssl::context::sslv23),
-#endif
-#else
-    m_ssl_context(0),
-#endif
-    m_endpoint(endpoint), m_ssl_flag(false), m_is_listening(false)
+    : server(&sched, endpoint, std::string())
 {}
 
-server::server(const unsigned int tcp_port)
-    : m_logger(PION_GET_LOGGER("pion.tcp.server")),
-    m_default_scheduler(), m_active_scheduler(m_default_scheduler),
-    m_tcp_acceptor(m_active_scheduler.get_io_service()),
-#ifdef PION_HAVE_SSL
-#if ASIO_VERSION >= 101009
-	m_ssl_context(asio::ssl::context::tls),
-#else
-	m_ssl_context(asio::ssl::context::sslv23),
-#endif
-#else
-    m_ssl_context(0),
+#ifdef ASIO_HAS_LOCAL_SOCKETS
+server::server(scheduler& sched, const asio::local::stream_protocol::endpoint& endpoint)
+    : server(&sched, asio::ip::tcp::endpoint(asio::ip::tcp::v4(), 0), endpoint.path())
+{}
 #endif
-    m_endpoint(asio::ip::tcp::v4(), tcp_port), m_ssl_flag(false), m_is_listening(false)
+
+server::server(const unsigned int tcp_port)
+    : server(NULL, asio::ip::tcp::endpoint(asio::ip::tcp::v4(), tcp_port), std::string())
 {}
 
 server::server(const asio::ip::tcp::endpoint& endpoint)
+    : server(NULL, endpoint, std::string())
+{}
+    
+#ifdef ASIO_HAS_LOCAL_SOCKETS
+server::server(const asio::local::stream_protocol::endpoint& endpoint)
+    : server(NULL, asio::ip::tcp::endpoint(asio::ip::tcp::v4(), 0), endpoint.path())
+{}
+#endif
+
+server::server(scheduler *sched_ptr, const asio::ip::tcp::endpoint& endpoint,
+               const std::string& local_path)
     : m_logger(PION_GET_LOGGER("pion.tcp.server")),
-    m_default_scheduler(), m_active_scheduler(m_default_scheduler),
+    m_default_scheduler(), m_active_scheduler(sched_ptr ? *sched_ptr : m_default_scheduler),
     m_tcp_acceptor(m_active_scheduler.get_io_service()),
 #ifdef PION_HAVE_SSL
 #if ASIO_VERSION >= 101009
@@ -79,7 +201,17 @@ server::server(const asio::ip::tcp::endpoint& endpoint)
 #else
     m_ssl_context(0),
 #endif
-    m_endpoint(endpoint), m_ssl_flag(false), m_is_listening(false)
+    m_num_connections(0), m_prune_timer(m_active_scheduler.get_io_service()),
+    m_resume_timer(m_active_scheduler.get_io_service()), m_resume_timer_armed(false),
+    m_connection_pool_size(DEFAULT_CONNECTION_POOL_SIZE),
+    m_endpoint(endpoint), m_local_path(local_path), m_ssl_flag(false), m_ktls_flag(false),
+    m_keep_local_socket(false), m_multi_acceptor(false), m_io_engine(m_active_scheduler.get_io_engine()),
+    m_max_connections(0), m_max_requests(0), m_max_accept_rate(0),
+    m_overload_policy(OVERLOAD_PAUSE), m_requests_in_flight(0), m_accept_window(0),
+    m_num_paused_listeners(0), m_num_rejected_connections(0),
+    m_num_rejected_requests(0), m_num_accept_pauses(0), m_num_header_timeouts(0),
+    m_num_body_rate_timeouts(0), m_num_send_stalls(0), m_handshake_threads(0),
+    m_is_listening(false)
 {}
     
 void server::start(void)
@@ -88,7 +220,7 @@ void server::start(void)
     std::unique_lock<std::mutex> server_lock(m_mutex);
 
     if (! m_is_listening) {
-        PION_LOG_INFO(m_logger, "Starting server on port " << get_port());
+        PION_LOG_INFO(m_logger, "Starting server on " << get_listen_name());
         
         before_starting();
 
@@ -96,28 +228,62 @@ void server::start(void)
         try {
             // get admin permissions in case we're binding to a privileged port
             pion::admin_rights use_admin_rights(get_port() > 0 && get_port() < 1024);
-            m_tcp_acceptor.open(m_endpoint.protocol());
-            // allow the acceptor to reuse the address (i.e. SO_REUSEADDR)
-            // ...except when running not on Windows - see http://msdn.microsoft.com/en-us/library/ms740621%28VS.85%29.aspx
-#ifndef PION_WIN32
-            m_tcp_acceptor.set_option(asio::ip::tcp::acceptor::reuse_address(true));
-#endif
-            m_tcp_acceptor.bind(m_endpoint);
-            if (m_endpoint.port() == 0) {
-                // update the endpoint to reflect the port chosen by bind
-                m_endpoint = m_tcp_acceptor.local_endpoint();
-            }
-            m_tcp_acceptor.listen();
+            open_listeners(m_multi_acceptor);
         } catch (std::exception& e) {
-            PION_LOG_ERROR(m_logger, "Unable to bind to port " << get_port() << ": " << e.what());
+            PION_LOG_ERROR(m_logger, "Unable to bind to " << get_listen_name() << ": " << e.what());
+            for (listener_pool_type::iterator i = m_listeners.begin(); i != m_listeners.end(); ++i) {
+                asio::error_code ec;
+                (*i)->m_acceptor.close(ec);
+            }
+            m_listeners.clear();
             throw;
         }
 
+        // accept connections with io_uring if it is selected and supported
+        if (m_io_engine == scheduler::IO_ENGINE_URING) {
+#ifdef PION_HAVE_IO_URING
+            for (listener_pool_type::iterator i = m_listeners.begin(); i != m_listeners.end(); ++i) {
+                uring_service& uring = asio::use_service<uring_service>((*i)->m_acceptor.get_io_service());
+                if (uring.is_available())
+                    (*i)->m_uring_ptr = &uring;
+            }
+            if (m_listeners.front()->m_uring_ptr == NULL)
+#endif
+                PION_LOG_WARN(m_logger, "io_uring is not available; using the reactor on " << get_listen_name());
+        }
+
+#ifdef PION_HAVE_SSL
+        // returning clients can resume their sessions on any thread
+        if (m_ssl_flag)
+            m_ssl_session_cache.attach(m_ssl_context.native_handle());
+
+        // the CPU-heavy steps of handshakes run on their own threads
+        if (m_ssl_flag && m_handshake_threads > 0)
+            m_handshake_pool.set_num_threads(m_handshake_threads);
+
+        // connections track their record sequence numbers for kernel TLS
+        if (m_ssl_flag && m_ktls_flag) {
+            if (ktls::is_supported())
+                m_ktls.attach(m_ssl_context.native_handle());
+            else
+                PION_LOG_WARN(m_logger, "Kernel TLS is not supported; using OpenSSL on " << get_listen_name());
+        }
+#endif
+
+        // allocate connection objects up front so that accepting can reuse them
+        open_connection_pools();
+        m_num_paused_listeners = 0;
+
         m_is_listening = true;
 
-        // unlock the mutex since listen() requires its own lock
+        // orphaned connections are pruned periodically instead of on every accept
+        schedule_prune_timer();
+
+        // start accepting connections on every listening socket
+        listener_pool_type listeners(m_listeners);
         server_lock.unlock();
-        listen();
+        for (listener_pool_type::iterator i = listeners.begin(); i != listeners.end(); ++i)
+            listen(*i);
         
         // notify the thread scheduler that we need it now
         m_active_scheduler.add_active_user();
@@ -130,21 +296,36 @@ void server::stop(bool wait_until_finished)
     std::unique_lock<std::mutex> server_lock(m_mutex);
 
     if (m_is_listening) {
-        PION_LOG_INFO(m_logger, "Shutting down server on port " << get_port());
+        PION_LOG_INFO(m_logger, "Shutting down server on " << get_listen_name());
     
         m_is_listening = false;
 
         // this terminates any connections waiting to be accepted
-        m_tcp_acceptor.close();
+        for (listener_pool_type::iterator i = m_listeners.begin(); i != m_listeners.end(); ++i) {
+            std::unique_lock<std::mutex> listener_lock((*i)->m_mutex);
+#ifdef PION_HAVE_IO_URING
+            // io_uring holds its own reference to the socket, so closing it
+            // does not stop accepting
+            if ((*i)->m_uring_ptr != NULL)
+                (*i)->m_uring_ptr->cancel((*i)->m_acceptor.native_handle());
+#endif
+            asio::error_code ec;
+            (*i)->m_acceptor.close(ec);
+        }
+        remove_local_socket();
+        m_prune_timer.cancel();
+        m_resume_timer.cancel();
+
+        // connections that finish from now on are deleted instead of recycled
+        close_connection_pools();
         
         if (! wait_until_finished) {
             // this terminates any other open connections
-            std::for_each(m_conn_pool.begin(), m_conn_pool.end(),
-                          std::bind(&connection::close, std::placeholders::_1));
+            close_connections();
         }
     
         // wait for all pending connections to complete
-        while (! m_conn_pool.empty()) {
+        while (m_num_connections > 0) {
             // try to prun connections that didn't finish cleanly
             if (prune_connections() == 0)
                 break;  // if no more left, then we can stop waiting
@@ -153,6 +334,9 @@ void server::stop(bool wait_until_finished)
             scheduler::sleep(m_no_more_connections, server_lock, 0, 250000000);
         }
         
+        // the connections are gone, so no more handshake steps are coming
+        m_handshake_pool.stop();
+
         // notify the thread scheduler that we no longer need it
         m_active_scheduler.remove_active_user();
         
@@ -184,63 +368,531 @@ void server::set_ssl_key_file(const std::string& pem_key_file)
 #endif
 }
 
-void server::listen(void)
+void server::open_listeners(bool reuse_port)
+{
+    // assumes that a server lock has already been acquired
+    m_listeners.clear();
+    if (! m_adopted_fds.empty()) {
+        adopt_listeners();
+        return;
+    }
+    if (is_local()) {
+        // a Unix domain socket path cannot be shared by several listening sockets
+        if (reuse_port) {
+            PION_LOG_WARN(m_logger, "Multiple acceptors are not supported for Unix domain sockets; using a single acceptor");
+        }
+        open_local_acceptor(m_tcp_acceptor);
+        m_listeners.push_back(listener_ptr(new listener_type(m_tcp_acceptor)));
+        return;
+    }
+#ifdef PION_HAVE_REUSEPORT
+    const uint32_t num_services = m_active_scheduler.get_num_services();
+    if (reuse_port && num_services > 1) {
+        // the primary acceptor serves whichever I/O service it was created with
+        open_acceptor(m_tcp_acceptor, true);
+        asio::io_service& primary_service = m_tcp_acceptor.get_io_service();
+        m_listeners.push_back(listener_ptr(new listener_type(m_tcp_acceptor)));
+        m_listeners.back()->m_service = &primary_service;
+        // add one acceptor for each of the other I/O services
+        for (uint32_t n = 0; n < num_services; ++n) {
+            asio::io_service& service = m_active_scheduler.get_io_service(n);
+            if (&service == &primary_service)
+                continue;
+            m_listeners.push_back(listener_ptr(new listener_type(service)));
+            open_acceptor(m_listeners.back()->m_acceptor, true);
+        }
+        PION_LOG_INFO(m_logger, "Using " << m_listeners.size()
+                      << " SO_REUSEPORT acceptors on " << get_listen_name());
+        return;
+    }
+#else
+    if (reuse_port) {
+        PION_LOG_WARN(m_logger, "SO_REUSEPORT is not supported; using a single acceptor");
+    }
+#endif
+    open_acceptor(m_tcp_acceptor, false);
+    m_listeners.push_back(listener_ptr(new listener_type(m_tcp_acceptor)));
+}
+
+void server::adopt_listeners(void)
+{
+    // assumes that a server lock has already been acquired
+    std::vector<int> fds;
+    fds.swap(m_adopted_fds);
+    const uint32_t num_services = m_active_scheduler.get_num_services();
+    for (std::size_t n = 0; n < fds.size(); ++n) {
+        try {
+            if (n == 0) {
+                adopt_acceptor(m_tcp_acceptor, fds[n]);
+                m_listeners.push_back(listener_ptr(new listener_type(m_tcp_acceptor)));
+                if (fds.size() > 1)
+                    m_listeners.back()->m_service = &m_tcp_acceptor.get_io_service();
+            } else {
+                listener_ptr listener(new listener_type(m_active_scheduler.get_io_service(n % num_services)));
+                adopt_acceptor(listener->m_acceptor, fds[n]);
+                m_listeners.push_back(listener);
+            }
+        } catch (...) {
+            // the server owns the sockets that it did not get to
+            for (std::size_t m = n + 1; m < fds.size(); ++m)
+                ::close(fds[m]);
+            throw;
+        }
+    }
+    PION_LOG_INFO(m_logger, "Adopted " << fds.size() << " listening socket"
+                  << (fds.size() == 1 ? "" : "s") << " on " << get_listen_name());
+}
+
+void server::adopt_acceptor(asio::ip::tcp::acceptor& acceptor, int fd)
+{
+#ifndef PION_WIN32
+    // only listening stream sockets with an address can be adopted
+    sockaddr_storage addr;
+    socklen_t addr_len = sizeof(addr);
+    int listening = 0;
+    socklen_t listening_len = sizeof(listening);
+    asio::error_code ec;
+    if (::getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &addr_len) != 0
+        || ::getsockopt(fd, SOL_SOCKET, SO_ACCEPTCONN, &listening, &listening_len) != 0)
+    {
+        ec = asio::error_code(errno, asio::error::get_system_category());
+    } else if (listening == 0
+               || (addr.ss_family != AF_INET && addr.ss_family != AF_INET6 && addr.ss_family != AF_UNIX)
+               || (addr.ss_family == AF_UNIX && addr_len <= offsetof(sockaddr_un, sun_path)))
+    {
+        ec = make_error_code(asio::error::invalid_argument);
+    } else {
+        // sockets passed by a service manager may be inherited by child processes
+        ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+        acceptor.assign(addr.ss_family == AF_INET6 ? asio::ip::tcp::v6() : asio::ip::tcp::v4(), fd, ec);
+    }
+    if (ec) {
+        ::close(fd);
+        throw asio::system_error(ec);
+    }
+
+    if (addr.ss_family == AF_UNIX) {
+        // handled like the sockets of open_local_acceptor(); the socket file
+        // belongs to whoever created the socket
+        const sockaddr_un& local_addr = reinterpret_cast<const sockaddr_un&>(addr);
+        const std::size_t path_len = addr_len - offsetof(sockaddr_un, sun_path);
+        if (local_addr.sun_path[0] == '\0')
+            m_local_path.assign(local_addr.sun_path, path_len);
+        else
+            m_local_path.assign(local_addr.sun_path, ::strnlen(local_addr.sun_path, path_len));
+        m_keep_local_socket = true;
+    } else {
+        m_local_path.clear();
+        m_endpoint = acceptor.local_endpoint();
+        m_socket_options.apply(acceptor);
+    }
+#else
+    (void)acceptor;
+    (void)fd;
+    throw asio::system_error(make_error_code(asio::error::operation_not_supported));
+#endif
+}
+
+std::vector<int> server::get_listen_fds(void) const
 {
-    // lock mutex for thread safety
     std::unique_lock<std::mutex> server_lock(m_mutex);
-    
-    if (m_is_listening) {
-        // create a new TCP connection object
-        tcp::connection_ptr new_connection(connection::create(get_io_service(),
-                                                              m_ssl_context, m_ssl_flag,
-                                                              std::bind(&server::finish_connection,
-                                                                          this, std::placeholders::_1)));
-        
-        // prune connections that finished uncleanly
-        prune_connections();
+    std::vector<int> fds;
+    for (listener_pool_type::const_iterator i = m_listeners.begin(); i != m_listeners.end(); ++i) {
+        if ((*i)->m_acceptor.is_open())
+            fds.push_back(static_cast<int>((*i)->m_acceptor.native_handle()));
+    }
+    return fds;
+}
 
-        // keep track of the object in the server's connection pool
-        m_conn_pool.insert(new_connection);
+void server::open_acceptor(asio::ip::tcp::acceptor& acceptor, bool reuse_port)
+{
+    acceptor.open(m_endpoint.protocol());
+    m_socket_options.apply(acceptor);
+#ifdef PION_HAVE_REUSEPORT
+    if (reuse_port)
+        acceptor.set_option(reuse_port_option(true));
+#else
+    (void)reuse_port;
+#endif
+    acceptor.bind(m_endpoint);
+    if (m_endpoint.port() == 0) {
+        // update the endpoint to reflect the port chosen by bind
+        // (any other acceptors will then share the same port)
+        m_endpoint = acceptor.local_endpoint();
+    }
+    acceptor.listen(m_socket_options.get_backlog());
+}
+
+void server::open_local_acceptor(asio::ip::tcp::acceptor& acceptor)
+{
+#ifdef ASIO_HAS_LOCAL_SOCKETS
+    const asio::local::stream_protocol::endpoint local_endpoint(m_local_path);
+    if (m_local_path[0] != '\0') {
+        // replace a socket file left behind by a server that did not stop
+        // cleanly, but not one that a running server still listens on
+        struct stat file_info;
+        if (::stat(m_local_path.c_str(), &file_info) == 0 && S_ISSOCK(file_info.st_mode)) {
+            asio::local::stream_protocol::socket probe(acceptor.get_io_service());
+            asio::error_code ec;
+            probe.connect(local_endpoint, ec);
+            if (ec == asio::error::connection_refused)
+                ::unlink(m_local_path.c_str());
+        }
+    }
+
+    asio::local::stream_protocol::acceptor local_acceptor(acceptor.get_io_service());
+    local_acceptor.open(local_endpoint.protocol());
+    local_acceptor.bind(local_endpoint);
+    local_acceptor.listen(m_socket_options.get_backlog());
+
+    // the tcp acceptor adopts a duplicate of the listening socket, labelled
+    // tcp::v4() since asio::ip::tcp cannot describe AF_UNIX.  asio only uses
+    // the label to open sockets, which the server never does for it; what
+    // would misread the socket is guarded instead: the server never asks the
+    // acceptor for its endpoint or applies tcp options to it, and accepted
+    // connections get the local flag, so that they skip the tcp options and
+    // kernel TLS and report no remote endpoint
+    const int fd = ::fcntl(local_acceptor.native_handle(), F_DUPFD_CLOEXEC, 0);
+    if (fd < 0)
+        throw asio::system_error(asio::error_code(errno, asio::error::get_system_category()));
+    asio::error_code ec;
+    acceptor.assign(asio::ip::tcp::v4(), fd, ec);
+    if (ec) {
+        ::close(fd);
+        throw asio::system_error(ec);
+    }
+#else
+    (void)acceptor;
+    throw asio::system_error(make_error_code(asio::error::operation_not_supported));
+#endif
+}
+
+void server::remove_local_socket(void)
+{
+    // abstract sockets (which start with a null character) have no file
+    if (is_local() && m_local_path[0] != '\0' && ! m_keep_local_socket)
+        ::unlink(m_local_path.c_str());
+}
+
+std::string server::get_listen_name(void) const
+{
+    if (is_local())
+        return "socket " + (m_local_path[0] != '\0' ? m_local_path : '@' + m_local_path.substr(1));
+    return "port " + std::to_string(get_port());
+}
+
+void server::open_connection_pools(void)
+{
+    // assumes that a server lock has already been acquired
+    close_connection_pools();
+    if (m_connection_pool_size == 0)
+        return;
+    const uint32_t num_services = m_active_scheduler.get_num_services();
+    for (uint32_t n = 0; n < num_services; ++n) {
+        connection_pool_ptr pool_ptr(new connection_pool(m_active_scheduler.get_io_service(n),
+                                                         m_ssl_context, m_ssl_flag,
+                                                         std::bind(&server::finish_connection,
+                                                                   this, std::placeholders::_1),
+                                                         m_connection_pool_size, m_io_engine));
+        pool_ptr->reserve(m_connection_pool_size);
+        m_free_connections.push_back(pool_ptr);
+    }
+}
+
+void server::close_connection_pools(void)
+{
+    // assumes that a server lock has already been acquired
+    for (std::vector<connection_pool_ptr>::iterator i = m_free_connections.begin();
+         i != m_free_connections.end(); ++i)
+    {
+        (*i)->close();
+    }
+    m_free_connections.clear();
+}
+
+tcp::connection_ptr server::create_connection(asio::io_service& service)
+{
+    tcp::connection_ptr tcp_conn;
+    for (std::vector<connection_pool_ptr>::iterator i = m_free_connections.begin();
+         i != m_free_connections.end(); ++i)
+    {
+        if (&(*i)->get_io_service() == &service) {
+            tcp_conn = (*i)->create();
+            break;
+        }
+    }
+    if (! tcp_conn) {
+        tcp_conn = connection::create(service, m_ssl_context, m_ssl_flag,
+                                      std::bind(&server::finish_connection,
+                                                this, std::placeholders::_1),
+                                      m_io_engine);
+    }
+    tcp_conn->set_local_flag(is_local());
+    return tcp_conn;
+}
+
+void server::listen(const listener_ptr& listener)
+{
+    // lock mutex for thread safety
+    std::unique_lock<std::mutex> listener_lock(listener->m_mutex);
+    
+    if (m_is_listening && ! listener->m_paused) {
+#ifdef PION_HAVE_IO_URING
+        if (listener->m_uring_ptr != NULL) {
+            // one multishot accept keeps accepting connections until it fails
+            listener->m_uring_ptr->async_accept(listener->m_acceptor.native_handle(),
+                                                std::bind(&server::handle_uring_accept,
+                                                          this, listener, std::placeholders::_1,
+                                                          std::placeholders::_2, std::placeholders::_3));
+            return;
+        }
+#endif
+        // create a new TCP connection object (in multi-acceptor mode, it is
+        // handled by the same I/O service that accepts it)
+        asio::io_service& service = (listener->m_service ? *listener->m_service : get_io_service());
+        tcp::connection_ptr new_connection(create_connection(service));
         
         // use the object to accept a new connection
-        new_connection->async_accept(m_tcp_acceptor,
+        new_connection->async_accept(listener->m_acceptor,
                                      std::bind(&server::handle_accept,
-                                                 this, new_connection,
+                                                 this, listener, new_connection,
                                                  std::placeholders::_1));
     }
 }
 
-void server::handle_accept(const tcp::connection_ptr& tcp_conn,
-                             const asio::error_code& accept_error)
+void server::handle_accept(const listener_ptr& listener,
+                           const tcp::connection_ptr& tcp_conn,
+                           const asio::error_code& accept_error)
 {
     if (accept_error) {
         // an error occured while trying to a accept a new connection
         // this happens when the server is being shut down
         if (m_is_listening) {
-            listen();   // schedule acceptance of another connection
-            PION_LOG_WARN(m_logger, "Accept error on port " << get_port() << ": " << accept_error.message());
+            listen(listener);   // schedule acceptance of another connection
+            PION_LOG_WARN(m_logger, "Accept error on " << get_listen_name() << ": " << accept_error.message());
         }
         finish_connection(tcp_conn);
     } else {
         // got a new TCP connection
         PION_LOG_DEBUG(m_logger, "New" << (tcp_conn->get_ssl_flag() ? " SSL " : " ")
-                       << "connection on port " << get_port());
+                       << "connection on " << get_listen_name());
+        apply_socket_options(tcp_conn);
+
+        // keep track of the object in the server's connection pool
+        add_connection(tcp_conn);
+        const bool admitted = admit_connection();
 
         // schedule the acceptance of another new connection
         // (this returns immediately since it schedules it as an event)
-        if (m_is_listening) listen();
+        if (m_is_listening) {
+            if (m_overload_policy == OVERLOAD_PAUSE && limits_reached())
+                pause_listener(listener);
+            else
+                listen(listener);
+        }
         
         // handle the new connection
-#ifdef PION_HAVE_SSL
-        if (tcp_conn->get_ssl_flag()) {
-            tcp_conn->async_handshake_server(std::bind(&server::handle_ssl_handshake,
-                                                         this, tcp_conn,
-                                                         std::placeholders::_1));
-        } else
+        if (admitted)
+            start_connection(tcp_conn);
+        else
+            reject_connection(tcp_conn);
+    }
+}
+
+void server::handle_uring_accept(const listener_ptr& listener,
+                                 const asio::error_code& accept_error,
+                                 int fd, bool more)
+{
+    if (accept_error) {
+        if (accept_error == asio::error::operation_aborted || ! m_is_listening)
+            return;     // the server is being shut down
+        if (accept_error == asio::error::invalid_argument) {
+            // the listening socket does not support multishot accepts
+            PION_LOG_WARN(m_logger, "io_uring cannot accept on " << get_listen_name()
+                          << "; using the reactor");
+            std::unique_lock<std::mutex> listener_lock(listener->m_mutex);
+            listener->m_uring_ptr = NULL;
+        } else {
+            PION_LOG_WARN(m_logger, "Accept error on " << get_listen_name() << ": " << accept_error.message());
+        }
+        if (! more)
+            listen(listener);   // schedule acceptance of another connection
+        return;
+    }
+
+    if (! m_is_listening) {
+        ::close(fd);
+    } else {
+        // adopt the new socket (in multi-acceptor mode, it is handled by the
+        // same I/O service that accepts it)
+        asio::io_service& service = (listener->m_service ? *listener->m_service : get_io_service());
+        tcp::connection_ptr tcp_conn(create_connection(service));
+        // a Unix domain socket gets the same tcp::v4() label as its acceptor
+        // (see open_local_acceptor())
+        const asio::error_code ec(tcp_conn->assign(m_endpoint.protocol(), fd));
+        if (ec) {
+            PION_LOG_WARN(m_logger, "Unable to use new connection on " << get_listen_name() << ": " << ec.message());
+            ::close(fd);
+        } else {
+            PION_LOG_DEBUG(m_logger, "New" << (tcp_conn->get_ssl_flag() ? " SSL " : " ")
+                           << "connection on " << get_listen_name());
+            apply_socket_options(tcp_conn);
+            add_connection(tcp_conn);
+            if (admit_connection())
+                start_connection(tcp_conn);
+            else
+                reject_connection(tcp_conn);
+        }
+    }
+
+    if (m_is_listening) {
+        if (m_overload_policy == OVERLOAD_PAUSE && limits_reached())
+            pause_listener(listener);
+        else if (! more)
+            listen(listener);   // the kernel may stop a multishot accept, which must then be started again
+    }
+}
+
+bool server::admit_connection(void)
+{
+    bool within_rate = true;
+    if (m_max_accept_rate > 0) {
+        // count the connection in the current one-second window (the count
+        // restarts at one in a new window, and saturates instead of wrapping)
+        const uint64_t now = get_accept_second();
+        uint64_t window = m_accept_window;
+        uint64_t next_window;
+        do {
+            uint64_t count = ((window >> 32) == now ? window & ACCEPT_COUNT_MASK : 0);
+            if (count < ACCEPT_COUNT_MASK)
+                ++count;
+            next_window = (now << 32) | count;
+        } while (! m_accept_window.compare_exchange_weak(window, next_window));
+        within_rate = ((next_window & ACCEPT_COUNT_MASK) <= m_max_accept_rate);
+    }
+
+    // with OVERLOAD_PAUSE, connections that were accepted are always handled
+    if (m_overload_policy != OVERLOAD_REJECT
+        || (within_rate && (m_max_connections == 0 || m_num_connections <= m_max_connections)))
+    {
+        return true;
+    }
+    ++m_num_rejected_connections;
+    return false;
+}
+
+bool server::accept_rate_exhausted(void) const
+{
+    const uint64_t window = m_accept_window;
+    return (window >> 32) == get_accept_second()
+        && (window & ACCEPT_COUNT_MASK) >= m_max_accept_rate;
+}
+
+void server::pause_listener(const listener_ptr& listener)
+{
+    if (listener->m_paused.exchange(true))
+        return;
+    ++m_num_paused_listeners;
+    ++m_num_accept_pauses;
+    PION_LOG_DEBUG(m_logger, "Limits reached; not accepting connections on " << get_listen_name());
+
+#ifdef PION_HAVE_IO_URING
+    if (listener->m_uring_ptr != NULL) {
+        // stop the multishot accept (connections that it already accepted are still handled)
+        std::unique_lock<std::mutex> listener_lock(listener->m_mutex);
+        listener->m_uring_ptr->cancel(listener->m_acceptor.native_handle());
+    }
 #endif
-            // not SSL -> call the handler immediately
-            handle_connection(tcp_conn);
+
+    // connections may have finished while the listener was being paused
+    resume_listeners();
+}
+
+void server::resume_listeners(void)
+{
+    if (m_num_paused_listeners == 0 || ! m_is_listening)
+        return;
+    if (limits_reached()) {
+        // an exceeded accept rate is not waited out by finishing connections
+        if (m_max_accept_rate > 0 && accept_rate_exhausted() && ! m_resume_timer_armed.exchange(true)) {
+            m_resume_timer.expires_from_now(std::chrono::milliseconds(1000 - get_steady_milliseconds() % 1000));
+            m_resume_timer.async_wait(std::bind(&server::handle_resume_timer,
+                                                this, std::placeholders::_1));
+        }
+        return;
+    }
+
+    listener_pool_type paused;
+    std::unique_lock<std::mutex> server_lock(m_mutex);
+    for (listener_pool_type::iterator i = m_listeners.begin(); i != m_listeners.end(); ++i) {
+        if ((*i)->m_paused.exchange(false)) {
+            --m_num_paused_listeners;
+            paused.push_back(*i);
+        }
     }
+    server_lock.unlock();
+
+    if (! paused.empty())
+        PION_LOG_DEBUG(m_logger, "Accepting connections again on " << get_listen_name());
+    for (listener_pool_type::iterator i = paused.begin(); i != paused.end(); ++i)
+        listen(*i);
+}
+
+void server::handle_resume_timer(const asio::error_code& ec)
+{
+    m_resume_timer_armed = false;
+    if (ec != asio::error::operation_aborted)
+        resume_listeners();
+}
+
+void server::reject_connection(const tcp::connection_ptr& tcp_conn)
+{
+    PION_LOG_DEBUG(m_logger, "Limits reached; refusing connection on " << get_listen_name());
+    if (tcp_conn->get_ssl_flag()) {
+        // nothing can be sent before the SSL handshake
+        tcp_conn->set_lifecycle(connection::LIFECYCLE_CLOSE);
+        tcp_conn->finish();
+    } else {
+        handle_overload(tcp_conn);
+    }
+}
+
+bool server::begin_request(const tcp::connection_ptr& tcp_conn)
+{
+    const std::size_t n = ++m_requests_in_flight;
+    if (m_max_requests > 0 && n > m_max_requests && m_overload_policy == OVERLOAD_REJECT) {
+        --m_requests_in_flight;
+        ++m_num_rejected_requests;
+        return false;
+    }
+    tcp_conn->begin_request();
+    return true;
+}
+
+void server::apply_socket_options(const tcp::connection_ptr& tcp_conn)
+{
+    // the options are tcp options, which Unix domain sockets do not support
+    if (tcp_conn->get_local_flag())
+        return;
+    asio::error_code ec;
+    m_socket_options.apply_accepted(tcp_conn->get_socket(), ec);
+    if (ec) {
+        PION_LOG_WARN(m_logger, "Unable to set socket options on " << get_listen_name()
+                      << ": " << ec.message());
+    }
+}
+
+void server::start_connection(const tcp::connection_ptr& tcp_conn)
+{
+#ifdef PION_HAVE_SSL
+    if (tcp_conn->get_ssl_flag()) {
+        // the CPU-heavy steps run on the handshake pool, if there is one
+        tcp_conn->async_handshake_server(handshake_handler(*this, tcp_conn,
+                                                           m_handshake_threads > 0));
+    } else
+#endif
+        // not SSL -> call the handler immediately
+        handle_connection(tcp_conn);
 }
 
 void server::handle_ssl_handshake(const tcp::connection_ptr& tcp_conn,
@@ -248,62 +900,198 @@ void server::handle_ssl_handshake(const tcp::connection_ptr& tcp_conn,
 {
     if (handshake_error) {
         // an error occured while trying to establish the SSL connection
-        PION_LOG_WARN(m_logger, "SSL handshake failed on port " << get_port()
+        PION_LOG_WARN(m_logger, "SSL handshake failed on " << get_listen_name()
                       << " (" << handshake_error.message() << ')');
         finish_connection(tcp_conn);
     } else {
         // handle the new connection
-        PION_LOG_DEBUG(m_logger, "SSL handshake succeeded on port " << get_port());
+        PION_LOG_DEBUG(m_logger, "SSL handshake succeeded on " << get_listen_name());
+#ifdef PION_HAVE_SSL
+        // the kernel encrypts what is sent from now on (if it can)
+        if (m_ktls_flag && ktls::is_supported())
+            tcp_conn->enable_ktls(m_ktls);
+#endif
         handle_connection(tcp_conn);
     }
 }
 
+void server::offload_handshake_step(const tcp::connection_ptr& tcp_conn, task step)
+{
+    // the pool drops work that it rejects, so it gets its own reference.  If
+    // the pool is stopped before the step runs, the step still has to run
+    // (on the I/O service) so that the handshake fails and its connection
+    // finishes, instead of waiting forever
+    std::shared_ptr<task> step_ptr(std::make_shared<task>(std::move(step)));
+    if (! m_handshake_pool.offload(tcp_conn->get_io_service(),
+                                   [step_ptr]() { (*step_ptr)(); },
+                                   [step_ptr](const asio::error_code& ec) { if (ec) (*step_ptr)(); }))
+    {
+        // the queue is full: run the step on the I/O service
+        (*step_ptr)();
+    }
+}
+
+void server::record_handshake(bool offloaded, uint64_t queue_usec, uint64_t duration_usec)
+{
+    std::unique_lock<std::mutex> handshake_lock(m_handshake_mutex);
+    if (offloaded)
+        ++m_handshake_queue_wait.m_buckets[scheduler::histogram::get_bucket(queue_usec)];
+    ++m_handshake_duration.m_buckets[scheduler::histogram::get_bucket(duration_usec)];
+}
+
+scheduler::histogram server::get_handshake_queue_wait(void) const
+{
+    std::unique_lock<std::mutex> handshake_lock(m_handshake_mutex);
+    return m_handshake_queue_wait;
+}
+
+scheduler::histogram server::get_handshake_duration(void) const
+{
+    std::unique_lock<std::mutex> handshake_lock(m_handshake_mutex);
+    return m_handshake_duration;
+}
+
 void server::finish_connection(const tcp::connection_ptr& tcp_conn)
 {
-    std::unique_lock<std::mutex> server_lock(m_mutex);
+    if (tcp_conn->get_in_flight()) {
+        // the connection has finished handling its request
+        tcp_conn->end_request();
+        --m_requests_in_flight;
+    }
+
+    // count the connections that were cut off by their limits
+    switch (tcp_conn->get_timeout_reason()) {
+    case tcp::connection::TIMEOUT_HEADER: ++m_num_header_timeouts; break;
+    case tcp::connection::TIMEOUT_BODY_RATE: ++m_num_body_rate_timeouts; break;
+    case tcp::connection::TIMEOUT_SEND_STALL: ++m_num_send_stalls; break;
+    case tcp::connection::TIMEOUT_NONE: break;
+    }
+    tcp_conn->set_timeout_reason(tcp::connection::TIMEOUT_NONE);
+
     if (m_is_listening && tcp_conn->get_keep_alive()) {
         
         // keep the connection alive
         handle_connection(tcp_conn);
 
     } else {
-        PION_LOG_DEBUG(m_logger, "Closing connection on port " << get_port());
+        PION_LOG_DEBUG(m_logger, "Closing connection on " << get_listen_name());
         
         // remove the connection from the server's management pool
-        ConnectionPool::iterator conn_itr = m_conn_pool.find(tcp_conn);
-        if (conn_itr != m_conn_pool.end())
-            m_conn_pool.erase(conn_itr);
+        remove_connection(tcp_conn);
 
         // trigger the no more connections condition if we're waiting to stop
-        if (!m_is_listening && m_conn_pool.empty())
+        if (!m_is_listening && m_num_connections == 0) {
+            std::unique_lock<std::mutex> server_lock(m_mutex);
             m_no_more_connections.notify_all();
+        }
+    }
+
+    // accept connections again if a limit had been reached
+    if (m_num_paused_listeners > 0)
+        resume_listeners();
+}
+
+void server::add_connection(const tcp::connection_ptr& tcp_conn)
+{
+    connection_shard& shard = get_shard(tcp_conn);
+    std::unique_lock<std::mutex> shard_lock(shard.m_mutex);
+    if (shard.m_conns.insert(tcp_conn).second) {
+        ++m_num_connections;
+        shard_lock.unlock();
+        m_active_scheduler.connection_opened(tcp_conn->get_io_service());
+    }
+}
+
+void server::remove_connection(const tcp::connection_ptr& tcp_conn)
+{
+    connection_shard& shard = get_shard(tcp_conn);
+    std::unique_lock<std::mutex> shard_lock(shard.m_mutex);
+    if (shard.m_conns.erase(tcp_conn) > 0) {
+        --m_num_connections;
+        shard_lock.unlock();
+        m_active_scheduler.connection_closed(tcp_conn->get_io_service());
+    }
+}
+
+void server::close_connections(void)
+{
+    for (ShardedConnectionPool::iterator i = m_conn_pool.begin(); i != m_conn_pool.end(); ++i) {
+        std::unique_lock<std::mutex> shard_lock(i->m_mutex);
+        std::for_each(i->m_conns.begin(), i->m_conns.end(),
+                      std::bind(&connection::close, std::placeholders::_1));
     }
 }
 
 std::size_t server::prune_connections(void)
 {
-    // assumes that a server lock has already been acquired
-    ConnectionPool::iterator conn_itr = m_conn_pool.begin();
-    while (conn_itr != m_conn_pool.end()) {
-        if (conn_itr->unique()) {
-            PION_LOG_WARN(m_logger, "Closing orphaned connection on port " << get_port());
-            ConnectionPool::iterator erase_itr = conn_itr;
-            ++conn_itr;
-            (*erase_itr)->close();
-            m_conn_pool.erase(erase_itr);
-        } else {
-            ++conn_itr;
+    // only one partition of the pool is locked at a time
+    std::vector<tcp::connection_ptr> orphans;
+    for (ShardedConnectionPool::iterator i = m_conn_pool.begin(); i != m_conn_pool.end(); ++i) {
+        std::unique_lock<std::mutex> shard_lock(i->m_mutex);
+        ConnectionPool::iterator conn_itr = i->m_conns.begin();
+        while (conn_itr != i->m_conns.end()) {
+            if (conn_itr->unique()) {
+                PION_LOG_WARN(m_logger, "Closing orphaned connection on " << get_listen_name());
+                orphans.push_back(*conn_itr);
+                conn_itr = i->m_conns.erase(conn_itr);
+                --m_num_connections;
+                if (orphans.back()->get_in_flight())
+                    --m_requests_in_flight;
+            } else {
+                ++conn_itr;
+            }
         }
     }
 
+    // close and release the orphans after all partition locks are released
+    for (std::vector<tcp::connection_ptr>::iterator i = orphans.begin(); i != orphans.end(); ++i) {
+        (*i)->close();
+        m_active_scheduler.connection_closed((*i)->get_io_service());
+    }
+    orphans.clear();
+
     // return the number of connections remaining
-    return m_conn_pool.size();
+    return m_num_connections;
+}
+
+void server::schedule_prune_timer(void)
+{
+    // assumes that a server lock has already been acquired
+    m_prune_timer.expires_from_now(std::chrono::seconds(PRUNE_TIMER_SECONDS));
+    m_prune_timer.async_wait(std::bind(&server::handle_prune_timer,
+                                       this, std::placeholders::_1));
+}
+
+void server::handle_prune_timer(const asio::error_code& ec)
+{
+    // the timer is cancelled when the server stops listening
+    if (ec == asio::error::operation_aborted || ! m_is_listening)
+        return;
+
+    prune_connections();
+    if (m_num_paused_listeners > 0)
+        resume_listeners();
+
+    std::unique_lock<std::mutex> server_lock(m_mutex);
+    if (m_is_listening)
+        schedule_prune_timer();
 }
 
 std::size_t server::get_connections(void) const
+{
+    return m_num_connections;
+}
+
+std::size_t server::get_idle_connections(void) const
 {
     std::unique_lock<std::mutex> server_lock(m_mutex);
-    return (m_is_listening ? (m_conn_pool.size() - 1) : m_conn_pool.size());
+    std::size_t num_idle = 0;
+    for (std::vector<connection_pool_ptr>::const_iterator i = m_free_connections.begin();
+         i != m_free_connections.end(); ++i)
+    {
+        num_idle += (*i)->size();
+    }
+    return num_idle;
 }
 
 }   // end namespace tcp
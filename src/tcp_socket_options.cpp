@@ -0,0 +1,176 @@
+// ---------------------------------------------------------------------
+// pion:  a Boost C++ framework for building lightweight HTTP interfaces
+// ---------------------------------------------------------------------
+// Copyright (C) 2021 Wang Qiang  (https://github.com/dnybz/pion)
+// Copyright (C) 2007-2014 Splunk Inc.  (https://github.com/splunk/pion)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include <cstdlib>
+#include <pion/tcp/socket_options.hpp>
+
+namespace pion {    // begin namespace pion
+namespace tcp {     // begin namespace tcp
+
+
+// platform-specific TCP options that asio does not define
+
+#if defined(TCP_KEEPIDLE)
+typedef asio::detail::socket_option::integer<IPPROTO_TCP, TCP_KEEPIDLE>         keep_alive_idle_option;
+#elif defined(TCP_KEEPALIVE)
+typedef asio::detail::socket_option::integer<IPPROTO_TCP, TCP_KEEPALIVE>        keep_alive_idle_option;
+#endif
+#ifdef TCP_KEEPINTVL
+typedef asio::detail::socket_option::integer<IPPROTO_TCP, TCP_KEEPINTVL>        keep_alive_interval_option;
+#endif
+#ifdef TCP_KEEPCNT
+typedef asio::detail::socket_option::integer<IPPROTO_TCP, TCP_KEEPCNT>          keep_alive_count_option;
+#endif
+#ifdef TCP_USER_TIMEOUT
+typedef asio::detail::socket_option::integer<IPPROTO_TCP, TCP_USER_TIMEOUT>     user_timeout_option;
+#endif
+#ifdef TCP_DEFER_ACCEPT
+typedef asio::detail::socket_option::integer<IPPROTO_TCP, TCP_DEFER_ACCEPT>     defer_accept_option;
+#endif
+#ifdef TCP_FASTOPEN
+typedef asio::detail::socket_option::integer<IPPROTO_TCP, TCP_FASTOPEN>         fast_open_option;
+#endif
+#ifdef TCP_QUICKACK
+typedef asio::detail::socket_option::boolean<IPPROTO_TCP, TCP_QUICKACK>         quick_ack_option;
+#endif
+
+
+/**
+ * applies the options that are shared by listening and connected sockets
+ *
+ * @param sock the socket or acceptor
+ * @param opts the options to apply
+ * @param ec set if an option could not be applied
+ */
+template <typename SocketType>
+static void apply_common(SocketType& sock, const socket_options& opts, asio::error_code& ec)
+{
+    if (opts.m_no_delay)
+        sock.set_option(asio::ip::tcp::no_delay(true), ec);
+    if (! ec && opts.m_send_buffer_size > 0)
+        sock.set_option(asio::socket_base::send_buffer_size(opts.m_send_buffer_size), ec);
+    if (! ec && opts.m_receive_buffer_size > 0)
+        sock.set_option(asio::socket_base::receive_buffer_size(opts.m_receive_buffer_size), ec);
+    if (! ec && opts.m_keep_alive) {
+        sock.set_option(asio::socket_base::keep_alive(true), ec);
+#if defined(TCP_KEEPIDLE) || defined(TCP_KEEPALIVE)
+        if (! ec && opts.m_keep_alive_idle > 0)
+            sock.set_option(keep_alive_idle_option(opts.m_keep_alive_idle), ec);
+#endif
+#ifdef TCP_KEEPINTVL
+        if (! ec && opts.m_keep_alive_interval > 0)
+            sock.set_option(keep_alive_interval_option(opts.m_keep_alive_interval), ec);
+#endif
+#ifdef TCP_KEEPCNT
+        if (! ec && opts.m_keep_alive_count > 0)
+            sock.set_option(keep_alive_count_option(opts.m_keep_alive_count), ec);
+#endif
+    }
+#ifdef TCP_USER_TIMEOUT
+    if (! ec && opts.m_user_timeout > 0)
+        sock.set_option(user_timeout_option(opts.m_user_timeout), ec);
+#endif
+}
+
+
+// socket_options member functions
+
+bool socket_options::set(const std::string& name, const std::string& value)
+{
+    char *end_ptr = NULL;
+    const long n = strtol(value.c_str(), &end_ptr, 10);
+    if (value.empty() || *end_ptr != '\0' || n < 0 || n > 0x7FFFFFFF)
+        return false;
+    const int i = static_cast<int>(n);
+
+    if (name == "backlog") {
+        m_backlog = i;
+    } else if (name == "reuse_address") {
+        m_reuse_address = (i != 0);
+    } else if (name == "nodelay") {
+        m_no_delay = (i != 0);
+    } else if (name == "send_buffer") {
+        m_send_buffer_size = i;
+    } else if (name == "receive_buffer") {
+        m_receive_buffer_size = i;
+    } else if (name == "keepalive") {
+        m_keep_alive = (i != 0);
+    } else if (name == "keepalive_idle") {
+        m_keep_alive_idle = i;
+    } else if (name == "keepalive_interval") {
+        m_keep_alive_interval = i;
+    } else if (name == "keepalive_count") {
+        m_keep_alive_count = i;
+    } else if (name == "user_timeout") {
+        m_user_timeout = i;
+    } else if (name == "defer_accept") {
+        m_defer_accept = i;
+    } else if (name == "fast_open") {
+        m_fast_open = i;
+    } else if (name == "quickack") {
+        m_quick_ack = (i != 0);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void socket_options::apply(asio::ip::tcp::acceptor& acceptor) const
+{
+    // allow the acceptor to reuse the address (i.e. SO_REUSEADDR)
+    // ...except when running not on Windows - see http://msdn.microsoft.com/en-us/library/ms740621%28VS.85%29.aspx
+#ifndef PION_WIN32
+    if (m_reuse_address)
+        acceptor.set_option(asio::ip::tcp::acceptor::reuse_address(true));
+#endif
+
+    // the receive buffer must be sized before listening so that the
+    // window scale that is advertised to clients can use it
+    asio::error_code ec;
+    apply_common(acceptor, *this, ec);
+    if (ec)
+        throw asio::system_error(ec);
+
+#ifdef TCP_DEFER_ACCEPT
+    if (m_defer_accept > 0)
+        acceptor.set_option(defer_accept_option(m_defer_accept));
+#endif
+#ifdef TCP_FASTOPEN
+    if (m_fast_open > 0)
+        acceptor.set_option(fast_open_option(m_fast_open));
+#endif
+}
+
+void socket_options::apply(asio::ip::tcp::socket& sock, asio::error_code& ec) const
+{
+    apply_common(sock, *this, ec);
+#ifdef TCP_QUICKACK
+    if (! ec && m_quick_ack)
+        sock.set_option(quick_ack_option(true), ec);
+#endif
+}
+
+void socket_options::apply_accepted(asio::ip::tcp::socket& sock, asio::error_code& ec) const
+{
+#ifdef __linux__
+    // Linux copies the listening socket's options to the connections that it
+    // accepts, except for TCP_QUICKACK
+#ifdef TCP_QUICKACK
+    if (m_quick_ack)
+        sock.set_option(quick_ack_option(true), ec);
+#endif
+#else
+    apply(sock, ec);
+#endif
+}
+
+
+}   // end namespace tcp
+}   // end namespace pion
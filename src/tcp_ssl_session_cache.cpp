@@ -0,0 +1,324 @@
+// ---------------------------------------------------------------------
+// pion:  a Boost C++ framework for building lightweight HTTP interfaces
+// ---------------------------------------------------------------------
+// Copyright (C) 2021 Wang Qiang  (https://github.com/dnybz/pion)
+// Copyright (C) 2007-2014 Splunk Inc.  (https://github.com/splunk/pion)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include <pion/tcp/ssl_session_cache.hpp>
+
+#ifdef PION_HAVE_SSL
+
+#include <chrono>
+#include <cstring>
+#include <openssl/rand.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#include <openssl/params.h>
+#endif
+
+
+namespace {
+
+/// returns the number of seconds on the steady clock
+inline uint64_t get_steady_seconds(void)
+{
+    return std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/// returns the index used to attach a cache to an SSL context
+int get_ex_data_index(void)
+{
+    static const int index = SSL_CTX_get_ex_new_index(0, NULL, NULL, NULL, NULL);
+    return index;
+}
+
+}
+
+
+namespace pion {    // begin namespace pion
+namespace tcp {     // begin namespace tcp
+
+
+// static members of ssl_session_cache
+
+const std::size_t   ssl_session_cache::DEFAULT_MAX_SESSIONS = 20480;
+const uint32_t      ssl_session_cache::DEFAULT_SESSION_TIMEOUT = 300;
+const uint32_t      ssl_session_cache::DEFAULT_TICKET_KEY_LIFETIME = 3600;
+
+
+// ssl_session_cache member functions
+
+ssl_session_cache::ssl_session_cache(void)
+    : m_max_sessions(DEFAULT_MAX_SESSIONS), m_session_timeout(DEFAULT_SESSION_TIMEOUT),
+    m_tickets(true), m_ticket_key_lifetime(DEFAULT_TICKET_KEY_LIFETIME),
+    m_hits(0), m_misses(0), m_ticket_hits(0), m_ticket_misses(0), m_ticket_key_rotations(0)
+{}
+
+void ssl_session_cache::attach(SSL_CTX *ctx)
+{
+    static const unsigned char SESSION_ID_CONTEXT[] = "pion";
+    SSL_CTX_set_ex_data(ctx, get_ex_data_index(), this);
+    SSL_CTX_set_session_id_context(ctx, SESSION_ID_CONTEXT, sizeof(SESSION_ID_CONTEXT) - 1);
+    SSL_CTX_set_timeout(ctx, m_session_timeout);
+
+    if (m_max_sessions > 0) {
+        // OpenSSL's own cache is a single list behind one lock; only ours is used
+        SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER | SSL_SESS_CACHE_NO_INTERNAL);
+        SSL_CTX_sess_set_new_cb(ctx, &ssl_session_cache::new_session_callback);
+        SSL_CTX_sess_set_get_cb(ctx, &ssl_session_cache::get_session_callback);
+        SSL_CTX_sess_set_remove_cb(ctx, &ssl_session_cache::remove_session_callback);
+    } else {
+        SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_OFF);
+        SSL_CTX_sess_set_new_cb(ctx, NULL);
+        SSL_CTX_sess_set_get_cb(ctx, NULL);
+        SSL_CTX_sess_set_remove_cb(ctx, NULL);
+    }
+
+    if (m_tickets) {
+        SSL_CTX_clear_options(ctx, SSL_OP_NO_TICKET);
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+        SSL_CTX_set_tlsext_ticket_key_evp_cb(ctx, &ssl_session_cache::ticket_key_callback);
+#else
+        SSL_CTX_set_tlsext_ticket_key_cb(ctx, &ssl_session_cache::ticket_key_callback);
+#endif
+    } else {
+        SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+    }
+}
+
+void ssl_session_cache::clear(void)
+{
+    for (std::size_t n = 0; n < NUM_SESSION_SHARDS; ++n) {
+        std::unique_lock<std::mutex> shard_lock(m_shards[n].m_mutex);
+        m_shards[n].m_sessions.clear();
+        m_shards[n].m_lru.clear();
+    }
+    std::unique_lock<std::mutex> ticket_lock(m_ticket_mutex);
+    m_ticket_keys.clear();
+}
+
+std::size_t ssl_session_cache::get_num_sessions(void) const
+{
+    std::size_t num_sessions = 0;
+    for (std::size_t n = 0; n < NUM_SESSION_SHARDS; ++n) {
+        std::unique_lock<std::mutex> shard_lock(m_shards[n].m_mutex);
+        num_sessions += m_shards[n].m_sessions.size();
+    }
+    return num_sessions;
+}
+
+void ssl_session_cache::store(SSL_SESSION *session)
+{
+    unsigned int id_length = 0;
+    const unsigned char *id_ptr = SSL_SESSION_get_id(session, &id_length);
+    const int data_length = i2d_SSL_SESSION(session, NULL);
+    if (m_max_sessions == 0 || id_length == 0 || data_length <= 0)
+        return;
+
+    const std::string id(reinterpret_cast<const char*>(id_ptr), id_length);
+    std::string data(data_length, '\0');
+    unsigned char *data_ptr = reinterpret_cast<unsigned char*>(&data[0]);
+    i2d_SSL_SESSION(session, &data_ptr);
+
+    // each partition holds its share of the sessions
+    const std::size_t max_shard_sessions = (m_max_sessions + NUM_SESSION_SHARDS - 1) / NUM_SESSION_SHARDS;
+    session_shard& shard = get_shard(id);
+    std::unique_lock<std::mutex> shard_lock(shard.m_mutex);
+    std::unordered_map<std::string, session_entry>::iterator i = shard.m_sessions.find(id);
+    if (i == shard.m_sessions.end()) {
+        shard.m_lru.push_front(id);
+        i = shard.m_sessions.insert(std::make_pair(id, session_entry())).first;
+    } else {
+        shard.m_lru.splice(shard.m_lru.begin(), shard.m_lru, i->second.m_lru_pos);
+    }
+    i->second.m_data.swap(data);
+    i->second.m_expires = get_steady_seconds() + m_session_timeout;
+    i->second.m_lru_pos = shard.m_lru.begin();
+    while (shard.m_sessions.size() > max_shard_sessions) {
+        shard.m_sessions.erase(shard.m_lru.back());
+        shard.m_lru.pop_back();
+    }
+}
+
+SSL_SESSION *ssl_session_cache::find(const std::string& id)
+{
+    std::string data;
+    session_shard& shard = get_shard(id);
+    std::unique_lock<std::mutex> shard_lock(shard.m_mutex);
+    std::unordered_map<std::string, session_entry>::iterator i = shard.m_sessions.find(id);
+    if (i != shard.m_sessions.end()) {
+        if (i->second.m_expires < get_steady_seconds()) {
+            shard.m_lru.erase(i->second.m_lru_pos);
+            shard.m_sessions.erase(i);
+        } else {
+            shard.m_lru.splice(shard.m_lru.begin(), shard.m_lru, i->second.m_lru_pos);
+            data = i->second.m_data;
+        }
+    }
+    shard_lock.unlock();
+
+    if (data.empty()) {
+        ++m_misses;
+        return NULL;
+    }
+    const unsigned char *data_ptr = reinterpret_cast<const unsigned char*>(data.data());
+    SSL_SESSION *session = d2i_SSL_SESSION(NULL, &data_ptr, static_cast<long>(data.size()));
+    if (session == NULL) {
+        ++m_misses;
+        return NULL;
+    }
+    ++m_hits;
+    return session;
+}
+
+void ssl_session_cache::remove(const std::string& id)
+{
+    session_shard& shard = get_shard(id);
+    std::unique_lock<std::mutex> shard_lock(shard.m_mutex);
+    std::unordered_map<std::string, session_entry>::iterator i = shard.m_sessions.find(id);
+    if (i != shard.m_sessions.end()) {
+        shard.m_lru.erase(i->second.m_lru_pos);
+        shard.m_sessions.erase(i);
+    }
+}
+
+bool ssl_session_cache::get_encrypt_key(ticket_key& key)
+{
+    const uint64_t now = get_steady_seconds();
+    std::unique_lock<std::mutex> ticket_lock(m_ticket_mutex);
+    if (m_ticket_keys.empty()
+        || (m_ticket_key_lifetime > 0 && now - m_ticket_keys.front().m_created >= m_ticket_key_lifetime))
+    {
+        // replace the current key, but keep accepting tickets issued with it
+        ticket_key new_key;
+        if (RAND_bytes(new_key.m_name, sizeof(new_key.m_name)) != 1
+            || RAND_bytes(new_key.m_aes_key, sizeof(new_key.m_aes_key)) != 1
+            || RAND_bytes(new_key.m_hmac_key, sizeof(new_key.m_hmac_key)) != 1)
+        {
+            return false;
+        }
+        new_key.m_created = now;
+        m_ticket_keys.insert(m_ticket_keys.begin(), new_key);
+        if (m_ticket_keys.size() > 2)
+            m_ticket_keys.pop_back();
+        ++m_ticket_key_rotations;
+    }
+    key = m_ticket_keys.front();
+    return true;
+}
+
+bool ssl_session_cache::get_decrypt_key(const unsigned char *name, ticket_key& key, bool& renew)
+{
+    const uint64_t now = get_steady_seconds();
+    std::unique_lock<std::mutex> ticket_lock(m_ticket_mutex);
+    for (std::size_t n = 0; n < m_ticket_keys.size(); ++n) {
+        if (memcmp(m_ticket_keys[n].m_name, name, sizeof(m_ticket_keys[n].m_name)) != 0)
+            continue;
+        const uint64_t age = now - m_ticket_keys[n].m_created;
+        if (m_ticket_key_lifetime > 0 && age >= 2 * static_cast<uint64_t>(m_ticket_key_lifetime))
+            return false;
+        key = m_ticket_keys[n];
+        renew = (n > 0 || (m_ticket_key_lifetime > 0 && age >= m_ticket_key_lifetime));
+        return true;
+    }
+    return false;
+}
+
+ssl_session_cache *ssl_session_cache::get_cache(SSL *ssl)
+{
+    return static_cast<ssl_session_cache*>(SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl),
+                                                               get_ex_data_index()));
+}
+
+int ssl_session_cache::new_session_callback(SSL *ssl, SSL_SESSION *session)
+{
+    ssl_session_cache *cache_ptr = get_cache(ssl);
+    if (cache_ptr != NULL)
+        cache_ptr->store(session);
+    return 0;   // the cache keeps a copy, not a reference
+}
+
+SSL_SESSION *ssl_session_cache::get_session_callback(SSL *ssl, const unsigned char *id,
+                                                     int id_length, int *copy)
+{
+    *copy = 0;  // the session that is returned is a new object
+    ssl_session_cache *cache_ptr = get_cache(ssl);
+    if (cache_ptr == NULL || id_length <= 0)
+        return NULL;
+    return cache_ptr->find(std::string(reinterpret_cast<const char*>(id), id_length));
+}
+
+void ssl_session_cache::remove_session_callback(SSL_CTX *ctx, SSL_SESSION *session)
+{
+    ssl_session_cache *cache_ptr =
+        static_cast<ssl_session_cache*>(SSL_CTX_get_ex_data(ctx, get_ex_data_index()));
+    unsigned int id_length = 0;
+    const unsigned char *id_ptr = SSL_SESSION_get_id(session, &id_length);
+    if (cache_ptr != NULL && id_length > 0)
+        cache_ptr->remove(std::string(reinterpret_cast<const char*>(id_ptr), id_length));
+}
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+int ssl_session_cache::ticket_key_callback(SSL *ssl, unsigned char *name, unsigned char *iv,
+                                           EVP_CIPHER_CTX *cipher_ctx, EVP_MAC_CTX *mac_ctx, int enc)
+#else
+int ssl_session_cache::ticket_key_callback(SSL *ssl, unsigned char *name, unsigned char *iv,
+                                           EVP_CIPHER_CTX *cipher_ctx, HMAC_CTX *hmac_ctx, int enc)
+#endif
+{
+    ssl_session_cache *cache_ptr = get_cache(ssl);
+    if (cache_ptr == NULL)
+        return -1;
+
+    ticket_key key;
+    bool renew = false;
+    if (enc) {
+        // issue a new ticket with the current key
+        if (! cache_ptr->get_encrypt_key(key)
+            || RAND_bytes(iv, EVP_CIPHER_iv_length(EVP_aes_256_cbc())) != 1)
+        {
+            return -1;
+        }
+        memcpy(name, key.m_name, sizeof(key.m_name));
+        if (EVP_EncryptInit_ex(cipher_ctx, EVP_aes_256_cbc(), NULL, key.m_aes_key, iv) != 1)
+            return -1;
+    } else {
+        // a client presented a ticket: a full handshake is needed if its key is gone
+        if (! cache_ptr->get_decrypt_key(name, key, renew)) {
+            ++cache_ptr->m_ticket_misses;
+            return 0;
+        }
+        if (EVP_DecryptInit_ex(cipher_ctx, EVP_aes_256_cbc(), NULL, key.m_aes_key, iv) != 1)
+            return -1;
+    }
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    OSSL_PARAM params[3];
+    params[0] = OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_KEY, key.m_hmac_key,
+                                                  sizeof(key.m_hmac_key));
+    params[1] = OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST,
+                                                 const_cast<char*>("SHA256"), 0);
+    params[2] = OSSL_PARAM_construct_end();
+    if (EVP_MAC_CTX_set_params(mac_ctx, params) != 1)
+        return -1;
+#else
+    if (HMAC_Init_ex(hmac_ctx, key.m_hmac_key, sizeof(key.m_hmac_key), EVP_sha256(), NULL) != 1)
+        return -1;
+#endif
+
+    if (enc)
+        return 1;
+    ++cache_ptr->m_ticket_hits;
+    return renew ? 2 : 1;   // 2 = accept the ticket, but issue a new one
+}
+
+
+}   // end namespace tcp
+}   // end namespace pion
+
+#endif  // PION_HAVE_SSL
@@ -0,0 +1,217 @@
+// ---------------------------------------------------------------------
+// pion:  a Boost C++ framework for building lightweight HTTP interfaces
+// ---------------------------------------------------------------------
+// Copyright (C) 2021 Wang Qiang  (https://github.com/dnybz/pion)
+// Copyright (C) 2007-2014 Splunk Inc.  (https://github.com/splunk/pion)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include <pion/tcp/timing_wheel.hpp>
+
+namespace pion {    // begin namespace pion
+namespace tcp {     // begin namespace tcp
+
+
+// static members of timing_wheel
+
+asio::io_service::id    timing_wheel::id;
+const uint32_t          timing_wheel::TICK_MILLISECONDS = 100;
+
+
+// timing_wheel member functions
+
+timing_wheel::timing_wheel(asio::io_service& io_service)
+    : asio::io_service::service(io_service),
+    m_start(std::chrono::steady_clock::now()), m_timer(io_service),
+    m_timer_running(false), m_base(0), m_num_entries(0)
+{
+    for (std::size_t n = 0; n < TICK_SLOTS; ++n)
+        m_ticks[n] = NULL;
+    for (std::size_t level = 0; level < NUM_LEVELS; ++level) {
+        for (std::size_t n = 0; n < LEVEL_SLOTS; ++n)
+            m_levels[level][n] = NULL;
+    }
+}
+
+void timing_wheel::arm(entry& e, uint32_t milliseconds)
+{
+    timing_wheel *other_wheel = e.m_wheel.load(std::memory_order_acquire);
+    if (other_wheel != NULL && other_wheel != this)
+        other_wheel->cancel(e);
+
+    std::unique_lock<std::mutex> wheel_lock(m_mutex);
+    if (e.m_slot)
+        remove(e);
+    else
+        ++m_num_entries;
+    e.m_wheel.store(this, std::memory_order_release);
+
+    // the current tick has already partly elapsed, so add one more
+    const uint64_t now = get_current_tick();
+    if (! m_timer_running)
+        m_base = now;
+    e.m_expires = now + (milliseconds + TICK_MILLISECONDS - 1) / TICK_MILLISECONDS + 1;
+    add(e);
+
+    if (! m_timer_running) {
+        m_timer_running = true;
+        schedule_tick();
+    }
+}
+
+void timing_wheel::cancel(entry& e)
+{
+    std::unique_lock<std::mutex> wheel_lock(m_mutex);
+    if (e.m_wheel.load(std::memory_order_relaxed) == this && e.m_slot) {
+        remove(e);
+        --m_num_entries;
+        e.m_wheel.store(NULL, std::memory_order_release);
+    }
+}
+
+std::size_t timing_wheel::size(void) const
+{
+    std::unique_lock<std::mutex> wheel_lock(m_mutex);
+    return m_num_entries;
+}
+
+void timing_wheel::shutdown(void)
+{
+    // forget about all deadlines, since the I/O service will not run them
+    std::unique_lock<std::mutex> wheel_lock(m_mutex);
+    entry **slots[NUM_LEVELS + 1] = { m_ticks, m_levels[0], m_levels[1], m_levels[2] };
+    const std::size_t num_slots[NUM_LEVELS + 1] = { TICK_SLOTS, LEVEL_SLOTS, LEVEL_SLOTS, LEVEL_SLOTS };
+    for (std::size_t level = 0; level < NUM_LEVELS + 1; ++level) {
+        for (std::size_t n = 0; n < num_slots[level]; ++n) {
+            for (entry *e = slots[level][n]; e != NULL; e = e->m_next) {
+                e->m_wheel.store(NULL, std::memory_order_release);
+                e->m_slot = NULL;
+            }
+            slots[level][n] = NULL;
+        }
+    }
+    m_num_entries = 0;
+    m_timer_running = false;
+    asio::error_code ec;
+    m_timer.cancel(ec);
+}
+
+void timing_wheel::add(entry& e)
+{
+    // assumes that the wheel lock has already been acquired
+    uint64_t expires = e.m_expires;
+    const uint64_t delta = expires - m_base;
+    entry **slot;
+    if (expires < m_base) {
+        // already expired: run it with the next tick
+        slot = &m_ticks[m_base & (TICK_SLOTS - 1)];
+    } else if (delta < TICK_SLOTS) {
+        slot = &m_ticks[expires & (TICK_SLOTS - 1)];
+    } else if (delta < (1ULL << (TICK_BITS + LEVEL_BITS))) {
+        slot = &m_levels[0][(expires >> TICK_BITS) & (LEVEL_SLOTS - 1)];
+    } else if (delta < (1ULL << (TICK_BITS + 2 * LEVEL_BITS))) {
+        slot = &m_levels[1][(expires >> (TICK_BITS + LEVEL_BITS)) & (LEVEL_SLOTS - 1)];
+    } else {
+        // deadlines beyond the range of the wheel (about 77 days) are capped
+        if (delta >= (1ULL << (TICK_BITS + 3 * LEVEL_BITS))) {
+            expires = m_base + (1ULL << (TICK_BITS + 3 * LEVEL_BITS)) - 1;
+            e.m_expires = expires;
+        }
+        slot = &m_levels[2][(expires >> (TICK_BITS + 2 * LEVEL_BITS)) & (LEVEL_SLOTS - 1)];
+    }
+
+    e.m_slot = slot;
+    e.m_prev = NULL;
+    e.m_next = *slot;
+    if (*slot)
+        (*slot)->m_prev = &e;
+    *slot = &e;
+}
+
+void timing_wheel::remove(entry& e)
+{
+    // assumes that the wheel lock has already been acquired
+    if (e.m_prev)
+        e.m_prev->m_next = e.m_next;
+    else
+        *e.m_slot = e.m_next;
+    if (e.m_next)
+        e.m_next->m_prev = e.m_prev;
+    e.m_slot = NULL;
+    e.m_prev = e.m_next = NULL;
+}
+
+std::size_t timing_wheel::cascade(std::size_t level, std::size_t index)
+{
+    // assumes that the wheel lock has already been acquired
+    entry *e = m_levels[level][index];
+    m_levels[level][index] = NULL;
+    while (e != NULL) {
+        entry *next = e->m_next;
+        add(*e);
+        e = next;
+    }
+    return index;
+}
+
+void timing_wheel::schedule_tick(void)
+{
+    // assumes that the wheel lock has already been acquired
+    m_timer.expires_at(m_start + std::chrono::milliseconds(m_base * TICK_MILLISECONDS));
+    m_timer.async_wait(std::bind(&timing_wheel::handle_tick,
+                                 this, std::placeholders::_1));
+}
+
+void timing_wheel::handle_tick(const asio::error_code& ec)
+{
+    if (ec == asio::error::operation_aborted)
+        return;
+
+    std::unique_lock<std::mutex> wheel_lock(m_mutex);
+    if (! m_timer_running)
+        return;
+
+    const uint64_t now = get_current_tick();
+    while (m_base <= now && m_num_entries > 0) {
+        // refill the first level from the higher levels when it wraps around
+        const std::size_t index = static_cast<std::size_t>(m_base & (TICK_SLOTS - 1));
+        if (index == 0
+            && cascade(0, (m_base >> TICK_BITS) & (LEVEL_SLOTS - 1)) == 0
+            && cascade(1, (m_base >> (TICK_BITS + LEVEL_BITS)) & (LEVEL_SLOTS - 1)) == 0)
+        {
+            cascade(2, (m_base >> (TICK_BITS + 2 * LEVEL_BITS)) & (LEVEL_SLOTS - 1));
+        }
+        ++m_base;
+
+        // expire every deadline in the current slot.  m_wheel is cleared
+        // only after expired() returns, so that cancelling the deadline on
+        // another thread (as its owner's destructor does) waits for the wheel
+        // lock instead of freeing the owner while expired() still uses it
+        entry *e = m_ticks[index];
+        m_ticks[index] = NULL;
+        while (e != NULL) {
+            entry *next = e->m_next;
+            e->m_slot = NULL;
+            e->m_prev = e->m_next = NULL;
+            --m_num_entries;
+            e->expired();
+            e->m_wheel.store(NULL, std::memory_order_release);
+            e = next;
+        }
+    }
+
+    // the timer stops when there is nothing left to expire
+    if (m_num_entries == 0) {
+        m_timer_running = false;
+    } else {
+        if (m_base <= now)
+            m_base = now + 1;
+        schedule_tick();
+    }
+}
+
+
+}   // end namespace tcp
+}   // end namespace pion
@@ -0,0 +1,592 @@
+// ---------------------------------------------------------------------
+// pion:  a Boost C++ framework for building lightweight HTTP interfaces
+// ---------------------------------------------------------------------
+// Copyright (C) 2021 Wang Qiang  (https://github.com/dnybz/pion)
+// Copyright (C) 2007-2014 Splunk Inc.  (https://github.com/splunk/pion)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include <pion/tcp/uring_service.hpp>
+
+#ifdef PION_HAVE_IO_URING
+
+#include <cstring>
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+
+namespace {
+
+/// sets up a new ring
+inline int io_uring_setup(unsigned entries, io_uring_params *params)
+{
+    return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+/// submits entries and/or waits for completions
+inline int io_uring_enter(int ring_fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    int ret;
+    do {
+        ret = static_cast<int>(::syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete,
+                                         flags, NULL, 0));
+    } while (ret < 0 && errno == EINTR);
+    return ret;
+}
+
+/// registers resources with a ring
+inline int io_uring_register(int ring_fd, unsigned opcode, const void *arg, unsigned nr_args)
+{
+    return static_cast<int>(::syscall(__NR_io_uring_register, ring_fd, opcode, arg, nr_args));
+}
+
+/// reads a ring index that is written by the kernel
+inline uint32_t load_acquire(const uint32_t *p)
+{
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+/// writes a ring index that is read by the kernel
+inline void store_release(uint32_t *p, uint32_t value)
+{
+    __atomic_store_n(p, value, __ATOMIC_RELEASE);
+}
+
+/// returns a pointer at an offset within a memory mapped ring
+template <typename T>
+inline T *ring_pointer(void *ring, uint32_t offset)
+{
+    return reinterpret_cast<T*>(static_cast<char*>(ring) + offset);
+}
+
+/// user data of entries that are not operations (cancellations)
+const uint64_t  INTERNAL_USER_DATA = 0;
+
+/// maximum number of completions reaped while the service is locked
+const uint32_t  MAX_REAPED_COMPLETIONS = 64;
+
+}
+
+
+namespace pion {    // begin namespace pion
+namespace tcp {     // begin namespace tcp
+
+
+// static members of uring_service
+
+asio::io_service::id    uring_service::id;
+const uint32_t          uring_service::SUBMIT_QUEUE_SIZE = 256;
+const uint32_t          uring_service::COMPLETION_QUEUE_SIZE = 4096;
+const uint32_t          uring_service::MAX_REGISTERED_BUFFERS = 1024;
+
+
+// uring_service member functions
+
+uring_service::uring_service(asio::io_service& io_service)
+    : asio::io_service::service(io_service), m_io_service(io_service),
+    m_ring_fd(-1), m_sq_ring(NULL), m_sq_ring_size(0), m_cq_ring(NULL), m_cq_ring_size(0),
+    m_sqes(NULL), m_sqes_size(0), m_sq_head(NULL), m_sq_tail(NULL), m_sq_mask(NULL),
+    m_sq_flags(NULL), m_sq_array(NULL), m_cq_head(NULL), m_cq_tail(NULL), m_cq_mask(NULL),
+    m_cqes(NULL), m_sq_entries(0), m_sq_local_tail(0), m_num_unsubmitted(0),
+    m_eventfd(io_service), m_is_waiting(false), m_operations(NULL), m_num_operations(0),
+    m_num_cancels(0), m_has_buffer_table(false)
+{
+    open_ring();
+}
+
+bool uring_service::is_supported(void)
+{
+    static const bool SUPPORTED = []() {
+        asio::io_service io_service;
+        return asio::use_service<uring_service>(io_service).is_available();
+    }();
+    return SUPPORTED;
+}
+
+void uring_service::open_ring(void)
+{
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_CLAMP;
+    params.cq_entries = COMPLETION_QUEUE_SIZE;
+    const int ring_fd = io_uring_setup(SUBMIT_QUEUE_SIZE, &params);
+    if (ring_fd < 0)
+        return;     // not supported by the kernel, or not permitted
+    m_ring_fd = ring_fd;
+
+    // completions must never be dropped, since handlers would be lost
+    if (! (params.features & IORING_FEAT_NODROP)) {
+        close_ring();
+        return;
+    }
+
+    // check for the operations that are used: multishot accepts and
+    // cancelling by file descriptor were added with IORING_OP_SOCKET (5.19)
+    const unsigned num_probe_ops = 256;
+    std::vector<char> probe_memory(sizeof(io_uring_probe) + num_probe_ops * sizeof(io_uring_probe_op), 0);
+    io_uring_probe *probe = reinterpret_cast<io_uring_probe*>(&probe_memory[0]);
+    if (io_uring_register(ring_fd, IORING_REGISTER_PROBE, probe, num_probe_ops) < 0) {
+        close_ring();
+        return;
+    }
+    const int required_ops[] = { IORING_OP_READ_FIXED, IORING_OP_RECV, IORING_OP_SENDMSG,
+        IORING_OP_ACCEPT, IORING_OP_READ, IORING_OP_ASYNC_CANCEL, IORING_OP_SOCKET };
+    for (std::size_t n = 0; n < sizeof(required_ops) / sizeof(required_ops[0]); ++n) {
+        if (required_ops[n] > probe->last_op
+            || ! (probe->ops[required_ops[n]].flags & IO_URING_OP_SUPPORTED))
+        {
+            close_ring();
+            return;
+        }
+    }
+
+    // map the submission and completion queues
+    m_sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    m_cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap)
+        m_sq_ring_size = m_cq_ring_size = std::max(m_sq_ring_size, m_cq_ring_size);
+    void *sq_ring = ::mmap(NULL, m_sq_ring_size, PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+    if (sq_ring == MAP_FAILED) {
+        close_ring();
+        return;
+    }
+    m_sq_ring = sq_ring;
+    if (single_mmap) {
+        m_cq_ring = m_sq_ring;
+    } else {
+        void *cq_ring = ::mmap(NULL, m_cq_ring_size, PROT_READ | PROT_WRITE,
+                               MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+        if (cq_ring == MAP_FAILED) {
+            close_ring();
+            return;
+        }
+        m_cq_ring = cq_ring;
+    }
+    m_sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    void *sqes = ::mmap(NULL, m_sqes_size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        close_ring();
+        return;
+    }
+    m_sqes = static_cast<io_uring_sqe*>(sqes);
+
+    m_sq_head = ring_pointer<uint32_t>(m_sq_ring, params.sq_off.head);
+    m_sq_tail = ring_pointer<uint32_t>(m_sq_ring, params.sq_off.tail);
+    m_sq_mask = ring_pointer<uint32_t>(m_sq_ring, params.sq_off.ring_mask);
+    m_sq_flags = ring_pointer<uint32_t>(m_sq_ring, params.sq_off.flags);
+    m_sq_array = ring_pointer<uint32_t>(m_sq_ring, params.sq_off.array);
+    m_cq_head = ring_pointer<uint32_t>(m_cq_ring, params.cq_off.head);
+    m_cq_tail = ring_pointer<uint32_t>(m_cq_ring, params.cq_off.tail);
+    m_cq_mask = ring_pointer<uint32_t>(m_cq_ring, params.cq_off.ring_mask);
+    m_cqes = ring_pointer<io_uring_cqe>(m_cq_ring, params.cq_off.cqes);
+    m_sq_entries = params.sq_entries;
+    m_sq_local_tail = *m_sq_tail;
+
+    // ring slot n always holds submission queue entry n
+    for (uint32_t n = 0; n < params.sq_entries; ++n)
+        m_sq_array[n] = n;
+
+    // the kernel signals an eventfd whenever completions are posted
+    const int event_fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (event_fd < 0) {
+        close_ring();
+        return;
+    }
+    if (io_uring_register(ring_fd, IORING_REGISTER_EVENTFD, &event_fd, 1) < 0) {
+        ::close(event_fd);
+        close_ring();
+        return;
+    }
+    asio::error_code ec;
+    m_eventfd.assign(event_fd, ec);
+    if (ec) {
+        ::close(event_fd);
+        close_ring();
+        return;
+    }
+
+    // an empty table of registered buffers, which are added as connections
+    // register their read buffers (optional: reads work without it)
+    io_uring_rsrc_register buffer_table;
+    std::memset(&buffer_table, 0, sizeof(buffer_table));
+    buffer_table.nr = MAX_REGISTERED_BUFFERS;
+    buffer_table.flags = IORING_RSRC_REGISTER_SPARSE;
+    if (io_uring_register(ring_fd, IORING_REGISTER_BUFFERS2, &buffer_table, sizeof(buffer_table)) == 0) {
+        m_has_buffer_table = true;
+        m_free_buffers.reserve(MAX_REGISTERED_BUFFERS);
+        for (int n = MAX_REGISTERED_BUFFERS - 1; n >= 0; --n)
+            m_free_buffers.push_back(n);
+    }
+}
+
+void uring_service::close_ring(void)
+{
+    // assumes that the service lock has already been acquired (or that the
+    // ring has not been shared yet)
+    asio::error_code ec;
+    m_eventfd.close(ec);
+    if (m_sqes != NULL)
+        ::munmap(m_sqes, m_sqes_size);
+    if (m_cq_ring != NULL && m_cq_ring != m_sq_ring)
+        ::munmap(m_cq_ring, m_cq_ring_size);
+    if (m_sq_ring != NULL)
+        ::munmap(m_sq_ring, m_sq_ring_size);
+    m_sqes = NULL;
+    m_cq_ring = m_sq_ring = NULL;
+    if (m_ring_fd >= 0)
+        ::close(m_ring_fd);
+    m_ring_fd = -1;
+    m_has_buffer_table = false;
+    m_free_buffers.clear();
+}
+
+int uring_service::register_buffer(void *data, std::size_t size)
+{
+    std::unique_lock<std::mutex> service_lock(m_mutex);
+    if (m_ring_fd < 0 || ! m_has_buffer_table || m_free_buffers.empty())
+        return -1;
+    const int index = m_free_buffers.back();
+    iovec buffer;
+    buffer.iov_base = data;
+    buffer.iov_len = size;
+    io_uring_rsrc_update2 update;
+    std::memset(&update, 0, sizeof(update));
+    update.offset = index;
+    update.data = reinterpret_cast<uint64_t>(&buffer);
+    update.nr = 1;
+    // fails if the process may not lock any more memory
+    if (io_uring_register(m_ring_fd, IORING_REGISTER_BUFFERS_UPDATE, &update, sizeof(update)) < 1)
+        return -1;
+    m_free_buffers.pop_back();
+    return index;
+}
+
+void uring_service::unregister_buffer(int index)
+{
+    std::unique_lock<std::mutex> service_lock(m_mutex);
+    if (m_ring_fd < 0 || index < 0)
+        return;
+    // operations that still use the buffer keep it registered until they finish
+    iovec buffer;
+    buffer.iov_base = NULL;
+    buffer.iov_len = 0;
+    io_uring_rsrc_update2 update;
+    std::memset(&update, 0, sizeof(update));
+    update.offset = index;
+    update.data = reinterpret_cast<uint64_t>(&buffer);
+    update.nr = 1;
+    io_uring_register(m_ring_fd, IORING_REGISTER_BUFFERS_UPDATE, &update, sizeof(update));
+    m_free_buffers.push_back(index);
+}
+
+void uring_service::cancel(int fd)
+{
+    std::unique_lock<std::mutex> service_lock(m_mutex);
+    if (fd < 0)
+        return;
+    prepare_cancel(fd, IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL);
+    submit();
+}
+
+std::size_t uring_service::size(void) const
+{
+    std::unique_lock<std::mutex> service_lock(m_mutex);
+    return m_num_operations;
+}
+
+void uring_service::shutdown(void)
+{
+    std::vector<operation*> ops;
+    {
+        std::unique_lock<std::mutex> service_lock(m_mutex);
+        if (m_ring_fd >= 0 && m_num_operations > 0) {
+            // cancel everything, and wait until the kernel has finished with
+            // the memory of the operations before releasing them
+            prepare_cancel(-1, IORING_ASYNC_CANCEL_ANY);
+            submit();
+            while (m_num_operations > 0) {
+                uint32_t head = *m_cq_head;
+                const uint32_t tail = load_acquire(m_cq_tail);
+                for (; head != tail; ++head) {
+                    const io_uring_cqe& cqe = m_cqes[head & *m_cq_mask];
+                    if (cqe.user_data == INTERNAL_USER_DATA)
+                        continue;
+                    operation *op = reinterpret_cast<operation*>(cqe.user_data);
+                    const bool more = (cqe.flags & IORING_CQE_F_MORE) != 0;
+                    remove(*op, more);
+                    if (! more)
+                        ops.push_back(op);
+                }
+                store_release(m_cq_head, head);
+                if (m_num_operations == 0
+                    || io_uring_enter(m_ring_fd, 0, 1, IORING_ENTER_GETEVENTS) < 0)
+                    break;
+            }
+        }
+        close_ring();
+        // operations that never completed (only if waiting failed)
+        for (operation *op = m_operations; op != NULL; op = op->m_next)
+            ops.push_back(op);
+        m_operations = NULL;
+        m_num_operations = 0;
+    }
+
+    // handlers are released without the lock, since they may own connections
+    // that unregister their buffers
+    for (std::vector<operation*>::iterator i = ops.begin(); i != ops.end(); ++i)
+        (*i)->destroy();
+}
+
+io_uring_sqe *uring_service::get_sqe(operation *op)
+{
+    // assumes that the service lock has already been acquired
+    if (m_ring_fd < 0)
+        return NULL;
+    if (m_sq_local_tail - load_acquire(m_sq_head) >= m_sq_entries) {
+        // the queue is full of entries that the kernel did not accept yet
+        submit();
+        if (m_sq_local_tail - load_acquire(m_sq_head) >= m_sq_entries)
+            return NULL;
+    }
+    io_uring_sqe *sqe = &m_sqes[m_sq_local_tail & *m_sq_mask];
+    std::memset(sqe, 0, sizeof(io_uring_sqe));
+    ++m_sq_local_tail;
+    ++m_num_unsubmitted;
+
+    if (op == NULL) {
+        sqe->user_data = INTERNAL_USER_DATA;
+    } else {
+        sqe->user_data = reinterpret_cast<uint64_t>(op);
+        op->m_prev = NULL;
+        op->m_next = m_operations;
+        if (m_operations != NULL)
+            m_operations->m_prev = op;
+        m_operations = op;
+        ++m_num_operations;
+    }
+    wait_for_completions();
+    return sqe;
+}
+
+void uring_service::submit(void)
+{
+    // assumes that the service lock has already been acquired
+    if (m_num_unsubmitted == 0 || m_ring_fd < 0)
+        return;
+    store_release(m_sq_tail, m_sq_local_tail);
+    const int num_submitted = io_uring_enter(m_ring_fd, m_num_unsubmitted, 0, 0);
+    // if the kernel is busy (too many completions are waiting to be reaped),
+    // the rest is submitted after the next completions are reaped
+    if (num_submitted > 0)
+        m_num_unsubmitted -= num_submitted;
+}
+
+void uring_service::prepare_cancel(int fd, uint32_t flags)
+{
+    // assumes that the service lock has already been acquired
+    io_uring_sqe *sqe = get_sqe(NULL);
+    if (sqe == NULL)
+        return;
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = fd;
+    sqe->cancel_flags = flags;
+    // the cancellation's own completion must be reaped too
+    ++m_num_cancels;
+}
+
+void uring_service::fail(operation& op, std::unique_lock<std::mutex>& service_lock)
+{
+    const int32_t res = (m_ring_fd < 0 ? -EBADF : -EBUSY);
+    service_lock.unlock();
+    op.complete(*this, res, false);
+}
+
+void uring_service::start_receive(operation& op, int fd, const asio::mutable_buffer& buffer,
+                                  int buffer_index)
+{
+    std::unique_lock<std::mutex> service_lock(m_mutex);
+    io_uring_sqe *sqe = get_sqe(&op);
+    if (sqe == NULL) {
+        fail(op, service_lock);
+        return;
+    }
+    if (buffer_index >= 0) {
+        sqe->opcode = IORING_OP_READ_FIXED;
+        sqe->buf_index = static_cast<uint16_t>(buffer_index);
+        sqe->off = 0;   // sockets cannot seek
+    } else {
+        sqe->opcode = IORING_OP_RECV;
+    }
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(buffer.data());
+    sqe->len = static_cast<uint32_t>(buffer.size());
+    submit();
+}
+
+void uring_service::start_send(operation& op, int fd, const msghdr& message)
+{
+    std::unique_lock<std::mutex> service_lock(m_mutex);
+    io_uring_sqe *sqe = get_sqe(&op);
+    if (sqe == NULL) {
+        fail(op, service_lock);
+        return;
+    }
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(&message);
+    sqe->len = 1;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    submit();
+}
+
+void uring_service::start_accept(operation& op, int fd)
+{
+    std::unique_lock<std::mutex> service_lock(m_mutex);
+    io_uring_sqe *sqe = get_sqe(&op);
+    if (sqe == NULL) {
+        fail(op, service_lock);
+        return;
+    }
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_CLOEXEC;
+    submit();
+}
+
+void uring_service::start_wait_readable(operation& op, int fd)
+{
+    std::unique_lock<std::mutex> service_lock(m_mutex);
+    io_uring_sqe *sqe = get_sqe(&op);
+    if (sqe == NULL) {
+        fail(op, service_lock);
+        return;
+    }
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = POLLIN;
+    submit();
+}
+
+void uring_service::start_read_file(operation& op, int fd, const asio::mutable_buffer& buffer,
+                                    uint64_t offset)
+{
+    std::unique_lock<std::mutex> service_lock(m_mutex);
+    io_uring_sqe *sqe = get_sqe(&op);
+    if (sqe == NULL) {
+        fail(op, service_lock);
+        return;
+    }
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(buffer.data());
+    sqe->len = static_cast<uint32_t>(buffer.size());
+    sqe->off = offset;
+    submit();
+}
+
+void uring_service::wait_for_completions(void)
+{
+    // assumes that the service lock has already been acquired
+    if (m_is_waiting)
+        return;
+    m_is_waiting = true;
+    m_eventfd.async_wait(asio::posix::stream_descriptor::wait_read,
+                         std::bind(&uring_service::handle_completions,
+                                   this, std::placeholders::_1));
+}
+
+void uring_service::handle_completions(const asio::error_code& ec)
+{
+    // the eventfd is only closed when the service shuts down
+    if (ec == asio::error::operation_aborted)
+        return;
+
+    // reset the eventfd before reaping, so that no signal can be missed
+    uint64_t num_signals;
+    if (::read(m_eventfd.native_handle(), &num_signals, sizeof(num_signals)) < 0) {
+        // nothing to do: EAGAIN if another thread reset it
+    }
+
+    struct completion_type {
+        operation *     m_op;
+        int32_t         m_res;
+        bool            m_more;
+    };
+    completion_type completions[MAX_REAPED_COMPLETIONS];
+
+    while (true) {
+        uint32_t num_completions = 0;
+        {
+            std::unique_lock<std::mutex> service_lock(m_mutex);
+            if (m_ring_fd < 0) {
+                m_is_waiting = false;
+                return;
+            }
+            // completions that did not fit in the queue are kept by the kernel
+            if (load_acquire(m_sq_flags) & IORING_SQ_CQ_OVERFLOW)
+                io_uring_enter(m_ring_fd, 0, 0, IORING_ENTER_GETEVENTS);
+
+            uint32_t head = *m_cq_head;
+            const uint32_t tail = load_acquire(m_cq_tail);
+            for (; head != tail && num_completions < MAX_REAPED_COMPLETIONS; ++head) {
+                const io_uring_cqe& cqe = m_cqes[head & *m_cq_mask];
+                if (cqe.user_data == INTERNAL_USER_DATA) {
+                    --m_num_cancels;
+                    continue;
+                }
+                completion_type& c = completions[num_completions++];
+                c.m_op = reinterpret_cast<operation*>(cqe.user_data);
+                c.m_res = cqe.res;
+                c.m_more = (cqe.flags & IORING_CQE_F_MORE) != 0;
+                remove(*c.m_op, c.m_more);
+            }
+            store_release(m_cq_head, head);
+
+            if (head == tail && num_completions == 0) {
+                // all caught up: submit anything the kernel was too busy to
+                // accept, and keep waiting while anything is outstanding
+                submit();
+                m_is_waiting = false;
+                if (m_num_operations > 0 || m_num_cancels > 0)
+                    wait_for_completions();
+                return;
+            }
+        }
+
+        // operations post their handlers (or submit more work) without the lock
+        for (uint32_t n = 0; n < num_completions; ++n)
+            completions[n].m_op->complete(*this, completions[n].m_res, completions[n].m_more);
+    }
+}
+
+void uring_service::remove(operation& op, bool more)
+{
+    // assumes that the service lock has already been acquired
+    if (more)
+        return;
+    if (op.m_prev != NULL)
+        op.m_prev->m_next = op.m_next;
+    else
+        m_operations = op.m_next;
+    if (op.m_next != NULL)
+        op.m_next->m_prev = op.m_prev;
+    op.m_prev = op.m_next = NULL;
+    --m_num_operations;
+}
+
+
+}   // end namespace tcp
+}   // end namespace pion
+
+#endif  // PION_HAVE_IO_URING
@@ -0,0 +1,280 @@
+// ---------------------------------------------------------------------
+// pion:  a Boost C++ framework for building lightweight HTTP interfaces
+// ---------------------------------------------------------------------
+// Copyright (C) 2021 Wang Qiang  (https://github.com/dnybz/pion)
+// Copyright (C) 2007-2014 Splunk Inc.  (https://github.com/splunk/pion)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <pion/config.hpp>
+#include <pion/coroutine.hpp>
+#include <pion/scheduler.hpp>
+#include <pion/tcp/awaitable.hpp>
+#include <pion/http/awaitable.hpp>
+#include <pion/http/server.hpp>
+#include <pion/http/response_writer.hpp>
+#ifdef PION_HAVE_IO_URING
+    #include <pion/tcp/uring_service.hpp>
+#endif
+#include <boost/test/unit_test.hpp>
+#include "../net/net_tests.hpp"
+
+#ifndef PION_HAVE_COROUTINES
+    #error "the coroutine tests must be compiled with C++20 coroutine support"
+#endif
+
+using namespace pion;
+
+
+/// returns the I/O engines that can be tested
+static std::vector<scheduler::io_engine_type> get_io_engines(void)
+{
+    std::vector<scheduler::io_engine_type> engines(1, scheduler::IO_ENGINE_REACTOR);
+#ifdef PION_HAVE_IO_URING
+    if (tcp::uring_service::is_supported())
+        engines.push_back(scheduler::IO_ENGINE_URING);
+#endif
+    return engines;
+}
+
+
+///
+/// CoroutineEchoServer: TCP server whose connections are handled by a
+/// coroutine that writes back everything it reads
+///
+class CoroutineEchoServer
+    : public tcp::server
+{
+public:
+    virtual ~CoroutineEchoServer() {}
+
+    /**
+     * creates a new CoroutineEchoServer
+     *
+     * @param sched the scheduler used to manage worker threads
+     */
+    explicit CoroutineEchoServer(scheduler& sched)
+        : tcp::server(sched, 0), m_num_finished(0)
+    {}
+
+    /// returns the number of connections whose coroutine has finished
+    inline int get_num_finished(void) const { return m_num_finished; }
+
+    /**
+     * starts the echo coroutine for a new connection
+     *
+     * @param tcp_conn the new TCP connection to handle
+     */
+    virtual void handle_connection(const tcp::connection_ptr& tcp_conn) {
+        echo(tcp_conn);
+    }
+
+private:
+
+    /// writes back what is read until the connection is closed
+    pion::coroutine echo(tcp::connection_ptr tcp_conn) {
+        for (;;) {
+            const tcp::io_result read_result = co_await tcp::async_read_some(*tcp_conn);
+            if (read_result.m_error)
+                break;
+            const tcp::io_result write_result = co_await tcp::async_write(*tcp_conn,
+                asio::buffer(tcp_conn->get_read_buffer().data(), read_result.m_bytes));
+            if (write_result.m_error)
+                break;
+        }
+        ++m_num_finished;
+        tcp_conn->set_lifecycle(tcp::connection::LIFECYCLE_CLOSE);
+        tcp_conn->finish();
+    }
+
+    /// number of connections whose coroutine has finished
+    std::atomic<int>    m_num_finished;
+};
+
+
+///
+/// CoroutineHttpServer: TCP server whose connections are handled by a
+/// coroutine that reads each request and sends back its resource
+///
+class CoroutineHttpServer
+    : public tcp::server
+{
+public:
+    virtual ~CoroutineHttpServer() {}
+
+    /**
+     * creates a new CoroutineHttpServer
+     *
+     * @param sched the scheduler used to manage worker threads
+     */
+    explicit CoroutineHttpServer(scheduler& sched)
+        : tcp::server(sched, 0)
+    {}
+
+    /**
+     * starts a coroutine that handles the next request on a connection
+     * (finish() calls this again for each request that is kept alive)
+     *
+     * @param tcp_conn the TCP connection to handle
+     */
+    virtual void handle_connection(const tcp::connection_ptr& tcp_conn) {
+        handle_request(tcp_conn);
+    }
+
+private:
+
+    /// reads a request and sends a response that repeats its resource
+    pion::coroutine handle_request(tcp::connection_ptr tcp_conn) {
+        http::read_result result = co_await http::async_read_request(tcp_conn);
+        if (result.m_error || ! result.m_request->is_valid()) {
+            tcp_conn->set_lifecycle(tcp::connection::LIFECYCLE_CLOSE);
+            tcp_conn->finish();
+            co_return;
+        }
+        http::response_writer_ptr writer(http::response_writer::create(tcp_conn, *result.m_request));
+        writer->write("resource=");
+        writer->write(result.m_request->get_resource());
+        co_await http::async_send(writer);
+        tcp_conn->finish();
+    }
+};
+
+
+///
+/// ChunkedHandler: coroutine request handler for http::server that sends
+/// its response in chunks
+///
+struct ChunkedHandler {
+    pion::coroutine operator()(http::request_ptr http_request_ptr, tcp::connection_ptr tcp_conn) {
+        http::response_writer_ptr writer(http::response_writer::create(tcp_conn, *http_request_ptr));
+        for (int n = 0; n < 3; ++n) {
+            writer->write("chunk ");
+            writer->write(n);
+            const tcp::io_result result = co_await http::async_send_chunk(writer);
+            if (result.m_error) {
+                tcp_conn->set_lifecycle(tcp::connection::LIFECYCLE_CLOSE);
+                tcp_conn->finish();
+                co_return;
+            }
+            writer->clear();
+        }
+        co_await http::async_send_final_chunk(writer);
+        tcp_conn->finish();
+    }
+};
+
+
+// coroutine Test Cases
+
+BOOST_AUTO_TEST_SUITE(CoroutineTests_S)
+
+BOOST_AUTO_TEST_CASE(checkCoroutineEchoesWhatItReads) {
+    const std::vector<scheduler::io_engine_type> engines(get_io_engines());
+    for (std::size_t e = 0; e < engines.size(); ++e) {
+        BOOST_TEST_CHECKPOINT("I/O engine " << engines[e]);
+        one_to_one_scheduler sched;
+        sched.set_num_threads(1);
+        sched.set_io_engine(engines[e]);
+        CoroutineEchoServer server(sched);
+        server.start();
+
+        // the coroutine suspends for each read and write, and resumes when
+        // they finish
+        asio::io_service io_service;
+        tcp::connection tcp_conn(io_service);
+        BOOST_REQUIRE(! tcp_conn.connect(asio::ip::address::from_string("127.0.0.1"), server.get_port()));
+        for (int n = 0; n < 5; ++n) {
+            const std::string line("line " + std::to_string(n) + "\n");
+            asio::error_code ec;
+            tcp_conn.write(asio::buffer(line), ec);
+            BOOST_REQUIRE(! ec);
+            BOOST_CHECK_EQUAL(test::read_until(tcp_conn, "\n"), line);
+        }
+        BOOST_CHECK_EQUAL(server.get_num_finished(), 0);
+
+        // closing the connection ends the coroutine, which finishes it
+        tcp_conn.close();
+        BOOST_CHECK(test::wait_until([&server]() { return server.get_num_finished() == 1; }));
+        BOOST_CHECK(test::wait_until([&server]() { return server.get_connections() == 0; }));
+
+        server.stop();
+        sched.shutdown();
+    }
+}
+
+BOOST_AUTO_TEST_CASE(checkCoroutineReadsRequestsAndSendsResponses) {
+    one_to_one_scheduler sched;
+    sched.set_num_threads(1);
+    CoroutineHttpServer server(sched);
+    server.start();
+
+    // each request that keeps the connection alive starts a new coroutine
+    asio::io_service io_service;
+    tcp::connection tcp_conn(io_service);
+    BOOST_REQUIRE(! tcp_conn.connect(asio::ip::address::from_string("127.0.0.1"), server.get_port()));
+    for (int n = 0; n < 3; ++n) {
+        const std::string resource("/request" + std::to_string(n));
+        const std::string response(test::send_request(tcp_conn,
+            "GET " + resource + " HTTP/1.1\r\nHost: localhost\r\n\r\n"));
+        BOOST_CHECK_EQUAL(response.compare(0, 15, "HTTP/1.1 200 OK"), 0);
+        BOOST_CHECK(response.find("Connection: close") == std::string::npos);
+        BOOST_CHECK(response.find("\r\n\r\nresource=" + resource) != std::string::npos);
+    }
+    BOOST_CHECK_EQUAL(server.get_connections(), 1U);
+
+    // the last request closes the connection
+    const std::string response(test::send_request(server.get_port(), "/last"));
+    BOOST_CHECK(response.find("Connection: close") != std::string::npos);
+    BOOST_CHECK(response.find("\r\n\r\nresource=/last") != std::string::npos);
+
+    // a request that cannot be parsed resumes the coroutine with an invalid
+    // request, and the coroutine closes the connection
+    tcp::connection bad_conn(io_service);
+    BOOST_REQUIRE(! bad_conn.connect(asio::ip::address::from_string("127.0.0.1"), server.get_port()));
+    asio::error_code ec;
+    bad_conn.write(asio::buffer(std::string("GET /\x01 HTTP/1.1\r\n\r\n")), ec);
+    bad_conn.read_some(ec);
+    BOOST_CHECK(ec == asio::error::eof || ec == asio::error::connection_reset);
+
+    tcp_conn.close();
+    BOOST_CHECK(test::wait_until([&server]() { return server.get_connections() == 0; }));
+    server.stop();
+    sched.shutdown();
+}
+
+BOOST_AUTO_TEST_CASE(checkHttpServerRunsCoroutineHandlers) {
+    one_to_one_scheduler sched;
+    sched.set_num_threads(1);
+    http::server server(sched, 0);
+    const http::coroutine_handler_t handler = ChunkedHandler();
+    server.add_resource("/chunks", handler);
+    server.start();
+
+    // the chunks are sent one at a time, then the final chunk
+    asio::io_service io_service;
+    tcp::connection tcp_conn(io_service);
+    BOOST_REQUIRE(! tcp_conn.connect(asio::ip::address::from_string("127.0.0.1"), server.get_port()));
+    for (int n = 0; n < 2; ++n) {
+        asio::error_code ec;
+        tcp_conn.write(asio::buffer(std::string("GET /chunks HTTP/1.1\r\nHost: localhost\r\n\r\n")), ec);
+        BOOST_REQUIRE(! ec);
+        const std::string response(test::read_until(tcp_conn, "0\r\n\r\n"));
+        BOOST_CHECK_EQUAL(response.compare(0, 15, "HTTP/1.1 200 OK"), 0);
+        BOOST_CHECK(response.find("Transfer-Encoding: chunked") != std::string::npos);
+        BOOST_CHECK(response.find("\r\n7\r\nchunk 0\r\n7\r\nchunk 1\r\n7\r\nchunk 2\r\n0\r\n\r\n")
+                    != std::string::npos);
+    }
+
+    tcp_conn.close();
+    BOOST_CHECK(test::wait_until([&server]() { return server.get_connections() == 0; }));
+    server.stop();
+    sched.shutdown();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,223 @@
+// ---------------------------------------------------------------------
+// pion:  a Boost C++ framework for building lightweight HTTP interfaces
+// ---------------------------------------------------------------------
+// Copyright (C) 2021 Wang Qiang  (https://github.com/dnybz/pion)
+// Copyright (C) 2007-2014 Splunk Inc.  (https://github.com/splunk/pion)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include <algorithm>
+#include <atomic>
+#include <pion/config.hpp>
+#include <pion/http/server.hpp>
+#include <pion/http/response_writer.hpp>
+#include <pion/tcp/handler_allocator.hpp>
+#include <boost/test/unit_test.hpp>
+#include "net_tests.hpp"
+
+using namespace pion;
+
+
+///
+/// EchoServer: TCP server that keeps each connection open and sends back
+/// whatever it receives, using only tcp::connection's asynchronous operations
+///
+class EchoServer
+    : public tcp::server
+{
+public:
+    virtual ~EchoServer() {}
+
+    /// creates a new EchoServer
+    EchoServer(void) : tcp::server(0) {}
+
+
+protected:
+
+    /**
+     * starts reading from a new connection
+     *
+     * @param tcp_conn the new TCP connection to handle
+     */
+    virtual void handle_connection(const tcp::connection_ptr& tcp_conn) {
+        tcp_conn->set_lifecycle(tcp::connection::LIFECYCLE_KEEPALIVE);
+        read_more(tcp_conn);
+    }
+
+
+private:
+
+    /**
+     * reads the next data from a connection, and sends it back
+     *
+     * @param tcp_conn the TCP connection to the client
+     */
+    void read_more(const tcp::connection_ptr& tcp_conn) {
+        tcp_conn->async_read_some([this, tcp_conn](const asio::error_code& read_error,
+                                                   std::size_t bytes_read)
+        {
+            if (read_error) {
+                tcp_conn->set_lifecycle(tcp::connection::LIFECYCLE_CLOSE);
+                tcp_conn->finish();
+                return;
+            }
+            tcp_conn->async_write(asio::buffer(tcp_conn->get_read_buffer().data(), bytes_read),
+                                  [this, tcp_conn](const asio::error_code& write_error, std::size_t)
+            {
+                if (write_error) {
+                    tcp_conn->set_lifecycle(tcp::connection::LIFECYCLE_CLOSE);
+                    tcp_conn->finish();
+                } else {
+                    read_more(tcp_conn);
+                }
+            });
+        });
+    }
+};
+
+
+/// ArenaServer: HTTP server that records how many asynchronous operations
+/// each connection had to allocate from the heap instead of its handler arena
+///
+class ArenaServer
+    : public http::server
+{
+public:
+    virtual ~ArenaServer() {}
+
+    /// creates a new ArenaServer that responds to "/hello"
+    ArenaServer(void) : http::server(0), m_heap_allocations(0) {
+        add_resource("/hello", std::bind(&ArenaServer::handle_hello, this,
+                                         std::placeholders::_1, std::placeholders::_2));
+    }
+
+    /// returns the heap allocations made by the last connection that sent a request
+    inline std::size_t get_heap_allocations(void) const { return m_heap_allocations; }
+
+
+private:
+
+    /**
+     * responds to a request and records the connection's heap allocations
+     *
+     * @param http_request_ptr the request to respond to
+     * @param tcp_conn the TCP connection to the client
+     */
+    void handle_hello(const http::request_ptr& http_request_ptr,
+                      const tcp::connection_ptr& tcp_conn)
+    {
+        m_heap_allocations = tcp_conn->get_handler_memory().get_heap_allocations();
+        http::response_writer_ptr writer(http::response_writer::create(tcp_conn, *http_request_ptr,
+                                                                       std::bind(&tcp::connection::finish, tcp_conn)));
+        writer->write_no_copy("Hello there!");
+        writer->send();
+    }
+
+    /// heap allocations made by the last connection that sent a request
+    std::atomic<std::size_t>    m_heap_allocations;
+};
+
+
+// handler_memory Test Cases
+
+BOOST_AUTO_TEST_SUITE(HandlerMemoryTests_S)
+
+BOOST_AUTO_TEST_CASE(checkSmallOperationsUseTheArena) {
+    tcp::handler_memory memory;
+    void *blocks[tcp::handler_memory::NUM_BLOCKS];
+    for (int n = 0; n < tcp::handler_memory::NUM_BLOCKS; ++n)
+        blocks[n] = memory.allocate(64);
+    BOOST_CHECK_EQUAL(memory.get_heap_allocations(), 0U);
+
+    // all blocks are in use, so the next operation comes from the heap
+    void *extra = memory.allocate(64);
+    BOOST_CHECK_EQUAL(memory.get_heap_allocations(), 1U);
+    memory.deallocate(extra);
+
+    // released blocks are reused
+    memory.deallocate(blocks[0]);
+    BOOST_CHECK(memory.allocate(64) == blocks[0]);
+    BOOST_CHECK_EQUAL(memory.get_heap_allocations(), 1U);
+    for (int n = 0; n < tcp::handler_memory::NUM_BLOCKS; ++n)
+        memory.deallocate(blocks[n]);
+}
+
+BOOST_AUTO_TEST_CASE(checkLargeOperationsUseTheHeap) {
+    tcp::handler_memory memory;
+    void *large = memory.allocate(tcp::handler_memory::BLOCK_SIZE + 1);
+    BOOST_CHECK_EQUAL(memory.get_heap_allocations(), 1U);
+    memory.deallocate(large);
+}
+
+BOOST_AUTO_TEST_CASE(checkConnectionReadsAndWritesDoNotAllocate) {
+    EchoServer server;
+    server.start();
+
+    asio::io_service io_service;
+    tcp::connection tcp_conn(io_service);
+    asio::error_code error_code;
+    error_code = tcp_conn.connect(asio::ip::address::from_string("127.0.0.1"), server.get_port());
+    BOOST_REQUIRE(! error_code);
+
+    // the client's synchronous reads and writes do not allocate, so once the
+    // server's connection is set up, the round trips must not allocate either
+    std::size_t num_allocations = 0;
+    for (int n = 0; n < 110; ++n) {
+        if (n == 10)
+            num_allocations = test::get_num_allocations();
+        tcp_conn.write(asio::buffer("hello", 5), error_code);
+        BOOST_REQUIRE(! error_code);
+        std::size_t bytes_read = 0;
+        while (bytes_read < 5 && ! error_code)
+            bytes_read += tcp_conn.read_some(error_code);
+        BOOST_REQUIRE(! error_code);
+    }
+    BOOST_CHECK_EQUAL(test::get_num_allocations() - num_allocations, 0U);
+
+    tcp_conn.close();
+    server.stop();
+}
+
+BOOST_AUTO_TEST_CASE(checkKeepAliveRequestsAllocateTheSameEachTime) {
+    ArenaServer server;
+    server.start();
+
+    asio::io_service io_service;
+    tcp::connection tcp_conn(io_service);
+    asio::error_code error_code;
+    error_code = tcp_conn.connect(asio::ip::address::from_string("127.0.0.1"), server.get_port());
+    BOOST_REQUIRE(! error_code);
+
+    // the request, its parser and the response writer are still allocated
+    // for each request, but after the first few requests the number of
+    // allocations per request does not change, and none of them are for
+    // asio operations that did not fit in the connection's arena (only the
+    // server's allocations are counted)
+    test::set_allocations_counted(false);
+    const std::string request("GET /hello HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    std::size_t num_allocations[3] = { 0, 0, 0 };
+    for (int n = 0; n < 110; ++n) {
+        if (n % 50 == 10)
+            num_allocations[n / 50] = test::get_num_allocations();
+        const std::string response(test::send_request(tcp_conn, request));
+        BOOST_REQUIRE_EQUAL(response.compare(0, 15, "HTTP/1.1 200 OK"), 0);
+        BOOST_REQUIRE_EQUAL(server.get_heap_allocations(), 0U);
+    }
+    num_allocations[2] = test::get_num_allocations();
+    BOOST_TEST_MESSAGE("allocations per keep-alive request: "
+                       << (num_allocations[2] - num_allocations[1]) / 50);
+
+    // the server's timers may allocate now and then, but the two windows
+    // differ by less than one allocation per request
+    const std::size_t first_window = num_allocations[1] - num_allocations[0];
+    const std::size_t second_window = num_allocations[2] - num_allocations[1];
+    BOOST_CHECK_LT(std::max(first_window, second_window) - std::min(first_window, second_window), 50U);
+    test::set_allocations_counted(true);
+
+    tcp_conn.close();
+    server.stop();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
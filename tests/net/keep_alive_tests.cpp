@@ -0,0 +1,161 @@
+// ---------------------------------------------------------------------
+// pion:  a Boost C++ framework for building lightweight HTTP interfaces
+// ---------------------------------------------------------------------
+// Copyright (C) 2021 Wang Qiang  (https://github.com/dnybz/pion)
+// Copyright (C) 2007-2014 Splunk Inc.  (https://github.com/splunk/pion)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <pion/config.hpp>
+#include <pion/scheduler.hpp>
+#include <pion/tcp/buffer_pool.hpp>
+#ifdef PION_HAVE_IO_URING
+    #include <pion/tcp/uring_service.hpp>
+#endif
+#include <boost/test/unit_test.hpp>
+#include "net_tests.hpp"
+
+using namespace pion;
+
+
+/// request for the "/hello" resource, on a connection that is kept alive
+static const std::string KEEP_ALIVE_REQUEST("GET /hello HTTP/1.1\r\nHost: localhost\r\n\r\n");
+
+
+/// returns the I/O engines that can be tested
+static std::vector<scheduler::io_engine_type> get_io_engines(void)
+{
+    std::vector<scheduler::io_engine_type> engines(1, scheduler::IO_ENGINE_REACTOR);
+#ifdef PION_HAVE_IO_URING
+    if (tcp::uring_service::is_supported())
+        engines.push_back(scheduler::IO_ENGINE_URING);
+#endif
+    return engines;
+}
+
+
+/// returns true if a response is "200 OK" and keeps the connection alive
+static bool is_kept_alive(const std::string& response)
+{
+    return response.compare(0, 15, "HTTP/1.1 200 OK") == 0
+        && response.find("Connection: close") == std::string::npos;
+}
+
+
+/// returns true if the server closed a connection after what was read
+static bool is_closed_by_server(tcp::connection& tcp_conn)
+{
+    asio::error_code ec;
+    tcp_conn.read_some(ec);
+    return ec == asio::error::eof || ec == asio::error::connection_reset;
+}
+
+
+// keep-alive Test Cases
+
+BOOST_AUTO_TEST_SUITE(KeepAliveTests_S)
+
+BOOST_AUTO_TEST_CASE(checkIdleConnectionsReleaseTheirReadBuffers) {
+    const std::vector<scheduler::io_engine_type> engines(get_io_engines());
+    for (std::size_t e = 0; e < engines.size(); ++e) {
+        BOOST_TEST_CHECKPOINT("I/O engine " << engines[e]);
+        one_to_one_scheduler sched;
+        sched.set_num_threads(1);
+        sched.set_io_engine(engines[e]);
+        test::hello_http_server server(sched);
+        server.start();
+        const tcp::buffer_pool& pool = asio::use_service<tcp::buffer_pool>(sched.get_io_service(0));
+
+        // connections that wait for their first request are reading
+        asio::io_service io_service;
+        std::vector<tcp::connection_ptr> connections;
+        for (int n = 0; n < 4; ++n) {
+            connections.push_back(std::make_shared<tcp::connection>(io_service));
+            BOOST_REQUIRE(! connections.back()->connect(asio::ip::address::from_string("127.0.0.1"),
+                                                        server.get_port()));
+        }
+        BOOST_REQUIRE(test::wait_until([&pool]() { return pool.get_num_in_use() == 4; }));
+
+        // between requests, they give their buffers back
+        for (int r = 0; r < 3; ++r) {
+            for (std::size_t n = 0; n < connections.size(); ++n)
+                BOOST_CHECK(is_kept_alive(test::send_request(*connections[n], KEEP_ALIVE_REQUEST)));
+            BOOST_CHECK(test::wait_until([&pool]() { return pool.get_num_in_use() == 0; }));
+            BOOST_CHECK_EQUAL(server.get_connections(), 4U);
+        }
+
+        // the released buffers are kept for the next requests
+        BOOST_CHECK_GE(pool.get_num_free(), 1U);
+
+        server.stop();
+        sched.shutdown();
+    }
+}
+
+BOOST_AUTO_TEST_CASE(checkIdleConnectionsAreClosedAfterTheTimeout) {
+    one_to_one_scheduler sched;
+    sched.set_num_threads(1);
+    test::hello_http_server server(sched);
+    server.set_keep_alive_timeout(1);
+    server.start();
+
+    asio::io_service io_service;
+    tcp::connection tcp_conn(io_service);
+    BOOST_REQUIRE(! tcp_conn.connect(asio::ip::address::from_string("127.0.0.1"), server.get_port()));
+
+    // a request that arrives within the timeout is served
+    BOOST_CHECK(is_kept_alive(test::send_request(tcp_conn, KEEP_ALIVE_REQUEST)));
+    scheduler::sleep(0, 500000000);
+    BOOST_CHECK(is_kept_alive(test::send_request(tcp_conn, KEEP_ALIVE_REQUEST)));
+
+    // then the idle connection is closed once the timeout has passed
+    const std::chrono::steady_clock::time_point idle_since = std::chrono::steady_clock::now();
+    BOOST_CHECK(is_closed_by_server(tcp_conn));
+    const long idle_milliseconds = static_cast<long>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - idle_since).count());
+    BOOST_CHECK_GE(idle_milliseconds, 900L);
+    BOOST_CHECK_LE(idle_milliseconds, 3000L);
+    BOOST_CHECK(test::wait_until([&server]() { return server.get_connections() == 0; }));
+
+    server.stop();
+    sched.shutdown();
+}
+
+BOOST_AUTO_TEST_CASE(checkLastAllowedRequestClosesTheConnection) {
+    one_to_one_scheduler sched;
+    sched.set_num_threads(1);
+    test::hello_http_server server(sched);
+    server.set_max_keep_alive_requests(3);
+    server.start();
+
+    asio::io_service io_service;
+    tcp::connection tcp_conn(io_service);
+    BOOST_REQUIRE(! tcp_conn.connect(asio::ip::address::from_string("127.0.0.1"), server.get_port()));
+    for (int n = 1; n < 3; ++n)
+        BOOST_CHECK(is_kept_alive(test::send_request(tcp_conn, KEEP_ALIVE_REQUEST)));
+
+    // the response to the last allowed request says that it closes the
+    // connection, so the request after it is never read
+    const std::string response(test::send_request(tcp_conn, KEEP_ALIVE_REQUEST));
+    BOOST_CHECK_EQUAL(response.compare(0, 15, "HTTP/1.1 200 OK"), 0);
+    BOOST_CHECK(response.find("Connection: close\r\n") != std::string::npos);
+    asio::error_code ec;
+    tcp_conn.write(asio::buffer(KEEP_ALIVE_REQUEST), ec);
+    BOOST_CHECK(is_closed_by_server(tcp_conn));
+
+    // new connections get the full number of requests again
+    tcp::connection next_conn(io_service);
+    BOOST_REQUIRE(! next_conn.connect(asio::ip::address::from_string("127.0.0.1"), server.get_port()));
+    BOOST_CHECK(is_kept_alive(test::send_request(next_conn, KEEP_ALIVE_REQUEST)));
+
+    server.stop();
+    sched.shutdown();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
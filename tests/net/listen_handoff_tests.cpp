@@ -0,0 +1,88 @@
+// ---------------------------------------------------------------------
+// pion:  a Boost C++ framework for building lightweight HTTP interfaces
+// ---------------------------------------------------------------------
+// Copyright (C) 2021 Wang Qiang  (https://github.com/dnybz/pion)
+// Copyright (C) 2007-2014 Splunk Inc.  (https://github.com/splunk/pion)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include <thread>
+#include <pion/config.hpp>
+#include <pion/tcp/listen_handoff.hpp>
+#include <boost/test/unit_test.hpp>
+#include "net_tests.hpp"
+
+using namespace pion;
+
+
+// Listening socket handoff Test Cases
+
+BOOST_AUTO_TEST_SUITE(ListenHandoffTests_S)
+
+BOOST_AUTO_TEST_CASE(checkServerAdoptsListeningSocket) {
+    // a listening socket opened by someone else, e.g. a service manager
+    asio::io_service io_service;
+    asio::ip::tcp::acceptor acceptor(io_service,
+        asio::ip::tcp::endpoint(asio::ip::address::from_string("127.0.0.1"), 0));
+    const unsigned int port = acceptor.local_endpoint().port();
+    std::vector<int> fds(1, static_cast<int>(acceptor.release()));
+
+    test::hello_server server;
+    server.set_listen_fds(fds);
+    server.start();
+    BOOST_CHECK_EQUAL(server.get_port(), port);
+    BOOST_CHECK_EQUAL(server.get_listen_fds().size(), 1U);
+    BOOST_CHECK_EQUAL(test::read_greeting(port), "Hello there!\n");
+    server.stop();
+}
+
+BOOST_AUTO_TEST_CASE(checkListeningSocketsAreHandedOff) {
+    if (! tcp::listen_handoff::is_supported())
+        return;
+    const std::string path("pion_handoff_test.sock");
+    test::hello_server old_server;
+    old_server.start();
+    const unsigned int port = old_server.get_port();
+
+    // the running server offers its socket until a new one confirms
+    tcp::listen_handoff old_handoff(path);
+    bool handed_off = false;
+    std::thread offer_thread([&]() { handed_off = old_handoff.offer(old_server.get_listen_fds()); });
+    tcp::listen_handoff new_handoff(path);
+    std::vector<int> fds;
+    for (int i = 0; i < 50 && ! new_handoff.take(fds); ++i)
+        scheduler::sleep(0, 10000000); // 0.01 seconds
+    BOOST_REQUIRE_EQUAL(fds.size(), 1U);
+
+    // until then, both servers accept from the socket
+    test::hello_server new_server;
+    new_server.set_listen_fds(fds);
+    new_server.start();
+    BOOST_CHECK_EQUAL(new_server.get_port(), port);
+    new_handoff.confirm();
+    offer_thread.join();
+    BOOST_CHECK(handed_off);
+
+    // the socket stays open after the old server has stopped
+    old_server.stop();
+    BOOST_CHECK_EQUAL(test::read_greeting(port), "Hello there!\n");
+    new_server.stop();
+}
+
+BOOST_AUTO_TEST_CASE(checkOfferCanBeCancelled) {
+    if (! tcp::listen_handoff::is_supported())
+        return;
+    test::hello_server server;
+    server.start();
+    tcp::listen_handoff handoff("pion_handoff_test.sock");
+    bool handed_off = true;
+    std::thread offer_thread([&]() { handed_off = handoff.offer(server.get_listen_fds()); });
+    handoff.cancel();
+    offer_thread.join();
+    BOOST_CHECK(! handed_off);
+    server.stop();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,253 @@
+// ---------------------------------------------------------------------
+// pion:  a Boost C++ framework for building lightweight HTTP interfaces
+// ---------------------------------------------------------------------
+// Copyright (C) 2021 Wang Qiang  (https://github.com/dnybz/pion)
+// Copyright (C) 2007-2014 Splunk Inc.  (https://github.com/splunk/pion)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include <pion/config.hpp>
+#include <asio.hpp>
+
+#ifdef ASIO_HAS_LOCAL_SOCKETS
+
+#include <atomic>
+#include <fstream>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <pion/scheduler.hpp>
+#ifdef PION_HAVE_IO_URING
+    #include <pion/tcp/uring_service.hpp>
+#endif
+#include <boost/test/unit_test.hpp>
+#include "net_tests.hpp"
+
+using namespace pion;
+
+
+///
+/// RemoteRecordingServer: hello_http_server that records what its
+/// connections report about the client
+///
+class RemoteRecordingServer
+    : public test::hello_http_server
+{
+public:
+    virtual ~RemoteRecordingServer() {}
+
+    /**
+     * creates a server that listens on a Unix domain socket
+     *
+     * @param sched the scheduler that runs the server's connections
+     * @param path the path of the socket
+     */
+    RemoteRecordingServer(scheduler& sched, const std::string& path)
+        : test::hello_http_server(sched), m_num_local(0), m_num_unspecified(0), m_num_unexposed(0)
+    {
+        set_local_endpoint(asio::local::stream_protocol::endpoint(path));
+    }
+
+    /// returns the number of requests whose connection had the local flag
+    inline std::size_t get_num_local(void) const { return m_num_local; }
+
+    /// returns the number of requests that reported no remote address or port
+    inline std::size_t get_num_unspecified(void) const { return m_num_unspecified; }
+
+    /// returns the number of requests whose connection did not expose its
+    /// tcp socket object, but did give its descriptor
+    inline std::size_t get_num_unexposed(void) const { return m_num_unexposed; }
+
+    /// records what the connection reports, then responds
+    virtual void handle_hello(const http::request_ptr& http_request_ptr,
+                              const tcp::connection_ptr& tcp_conn)
+    {
+        if (tcp_conn->get_local_flag())
+            ++m_num_local;
+        if (http_request_ptr->get_remote_ip().is_unspecified() && tcp_conn->get_remote_port() == 0)
+            ++m_num_unspecified;
+        try {
+            tcp_conn->get_socket();
+        } catch (asio::system_error& e) {
+            if (e.code() == asio::error::operation_not_supported && tcp_conn->get_native_handle() >= 0)
+                ++m_num_unexposed;
+        }
+        test::hello_http_server::handle_hello(http_request_ptr, tcp_conn);
+    }
+
+
+private:
+
+    /// number of requests whose connection had the local flag
+    std::atomic<std::size_t>    m_num_local;
+
+    /// number of requests that reported no remote address or port
+    std::atomic<std::size_t>    m_num_unspecified;
+
+    /// number of requests whose connection did not expose its tcp socket object
+    std::atomic<std::size_t>    m_num_unexposed;
+};
+
+
+/// returns a socket path that is unique to the test process
+static std::string get_socket_path(const std::string& name)
+{
+    return "/tmp/pion_" + name + "_" + std::to_string(::getpid()) + ".sock";
+}
+
+
+/// returns true if a file exists at a path
+static bool file_exists(const std::string& path)
+{
+    struct stat file_info;
+    return ::stat(path.c_str(), &file_info) == 0;
+}
+
+
+/**
+ * sends keep-alive requests for "/hello" over one Unix domain socket connection
+ *
+ * @param path the path of the server's socket
+ * @param num_requests the number of requests to send
+ *
+ * @return std::size_t the number of "200 OK" responses with the greeting
+ */
+static std::size_t send_local_requests(const std::string& path, std::size_t num_requests)
+{
+    static const std::string REQUEST("GET /hello HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    asio::io_service io_service;
+    asio::local::stream_protocol::socket sock(io_service);
+    asio::error_code ec;
+    sock.connect(asio::local::stream_protocol::endpoint(path), ec);
+    std::size_t num_ok = 0;
+    asio::streambuf response_buf;
+    for (std::size_t n = 0; ! ec && n < num_requests; ++n) {
+        asio::write(sock, asio::buffer(REQUEST), ec);
+        if (! ec)
+            asio::read_until(sock, response_buf, "Hello there!", ec);
+        if (ec)
+            break;
+        const std::string response(asio::buffers_begin(response_buf.data()),
+                                   asio::buffers_end(response_buf.data()));
+        response_buf.consume(response_buf.size());
+        if (response.compare(0, 15, "HTTP/1.1 200 OK") == 0)
+            ++num_ok;
+    }
+    return num_ok;
+}
+
+
+// Unix domain socket Test Cases
+
+BOOST_AUTO_TEST_SUITE(LocalSocketTests_S)
+
+BOOST_AUTO_TEST_CASE(checkServerAnswersHttpOverUnixSocket) {
+    const std::string path(get_socket_path("http"));
+    one_to_one_scheduler sched;
+    sched.set_num_threads(2);
+    RemoteRecordingServer server(sched, path);
+    BOOST_CHECK(server.is_local());
+    server.start();
+    BOOST_CHECK(file_exists(path));
+
+    BOOST_CHECK_EQUAL(send_local_requests(path, 10), 10U);
+    BOOST_CHECK_EQUAL(send_local_requests(path, 5), 5U);
+
+    // the clients of a Unix domain socket have no address, and the tcp
+    // socket object that holds it is not handed out
+    BOOST_CHECK_EQUAL(server.get_num_local(), 15U);
+    BOOST_CHECK_EQUAL(server.get_num_unspecified(), 15U);
+    BOOST_CHECK_EQUAL(server.get_num_unexposed(), 15U);
+
+    // the socket file is removed when the server stops
+    server.stop();
+    BOOST_CHECK(! file_exists(path));
+    sched.shutdown();
+}
+
+BOOST_AUTO_TEST_CASE(checkServerReplacesStaleSocketFile) {
+    const std::string path(get_socket_path("stale"));
+    {
+        // a socket that was closed without removing its file
+        asio::io_service io_service;
+        asio::local::stream_protocol::acceptor stale(io_service, asio::local::stream_protocol::endpoint(path));
+    }
+    BOOST_REQUIRE(file_exists(path));
+
+    one_to_one_scheduler sched;
+    sched.set_num_threads(1);
+    RemoteRecordingServer server(sched, path);
+    server.start();
+    BOOST_CHECK_EQUAL(send_local_requests(path, 3), 3U);
+
+    // a socket that a running server listens on is not replaced
+    RemoteRecordingServer second_server(sched, path);
+    BOOST_CHECK_THROW(second_server.start(), std::exception);
+    BOOST_CHECK_EQUAL(send_local_requests(path, 3), 3U);
+
+    server.stop();
+    BOOST_CHECK(! file_exists(path));
+    sched.shutdown();
+}
+
+BOOST_AUTO_TEST_CASE(checkServerDoesNotReplaceOtherFiles) {
+    const std::string path(get_socket_path("file"));
+    std::ofstream(path.c_str()) << "not a socket";
+    BOOST_REQUIRE(file_exists(path));
+
+    one_to_one_scheduler sched;
+    sched.set_num_threads(1);
+    RemoteRecordingServer server(sched, path);
+    BOOST_CHECK_THROW(server.start(), std::exception);
+    BOOST_CHECK(file_exists(path));
+    ::unlink(path.c_str());
+    sched.shutdown();
+}
+
+BOOST_AUTO_TEST_CASE(checkServerAnswersHttpOverAbstractSocket) {
+    // abstract sockets start with a null character and have no file
+    const std::string name("pion_abstract_" + std::to_string(::getpid()));
+    const std::string path(std::string(1, '\0') + name);
+    one_to_one_scheduler sched;
+    sched.set_num_threads(1);
+#ifdef PION_HAVE_IO_URING
+    // (io_uring accepts hand over descriptors, which the connections adopt)
+    if (tcp::uring_service::is_supported())
+        sched.set_io_engine(scheduler::IO_ENGINE_URING);
+#endif
+    RemoteRecordingServer server(sched, path);
+    server.start();
+    BOOST_CHECK_EQUAL(server.get_local_endpoint().path(), path);
+    BOOST_CHECK(! file_exists(name));
+    BOOST_CHECK_EQUAL(send_local_requests(path, 10), 10U);
+    BOOST_CHECK_EQUAL(server.get_num_unspecified(), 10U);
+    BOOST_CHECK_EQUAL(server.get_num_unexposed(), 10U);
+
+    // the name is free again once the server stops
+    server.stop();
+    BOOST_CHECK_EQUAL(send_local_requests(path, 1), 0U);
+    server.start();
+    BOOST_CHECK_EQUAL(send_local_requests(path, 1), 1U);
+    server.stop();
+    sched.shutdown();
+}
+
+BOOST_AUTO_TEST_CASE(checkSettingAnEndpointSwitchesBackToTcp) {
+    one_to_one_scheduler sched;
+    sched.set_num_threads(1);
+    RemoteRecordingServer server(sched, get_socket_path("switch"));
+    BOOST_CHECK(server.is_local());
+    server.set_endpoint(asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+    BOOST_CHECK(! server.is_local());
+    server.start();
+    const std::string response(test::send_request(server.get_port(), "/hello"));
+    BOOST_CHECK_EQUAL(response.compare(0, 15, "HTTP/1.1 200 OK"), 0);
+    server.stop();
+    sched.shutdown();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+#endif  // ASIO_HAS_LOCAL_SOCKETS
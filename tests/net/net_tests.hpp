@@ -0,0 +1,268 @@
+// ---------------------------------------------------------------------
+// pion:  a Boost C++ framework for building lightweight HTTP interfaces
+// ---------------------------------------------------------------------
+// Copyright (C) 2021 Wang Qiang  (https://github.com/dnybz/pion)
+// Copyright (C) 2007-2014 Splunk Inc.  (https://github.com/splunk/pion)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+//
+
+#ifndef __PION_NET_TESTS_HEADER__
+#define __PION_NET_TESTS_HEADER__
+
+#include <string>
+#include <pion/config.hpp>
+#include <pion/scheduler.hpp>
+#include <pion/tcp/server.hpp>
+#include <pion/tcp/connection.hpp>
+#include <pion/http/server.hpp>
+#include <pion/http/response_writer.hpp>
+
+
+namespace pion {    // begin namespace pion
+namespace test {    // begin namespace test
+
+
+///
+/// hello_server: TCP server that sends "Hello there!" to each connection and
+/// closes it
+///
+class hello_server
+    : public pion::tcp::server
+{
+public:
+    virtual ~hello_server() {}
+
+    /**
+     * creates a Hello server
+     *
+     * @param tcp_port port number used to listen for new connections (IPv4)
+     */
+    explicit hello_server(const unsigned int tcp_port = 0) : pion::tcp::server(tcp_port) {}
+
+    /**
+     * creates a Hello server that uses a specific scheduler
+     *
+     * @param sched the scheduler used to manage worker threads
+     * @param tcp_port port number used to listen for new connections (IPv4)
+     */
+    explicit hello_server(scheduler& sched, const unsigned int tcp_port = 0)
+        : pion::tcp::server(sched, tcp_port)
+    {}
+
+    /**
+     * sends the greeting to a new TCP connection
+     *
+     * @param tcp_conn the new TCP connection to handle
+     */
+    virtual void handle_connection(const pion::tcp::connection_ptr& tcp_conn) {
+        static const std::string HELLO_MESSAGE("Hello there!\n");
+        tcp_conn->set_lifecycle(pion::tcp::connection::LIFECYCLE_CLOSE);
+        tcp_conn->async_write(asio::buffer(HELLO_MESSAGE),
+                              [tcp_conn](const asio::error_code&, std::size_t) { tcp_conn->finish(); });
+    }
+};
+
+
+///
+/// hello_http_server: HTTP server that responds to "/hello" with "Hello there!"
+///
+class hello_http_server
+    : public pion::http::server
+{
+public:
+    virtual ~hello_http_server() {}
+
+    /**
+     * creates a Hello HTTP server
+     *
+     * @param tcp_port port number used to listen for new connections (IPv4)
+     */
+    explicit hello_http_server(const unsigned int tcp_port = 0)
+        : pion::http::server(tcp_port)
+    {
+        add_hello_resource();
+    }
+
+    /**
+     * creates a Hello HTTP server that uses a specific scheduler
+     *
+     * @param sched the scheduler used to manage worker threads
+     * @param tcp_port port number used to listen for new connections (IPv4)
+     */
+    explicit hello_http_server(scheduler& sched, const unsigned int tcp_port = 0)
+        : pion::http::server(sched, tcp_port)
+    {
+        add_hello_resource();
+    }
+
+    /**
+     * responds to a request
+     *
+     * @param http_request_ptr the request to respond to
+     * @param tcp_conn the TCP connection to the client
+     */
+    virtual void handle_hello(const pion::http::request_ptr& http_request_ptr,
+                              const pion::tcp::connection_ptr& tcp_conn)
+    {
+        pion::http::response_writer_ptr writer(
+            pion::http::response_writer::create(tcp_conn, *http_request_ptr,
+                                                std::bind(&pion::tcp::connection::finish, tcp_conn)));
+        writer->write_no_copy("Hello there!");
+        writer->send();
+    }
+
+
+private:
+
+    /// adds the "/hello" resource
+    void add_hello_resource(void) {
+        add_resource("/hello", std::bind(&hello_http_server::handle_hello, this,
+                                         std::placeholders::_1, std::placeholders::_2));
+    }
+};
+
+
+/// returns the number of times that memory was allocated from the heap by
+/// the program (operator new is replaced to count them)
+std::size_t get_num_allocations(void);
+
+/**
+ * sets whether the allocations made by the calling thread are counted
+ *
+ * @param counted false for a thread whose allocations must not be counted
+ *                (e.g. a test's client)
+ */
+void set_allocations_counted(bool counted);
+
+
+/**
+ * waits until a condition holds
+ *
+ * @param condition function that returns true once the condition holds
+ * @param milliseconds longest time to wait
+ *
+ * @return bool the final value of the condition
+ */
+template <typename Condition>
+inline bool wait_until(Condition condition, unsigned long milliseconds = 5000)
+{
+    for (unsigned long waited = 0; ! condition() && waited < milliseconds; waited += 10)
+        scheduler::sleep(0, 10000000); // 0.01 seconds
+    return condition();
+}
+
+
+/**
+ * reads from a connection until a delimiter arrives
+ *
+ * @param tcp_conn a connected TCP connection
+ * @param delimiter text that ends the data
+ *
+ * @return std::string the data read (which may be incomplete if the
+ *                     connection was closed)
+ */
+inline std::string read_until(pion::tcp::connection& tcp_conn, const std::string& delimiter)
+{
+    asio::error_code error_code;
+    std::string data;
+    while (! error_code && data.find(delimiter) == std::string::npos) {
+        const std::size_t bytes_read = tcp_conn.read_some(error_code);
+        data.append(tcp_conn.get_read_buffer().data(), bytes_read);
+    }
+    return data;
+}
+
+
+/**
+ * connects to a hello_server and reads its greeting
+ *
+ * @param port the server's port number
+ *
+ * @return std::string the greeting (empty if the connection failed)
+ */
+inline std::string read_greeting(unsigned int port)
+{
+    asio::io_service io_service;
+    pion::tcp::connection tcp_conn(io_service);
+    if (tcp_conn.connect(asio::ip::address::from_string("127.0.0.1"), port))
+        return std::string();
+    return read_until(tcp_conn, "\n");
+}
+
+
+/**
+ * reads one HTTP response with a Content-Length from a connection
+ *
+ * @param tcp_conn a connected TCP connection
+ *
+ * @return std::string the status line, headers and content (empty if the
+ *                     connection was closed first)
+ */
+inline std::string read_response(pion::tcp::connection& tcp_conn)
+{
+    asio::error_code error_code;
+    std::string response;
+    std::size_t end_of_headers = std::string::npos;
+    std::size_t content_length = 0;
+    for (;;) {
+        if (end_of_headers == std::string::npos) {
+            end_of_headers = response.find("\r\n\r\n");
+            if (end_of_headers != std::string::npos) {
+                end_of_headers += 4;
+                const std::size_t pos = response.find("Content-Length: ");
+                if (pos != std::string::npos && pos < end_of_headers)
+                    content_length = std::stoul(response.substr(pos + 16));
+            }
+        }
+        if (end_of_headers != std::string::npos && response.size() >= end_of_headers + content_length)
+            return response;
+        const std::size_t bytes_read = tcp_conn.read_some(error_code);
+        if (error_code)
+            return std::string();
+        response.append(tcp_conn.get_read_buffer().data(), bytes_read);
+    }
+}
+
+
+/**
+ * sends an HTTP request over a connection and reads the response
+ *
+ * @param tcp_conn a connected TCP connection
+ * @param request the complete request
+ *
+ * @return std::string the response (empty if the request failed)
+ */
+inline std::string send_request(pion::tcp::connection& tcp_conn, const std::string& request)
+{
+    asio::error_code error_code;
+    tcp_conn.write(asio::buffer(request), error_code);
+    if (error_code)
+        return std::string();
+    return read_response(tcp_conn);
+}
+
+
+/**
+ * connects to an HTTP server, sends a request and reads the response
+ *
+ * @param port the server's port number
+ * @param resource the resource requested
+ *
+ * @return std::string the response (empty if the request failed)
+ */
+inline std::string send_request(unsigned int port, const std::string& resource)
+{
+    asio::io_service io_service;
+    pion::tcp::connection tcp_conn(io_service);
+    if (tcp_conn.connect(asio::ip::address::from_string("127.0.0.1"), port))
+        return std::string();
+    return send_request(tcp_conn, "GET " + resource + " HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n");
+}
+
+
+}   // end namespace test
+}   // end namespace pion
+
+#endif
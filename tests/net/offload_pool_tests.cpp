@@ -0,0 +1,241 @@
+// ---------------------------------------------------------------------
+// pion:  a Boost C++ framework for building lightweight HTTP interfaces
+// ---------------------------------------------------------------------
+// Copyright (C) 2021 Wang Qiang  (https://github.com/dnybz/pion)
+// Copyright (C) 2007-2014 Splunk Inc.  (https://github.com/splunk/pion)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include <atomic>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <pion/config.hpp>
+#include <pion/offload_pool.hpp>
+#include <pion/scheduler.hpp>
+#include <boost/test/unit_test.hpp>
+#include "net_tests.hpp"
+
+using namespace pion;
+
+
+///
+/// ServiceThread: an I/O service that runs on its own thread until it is
+/// destroyed
+///
+class ServiceThread {
+public:
+
+    /// starts running the I/O service
+    ServiceThread(void)
+        : m_work(new asio::io_service::work(m_service)),
+        m_thread([this]() { m_service.run(); })
+    {}
+
+    /// stops running the I/O service
+    ~ServiceThread() {
+        m_work.reset();
+        m_thread.join();
+    }
+
+    /// returns the I/O service
+    inline asio::io_service& get_io_service(void) { return m_service; }
+
+    /// returns the identifier of the thread that runs the I/O service
+    inline std::thread::id get_id(void) const { return m_thread.get_id(); }
+
+
+private:
+
+    /// the I/O service
+    asio::io_service                            m_service;
+
+    /// keeps the I/O service running while there is nothing to do
+    std::unique_ptr<asio::io_service::work>     m_work;
+
+    /// the thread that runs the I/O service
+    std::thread                                 m_thread;
+};
+
+
+///
+/// OffloadPoolFixture: pool with one thread, whose work can be held back
+/// until the test releases it
+///
+class OffloadPoolFixture {
+public:
+
+    /// creates a pool with one thread and room for two queued tasks
+    OffloadPoolFixture(void) : m_released(m_release.get_future().share()), m_num_run(0) {
+        m_pool.set_num_threads(1);
+        m_pool.set_max_queue_size(2);
+    }
+
+    /// lets the held back work finish, then stops the pool
+    ~OffloadPoolFixture() {
+        release();
+        m_pool.stop();
+    }
+
+    /// returns work that waits until release() is called
+    task held_work(void) {
+        std::shared_future<void> released(m_released);
+        std::atomic<int> *num_run = &m_num_run;
+        return task([released, num_run]() { released.wait(); ++*num_run; });
+    }
+
+    /// returns work that counts that it ran
+    task counted_work(void) {
+        std::atomic<int> *num_run = &m_num_run;
+        return task([num_run]() { ++*num_run; });
+    }
+
+    /// lets the held back work finish
+    void release(void) {
+        std::call_once(m_released_once, [this]() { m_release.set_value(); });
+    }
+
+    /// occupies the pool's thread with held back work
+    void occupy_pool_thread(asio::io_service& service) {
+        BOOST_REQUIRE(m_pool.offload(service, held_work(), offload_pool::completion_handler_t()));
+        BOOST_REQUIRE(test::wait_until([this]() { return m_pool.get_num_active() == 1; }));
+    }
+
+    offload_pool                m_pool;
+    std::promise<void>          m_release;
+    std::shared_future<void>    m_released;
+    std::once_flag              m_released_once;
+    std::atomic<int>            m_num_run;
+};
+
+
+// offload_pool Test Cases
+
+BOOST_FIXTURE_TEST_SUITE(OffloadPoolTests_S, OffloadPoolFixture)
+
+BOOST_AUTO_TEST_CASE(checkWorkIsRejectedWhenTheQueueIsFull) {
+    asio::io_service service;
+    occupy_pool_thread(service);
+    BOOST_CHECK(m_pool.offload(service, counted_work(), offload_pool::completion_handler_t()));
+    BOOST_CHECK(m_pool.offload(service, counted_work(), offload_pool::completion_handler_t()));
+    BOOST_CHECK_EQUAL(m_pool.get_queue_depth(), 2U);
+
+    // a rejected task never runs, and neither does its completion
+    bool rejected_completion_ran = false;
+    BOOST_CHECK(! m_pool.offload(service, counted_work(),
+                                 [&rejected_completion_ran](const asio::error_code&) { rejected_completion_ran = true; }));
+    BOOST_CHECK_EQUAL(m_pool.get_num_rejected(), 1U);
+    BOOST_CHECK_EQUAL(m_pool.get_queue_depth(), 2U);
+
+    release();
+    BOOST_REQUIRE(test::wait_until([this]() { return m_pool.get_num_completed() == 3; }));
+    BOOST_CHECK_EQUAL(m_num_run.load(), 3);
+    BOOST_CHECK_EQUAL(m_pool.get_queue_depth(), 0U);
+    BOOST_CHECK_EQUAL(m_pool.get_num_active(), 0U);
+
+    // there is room again once the queue has drained
+    BOOST_CHECK(m_pool.offload(service, counted_work(), offload_pool::completion_handler_t()));
+    BOOST_REQUIRE(test::wait_until([this]() { return m_pool.get_num_completed() == 4; }));
+    service.run();
+    BOOST_CHECK(! rejected_completion_ran);
+    BOOST_CHECK_EQUAL(m_pool.get_num_rejected(), 1U);
+}
+
+BOOST_AUTO_TEST_CASE(checkCompletionRunsOnTheGivenService) {
+    ServiceThread first_thread;
+    ServiceThread second_thread;
+    std::vector<std::promise<std::thread::id> > completed(2);
+    std::vector<asio::error_code> errors(2, make_error_code(asio::error::fault));
+    ServiceThread *service_threads[] = { &first_thread, &second_thread };
+    for (int n = 0; n < 2; ++n) {
+        std::promise<std::thread::id> *done = &completed[n];
+        asio::error_code *error = &errors[n];
+        BOOST_REQUIRE(m_pool.offload(service_threads[n]->get_io_service(), counted_work(),
+                                     [done, error](const asio::error_code& ec) {
+                                         *error = ec;
+                                         done->set_value(std::this_thread::get_id());
+                                     }));
+    }
+    for (int n = 0; n < 2; ++n) {
+        BOOST_CHECK(completed[n].get_future().get() == service_threads[n]->get_id());
+        BOOST_CHECK(! errors[n]);
+    }
+    BOOST_CHECK_EQUAL(m_num_run.load(), 2);
+}
+
+BOOST_AUTO_TEST_CASE(checkCompletionRunsEvenIfTheWorkThrows) {
+    asio::io_service service;
+    asio::error_code error(make_error_code(asio::error::fault));
+    BOOST_REQUIRE(m_pool.offload(service, task([]() { throw std::runtime_error("offloaded work failed"); }),
+                                 [&error](const asio::error_code& ec) { error = ec; }));
+    BOOST_REQUIRE(test::wait_until([this]() { return m_pool.get_num_completed() == 1; }));
+    BOOST_CHECK_EQUAL(service.run(), 1U);
+    BOOST_CHECK(! error);
+}
+
+BOOST_AUTO_TEST_CASE(checkStopCancelsQueuedWork) {
+    asio::io_service service;
+    std::vector<asio::error_code> errors;
+    occupy_pool_thread(service);
+    for (int n = 0; n < 2; ++n)
+        BOOST_REQUIRE(m_pool.offload(service, counted_work(),
+                                     [&errors](const asio::error_code& ec) { errors.push_back(ec); }));
+
+    // stop() discards the queue right away, then waits for the running work
+    std::thread stopping_thread([this]() { m_pool.stop(); });
+    BOOST_REQUIRE(test::wait_until([this]() { return m_pool.get_queue_depth() == 0; }));
+    release();
+    stopping_thread.join();
+
+    // only the held back work ran; the completions of the queued work are
+    // posted to their service with operation_aborted
+    BOOST_CHECK_EQUAL(m_num_run.load(), 1);
+    BOOST_CHECK_EQUAL(service.run(), 2U);
+    BOOST_REQUIRE_EQUAL(errors.size(), 2U);
+    for (std::size_t n = 0; n < errors.size(); ++n)
+        BOOST_CHECK(errors[n] == asio::error::operation_aborted);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+
+// scheduler::offload Test Cases
+
+BOOST_AUTO_TEST_SUITE(SchedulerOffloadTests_S)
+
+BOOST_AUTO_TEST_CASE(checkCompletionRunsOnTheConnectionService) {
+    one_to_one_scheduler sched;
+    sched.set_num_threads(3);
+    sched.add_active_user();
+    BOOST_REQUIRE_EQUAL(sched.get_num_services(), 3U);
+
+    // each service is run by its own thread, which the completion must use
+    for (uint32_t n = 0; n < sched.get_num_services(); ++n) {
+        asio::io_service& service = sched.get_io_service(n);
+        std::promise<std::thread::id> service_thread;
+        service.post([&service_thread]() { service_thread.set_value(std::this_thread::get_id()); });
+        const std::thread::id expected(service_thread.get_future().get());
+
+        std::promise<std::thread::id> completed;
+        std::thread::id work_thread;
+        asio::error_code error(make_error_code(asio::error::fault));
+        BOOST_REQUIRE(sched.offload(service, task([&work_thread]() { work_thread = std::this_thread::get_id(); }),
+                                    [&completed, &error](const asio::error_code& ec) {
+                                        error = ec;
+                                        completed.set_value(std::this_thread::get_id());
+                                    }));
+        const std::thread::id completion_thread(completed.get_future().get());
+        BOOST_CHECK(! error);
+        BOOST_CHECK(completion_thread == expected);
+        BOOST_CHECK(work_thread != expected);
+    }
+
+    sched.remove_active_user();
+    sched.shutdown();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,320 @@
+// ---------------------------------------------------------------------
+// pion:  a Boost C++ framework for building lightweight HTTP interfaces
+// ---------------------------------------------------------------------
+// Copyright (C) 2021 Wang Qiang  (https://github.com/dnybz/pion)
+// Copyright (C) 2007-2014 Splunk Inc.  (https://github.com/splunk/pion)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include <pion/config.hpp>
+#include <pion/scheduler.hpp>
+#include <boost/test/unit_test.hpp>
+#include "net_tests.hpp"
+
+using namespace pion;
+
+
+///
+/// HoldingServer: hello_http_server that holds back its responses until the
+/// test releases them, so that requests stay in flight
+///
+class HoldingServer
+    : public test::hello_http_server
+{
+public:
+    virtual ~HoldingServer() {}
+
+    /**
+     * creates a new HoldingServer
+     *
+     * @param sched the scheduler that runs the server's connections
+     */
+    explicit HoldingServer(scheduler& sched) : test::hello_http_server(sched), m_holding(false) {}
+
+    /// sets whether responses are held back
+    void set_holding(bool holding) {
+        std::unique_lock<std::mutex> held_lock(m_mutex);
+        m_holding = holding;
+    }
+
+    /// returns the number of responses held back
+    std::size_t get_num_held(void) {
+        std::unique_lock<std::mutex> held_lock(m_mutex);
+        return m_held.size();
+    }
+
+    /// sends the responses that were held back
+    void release(void) {
+        std::vector<held_request> held;
+        {
+            std::unique_lock<std::mutex> held_lock(m_mutex);
+            m_holding = false;
+            held.swap(m_held);
+        }
+        for (std::size_t n = 0; n < held.size(); ++n) {
+            const held_request request(held[n]);
+            request.second->get_io_service().post([this, request]() {
+                test::hello_http_server::handle_hello(request.first, request.second);
+            });
+        }
+    }
+
+    /// holds back the response, or responds
+    virtual void handle_hello(const http::request_ptr& http_request_ptr,
+                              const tcp::connection_ptr& tcp_conn)
+    {
+        {
+            std::unique_lock<std::mutex> held_lock(m_mutex);
+            if (m_holding) {
+                m_held.push_back(held_request(http_request_ptr, tcp_conn));
+                return;
+            }
+        }
+        test::hello_http_server::handle_hello(http_request_ptr, tcp_conn);
+    }
+
+
+private:
+
+    /// a request whose response is held back
+    typedef std::pair<http::request_ptr, tcp::connection_ptr>   held_request;
+
+    /// protects the held requests
+    std::mutex                  m_mutex;
+
+    /// true if responses are held back
+    bool                        m_holding;
+
+    /// requests whose responses are held back
+    std::vector<held_request>   m_held;
+};
+
+
+/// request for the "/hello" resource, on a connection that is kept alive
+static const std::string HELLO_REQUEST("GET /hello HTTP/1.1\r\nHost: localhost\r\n\r\n");
+
+
+/// returns the current second of the steady clock (the one used for the accept rate)
+static uint64_t get_steady_second(void)
+{
+    return std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+/// waits until the current second of the steady clock has just started, so
+/// that a test can count on the rest of it
+static void wait_for_new_second(void)
+{
+    while (std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count() % 1000 > 100)
+    {
+        scheduler::sleep(0, 5000000);
+    }
+}
+
+
+/// returns a new connection to a local port (the test fails if connecting fails)
+static tcp::connection_ptr connect_to(asio::io_service& io_service, unsigned int port)
+{
+    tcp::connection_ptr tcp_conn(std::make_shared<tcp::connection>(io_service));
+    BOOST_REQUIRE(! tcp_conn->connect(asio::ip::address::from_string("127.0.0.1"), port));
+    return tcp_conn;
+}
+
+
+/// returns true if a response is the pre-serialized 503 that closes the connection
+static bool is_service_unavailable(const std::string& response)
+{
+    return response.compare(0, 32, "HTTP/1.1 503 Service Unavailable") == 0
+        && response.find("Retry-After: 1\r\n") != std::string::npos
+        && response.find("Connection: close\r\n") != std::string::npos;
+}
+
+
+/// returns true if the server closed a connection after what was read
+static bool is_closed_by_server(tcp::connection& tcp_conn)
+{
+    asio::error_code ec;
+    tcp_conn.read_some(ec);
+    return ec == asio::error::eof || ec == asio::error::connection_reset;
+}
+
+
+// server limits Test Cases
+
+BOOST_AUTO_TEST_SUITE(OverloadTests_S)
+
+BOOST_AUTO_TEST_CASE(checkConnectionLimitRejectsWithServiceUnavailable) {
+    one_to_one_scheduler sched;
+    sched.set_num_threads(1);
+    HoldingServer server(sched);
+    server.set_max_connections(2);
+    server.set_overload_policy(tcp::server::OVERLOAD_REJECT);
+    server.start();
+
+    asio::io_service io_service;
+    tcp::connection_ptr first(connect_to(io_service, server.get_port()));
+    tcp::connection_ptr second(connect_to(io_service, server.get_port()));
+    BOOST_REQUIRE(test::wait_until([&server]() { return server.get_connections() == 2; }));
+
+    // the third connection is accepted, refused and closed
+    tcp::connection_ptr third(connect_to(io_service, server.get_port()));
+    BOOST_CHECK(is_service_unavailable(test::read_response(*third)));
+    BOOST_CHECK(is_closed_by_server(*third));
+    BOOST_CHECK_EQUAL(server.get_rejected_connections(), 1U);
+    BOOST_CHECK_EQUAL(server.get_accept_pauses(), 0U);
+
+    // the connections that were admitted are served
+    BOOST_CHECK_EQUAL(test::send_request(*first, HELLO_REQUEST).compare(0, 15, "HTTP/1.1 200 OK"), 0);
+
+    // there is room again once a connection has closed
+    second->close();
+    BOOST_REQUIRE(test::wait_until([&server]() { return server.get_connections() == 1; }));
+    tcp::connection_ptr fourth(connect_to(io_service, server.get_port()));
+    BOOST_CHECK_EQUAL(test::send_request(*fourth, HELLO_REQUEST).compare(0, 15, "HTTP/1.1 200 OK"), 0);
+    BOOST_CHECK_EQUAL(server.get_rejected_connections(), 1U);
+
+    server.stop();
+    sched.shutdown();
+}
+
+BOOST_AUTO_TEST_CASE(checkConnectionLimitPausesAccepting) {
+    one_to_one_scheduler sched;
+    sched.set_num_threads(1);
+    HoldingServer server(sched);
+    server.set_max_connections(1);
+    server.start();
+
+    asio::io_service io_service;
+    tcp::connection_ptr first(connect_to(io_service, server.get_port()));
+    BOOST_REQUIRE(test::wait_until([&server]() { return server.get_accept_pauses() == 1; }));
+
+    // the kernel queues the second connection, which the server leaves alone
+    tcp::connection_ptr second(connect_to(io_service, server.get_port()));
+    asio::error_code ec;
+    second->write(asio::buffer(HELLO_REQUEST), ec);
+    BOOST_REQUIRE(! ec);
+    scheduler::sleep(0, 200000000);
+    BOOST_CHECK_EQUAL(server.get_connections(), 1U);
+    BOOST_CHECK_EQUAL(second->get_socket().available(), 0U);
+
+    // it is accepted and served once the first one has closed
+    first->close();
+    const std::string response(test::read_response(*second));
+    BOOST_CHECK_EQUAL(response.compare(0, 15, "HTTP/1.1 200 OK"), 0);
+    BOOST_CHECK_EQUAL(server.get_rejected_connections(), 0U);
+    BOOST_CHECK_GE(server.get_accept_pauses(), 1U);
+
+    server.stop();
+    sched.shutdown();
+}
+
+BOOST_AUTO_TEST_CASE(checkRequestLimitRejectsWithServiceUnavailable) {
+    one_to_one_scheduler sched;
+    sched.set_num_threads(1);
+    HoldingServer server(sched);
+    server.set_max_requests(1);
+    server.set_overload_policy(tcp::server::OVERLOAD_REJECT);
+    server.set_holding(true);
+    server.start();
+
+    asio::io_service io_service;
+    tcp::connection_ptr first(connect_to(io_service, server.get_port()));
+    asio::error_code ec;
+    first->write(asio::buffer(HELLO_REQUEST), ec);
+    BOOST_REQUIRE(! ec);
+    BOOST_REQUIRE(test::wait_until([&server]() { return server.get_num_held() == 1; }));
+    BOOST_CHECK_EQUAL(server.get_requests_in_flight(), 1U);
+
+    // a second request is refused while the first one is in flight
+    tcp::connection_ptr second(connect_to(io_service, server.get_port()));
+    BOOST_CHECK(is_service_unavailable(test::send_request(*second, HELLO_REQUEST)));
+    BOOST_CHECK(is_closed_by_server(*second));
+    BOOST_CHECK_EQUAL(server.get_rejected_requests(), 1U);
+    BOOST_CHECK_EQUAL(server.get_rejected_connections(), 0U);
+    BOOST_CHECK_EQUAL(server.get_requests_in_flight(), 1U);
+
+    // the first request finishes, which makes room for more
+    server.release();
+    BOOST_CHECK_EQUAL(test::read_response(*first).compare(0, 15, "HTTP/1.1 200 OK"), 0);
+    BOOST_REQUIRE(test::wait_until([&server]() { return server.get_requests_in_flight() == 0; }));
+    BOOST_CHECK_EQUAL(test::send_request(*first, HELLO_REQUEST).compare(0, 15, "HTTP/1.1 200 OK"), 0);
+    BOOST_CHECK_EQUAL(server.get_rejected_requests(), 1U);
+
+    server.stop();
+    sched.shutdown();
+}
+
+BOOST_AUTO_TEST_CASE(checkAcceptRateRejectsWithServiceUnavailable) {
+    one_to_one_scheduler sched;
+    sched.set_num_threads(1);
+    HoldingServer server(sched);
+    server.set_max_accept_rate(3);
+    server.set_overload_policy(tcp::server::OVERLOAD_REJECT);
+    server.start();
+
+    // all of the connections arrive within the same second
+    asio::io_service io_service;
+    wait_for_new_second();
+    const uint64_t start_second = get_steady_second();
+    std::vector<tcp::connection_ptr> connections;
+    for (int n = 0; n < 6; ++n)
+        connections.push_back(connect_to(io_service, server.get_port()));
+    for (int n = 0; n < 3; ++n)
+        BOOST_CHECK_EQUAL(test::send_request(*connections[n], HELLO_REQUEST).compare(0, 15, "HTTP/1.1 200 OK"), 0);
+    for (int n = 3; n < 6; ++n)
+        BOOST_CHECK(is_service_unavailable(test::read_response(*connections[n])));
+    BOOST_REQUIRE_EQUAL(get_steady_second(), start_second);
+    BOOST_CHECK_EQUAL(server.get_rejected_connections(), 3U);
+
+    // the next second has room again
+    BOOST_REQUIRE(test::wait_until([start_second]() { return get_steady_second() > start_second; }));
+    tcp::connection_ptr next(connect_to(io_service, server.get_port()));
+    BOOST_CHECK_EQUAL(test::send_request(*next, HELLO_REQUEST).compare(0, 15, "HTTP/1.1 200 OK"), 0);
+    BOOST_CHECK_EQUAL(server.get_rejected_connections(), 3U);
+
+    server.stop();
+    sched.shutdown();
+}
+
+BOOST_AUTO_TEST_CASE(checkAcceptRatePausesUntilTheNextSecond) {
+    one_to_one_scheduler sched;
+    sched.set_num_threads(1);
+    HoldingServer server(sched);
+    server.set_max_accept_rate(2);
+    server.start();
+
+    asio::io_service io_service;
+    wait_for_new_second();
+    const uint64_t start_second = get_steady_second();
+    std::vector<tcp::connection_ptr> connections;
+    for (int n = 0; n < 3; ++n) {
+        connections.push_back(connect_to(io_service, server.get_port()));
+        asio::error_code ec;
+        connections.back()->write(asio::buffer(HELLO_REQUEST), ec);
+        BOOST_REQUIRE(! ec);
+    }
+    for (int n = 0; n < 2; ++n)
+        BOOST_CHECK_EQUAL(test::read_response(*connections[n]).compare(0, 15, "HTTP/1.1 200 OK"), 0);
+    BOOST_REQUIRE_EQUAL(get_steady_second(), start_second);
+    BOOST_CHECK_EQUAL(server.get_accept_pauses(), 1U);
+
+    // the resume timer accepts the third connection when the second is over
+    BOOST_CHECK_EQUAL(test::read_response(*connections[2]).compare(0, 15, "HTTP/1.1 200 OK"), 0);
+    BOOST_CHECK_GT(get_steady_second(), start_second);
+    BOOST_CHECK_EQUAL(server.get_rejected_connections(), 0U);
+
+    server.stop();
+    sched.shutdown();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
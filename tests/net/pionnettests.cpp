@@ -0,0 +1,64 @@
+// ---------------------------------------------------------------------
+// pion:  a Boost C++ framework for building lightweight HTTP interfaces
+// ---------------------------------------------------------------------
+// Copyright (C) 2021 Wang Qiang  (https://github.com/dnybz/pion)
+// Copyright (C) 2007-2014 Splunk Inc.  (https://github.com/splunk/pion)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <pion/config.hpp>
+#include "net_tests.hpp"
+
+#define BOOST_TEST_MODULE pion-net-unit-tests
+#include <boost/test/unit_test.hpp>
+
+
+/// number of times that memory was allocated from the heap by the program
+static std::atomic<std::size_t> g_num_allocations(0);
+
+/// true for a thread whose allocations are not counted (e.g. a test's client)
+static thread_local bool t_uncounted = false;
+
+/// counts every allocation made from the heap (including those of libpion)
+void *operator new(std::size_t size)
+{
+    if (! t_uncounted)
+        ++g_num_allocations;
+    if (void *pointer = std::malloc(size == 0 ? 1 : size))
+        return pointer;
+    throw std::bad_alloc();
+}
+
+/// releases memory allocated by operator new
+void operator delete(void *pointer) noexcept
+{
+    std::free(pointer);
+}
+
+/// releases memory allocated by operator new (called by code built for C++14)
+void operator delete(void *pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+
+
+namespace pion {    // begin namespace pion
+namespace test {    // begin namespace test
+
+std::size_t get_num_allocations(void)
+{
+    return g_num_allocations;
+}
+
+void set_allocations_counted(bool counted)
+{
+    t_uncounted = ! counted;
+}
+
+}   // end namespace test
+}   // end namespace pion
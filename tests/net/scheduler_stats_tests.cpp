@@ -0,0 +1,233 @@
+// ---------------------------------------------------------------------
+// pion:  a Boost C++ framework for building lightweight HTTP interfaces
+// ---------------------------------------------------------------------
+// Copyright (C) 2021 Wang Qiang  (https://github.com/dnybz/pion)
+// Copyright (C) 2007-2014 Splunk Inc.  (https://github.com/splunk/pion)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <pion/config.hpp>
+#include <pion/scheduler.hpp>
+#include <pion/tcp/handler_allocator.hpp>
+#include <boost/test/unit_test.hpp>
+#include "net_tests.hpp"
+
+using namespace pion;
+
+
+/// nanoseconds in a millisecond
+static const uint64_t NSEC_PER_MSEC = 1000000;
+
+
+/// returns the sum of the statistics of all of a scheduler's threads
+static scheduler::stats_type get_total_stats(const scheduler& sched)
+{
+    const std::vector<scheduler::stats_type> thread_stats(sched.get_thread_stats());
+    scheduler::stats_type total;
+    for (std::size_t n = 0; n < thread_stats.size(); ++n)
+        total += thread_stats[n];
+    return total;
+}
+
+
+///
+/// ReadCompletion: completion handler for a read that takes some time to
+/// run, and then tells that it has finished
+///
+struct ReadCompletion {
+    ReadCompletion(std::atomic<bool> *done) : m_done(done) {}
+    void operator()(const asio::error_code&, std::size_t) {
+        scheduler::sleep(0, 50000000);  // 0.05 seconds
+        *m_done = true;
+    }
+    std::atomic<bool> *     m_done;
+};
+
+
+// scheduler statistics Test Cases
+
+BOOST_AUTO_TEST_SUITE(SchedulerStatsTests_S)
+
+BOOST_AUTO_TEST_CASE(checkHistogramBuckets) {
+    // bucket n counts durations from 2^(n-1) up to 2^n microseconds
+    BOOST_CHECK_EQUAL(scheduler::histogram::get_bucket(0), 0U);
+    BOOST_CHECK_EQUAL(scheduler::histogram::get_bucket(1), 1U);
+    BOOST_CHECK_EQUAL(scheduler::histogram::get_bucket(2), 2U);
+    BOOST_CHECK_EQUAL(scheduler::histogram::get_bucket(3), 2U);
+    BOOST_CHECK_EQUAL(scheduler::histogram::get_bucket(4), 3U);
+    BOOST_CHECK_EQUAL(scheduler::histogram::get_bucket(1000), 10U);
+    for (uint32_t n = 1; n < scheduler::histogram::NUM_BUCKETS; ++n)
+        BOOST_CHECK_EQUAL(scheduler::histogram::get_bucket(scheduler::histogram::get_bucket_min(n)), n);
+
+    // the last bucket also counts anything longer
+    BOOST_CHECK_EQUAL(scheduler::histogram::get_bucket(1ULL << 40),
+                      static_cast<uint32_t>(scheduler::histogram::NUM_BUCKETS - 1));
+}
+
+BOOST_AUTO_TEST_CASE(checkHistogramPercentiles) {
+    scheduler::histogram h;
+    BOOST_CHECK_EQUAL(h.get_count(), 0U);
+    BOOST_CHECK_EQUAL(h.get_percentile(50), 0U);
+
+    // 90 durations of 2-3 usec and 10 of 512-1023 usec
+    h.m_buckets[scheduler::histogram::get_bucket(3)] = 90;
+    h.m_buckets[scheduler::histogram::get_bucket(700)] = 10;
+    BOOST_CHECK_EQUAL(h.get_count(), 100U);
+    BOOST_CHECK_EQUAL(h.get_percentile(50), 4U);
+    BOOST_CHECK_EQUAL(h.get_percentile(90), 4U);
+    BOOST_CHECK_EQUAL(h.get_percentile(99), 1024U);
+    BOOST_CHECK_EQUAL(h.get_percentile(100), 1024U);
+
+    // adding a histogram adds its counts to each bucket
+    scheduler::histogram other;
+    other.m_buckets[scheduler::histogram::get_bucket(700)] = 100;
+    h += other;
+    BOOST_CHECK_EQUAL(h.get_count(), 200U);
+    BOOST_CHECK_EQUAL(h.m_buckets[scheduler::histogram::get_bucket(700)], 110U);
+    BOOST_CHECK_EQUAL(h.get_percentile(50), 1024U);
+}
+
+BOOST_AUTO_TEST_CASE(checkStatsAreAddedUp) {
+    scheduler::stats_type stats;
+    BOOST_CHECK_EQUAL(stats.get_utilization(), 0.0);
+
+    scheduler::stats_type thread_stats;
+    thread_stats.m_num_threads = 1;
+    thread_stats.m_num_handlers = 10;
+    thread_stats.m_busy_nsec = 1000;
+    thread_stats.m_idle_nsec = 3000;
+    thread_stats.m_lane_tasks[scheduler::PRIORITY_LOW] = 4;
+    thread_stats.m_run_time.m_buckets[2] = 10;
+    stats += thread_stats;
+    stats += thread_stats;
+    BOOST_CHECK_EQUAL(stats.m_num_threads, 2U);
+    BOOST_CHECK_EQUAL(stats.m_num_handlers, 20U);
+    BOOST_CHECK_EQUAL(stats.m_lane_tasks[scheduler::PRIORITY_LOW], 8U);
+    BOOST_CHECK_EQUAL(stats.m_run_time.get_count(), 20U);
+    BOOST_CHECK_CLOSE(stats.get_utilization(), 0.25, 0.001);
+}
+
+BOOST_AUTO_TEST_CASE(checkSnapshotsCoverEachThreadAndService) {
+    // the threads that share a service are combined
+    single_service_scheduler sched;
+    sched.set_num_threads(3);
+    BOOST_CHECK(sched.get_thread_stats().empty());
+    sched.startup();
+    sched.reset_stats();
+    std::atomic<int> num_run(0);
+    for (int n = 0; n < 30; ++n)
+        sched.post([&num_run]() { ++num_run; }, scheduler::PRIORITY_LOW);
+    BOOST_REQUIRE(test::wait_until([&num_run]() { return num_run == 30; }));
+
+    // (each thread attaches its statistics when it starts)
+    BOOST_REQUIRE(test::wait_until([&sched]() { return sched.get_thread_stats().size() == 3; }));
+    const std::vector<scheduler::stats_type> thread_stats(sched.get_thread_stats());
+    BOOST_REQUIRE_EQUAL(thread_stats.size(), 3U);
+    for (std::size_t n = 0; n < thread_stats.size(); ++n) {
+        BOOST_CHECK_EQUAL(thread_stats[n].m_service, 0U);
+        BOOST_CHECK_EQUAL(thread_stats[n].m_num_threads, 1U);
+    }
+    const std::vector<scheduler::stats_type> service_stats(sched.get_service_stats());
+    BOOST_REQUIRE_EQUAL(service_stats.size(), 1U);
+    BOOST_CHECK_EQUAL(service_stats[0].m_num_threads, 3U);
+    BOOST_CHECK_EQUAL(service_stats[0].m_lane_tasks[scheduler::PRIORITY_LOW], 30U);
+    BOOST_CHECK_EQUAL(service_stats[0].m_queue_wait.get_count(), 30U);
+    BOOST_CHECK_GE(service_stats[0].m_num_handlers, 30U);
+
+    // resetting the statistics sets them back to zero
+    sched.reset_stats();
+    const scheduler::stats_type total(get_total_stats(sched));
+    BOOST_CHECK_EQUAL(total.m_lane_tasks[scheduler::PRIORITY_LOW], 0U);
+    BOOST_CHECK_EQUAL(total.m_queue_wait.get_count(), 0U);
+    sched.shutdown();
+
+    // each thread has its own service, whose queue depth is reported
+    one_to_one_scheduler sched3;
+    sched3.set_num_threads(3);
+    for (int n = 0; n < 6; ++n)
+        sched3.post([]() {});
+    const std::vector<scheduler::stats_type> queued_stats(sched3.get_service_stats());
+    BOOST_REQUIRE_EQUAL(queued_stats.size(), 3U);
+    uint32_t queue_depth = 0;
+    for (uint32_t n = 0; n < queued_stats.size(); ++n) {
+        BOOST_CHECK_EQUAL(queued_stats[n].m_service, n);
+        queue_depth += queued_stats[n].m_queue_depth;
+    }
+    BOOST_CHECK_EQUAL(queue_depth, 6U);
+    sched3.startup();
+    BOOST_REQUIRE(test::wait_until([&sched3]() { return sched3.get_thread_stats().size() == 3; }));
+    const std::vector<scheduler::stats_type> running_stats(sched3.get_thread_stats());
+    BOOST_REQUIRE_EQUAL(running_stats.size(), 3U);
+    for (uint32_t n = 0; n < running_stats.size(); ++n)
+        BOOST_CHECK_EQUAL(running_stats[n].m_service, n);
+    sched3.shutdown();
+}
+
+BOOST_AUTO_TEST_CASE(checkBusyAndIdleTimeAreCounted) {
+    single_service_scheduler sched;
+    sched.set_num_threads(1);
+    sched.startup();
+    sched.reset_stats();
+
+    // the thread waits, and then runs a task that takes 0.05 seconds
+    scheduler::sleep(0, 100000000);     // 0.1 seconds
+    std::atomic<bool> done(false);
+    sched.post([&done]() {
+        scheduler::sleep(0, 50000000);  // 0.05 seconds
+        done = true;
+    });
+    BOOST_REQUIRE(test::wait_until([&done]() { return done.load(); }));
+    BOOST_REQUIRE(test::wait_until([&sched]() { return get_total_stats(sched).m_busy_nsec > 0; }));
+
+    const scheduler::stats_type total(get_total_stats(sched));
+    BOOST_CHECK_GE(total.m_busy_nsec, 45 * NSEC_PER_MSEC);
+    BOOST_CHECK_LT(total.m_busy_nsec, 1000 * NSEC_PER_MSEC);
+    BOOST_CHECK_GE(total.m_idle_nsec, 90 * NSEC_PER_MSEC);
+    BOOST_CHECK_GT(total.get_utilization(), 0.0);
+    BOOST_CHECK_LT(total.get_utilization(), 1.0);
+
+    // the task is counted in the run time histogram
+    BOOST_CHECK_GE(total.m_run_time.get_percentile(100), 32768U);
+    sched.shutdown();
+}
+
+BOOST_AUTO_TEST_CASE(checkIoCompletionsStopTheIdleTime) {
+    one_to_one_scheduler sched;
+    sched.set_num_threads(1);
+    sched.startup();
+
+    // a loopback connection whose client socket belongs to the scheduler
+    asio::io_service io_service;
+    asio::ip::tcp::acceptor acceptor(io_service, asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+    asio::ip::tcp::socket client_sock(sched.get_io_service(0));
+    client_sock.connect(acceptor.local_endpoint());
+    asio::ip::tcp::socket server_sock(io_service);
+    acceptor.accept(server_sock);
+
+    // the thread waits for the read, whose completion handler (wrapped by
+    // alloc_handler) takes 0.05 seconds: only that time counts as busy
+    sched.reset_stats();
+    std::atomic<bool> done(false);
+    char data[5];
+    const tcp::handler_memory_ptr memory_ptr(new tcp::handler_memory());
+    client_sock.async_read_some(asio::buffer(data), tcp::make_alloc_handler(memory_ptr, ReadCompletion(&done)));
+    scheduler::sleep(0, 100000000);     // 0.1 seconds
+    asio::write(server_sock, asio::buffer("hello", 5));
+    BOOST_REQUIRE(test::wait_until([&done]() { return done.load(); }));
+    BOOST_REQUIRE(test::wait_until([&sched]() { return get_total_stats(sched).m_busy_nsec > 0; }));
+
+    const scheduler::stats_type total(get_total_stats(sched));
+    BOOST_CHECK_GE(total.m_busy_nsec, 45 * NSEC_PER_MSEC);
+    BOOST_CHECK_LT(total.m_busy_nsec, 90 * NSEC_PER_MSEC);
+    BOOST_CHECK_GE(total.m_idle_nsec, 90 * NSEC_PER_MSEC);
+
+    client_sock.close();
+    sched.shutdown();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
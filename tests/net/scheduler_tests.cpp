@@ -0,0 +1,612 @@
+// ---------------------------------------------------------------------
+// pion:  a Boost C++ framework for building lightweight HTTP interfaces
+// ---------------------------------------------------------------------
+// Copyright (C) 2021 Wang Qiang  (https://github.com/dnybz/pion)
+// Copyright (C) 2007-2014 Splunk Inc.  (https://github.com/splunk/pion)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <pion/config.hpp>
+#include <pion/scheduler.hpp>
+#include <boost/test/unit_test.hpp>
+#include "net_tests.hpp"
+
+#ifdef __linux__
+    #include <pthread.h>
+    #include <sched.h>
+#endif
+
+using namespace pion;
+
+
+/**
+ * pushes an empty task to a queue
+ *
+ * @param queue the queue
+ * @param priority priority class of the task
+ */
+static void push_task(scheduler::task_queue& queue, scheduler::priority_type priority)
+{
+    queue.push(task([]() {}), priority);
+}
+
+/// returns the priority class of the next task in a queue (or -1 if it is empty)
+static int pop_priority(scheduler::task_queue& queue)
+{
+    scheduler::task_queue::task_type next;
+    return queue.pop(next) ? static_cast<int>(next.m_priority) : -1;
+}
+
+
+///
+/// CountingScheduler: single_service_scheduler that counts the work posted
+/// without a priority
+///
+class CountingScheduler
+    : public single_service_scheduler
+{
+public:
+    virtual ~CountingScheduler() {}
+
+    /// constructs a new CountingScheduler
+    CountingScheduler(void) : m_num_posted(0) {}
+
+    /// counts the work and schedules it as usual
+    virtual void post(task work_func) {
+        ++m_num_posted;
+        single_service_scheduler::post(std::move(work_func));
+    }
+
+    /// returns the number of times that work was posted without a priority
+    inline std::size_t get_num_posted(void) const { return m_num_posted; }
+
+    using single_service_scheduler::post;
+
+
+private:
+
+    /// number of times that work was posted without a priority
+    std::atomic<std::size_t>    m_num_posted;
+};
+
+
+// task_queue Test Cases
+
+BOOST_AUTO_TEST_SUITE(TaskQueueTests_S)
+
+BOOST_AUTO_TEST_CASE(checkLanesAreServedByWeight) {
+    scheduler::task_queue queue;
+    for (int n = 0; n < 100; ++n) {
+        push_task(queue, scheduler::PRIORITY_HIGH);
+        push_task(queue, scheduler::PRIORITY_NORMAL);
+        push_task(queue, scheduler::PRIORITY_LOW);
+    }
+    BOOST_CHECK_EQUAL(queue.size(), 300U);
+
+    // while all lanes have work, each round serves the lanes in proportion
+    // to their weights
+    const uint32_t *weights = scheduler::task_queue::LANE_WEIGHTS;
+    const uint32_t round = weights[0] + weights[1] + weights[2];
+    uint32_t served[scheduler::NUM_PRIORITIES] = { 0, 0, 0 };
+    for (uint32_t n = 0; n < 2 * round; ++n)
+        ++served[pop_priority(queue)];
+    for (int lane = 0; lane < scheduler::NUM_PRIORITIES; ++lane)
+        BOOST_CHECK_EQUAL(served[lane], 2 * weights[lane]);
+    BOOST_CHECK_EQUAL(queue.size(), 300U - 2 * round);
+}
+
+BOOST_AUTO_TEST_CASE(checkIdleLanesDoNotSaveUpCredit) {
+    scheduler::task_queue queue;
+    for (int n = 0; n < 50; ++n)
+        push_task(queue, scheduler::PRIORITY_LOW);
+    for (int n = 0; n < 50; ++n)
+        BOOST_CHECK_EQUAL(pop_priority(queue), scheduler::PRIORITY_LOW);
+
+    // after serving the low lane alone, it does not get ahead of the high lane
+    push_task(queue, scheduler::PRIORITY_LOW);
+    push_task(queue, scheduler::PRIORITY_HIGH);
+    BOOST_CHECK_EQUAL(pop_priority(queue), scheduler::PRIORITY_HIGH);
+    BOOST_CHECK_EQUAL(pop_priority(queue), scheduler::PRIORITY_LOW);
+    BOOST_CHECK_EQUAL(pop_priority(queue), -1);
+}
+
+BOOST_AUTO_TEST_CASE(checkStarvedLanesAreServedOldestFirst) {
+    scheduler::task_queue queue;
+
+    // all three lanes have waited too long: the high lane's task is the
+    // oldest, so it is not passed over for the low lane's
+    push_task(queue, scheduler::PRIORITY_HIGH);
+    scheduler::sleep(0, 2000000); // 0.002 seconds
+    push_task(queue, scheduler::PRIORITY_NORMAL);
+    scheduler::sleep(0, 2000000); // 0.002 seconds
+    push_task(queue, scheduler::PRIORITY_LOW);
+    scheduler::sleep(0, (scheduler::task_queue::MAX_WAIT_MSEC + 50) * 1000000);
+    BOOST_CHECK_EQUAL(pop_priority(queue), scheduler::PRIORITY_HIGH);
+    BOOST_CHECK_EQUAL(pop_priority(queue), scheduler::PRIORITY_NORMAL);
+    BOOST_CHECK_EQUAL(pop_priority(queue), scheduler::PRIORITY_LOW);
+
+    // a starved low priority task that was posted first is served first,
+    // ahead of the weights that favor the other lanes
+    push_task(queue, scheduler::PRIORITY_LOW);
+    scheduler::sleep(0, 2000000); // 0.002 seconds
+    push_task(queue, scheduler::PRIORITY_NORMAL);
+    scheduler::sleep(0, 2000000); // 0.002 seconds
+    push_task(queue, scheduler::PRIORITY_HIGH);
+    scheduler::sleep(0, (scheduler::task_queue::MAX_WAIT_MSEC + 50) * 1000000);
+    push_task(queue, scheduler::PRIORITY_HIGH);
+    BOOST_CHECK_EQUAL(pop_priority(queue), scheduler::PRIORITY_LOW);
+    BOOST_CHECK_EQUAL(pop_priority(queue), scheduler::PRIORITY_NORMAL);
+    BOOST_CHECK_EQUAL(pop_priority(queue), scheduler::PRIORITY_HIGH);
+
+    // the new task has not waited long, and is served by weight
+    BOOST_CHECK_EQUAL(pop_priority(queue), scheduler::PRIORITY_HIGH);
+    BOOST_CHECK_EQUAL(pop_priority(queue), -1);
+}
+
+BOOST_AUTO_TEST_CASE(checkOutOfRangePriorityIsNormal) {
+    scheduler::task_queue queue;
+    push_task(queue, static_cast<scheduler::priority_type>(scheduler::NUM_PRIORITIES));
+    BOOST_CHECK_EQUAL(pop_priority(queue), scheduler::PRIORITY_NORMAL);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+
+// scheduler priority Test Cases
+
+BOOST_AUTO_TEST_SUITE(SchedulerPriorityTests_S)
+
+BOOST_AUTO_TEST_CASE(checkPostWithoutPriorityCanBeOverridden) {
+    CountingScheduler sched;
+    sched.set_num_threads(1);
+    sched.startup();
+    std::atomic<int> num_run(0);
+    scheduler& base = sched;
+    base.post([&num_run]() { ++num_run; });
+    base.post([&num_run]() { ++num_run; }, scheduler::PRIORITY_HIGH);
+    BOOST_CHECK(test::wait_until([&num_run]() { return num_run == 2; }));
+    BOOST_CHECK_EQUAL(sched.get_num_posted(), 1U);
+    sched.shutdown();
+}
+
+BOOST_AUTO_TEST_CASE(checkLaneCountersAreUpdated) {
+    single_service_scheduler sched;
+    sched.set_num_threads(1);
+    sched.startup();
+    sched.reset_stats();
+
+    // the first task holds the thread, so that the others wait in the queue
+    std::atomic<int> num_run(0);
+    sched.post([]() { scheduler::sleep(0, 20000000); }, scheduler::PRIORITY_NORMAL);  // 0.02 seconds
+    for (int n = 0; n < 3; ++n)
+        sched.post([&num_run]() { ++num_run; }, scheduler::PRIORITY_HIGH);
+    for (int n = 0; n < 2; ++n)
+        sched.post([&num_run]() { ++num_run; }, scheduler::PRIORITY_LOW);
+    BOOST_REQUIRE(test::wait_until([&num_run]() { return num_run == 5; }));
+
+    const std::vector<scheduler::stats_type> stats(sched.get_service_stats());
+    BOOST_REQUIRE_EQUAL(stats.size(), 1U);
+    BOOST_CHECK_EQUAL(stats[0].m_lane_tasks[scheduler::PRIORITY_HIGH], 3U);
+    BOOST_CHECK_EQUAL(stats[0].m_lane_tasks[scheduler::PRIORITY_NORMAL], 1U);
+    BOOST_CHECK_EQUAL(stats[0].m_lane_tasks[scheduler::PRIORITY_LOW], 2U);
+    BOOST_CHECK_EQUAL(stats[0].m_lane_wait[scheduler::PRIORITY_HIGH].get_count(), 3U);
+    BOOST_CHECK_EQUAL(stats[0].m_lane_wait[scheduler::PRIORITY_LOW].get_count(), 2U);
+    BOOST_CHECK_EQUAL(stats[0].m_queue_wait.get_count(), 6U);
+
+    // the tasks behind the first one waited for at least 10 milliseconds
+    BOOST_CHECK_GE(stats[0].m_lane_wait[scheduler::PRIORITY_LOW].get_percentile(100), 10000U);
+    sched.shutdown();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+
+///
+/// LoadScheduler: one_to_one_scheduler that exposes the load of its services
+///
+class LoadScheduler
+    : public one_to_one_scheduler
+{
+public:
+    virtual ~LoadScheduler() {}
+
+    /// returns the load of an I/O service (0 if it does not exist)
+    inline uint32_t get_load(uint32_t n) const {
+        const service_pool_ptr pool_ptr(get_service_pool());
+        return (pool_ptr && n < pool_ptr->size() ? (*pool_ptr)[n]->get_load() : 0);
+    }
+
+    /// returns the number of the service that get_io_service() picks (or -1)
+    inline int pick_service(void) {
+        asio::io_service& service = get_io_service();
+        for (uint32_t n = 0; n < get_num_services(); ++n) {
+            if (&get_io_service(n) == &service)
+                return static_cast<int>(n);
+        }
+        return -1;
+    }
+
+    using one_to_one_scheduler::get_queue_depth;
+};
+
+
+// one_to_one_scheduler Test Cases
+
+BOOST_AUTO_TEST_SUITE(OneToOneSchedulerTests_S)
+
+BOOST_AUTO_TEST_CASE(checkConnectionsAreCountedAgainstTheirService) {
+    LoadScheduler sched;
+    sched.set_num_threads(2);
+    sched.connection_opened(sched.get_io_service(0));
+    sched.connection_opened(sched.get_io_service(0));
+    sched.connection_opened(sched.get_io_service(1));
+    BOOST_CHECK_EQUAL(sched.get_load(0), 2U);
+    BOOST_CHECK_EQUAL(sched.get_load(1), 1U);
+
+    // the count never drops below zero
+    sched.connection_closed(sched.get_io_service(1));
+    sched.connection_closed(sched.get_io_service(1));
+    BOOST_CHECK_EQUAL(sched.get_load(1), 0U);
+    sched.connection_opened(sched.get_io_service(1));
+    BOOST_CHECK_EQUAL(sched.get_load(1), 1U);
+
+    // services that belong to someone else are ignored
+    asio::io_service other_service;
+    sched.connection_opened(other_service);
+    sched.connection_closed(other_service);
+    BOOST_CHECK_EQUAL(sched.get_load(0) + sched.get_load(1), 3U);
+}
+
+BOOST_AUTO_TEST_CASE(checkLessLoadedServiceIsPicked) {
+    LoadScheduler sched;
+    sched.set_num_threads(2);
+
+    // with two services, both are compared each time
+    sched.connection_opened(sched.get_io_service(0));
+    for (int n = 0; n < 20; ++n)
+        BOOST_CHECK_EQUAL(sched.pick_service(), 1);
+
+    // with four, the two that are compared are picked at random, so the
+    // most loaded service is never picked and the least loaded one usually is
+    LoadScheduler sched4;
+    sched4.set_num_threads(4);
+    for (uint32_t n = 0; n < 3; ++n) {
+        for (uint32_t i = 0; i < 10 * (3 - n); ++i)
+            sched4.connection_opened(sched4.get_io_service(n));
+    }
+    int picked[4] = { 0, 0, 0, 0 };
+    for (int n = 0; n < 400; ++n)
+        ++picked[sched4.pick_service()];
+    BOOST_CHECK_EQUAL(picked[0], 0);
+    BOOST_CHECK_GT(picked[3], picked[2]);
+    BOOST_CHECK_GT(picked[2], picked[1]);
+    BOOST_CHECK_GT(picked[1], 0);
+}
+
+BOOST_AUTO_TEST_CASE(checkPostedWorkCountsAsLoad) {
+    LoadScheduler sched;
+    sched.set_num_threads(2);
+
+    // the scheduler is not running, so posted work waits in the queues
+    for (int n = 0; n < 10; ++n)
+        sched.post([]() {});
+    BOOST_CHECK_EQUAL(sched.get_load(0) + sched.get_load(1), 10U);
+    BOOST_CHECK_LE(std::max(sched.get_load(0), sched.get_load(1)) - std::min(sched.get_load(0), sched.get_load(1)), 1U);
+    BOOST_CHECK_EQUAL(sched.get_queue_depth(0) + sched.get_queue_depth(1), 10U);
+}
+
+BOOST_AUTO_TEST_CASE(checkServicesCanBeUsedWhileTheSchedulerRestarts) {
+    LoadScheduler sched;
+    sched.set_num_threads(4);
+    sched.startup();
+
+    // other threads keep using the services while the scheduler is shut
+    // down and started again, which replaces them
+    std::atomic<bool> done(false);
+    std::atomic<int> num_run(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 2; ++t) {
+        threads.push_back(std::thread([&sched, &done, &num_run]() {
+            while (! done) {
+                asio::io_service& service = sched.get_io_service();
+                sched.connection_opened(service);
+                sched.post([&num_run]() { ++num_run; });
+                sched.connection_closed(service);
+            }
+        }));
+    }
+    for (int n = 0; n < 20; ++n) {
+        scheduler::sleep(0, 5000000); // 0.005 seconds
+        sched.shutdown();
+        sched.startup();
+    }
+    done = true;
+    for (std::size_t t = 0; t < threads.size(); ++t)
+        threads[t].join();
+    BOOST_CHECK_GT(num_run, 0);
+    sched.shutdown();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+
+/// returns the thread that runs an I/O service's handlers
+static std::thread::id get_service_thread(asio::io_service& service)
+{
+    std::promise<std::thread::id> service_thread;
+    service.post([&service_thread]() { service_thread.set_value(std::this_thread::get_id()); });
+    return service_thread.get_future().get();
+}
+
+
+// work_stealing_scheduler Test Cases
+
+BOOST_AUTO_TEST_SUITE(WorkStealingSchedulerTests_S)
+
+BOOST_AUTO_TEST_CASE(checkWorkPostedToABusyThreadIsStolen) {
+    work_stealing_scheduler sched;
+    sched.set_num_threads(3);
+    sched.startup();
+    const std::thread::id busy_thread(get_service_thread(sched.get_io_service(0)));
+
+    // a handler on thread 0 posts work, which is queued locally to that
+    // thread, and then keeps it busy until all of the work has been done
+    const std::size_t NUM_TASKS = 30;
+    std::mutex run_mutex;
+    std::vector<std::thread::id> run_on;
+    std::promise<bool> all_run;
+    sched.get_io_service(0).post([&sched, &run_mutex, &run_on, &all_run, NUM_TASKS]() {
+        for (std::size_t n = 0; n < NUM_TASKS; ++n) {
+            sched.post([&run_mutex, &run_on]() {
+                std::unique_lock<std::mutex> run_lock(run_mutex);
+                run_on.push_back(std::this_thread::get_id());
+            });
+        }
+        all_run.set_value(test::wait_until([&run_mutex, &run_on, NUM_TASKS]() {
+            std::unique_lock<std::mutex> run_lock(run_mutex);
+            return run_on.size() == NUM_TASKS;
+        }));
+    });
+    BOOST_CHECK(all_run.get_future().get());
+
+    // so the idle threads stole all of it
+    std::unique_lock<std::mutex> run_lock(run_mutex);
+    BOOST_CHECK_EQUAL(run_on.size(), NUM_TASKS);
+    BOOST_CHECK_EQUAL(std::count(run_on.begin(), run_on.end(), busy_thread), 0);
+    run_lock.unlock();
+    sched.shutdown();
+}
+
+BOOST_AUTO_TEST_CASE(checkSocketCompletionsStayOnTheirService) {
+    work_stealing_scheduler sched;
+    sched.set_num_threads(3);
+    sched.startup();
+    asio::io_service& home_service = sched.get_io_service(1);
+    const std::thread::id home_thread(get_service_thread(home_service));
+
+    // a loopback connection whose client socket belongs to service 1
+    asio::io_service io_service;
+    asio::ip::tcp::acceptor acceptor(io_service, asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+    asio::ip::tcp::socket client_sock(home_service);
+    client_sock.connect(acceptor.local_endpoint());
+    asio::ip::tcp::socket server_sock(io_service);
+    acceptor.accept(server_sock);
+
+    // keep service 1's thread busy while data arrives for the client
+    std::promise<void> release;
+    std::shared_future<void> released(release.get_future());
+    std::atomic<bool> holding(false);
+    home_service.post([&holding, released]() {
+        holding = true;
+        released.wait_for(std::chrono::seconds(5));
+    });
+    BOOST_REQUIRE(test::wait_until([&holding]() { return holding.load(); }));
+    std::promise<std::thread::id> completed_on;
+    std::atomic<bool> completed(false);
+    char data[5];
+    client_sock.async_read_some(asio::buffer(data), [&completed_on, &completed](const asio::error_code&, std::size_t) {
+        completed_on.set_value(std::this_thread::get_id());
+        completed = true;
+    });
+    asio::write(server_sock, asio::buffer("hello", 5));
+
+    // the other threads are free, and run posted work (including what was
+    // queued to the busy thread), but never the read's completion
+    std::atomic<int> num_run(0);
+    for (int n = 0; n < 12; ++n)
+        sched.post([&num_run]() { ++num_run; });
+    BOOST_CHECK(test::wait_until([&num_run]() { return num_run == 12; }));
+    scheduler::sleep(0, 100000000); // 0.1 seconds
+    BOOST_CHECK(! completed);
+
+    // which runs on its own thread once that is free again
+    release.set_value();
+    std::future<std::thread::id> completed_future(completed_on.get_future());
+    BOOST_REQUIRE(completed_future.wait_for(std::chrono::seconds(5)) == std::future_status::ready);
+    BOOST_CHECK(completed_future.get() == home_thread);
+
+    client_sock.close();
+    sched.shutdown();
+}
+
+BOOST_AUTO_TEST_CASE(checkWorkCanBePostedWhileTheSchedulerRestarts) {
+    work_stealing_scheduler sched;
+    sched.set_num_threads(4);
+    sched.startup();
+
+    // other threads keep posting work and using the services while the
+    // scheduler is shut down and started again, which replaces the workers
+    std::atomic<bool> done(false);
+    std::atomic<int> num_run(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 2; ++t) {
+        threads.push_back(std::thread([&sched, &done, &num_run]() {
+            while (! done) {
+                sched.post([&num_run]() { ++num_run; });
+                sched.get_io_service();
+            }
+        }));
+    }
+    for (int n = 0; n < 20; ++n) {
+        scheduler::sleep(0, 5000000); // 0.005 seconds
+        sched.shutdown();
+        sched.startup();
+    }
+    done = true;
+    for (std::size_t t = 0; t < threads.size(); ++t)
+        threads[t].join();
+    BOOST_CHECK_GT(num_run, 0);
+    sched.shutdown();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+
+#ifdef __linux__
+
+///
+/// PinningScheduler: one_to_one_scheduler that runs functions on the CPUs of
+/// its threads for the tests
+///
+class PinningScheduler
+    : public one_to_one_scheduler
+{
+public:
+    virtual ~PinningScheduler() {}
+
+    using scheduler::run_pinned;
+};
+
+
+/// returns the CPUs that the calling thread may run on
+static std::vector<uint32_t> get_thread_cpus(void)
+{
+    std::vector<uint32_t> cpus;
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    if (pthread_getaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set) == 0) {
+        for (uint32_t cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &cpu_set))
+                cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+
+/**
+ * returns the CPUs that a scheduler's threads are pinned to: the ones that
+ * the test may use, in reverse order, so that thread n is not simply pinned
+ * to CPU n
+ */
+static std::vector<uint32_t> get_test_cpus(void)
+{
+    std::vector<uint32_t> cpus(get_thread_cpus());
+    std::reverse(cpus.begin(), cpus.end());
+    return cpus;
+}
+
+
+/// returns the CPUs that the thread running an I/O service may run on
+static std::vector<uint32_t> get_service_cpus(asio::io_service& service)
+{
+    std::promise<std::vector<uint32_t> > service_cpus;
+    service.post([&service_cpus]() { service_cpus.set_value(get_thread_cpus()); });
+    return service_cpus.get_future().get();
+}
+
+
+// CPU affinity Test Cases
+
+BOOST_AUTO_TEST_SUITE(SchedulerAffinityTests_S)
+
+BOOST_AUTO_TEST_CASE(checkOneToOneThreadsArePinned) {
+    const std::vector<uint32_t> cpus(get_test_cpus());
+    BOOST_REQUIRE(! cpus.empty());
+    one_to_one_scheduler sched;
+    sched.set_num_threads(3);
+    sched.set_cpu_affinity(cpus);
+    sched.add_active_user();
+    for (uint32_t n = 0; n < sched.get_num_services(); ++n) {
+        const std::vector<uint32_t> service_cpus(get_service_cpus(sched.get_io_service(n)));
+        BOOST_REQUIRE_EQUAL(service_cpus.size(), 1U);
+        BOOST_CHECK_EQUAL(service_cpus[0], cpus[n % cpus.size()]);
+    }
+    sched.remove_active_user();
+    sched.shutdown();
+}
+
+BOOST_AUTO_TEST_CASE(checkWorkStealingThreadsArePinned) {
+    const std::vector<uint32_t> cpus(get_test_cpus());
+    BOOST_REQUIRE(! cpus.empty());
+    work_stealing_scheduler sched;
+    sched.set_num_threads(3);
+    sched.set_cpu_affinity(cpus);
+    sched.add_active_user();
+    for (uint32_t n = 0; n < sched.get_num_services(); ++n) {
+        const std::vector<uint32_t> service_cpus(get_service_cpus(sched.get_io_service(n)));
+        BOOST_REQUIRE_EQUAL(service_cpus.size(), 1U);
+        BOOST_CHECK_EQUAL(service_cpus[0], cpus[n % cpus.size()]);
+    }
+    sched.remove_active_user();
+    sched.shutdown();
+}
+
+BOOST_AUTO_TEST_CASE(checkSingleServiceThreadsArePinned) {
+    const std::vector<uint32_t> cpus(get_test_cpus());
+    BOOST_REQUIRE(! cpus.empty());
+    single_service_scheduler sched;
+    sched.set_num_threads(3);
+    sched.set_cpu_affinity(cpus);
+    sched.add_active_user();
+
+    // whichever thread runs a handler is pinned to one of the CPUs
+    for (int n = 0; n < 10; ++n) {
+        const std::vector<uint32_t> service_cpus(get_service_cpus(sched.get_io_service()));
+        BOOST_REQUIRE_EQUAL(service_cpus.size(), 1U);
+        BOOST_CHECK(std::find(cpus.begin(), cpus.end(), service_cpus[0]) != cpus.end());
+    }
+    sched.remove_active_user();
+    sched.shutdown();
+}
+
+BOOST_AUTO_TEST_CASE(checkPerThreadStateIsCreatedOnTheThreadCpu) {
+    const std::vector<uint32_t> cpus(get_test_cpus());
+    BOOST_REQUIRE(! cpus.empty());
+    PinningScheduler sched;
+    sched.set_num_threads(2);
+
+    // without CPUs, the function runs on the calling thread
+    std::thread::id pinned_thread;
+    sched.run_pinned(1, [&pinned_thread]() { pinned_thread = std::this_thread::get_id(); });
+    BOOST_CHECK(pinned_thread == std::this_thread::get_id());
+
+    // with CPUs, it runs on a thread pinned to the CPU of the scheduler thread
+    sched.set_cpu_affinity(cpus);
+    for (uint32_t n = 0; n < 2; ++n) {
+        std::vector<uint32_t> pinned_cpus;
+        sched.run_pinned(n, [&pinned_thread, &pinned_cpus]() {
+            pinned_thread = std::this_thread::get_id();
+            pinned_cpus = get_thread_cpus();
+        });
+        BOOST_CHECK(pinned_thread != std::this_thread::get_id());
+        BOOST_REQUIRE_EQUAL(pinned_cpus.size(), 1U);
+        BOOST_CHECK_EQUAL(pinned_cpus[0], cpus[n % cpus.size()]);
+    }
+
+    // the calling thread itself is left alone
+    BOOST_CHECK_EQUAL(get_thread_cpus().size(), cpus.size());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+#endif  // __linux__
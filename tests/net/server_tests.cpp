@@ -0,0 +1,399 @@
+// ---------------------------------------------------------------------
+// pion:  a Boost C++ framework for building lightweight HTTP interfaces
+// ---------------------------------------------------------------------
+// Copyright (C) 2021 Wang Qiang  (https://github.com/dnybz/pion)
+// Copyright (C) 2007-2014 Splunk Inc.  (https://github.com/splunk/pion)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include <pion/config.hpp>
+#include <pion/scheduler.hpp>
+#include <pion/tcp/connection_pool.hpp>
+#include <pion/tcp/server.hpp>
+#include <boost/test/unit_test.hpp>
+#include "net_tests.hpp"
+
+using namespace pion;
+
+
+///
+/// ServiceCountingServer: hello_server that counts the connections handled
+/// by each I/O service
+///
+class ServiceCountingServer
+    : public test::hello_server
+{
+public:
+    virtual ~ServiceCountingServer() {}
+
+    /**
+     * creates a new ServiceCountingServer
+     *
+     * @param sched the scheduler that runs the server's connections
+     */
+    explicit ServiceCountingServer(scheduler& sched) : test::hello_server(sched) {}
+
+    /// returns the number of connections handled by each I/O service
+    std::map<asio::io_service*, std::size_t> get_connections_by_service(void) {
+        std::unique_lock<std::mutex> counts_lock(m_mutex);
+        return m_counts;
+    }
+
+    /// counts the connection, then sends the greeting
+    virtual void handle_connection(const tcp::connection_ptr& tcp_conn) {
+        {
+            std::unique_lock<std::mutex> counts_lock(m_mutex);
+            ++m_counts[&tcp_conn->get_io_service()];
+        }
+        test::hello_server::handle_connection(tcp_conn);
+    }
+
+
+private:
+
+    /// protects the counts
+    std::mutex                                  m_mutex;
+
+    /// number of connections handled by each I/O service
+    std::map<asio::io_service*, std::size_t>    m_counts;
+};
+
+
+// multi-acceptor Test Cases
+
+BOOST_AUTO_TEST_SUITE(MultiAcceptorTests_S)
+
+BOOST_AUTO_TEST_CASE(checkOneAcceptorPerServiceServesRequests) {
+    one_to_one_scheduler sched;
+    sched.set_num_threads(4);
+    ServiceCountingServer server(sched);
+    server.set_multi_acceptor();
+    server.start();
+    BOOST_REQUIRE_EQUAL(sched.get_num_services(), 4U);
+#if defined(SO_REUSEPORT) && !defined(PION_WIN32)
+    BOOST_CHECK_EQUAL(server.get_num_acceptors(), 4U);
+#else
+    BOOST_CHECK_EQUAL(server.get_num_acceptors(), 1U);
+#endif
+
+    // the kernel spreads new connections across the listening sockets, and
+    // each connection is handled by the service of the socket that accepted it
+    for (int n = 0; n < 64; ++n)
+        BOOST_REQUIRE_EQUAL(test::read_greeting(server.get_port()), "Hello there!\n");
+    const std::map<asio::io_service*, std::size_t> counts(server.get_connections_by_service());
+    BOOST_CHECK_EQUAL(counts.size(), server.get_num_acceptors());
+    std::size_t total = 0;
+    for (std::map<asio::io_service*, std::size_t>::const_iterator i = counts.begin(); i != counts.end(); ++i) {
+        bool is_scheduler_service = false;
+        for (uint32_t n = 0; n < sched.get_num_services(); ++n)
+            is_scheduler_service = is_scheduler_service || i->first == &sched.get_io_service(n);
+        BOOST_CHECK(is_scheduler_service);
+        total += i->second;
+    }
+    BOOST_CHECK_EQUAL(total, 64U);
+
+    server.stop();
+    sched.shutdown();
+}
+
+BOOST_AUTO_TEST_CASE(checkSingleServiceUsesOneAcceptor) {
+    single_service_scheduler sched;
+    sched.set_num_threads(2);
+    ServiceCountingServer server(sched);
+    server.set_multi_acceptor();
+    server.start();
+    BOOST_CHECK_EQUAL(server.get_num_acceptors(), 1U);
+    BOOST_CHECK_EQUAL(test::read_greeting(server.get_port()), "Hello there!\n");
+    server.stop();
+    sched.shutdown();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+
+///
+/// OrphaningServer: TCP server that reads one byte from each connection and
+/// then sends "bye" and closes it, except for connections that send "o":
+/// those are dropped without being finished, so that only the server's
+/// registry refers to them until they are pruned
+///
+class OrphaningServer
+    : public tcp::server
+{
+public:
+    virtual ~OrphaningServer() {}
+
+    /**
+     * creates a new OrphaningServer
+     *
+     * @param sched the scheduler that runs the server's connections
+     */
+    explicit OrphaningServer(scheduler& sched) : tcp::server(sched, 0) {}
+
+    /// reads the first byte from a new connection
+    virtual void handle_connection(const tcp::connection_ptr& tcp_conn) {
+        static const std::string BYE_MESSAGE("bye\n");
+        tcp_conn->set_lifecycle(tcp::connection::LIFECYCLE_CLOSE);
+        tcp_conn->async_read_some([tcp_conn](const asio::error_code& read_error, std::size_t bytes_read) {
+            if (read_error) {
+                tcp_conn->finish();
+            } else if (bytes_read > 0 && tcp_conn->get_read_buffer()[0] != 'o') {
+                tcp_conn->async_write(asio::buffer(BYE_MESSAGE),
+                                      [tcp_conn](const asio::error_code&, std::size_t) { tcp_conn->finish(); });
+            }
+        });
+    }
+};
+
+
+/// returns true if the other end closed a socket
+static bool is_closed_by_peer(asio::ip::tcp::socket& sock)
+{
+    char data[16];
+    asio::error_code ec;
+    while (! ec)
+        sock.read_some(asio::buffer(data), ec);
+    return ec == asio::error::eof || ec == asio::error::connection_reset;
+}
+
+
+// connection registry Test Cases
+
+BOOST_AUTO_TEST_SUITE(ConnectionRegistryTests_S)
+
+BOOST_AUTO_TEST_CASE(checkConnectionCountUnderConcurrentOpenCloseAndPruning) {
+    one_to_one_scheduler sched;
+    sched.set_num_threads(4);
+    OrphaningServer server(sched);
+    server.start();
+    const asio::ip::tcp::endpoint endpoint(asio::ip::address_v4::loopback(), server.get_port());
+
+    // clients open and close connections for longer than the prune timer's
+    // period, orphaning every fifth one, which they keep open
+    asio::io_service io_service;
+    std::mutex orphans_mutex;
+    std::vector<std::shared_ptr<asio::ip::tcp::socket> > orphans;
+    std::atomic<std::size_t> num_closed(0);
+    std::atomic<std::size_t> num_failed(0);
+    std::atomic<std::size_t> max_connections(0);
+    const std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(1500);
+    std::vector<std::thread> clients;
+    for (int t = 0; t < 4; ++t) {
+        clients.push_back(std::thread([&server, &endpoint, &io_service, &orphans_mutex, &orphans,
+                                       &num_closed, &num_failed, &max_connections, deadline]()
+        {
+            for (int n = 0; std::chrono::steady_clock::now() < deadline; ++n) {
+                std::shared_ptr<asio::ip::tcp::socket> sock(new asio::ip::tcp::socket(io_service));
+                asio::error_code ec;
+                sock->connect(endpoint, ec);
+                if (! ec)
+                    asio::write(*sock, asio::buffer(n % 5 == 4 ? "o" : "x", 1), ec);
+                if (ec) {
+                    ++num_failed;
+                    continue;
+                }
+                if (n % 5 == 4) {
+                    std::unique_lock<std::mutex> orphans_lock(orphans_mutex);
+                    orphans.push_back(sock);
+                } else if (is_closed_by_peer(*sock)) {
+                    ++num_closed;
+                } else {
+                    ++num_failed;
+                }
+                std::size_t seen = max_connections;
+                const std::size_t num_connections = server.get_connections();
+                while (num_connections > seen && ! max_connections.compare_exchange_weak(seen, num_connections)) ;
+            }
+        }));
+    }
+    for (std::size_t t = 0; t < clients.size(); ++t)
+        clients[t].join();
+    BOOST_CHECK_EQUAL(num_failed, 0U);
+    BOOST_CHECK_GT(num_closed, 0U);
+    BOOST_REQUIRE(! orphans.empty());
+
+    // the count never went below zero (or past what could be open at once)
+    BOOST_CHECK_LE(max_connections, orphans.size() + 4);
+    BOOST_CHECK_LE(server.get_connections(), orphans.size());
+
+    // the orphans are pruned, and closed
+    BOOST_CHECK(test::wait_until([&server]() { return server.get_connections() == 0; }));
+    for (std::size_t n = 0; n < orphans.size(); ++n)
+        BOOST_CHECK(is_closed_by_peer(*orphans[n]));
+
+    // connections that are open are counted until they close
+    std::vector<std::shared_ptr<asio::ip::tcp::socket> > open_sockets;
+    for (int n = 0; n < 10; ++n) {
+        open_sockets.push_back(std::make_shared<asio::ip::tcp::socket>(io_service));
+        open_sockets.back()->connect(endpoint);
+    }
+    BOOST_CHECK(test::wait_until([&server]() { return server.get_connections() == 10; }));
+    scheduler::sleep(1, 100000000);     // 1.1 seconds, so that they are seen by the prune timer
+    BOOST_CHECK_EQUAL(server.get_connections(), 10U);
+    for (std::size_t n = 0; n < open_sockets.size(); ++n)
+        open_sockets[n]->close();
+    BOOST_CHECK(test::wait_until([&server]() { return server.get_connections() == 0; }));
+
+    server.stop();
+    sched.shutdown();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+
+///
+/// ConnectionRecordingServer: hello_http_server that records which connection
+/// objects served its requests
+///
+class ConnectionRecordingServer
+    : public test::hello_http_server
+{
+public:
+    virtual ~ConnectionRecordingServer() {}
+
+    /**
+     * creates a new ConnectionRecordingServer
+     *
+     * @param sched the scheduler that runs the server's connections
+     */
+    explicit ConnectionRecordingServer(scheduler& sched) : test::hello_http_server(sched) {}
+
+    /// returns the number of distinct connection objects that served requests
+    inline std::size_t get_num_connection_objects(void) {
+        std::unique_lock<std::mutex> objects_lock(m_mutex);
+        return m_objects.size();
+    }
+
+    /// records the connection, then responds
+    virtual void handle_hello(const http::request_ptr& http_request_ptr,
+                              const tcp::connection_ptr& tcp_conn)
+    {
+        {
+            std::unique_lock<std::mutex> objects_lock(m_mutex);
+            m_objects.insert(tcp_conn.get());
+        }
+        test::hello_http_server::handle_hello(http_request_ptr, tcp_conn);
+    }
+
+
+private:
+
+    /// protects the connection objects
+    std::mutex                      m_mutex;
+
+    /// connection objects that served requests
+    std::set<tcp::connection*>      m_objects;
+};
+
+
+// connection_pool Test Cases
+
+BOOST_AUTO_TEST_SUITE(ConnectionPoolTests_S)
+
+BOOST_AUTO_TEST_CASE(checkPoolKeepsConnectionsUpToItsSize) {
+    asio::io_service io_service;
+    test::hello_server server;  // provides an SSL context
+    const tcp::connection_pool_ptr pool_ptr(new tcp::connection_pool(io_service, server.get_ssl_context_type(),
+                                                                     false, tcp::connection::connection_handler(), 2));
+    BOOST_CHECK_EQUAL(pool_ptr->size(), 0U);
+
+    // three connections are allocated, and two of them are kept when released
+    std::vector<tcp::connection_ptr> connections;
+    for (int n = 0; n < 3; ++n)
+        connections.push_back(pool_ptr->create());
+    const tcp::connection *first = connections[0].get();
+    const tcp::connection *second = connections[1].get();
+    connections[1]->set_lifecycle(tcp::connection::LIFECYCLE_KEEPALIVE);
+    connections.clear();
+    BOOST_CHECK_EQUAL(pool_ptr->size(), 2U);
+
+    // the kept connections are handed out again (the last one released first),
+    // with their state cleared
+    tcp::connection_ptr recycled(pool_ptr->create());
+    BOOST_CHECK_EQUAL(recycled.get(), second);
+    BOOST_CHECK(! recycled->get_keep_alive());
+    BOOST_CHECK(! recycled->is_open());
+    tcp::connection_ptr recycled_too(pool_ptr->create());
+    BOOST_CHECK_EQUAL(recycled_too.get(), first);
+    BOOST_CHECK_EQUAL(pool_ptr->size(), 0U);
+
+    // no more than the pool's size are allocated in advance
+    pool_ptr->reserve(5);
+    BOOST_CHECK_EQUAL(pool_ptr->size(), 2U);
+
+    // once closed, the pool keeps nothing
+    pool_ptr->close();
+    BOOST_CHECK_EQUAL(pool_ptr->size(), 0U);
+    recycled.reset();
+    recycled_too.reset();
+    BOOST_CHECK_EQUAL(pool_ptr->size(), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(checkServerRecyclesFinishedConnections) {
+    one_to_one_scheduler sched;
+    sched.set_num_threads(1);
+    ConnectionRecordingServer server(sched);
+    server.set_connection_pool_size(2);
+    server.start();
+
+    // one of the two connections allocated in advance waits for the next accept
+    BOOST_CHECK(test::wait_until([&server]() { return server.get_idle_connections() == 1; }));
+
+    // more connections than the pool's size are allocated while they are open,
+    // but only the pool's size are kept once they have finished
+    asio::io_service io_service;
+    std::vector<std::shared_ptr<tcp::connection> > connections;
+    for (int n = 0; n < 4; ++n) {
+        connections.push_back(std::make_shared<tcp::connection>(io_service));
+        BOOST_REQUIRE(! connections.back()->connect(asio::ip::address::from_string("127.0.0.1"),
+                                                    server.get_port()));
+    }
+    BOOST_REQUIRE(test::wait_until([&server]() { return server.get_connections() == 4; }));
+    BOOST_CHECK_EQUAL(server.get_idle_connections(), 0U);
+    connections.clear();
+    BOOST_CHECK(test::wait_until([&server]() { return server.get_connections() == 0; }));
+    BOOST_CHECK(test::wait_until([&server]() { return server.get_idle_connections() == 2; }));
+
+    // connections made one at a time reuse the same few objects
+    for (int n = 0; n < 20; ++n) {
+        const std::string response(test::send_request(server.get_port(), "/hello"));
+        BOOST_REQUIRE_EQUAL(response.compare(0, 15, "HTTP/1.1 200 OK"), 0);
+        BOOST_CHECK(test::wait_until([&server]() { return server.get_connections() == 0; }));
+    }
+    BOOST_CHECK_LE(server.get_num_connection_objects(), 3U);
+    BOOST_CHECK(test::wait_until([&server]() { return server.get_idle_connections() == 2; }));
+
+    // the idle connections are deleted when the server stops
+    server.stop();
+    BOOST_CHECK_EQUAL(server.get_idle_connections(), 0U);
+    sched.shutdown();
+}
+
+BOOST_AUTO_TEST_CASE(checkServerWithoutPoolStillServes) {
+    one_to_one_scheduler sched;
+    sched.set_num_threads(1);
+    ConnectionRecordingServer server(sched);
+    server.set_connection_pool_size(0);
+    server.start();
+    for (int n = 0; n < 3; ++n) {
+        const std::string response(test::send_request(server.get_port(), "/hello"));
+        BOOST_CHECK_EQUAL(response.compare(0, 15, "HTTP/1.1 200 OK"), 0);
+    }
+    BOOST_CHECK_EQUAL(server.get_idle_connections(), 0U);
+    server.stop();
+    sched.shutdown();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
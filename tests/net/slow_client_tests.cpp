@@ -0,0 +1,167 @@
+// ---------------------------------------------------------------------
+// pion:  a Boost C++ framework for building lightweight HTTP interfaces
+// ---------------------------------------------------------------------
+// Copyright (C) 2021 Wang Qiang  (https://github.com/dnybz/pion)
+// Copyright (C) 2007-2014 Splunk Inc.  (https://github.com/splunk/pion)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include <algorithm>
+#include <pion/config.hpp>
+#include <pion/http/server.hpp>
+#include <pion/http/response_writer.hpp>
+#include <boost/test/unit_test.hpp>
+#include "net_tests.hpp"
+
+using namespace pion;
+
+
+/// SlowClientServer: HTTP server with short slow-client limits that answers
+/// "/big" with a large response
+///
+class SlowClientServer
+    : public http::server
+{
+public:
+    virtual ~SlowClientServer() {}
+
+    /// size of the "/big" response
+    enum { BIG_CONTENT_SIZE = 64 * 1024 * 1024 };
+
+    /// creates a new SlowClientServer
+    SlowClientServer(void) : http::server(0), m_big_content(BIG_CONTENT_SIZE, 'x') {
+        set_read_timeout(1);
+        set_header_timeout(2);
+        set_min_body_rate(1000);
+        add_resource("/big", std::bind(&SlowClientServer::handle_big, this,
+                                       std::placeholders::_1, std::placeholders::_2));
+    }
+
+
+private:
+
+    /**
+     * sends the large response with a one second send-stall timeout
+     *
+     * @param http_request_ptr the request to respond to
+     * @param tcp_conn the TCP connection to the client
+     */
+    void handle_big(const http::request_ptr& http_request_ptr,
+                    const tcp::connection_ptr& tcp_conn)
+    {
+        http::response_writer_ptr writer(http::response_writer::create(tcp_conn, *http_request_ptr,
+                                                                       std::bind(&tcp::connection::finish, tcp_conn)));
+        writer->set_send_timeout(1);
+        writer->write_no_copy(m_big_content);
+        writer->send();
+    }
+
+    /// content of the "/big" response
+    const std::string   m_big_content;
+};
+
+
+/**
+ * sends data to a connection a few bytes at a time, then waits for the server
+ * to close the connection
+ *
+ * @param tcp_conn the connection to the server
+ * @param data the data to send
+ * @param bytes_per_write number of bytes sent at a time
+ * @param milliseconds time between writes
+ *
+ * @return true if the server closed the connection within 10 seconds
+ */
+static bool trickle(tcp::connection& tcp_conn, const std::string& data,
+                    std::size_t bytes_per_write, unsigned long milliseconds)
+{
+    asio::error_code error_code;
+    for (std::size_t pos = 0; pos < data.size(); pos += bytes_per_write) {
+        tcp_conn.write(asio::buffer(data.data() + pos, std::min(bytes_per_write, data.size() - pos)),
+                       error_code);
+        if (error_code)
+            return true;    // already closed
+        scheduler::sleep(0, milliseconds * 1000000);
+    }
+    // the server closes the connection without a response
+    tcp_conn.read_some(error_code);
+    return error_code == asio::error::eof || error_code == asio::error::connection_reset;
+}
+
+
+// slow client Test Cases
+
+BOOST_AUTO_TEST_SUITE(SlowClientTests_S)
+
+BOOST_AUTO_TEST_CASE(checkHeaderTimeoutIsNotExtendedByTrickledData) {
+    SlowClientServer server;
+    server.start();
+
+    // each byte arrives well within the read timeout, but the headers as a
+    // whole take longer than the header timeout
+    asio::io_service io_service;
+    tcp::connection tcp_conn(io_service);
+    asio::error_code error_code;
+    error_code = tcp_conn.connect(asio::ip::address::from_string("127.0.0.1"), server.get_port());
+    BOOST_REQUIRE(! error_code);
+    std::string headers("GET /big HTTP/1.1\r\nHost: localhost\r\nX-Slow: 0123456789012345678901234567890123456789\r\n\r\n");
+    BOOST_CHECK(trickle(tcp_conn, headers, 1, 200));
+    for (int i = 0; i < 10 && server.get_connections() > 0; ++i)
+        scheduler::sleep(0, 100000000); // 0.1 seconds
+    BOOST_CHECK_EQUAL(server.get_header_timeouts(), 1U);
+    BOOST_CHECK_EQUAL(server.get_body_rate_timeouts(), 0U);
+
+    tcp_conn.close();
+    server.stop();
+}
+
+BOOST_AUTO_TEST_CASE(checkSlowBodyIsCutOff) {
+    SlowClientServer server;
+    server.start();
+
+    // the headers arrive at once, but the body arrives at 100 bytes per second
+    asio::io_service io_service;
+    tcp::connection tcp_conn(io_service);
+    asio::error_code error_code;
+    error_code = tcp_conn.connect(asio::ip::address::from_string("127.0.0.1"), server.get_port());
+    BOOST_REQUIRE(! error_code);
+    std::string request("POST /big HTTP/1.1\r\nHost: localhost\r\nContent-Length: 100000\r\n\r\n");
+    tcp_conn.write(asio::buffer(request), error_code);
+    BOOST_REQUIRE(! error_code);
+    BOOST_CHECK(trickle(tcp_conn, std::string(1000, 'x'), 10, 100));
+    for (int i = 0; i < 10 && server.get_connections() > 0; ++i)
+        scheduler::sleep(0, 100000000); // 0.1 seconds
+    BOOST_CHECK_EQUAL(server.get_body_rate_timeouts(), 1U);
+    BOOST_CHECK_EQUAL(server.get_header_timeouts(), 0U);
+
+    tcp_conn.close();
+    server.stop();
+}
+
+BOOST_AUTO_TEST_CASE(checkSendStallIsCutOff) {
+    SlowClientServer server;
+    server.start();
+
+    // the client requests a large response and never reads it
+    asio::io_service io_service;
+    tcp::connection tcp_conn(io_service);
+    asio::error_code error_code;
+    error_code = tcp_conn.connect(asio::ip::address::from_string("127.0.0.1"), server.get_port());
+    BOOST_REQUIRE(! error_code);
+    std::string request("GET /big HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    tcp_conn.write(asio::buffer(request), error_code);
+    BOOST_REQUIRE(! error_code);
+    for (int i = 0; i < 100 && server.get_send_stalls() == 0; ++i)
+        scheduler::sleep(0, 100000000); // 0.1 seconds
+    BOOST_CHECK_EQUAL(server.get_send_stalls(), 1U);
+    for (int i = 0; i < 10 && server.get_connections() > 0; ++i)
+        scheduler::sleep(0, 100000000); // 0.1 seconds
+    BOOST_CHECK_EQUAL(server.get_connections(), 0U);
+
+    tcp_conn.close();
+    server.stop();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,150 @@
+// ---------------------------------------------------------------------
+// pion:  a Boost C++ framework for building lightweight HTTP interfaces
+// ---------------------------------------------------------------------
+// Copyright (C) 2021 Wang Qiang  (https://github.com/dnybz/pion)
+// Copyright (C) 2007-2014 Splunk Inc.  (https://github.com/splunk/pion)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include <pion/config.hpp>
+#include <pion/tcp/server.hpp>
+#include <boost/test/unit_test.hpp>
+#include "net_tests.hpp"
+
+using namespace pion;
+
+
+/// OptionsServer: TCP server that reads back the socket options of the
+/// connections that it accepts
+///
+class OptionsServer
+    : public tcp::server
+{
+public:
+    virtual ~OptionsServer() {}
+
+    /// creates a new OptionsServer that uses the given socket options
+    explicit OptionsServer(const tcp::socket_options& opts)
+        : tcp::server(0), m_num_accepted(0), m_no_delay(false), m_keep_alive(false)
+    {
+        set_socket_options(opts);
+    }
+
+    /// returns the number of connections accepted
+    inline std::size_t get_num_accepted(void) const { return m_num_accepted; }
+
+    /// returns true if TCP_NODELAY was set on the last accepted connection
+    inline bool get_no_delay(void) const { return m_no_delay; }
+
+    /// returns true if SO_KEEPALIVE was set on the last accepted connection
+    inline bool get_keep_alive(void) const { return m_keep_alive; }
+
+
+protected:
+
+    /**
+     * reads the connection's socket options and closes it
+     *
+     * @param tcp_conn the new TCP connection to handle
+     */
+    virtual void handle_connection(const tcp::connection_ptr& tcp_conn) {
+        asio::ip::tcp::no_delay no_delay;
+        asio::socket_base::keep_alive keep_alive;
+        tcp_conn->get_socket().get_option(no_delay);
+        tcp_conn->get_socket().get_option(keep_alive);
+        m_no_delay = no_delay.value();
+        m_keep_alive = keep_alive.value();
+        ++m_num_accepted;
+        tcp_conn->set_lifecycle(tcp::connection::LIFECYCLE_CLOSE);
+        tcp_conn->finish();
+    }
+
+
+private:
+
+    /// number of connections accepted
+    std::atomic<std::size_t>    m_num_accepted;
+
+    /// true if TCP_NODELAY was set on the last accepted connection
+    std::atomic<bool>           m_no_delay;
+
+    /// true if SO_KEEPALIVE was set on the last accepted connection
+    std::atomic<bool>           m_keep_alive;
+};
+
+
+// socket_options Test Cases
+
+BOOST_AUTO_TEST_SUITE(SocketOptionsTests_S)
+
+BOOST_AUTO_TEST_CASE(checkSetOptionsByName) {
+    tcp::socket_options opts;
+    BOOST_CHECK(! opts.m_no_delay);
+    BOOST_CHECK(opts.set("nodelay", "1"));
+    BOOST_CHECK(opts.m_no_delay);
+    BOOST_CHECK(opts.set("keepalive_idle", "30"));
+    BOOST_CHECK_EQUAL(opts.m_keep_alive_idle, 30);
+    BOOST_CHECK(opts.set("backlog", "128"));
+    BOOST_CHECK_EQUAL(opts.get_backlog(), 128);
+    BOOST_CHECK(! opts.set("unknown", "1"));
+    BOOST_CHECK(! opts.set("send_buffer", "big"));
+    BOOST_CHECK(! opts.set("send_buffer", "-1"));
+    BOOST_CHECK_EQUAL(opts.m_send_buffer_size, 0);
+}
+
+BOOST_AUTO_TEST_CASE(checkOptionsAreAppliedToListenerAndConnections) {
+    tcp::socket_options opts;
+    opts.m_no_delay = true;
+    opts.m_keep_alive = true;
+    opts.m_keep_alive_idle = 30;
+    opts.m_receive_buffer_size = 65536;
+    opts.m_defer_accept = 5;
+    OptionsServer server(opts);
+    server.start();
+
+    // the listening socket has the options
+    asio::ip::tcp::no_delay no_delay;
+    server.get_acceptor().get_option(no_delay);
+    BOOST_CHECK(no_delay.value());
+    asio::socket_base::keep_alive keep_alive;
+    server.get_acceptor().get_option(keep_alive);
+    BOOST_CHECK(keep_alive.value());
+    asio::socket_base::receive_buffer_size receive_buffer_size;
+    server.get_acceptor().get_option(receive_buffer_size);
+    BOOST_CHECK_GE(receive_buffer_size.value(), 65536);
+#ifdef TCP_DEFER_ACCEPT
+    int defer_accept = 0;
+    socklen_t len = sizeof(defer_accept);
+    BOOST_REQUIRE_EQUAL(getsockopt(server.get_acceptor().native_handle(), IPPROTO_TCP,
+                                   TCP_DEFER_ACCEPT, &defer_accept, &len), 0);
+    BOOST_CHECK_GT(defer_accept, 0);
+#endif
+
+    // connections accepted by the server have them too (with TCP_DEFER_ACCEPT,
+    // the connection is only accepted once the client sends something)
+    asio::io_service io_service;
+    tcp::connection tcp_conn(io_service);
+    asio::error_code error_code;
+    error_code = tcp_conn.connect(asio::ip::address::from_string("127.0.0.1"), server.get_port());
+    BOOST_REQUIRE(! error_code);
+    tcp_conn.write(asio::buffer("x", 1), error_code);
+    BOOST_REQUIRE(! error_code);
+    for (int i = 0; i < 10 && server.get_num_accepted() == 0; ++i)
+        scheduler::sleep(0, 100000000); // 0.1 seconds
+    BOOST_REQUIRE_EQUAL(server.get_num_accepted(), 1U);
+    BOOST_CHECK(server.get_no_delay());
+    BOOST_CHECK(server.get_keep_alive());
+
+    // client connections can use the same options
+    error_code = tcp_conn.set_socket_options(opts);
+    BOOST_CHECK(! error_code);
+    tcp_conn.get_socket().get_option(no_delay);
+    BOOST_CHECK(no_delay.value());
+
+    tcp_conn.close();
+    server.stop();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,359 @@
+// ---------------------------------------------------------------------
+// pion:  a Boost C++ framework for building lightweight HTTP interfaces
+// ---------------------------------------------------------------------
+// Copyright (C) 2021 Wang Qiang  (https://github.com/dnybz/pion)
+// Copyright (C) 2007-2014 Splunk Inc.  (https://github.com/splunk/pion)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include <algorithm>
+#include <pion/config.hpp>
+#include <pion/http/server.hpp>
+#include <pion/http/response_writer.hpp>
+#include <boost/test/unit_test.hpp>
+#include "net_tests.hpp"
+#ifdef PION_HAVE_SSL
+#include <openssl/ec.h>
+#include <openssl/x509.h>
+#endif
+
+using namespace pion;
+
+
+#ifdef PION_HAVE_SSL
+
+///
+/// SessionCacheServer: HTTPS server with a self-signed certificate that
+/// answers "/hello"
+///
+class SessionCacheServer
+    : public http::server
+{
+public:
+    virtual ~SessionCacheServer() {}
+
+    /// creates a new SessionCacheServer
+    SessionCacheServer(void) : http::server(0) {
+        set_ssl_flag(true);
+        SSL_CTX *ctx = get_ssl_context_type().native_handle();
+
+        // generate an EC key and a certificate for it
+        EVP_PKEY *key = NULL;
+        EVP_PKEY_CTX *key_ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, NULL);
+        EVP_PKEY_keygen_init(key_ctx);
+        EVP_PKEY_CTX_set_ec_paramgen_curve_nid(key_ctx, NID_X9_62_prime256v1);
+        EVP_PKEY_keygen(key_ctx, &key);
+        EVP_PKEY_CTX_free(key_ctx);
+        X509 *cert = X509_new();
+        ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+        X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+        X509_gmtime_adj(X509_getm_notAfter(cert), 3600);
+        X509_set_pubkey(cert, key);
+        X509_NAME_add_entry_by_txt(X509_get_subject_name(cert), "CN", MBSTRING_ASC,
+                                   reinterpret_cast<const unsigned char*>("localhost"), -1, -1, 0);
+        X509_set_issuer_name(cert, X509_get_subject_name(cert));
+        X509_sign(cert, key, EVP_sha256());
+        SSL_CTX_use_certificate(ctx, cert);
+        SSL_CTX_use_PrivateKey(ctx, key);
+        X509_free(cert);
+        EVP_PKEY_free(key);
+
+        add_resource("/hello", std::bind(&SessionCacheServer::handle_hello, this,
+                                         std::placeholders::_1, std::placeholders::_2));
+        add_resource("/large", std::bind(&SessionCacheServer::handle_large, this,
+                                         std::placeholders::_1, std::placeholders::_2));
+    }
+
+    /// size of the response to "/large"
+    enum { LARGE_RESPONSE_SIZE = 100000 };
+
+
+private:
+
+    /**
+     * sends a short response
+     *
+     * @param http_request_ptr the request to respond to
+     * @param tcp_conn the TCP connection to the client
+     */
+    void handle_hello(const http::request_ptr& http_request_ptr,
+                      const tcp::connection_ptr& tcp_conn)
+    {
+        http::response_writer_ptr writer(http::response_writer::create(tcp_conn, *http_request_ptr,
+                                                                       std::bind(&tcp::connection::finish, tcp_conn)));
+        writer->write("hello");
+        writer->send();
+    }
+
+    /**
+     * sends a large response in many small pieces
+     *
+     * @param http_request_ptr the request to respond to
+     * @param tcp_conn the TCP connection to the client
+     */
+    void handle_large(const http::request_ptr& http_request_ptr,
+                      const tcp::connection_ptr& tcp_conn)
+    {
+        http::response_writer_ptr writer(http::response_writer::create(tcp_conn, *http_request_ptr,
+                                                                       std::bind(&tcp::connection::finish, tcp_conn)));
+        for (int n = 0; n < LARGE_RESPONSE_SIZE / 10; ++n)
+            writer->write("0123456789");
+        writer->send();
+    }
+};
+
+
+/**
+ * connects to a SessionCacheServer and requests "/hello"
+ *
+ * @param port the server's port number
+ * @param session a session to resume (NULL for a full handshake)
+ * @param reused set to true if the session was resumed
+ *
+ * @return SSL_SESSION* the connection's session (the caller must free it), or
+ *                      NULL if the request failed
+ */
+static SSL_SESSION *request_hello(unsigned int port, SSL_SESSION *session, bool& reused)
+{
+    asio::io_service io_service;
+    asio::ssl::context ssl_context(asio::ssl::context::tls);
+    tcp::connection tcp_conn(io_service, ssl_context);
+    asio::error_code error_code;
+    error_code = tcp_conn.connect(asio::ip::address::from_string("127.0.0.1"), port);
+    if (error_code)
+        return NULL;
+    SSL *ssl = tcp_conn.get_ssl_socket().native_handle();
+    if (session != NULL)
+        SSL_set_session(ssl, session);
+    error_code = tcp_conn.handshake_client();
+    if (error_code)
+        return NULL;
+
+    // read the response, so that session tickets sent after the handshake
+    // (TLS 1.3) are received; the session is taken before the server closes
+    // the connection, since an SSL connection that ends without a shutdown
+    // alert cannot be resumed
+    std::string request("GET /hello HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n");
+    tcp_conn.write(asio::buffer(request), error_code);
+    std::string response;
+    while (! error_code && response.find("hello") == std::string::npos) {
+        const std::size_t bytes_read = tcp_conn.read_some(error_code);
+        response.append(tcp_conn.get_read_buffer().data(), bytes_read);
+    }
+    if (error_code)
+        return NULL;
+    reused = (SSL_session_reused(ssl) == 1);
+    return SSL_get1_session(ssl);
+}
+
+
+/// lengths of the application data records that a client received
+static std::vector<std::size_t> g_record_lengths;
+
+/// OpenSSL callback: keeps the lengths of application data records received
+static void record_length_callback(int write_p, int /* version */, int content_type,
+                                   const void *buf, std::size_t len, SSL * /* ssl */, void * /* arg */)
+{
+    const unsigned char *header = static_cast<const unsigned char*>(buf);
+    if (! write_p && content_type == SSL3_RT_HEADER && len == SSL3_RT_HEADER_LENGTH
+        && header[0] == SSL3_RT_APPLICATION_DATA)
+        g_record_lengths.push_back((header[3] << 8) | header[4]);
+}
+
+
+// SSL session cache Test Cases
+
+BOOST_AUTO_TEST_SUITE(SSLSessionCacheTests_S)
+
+BOOST_AUTO_TEST_CASE(checkReconnectResumesSessionFromTicket) {
+    SessionCacheServer server;
+    server.start();
+
+    bool reused = true;
+    SSL_SESSION *session = request_hello(server.get_port(), NULL, reused);
+    BOOST_REQUIRE(session != NULL);
+    BOOST_CHECK(! reused);
+
+    SSL_SESSION *resumed_session = request_hello(server.get_port(), session, reused);
+    BOOST_REQUIRE(resumed_session != NULL);
+    BOOST_CHECK(reused);
+    BOOST_CHECK_GE(server.get_ssl_session_cache().get_ticket_hits(), 1U);
+    BOOST_CHECK_EQUAL(server.get_ssl_session_cache().get_ticket_misses(), 0U);
+    BOOST_CHECK_EQUAL(server.get_ssl_session_cache().get_ticket_key_rotations(), 1U);
+
+    SSL_SESSION_free(resumed_session);
+    SSL_SESSION_free(session);
+    server.stop();
+}
+
+BOOST_AUTO_TEST_CASE(checkReconnectResumesSessionFromCache) {
+    SessionCacheServer server;
+    server.get_ssl_session_cache().set_tickets(false);
+    server.start();
+
+    bool reused = true;
+    SSL_SESSION *session = request_hello(server.get_port(), NULL, reused);
+    BOOST_REQUIRE(session != NULL);
+    BOOST_CHECK(! reused);
+    BOOST_CHECK_GE(server.get_ssl_session_cache().get_num_sessions(), 1U);
+
+    SSL_SESSION *resumed_session = request_hello(server.get_port(), session, reused);
+    BOOST_REQUIRE(resumed_session != NULL);
+    BOOST_CHECK(reused);
+    BOOST_CHECK_EQUAL(server.get_ssl_session_cache().get_hits(), 1U);
+    BOOST_CHECK_EQUAL(server.get_ssl_session_cache().get_misses(), 0U);
+    BOOST_CHECK_EQUAL(server.get_ssl_session_cache().get_ticket_hits(), 0U);
+
+    // a session that is not cached gets a full handshake
+    server.get_ssl_session_cache().clear();
+    SSL_SESSION *new_session = request_hello(server.get_port(), resumed_session, reused);
+    BOOST_REQUIRE(new_session != NULL);
+    BOOST_CHECK(! reused);
+    BOOST_CHECK_EQUAL(server.get_ssl_session_cache().get_misses(), 1U);
+
+    SSL_SESSION_free(new_session);
+    SSL_SESSION_free(resumed_session);
+    SSL_SESSION_free(session);
+    server.stop();
+}
+
+BOOST_AUTO_TEST_CASE(checkSessionCacheIsBounded) {
+    SessionCacheServer server;
+    server.get_ssl_session_cache().set_tickets(false);
+    server.get_ssl_session_cache().set_max_sessions(16);
+    server.start();
+
+    for (int i = 0; i < 40; ++i) {
+        bool reused = false;
+        SSL_SESSION *session = request_hello(server.get_port(), NULL, reused);
+        BOOST_REQUIRE(session != NULL);
+        SSL_SESSION_free(session);
+    }
+    BOOST_CHECK_GT(server.get_ssl_session_cache().get_num_sessions(), 0U);
+    BOOST_CHECK_LE(server.get_ssl_session_cache().get_num_sessions(), 16U);
+
+    server.stop();
+}
+
+BOOST_AUTO_TEST_CASE(checkTicketsFromThePreviousKeyAreAccepted) {
+    SessionCacheServer server;
+    server.get_ssl_session_cache().set_ticket_key_lifetime(2);
+    server.start();
+
+    bool reused = true;
+    SSL_SESSION *session = request_hello(server.get_port(), NULL, reused);
+    BOOST_REQUIRE(session != NULL);
+    BOOST_CHECK(! reused);
+
+    // once the key has been replaced, the old ticket is still accepted,
+    // and the client gets a new one
+    scheduler::sleep(2, 500000000); // 2.5 seconds
+    SSL_SESSION *resumed_session = request_hello(server.get_port(), session, reused);
+    BOOST_REQUIRE(resumed_session != NULL);
+    BOOST_CHECK(reused);
+    BOOST_CHECK_EQUAL(server.get_ssl_session_cache().get_ticket_key_rotations(), 2U);
+
+    SSL_SESSION_free(resumed_session);
+    SSL_SESSION_free(session);
+    server.stop();
+}
+
+BOOST_AUTO_TEST_CASE(checkKtlsConnectionsServeRequests) {
+    SessionCacheServer server;
+    server.set_ktls_flag();
+    server.start();
+
+    // whether or not the kernel supports TLS, the responses are the same
+    bool reused = true;
+    SSL_SESSION *session = request_hello(server.get_port(), NULL, reused);
+    BOOST_REQUIRE(session != NULL);
+    SSL_SESSION *resumed_session = request_hello(server.get_port(), session, reused);
+    BOOST_REQUIRE(resumed_session != NULL);
+    BOOST_CHECK(reused);
+    BOOST_CHECK_EQUAL(server.get_ktls().get_num_enabled() + server.get_ktls().get_num_fallbacks(), 2U);
+    if (! tcp::ktls::is_supported())
+        BOOST_CHECK_EQUAL(server.get_ktls().get_num_enabled(), 0U);
+
+    SSL_SESSION_free(resumed_session);
+    SSL_SESSION_free(session);
+    server.stop();
+}
+
+BOOST_AUTO_TEST_CASE(checkHandshakesRunOnTheHandshakePool) {
+    SessionCacheServer server;
+    server.set_handshake_threads(2);
+    server.start();
+
+    bool reused = true;
+    SSL_SESSION *session = request_hello(server.get_port(), NULL, reused);
+    BOOST_REQUIRE(session != NULL);
+    SSL_SESSION *resumed_session = request_hello(server.get_port(), session, reused);
+    BOOST_REQUIRE(resumed_session != NULL);
+    BOOST_CHECK(reused);
+
+    // each handshake takes several steps
+    BOOST_CHECK_GE(server.get_handshake_pool().get_num_completed(), 4U);
+    BOOST_CHECK_EQUAL(server.get_handshake_pool().get_num_rejected(), 0U);
+    BOOST_CHECK_EQUAL(server.get_handshake_queue_wait().get_count(), 2U);
+    BOOST_CHECK_EQUAL(server.get_handshake_duration().get_count(), 2U);
+
+    SSL_SESSION_free(resumed_session);
+    SSL_SESSION_free(session);
+    server.stop();
+}
+
+BOOST_AUTO_TEST_CASE(checkSslResponsesAreCoalescedIntoGrowingRecords) {
+    SessionCacheServer server;
+    server.start();
+
+    asio::io_service io_service;
+    asio::ssl::context ssl_context(asio::ssl::context::tls);
+    tcp::connection tcp_conn(io_service, ssl_context);
+    BOOST_REQUIRE(! tcp_conn.connect(asio::ip::address::from_string("127.0.0.1"), server.get_port()));
+    SSL_set_msg_callback(tcp_conn.get_ssl_socket().native_handle(), record_length_callback);
+    BOOST_REQUIRE(! tcp_conn.handshake_client());
+
+    // both responses of the connection start with small records
+    for (int n = 0; n < 2; ++n) {
+        g_record_lengths.clear();
+        asio::error_code error_code;
+        std::string request("GET /large HTTP/1.1\r\nHost: localhost\r\n\r\n");
+        tcp_conn.write(asio::buffer(request), error_code);
+        std::string response;
+        std::size_t body_start = std::string::npos;
+        while (! error_code && (body_start == std::string::npos
+                                || response.size() < body_start + SessionCacheServer::LARGE_RESPONSE_SIZE))
+        {
+            const std::size_t bytes_read = tcp_conn.read_some(error_code);
+            response.append(tcp_conn.get_read_buffer().data(), bytes_read);
+            if (body_start == std::string::npos && response.find("\r\n\r\n") != std::string::npos)
+                body_start = response.find("\r\n\r\n") + 4;
+        }
+        BOOST_REQUIRE(! error_code);
+        BOOST_CHECK_EQUAL(response.size(), body_start + SessionCacheServer::LARGE_RESPONSE_SIZE);
+        BOOST_CHECK_EQUAL(response.compare(response.size() - 10, 10, "0123456789"), 0);
+
+        // the ten thousand pieces are sent in a few dozen records, which grow
+        // to the largest size TLS allows
+        BOOST_CHECK_LT(g_record_lengths.size(), 40U);
+        const std::size_t max_length = *std::max_element(g_record_lengths.begin(), g_record_lengths.end());
+        BOOST_CHECK_GT(max_length, static_cast<std::size_t>(tcp::connection::SSL_MAX_RECORD_SIZE));
+        BOOST_CHECK_LT(max_length, static_cast<std::size_t>(tcp::connection::SSL_MAX_RECORD_SIZE + 256));
+        g_record_lengths.erase(std::remove_if(g_record_lengths.begin(), g_record_lengths.end(),
+                                              [](std::size_t length) { return length < 512; }),
+                               g_record_lengths.end());
+
+        // session tickets may arrive before the response, which starts with
+        // records that fit in one TCP segment
+        BOOST_REQUIRE(! g_record_lengths.empty());
+        BOOST_CHECK_GT(g_record_lengths.front(), static_cast<std::size_t>(tcp::connection::SSL_SMALL_RECORD_SIZE));
+        BOOST_CHECK_LT(g_record_lengths.front(), static_cast<std::size_t>(tcp::connection::SSL_SMALL_RECORD_SIZE + 256));
+    }
+    server.stop();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+#endif  // PION_HAVE_SSL
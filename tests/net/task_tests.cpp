@@ -0,0 +1,232 @@
+// ---------------------------------------------------------------------
+// pion:  a Boost C++ framework for building lightweight HTTP interfaces
+// ---------------------------------------------------------------------
+// Copyright (C) 2021 Wang Qiang  (https://github.com/dnybz/pion)
+// Copyright (C) 2007-2014 Splunk Inc.  (https://github.com/splunk/pion)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <pion/config.hpp>
+#include <pion/task.hpp>
+#include <boost/test/unit_test.hpp>
+#include "net_tests.hpp"
+
+using namespace pion;
+
+
+///
+/// SizedFunction: function object of a given size that records where it was
+/// when it was called (to tell if it is stored inside a task)
+///
+template <std::size_t Size>
+struct SizedFunction {
+    SizedFunction(const void **called_at) : m_called_at(called_at) {}
+    void operator()(void) { *m_called_at = this; }
+    const void **   m_called_at;
+    char            m_padding[Size - sizeof(const void **)];
+};
+
+///
+/// OverAlignedFunction: small function object that needs more alignment than
+/// a task's storage
+///
+struct alignas(64) OverAlignedFunction {
+    OverAlignedFunction(const void **called_at) : m_called_at(called_at) {}
+    void operator()(void) { *m_called_at = this; }
+    const void **   m_called_at;
+};
+
+///
+/// ThrowingMoveFunction: small function object whose move constructor may throw
+///
+struct ThrowingMoveFunction {
+    ThrowingMoveFunction(const void **called_at) : m_called_at(called_at) {}
+    ThrowingMoveFunction(const ThrowingMoveFunction& f) : m_called_at(f.m_called_at) {}
+    void operator()(void) { *m_called_at = this; }
+    const void **   m_called_at;
+};
+
+///
+/// UniqueFunction: move-only function object that owns what it works on
+///
+struct UniqueFunction {
+    UniqueFunction(std::unique_ptr<int>&& value, int *result)
+        : m_value(std::move(value)), m_result(result) {}
+    void operator()(void) { *m_result = *m_value; }
+    std::unique_ptr<int>    m_value;
+    int *                   m_result;
+};
+
+///
+/// CountedFunction: function object that counts its live instances and calls
+///
+struct CountedFunction {
+    CountedFunction(int *num_alive, int *num_calls) : m_num_alive(num_alive), m_num_calls(num_calls) {
+        ++*m_num_alive;
+    }
+    CountedFunction(const CountedFunction& f) noexcept : m_num_alive(f.m_num_alive), m_num_calls(f.m_num_calls) {
+        ++*m_num_alive;
+    }
+    ~CountedFunction() { --*m_num_alive; }
+    void operator()(void) { ++*m_num_calls; }
+    int *   m_num_alive;
+    int *   m_num_calls;
+};
+
+
+/// returns true if the function object that a task called is stored inside it
+static bool is_stored_inline(const task& t, const void *called_at)
+{
+    const char *begin = reinterpret_cast<const char*>(&t);
+    const char *address = static_cast<const char*>(called_at);
+    return address >= begin && address < begin + sizeof(task);
+}
+
+
+/**
+ * creates a task from a function object, calls it and reports how it was stored
+ *
+ * @param f the function object
+ * @param num_allocations the number of heap allocations made to create the task
+ *
+ * @return bool true if the function object was stored inside the task
+ */
+template <typename Function>
+static bool check_storage(const Function& f, std::size_t& num_allocations)
+{
+    const std::size_t allocations_before = test::get_num_allocations();
+    task t(f);
+    num_allocations = test::get_num_allocations() - allocations_before;
+    t();
+    return is_stored_inline(t, *f.m_called_at);
+}
+
+
+// task Test Cases
+
+BOOST_AUTO_TEST_SUITE(TaskTests_S)
+
+BOOST_AUTO_TEST_CASE(checkTaskMovesDoNotThrow) {
+    BOOST_CHECK((std::is_nothrow_move_constructible<task>::value));
+    BOOST_CHECK((std::is_nothrow_move_assignable<task>::value));
+    BOOST_CHECK(! (std::is_copy_constructible<task>::value));
+}
+
+BOOST_AUTO_TEST_CASE(checkTaskOwnsMoveOnlyCaptures) {
+    int result = 0;
+    std::unique_ptr<int> value(new int(42));
+    task t(UniqueFunction(std::move(value), &result));
+    BOOST_CHECK(! value);
+
+    // the captured unique_ptr follows the task through moves
+    task moved(std::move(t));
+    task assigned;
+    assigned = std::move(moved);
+    BOOST_CHECK(! t);
+    BOOST_CHECK(! moved);
+    BOOST_REQUIRE(assigned);
+    assigned();
+    BOOST_CHECK_EQUAL(result, 42);
+}
+
+BOOST_AUTO_TEST_CASE(checkFunctionsUpToInlineSizeAreStoredInside) {
+    const void *called_at = NULL;
+    std::size_t num_allocations = 0;
+
+    // the largest function object that fits is stored without allocating
+    BOOST_CHECK(check_storage(SizedFunction<task::INLINE_SIZE>(&called_at), num_allocations));
+    BOOST_CHECK_EQUAL(num_allocations, 0U);
+
+    // one more byte, and it is allocated on the heap
+    BOOST_CHECK(! check_storage(SizedFunction<task::INLINE_SIZE + 1>(&called_at), num_allocations));
+    BOOST_CHECK_EQUAL(num_allocations, 1U);
+
+    // as are small function objects that cannot be stored safely inside
+    BOOST_CHECK(! check_storage(OverAlignedFunction(&called_at), num_allocations));
+    BOOST_CHECK_EQUAL(num_allocations, 1U);
+    BOOST_CHECK(! check_storage(ThrowingMoveFunction(&called_at), num_allocations));
+    BOOST_CHECK_EQUAL(num_allocations, 1U);
+}
+
+BOOST_AUTO_TEST_CASE(checkOverAlignedFunctionsAreAligned) {
+    // operator new only guarantees the alignment of max_align_t, so the
+    // function object is placed at an aligned address within its memory
+    for (int n = 0; n < 10; ++n) {
+        const void *called_at = NULL;
+        task t = OverAlignedFunction(&called_at);
+        t();
+        BOOST_CHECK_EQUAL(reinterpret_cast<std::size_t>(called_at) % 64, 0U);
+
+        // and stays there when the task is moved
+        const void *heap_address = called_at;
+        task moved(std::move(t));
+        moved();
+        BOOST_CHECK_EQUAL(called_at, heap_address);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(checkInlineFunctionsMoveWithTheTask) {
+    const void *called_at = NULL;
+    task t = SizedFunction<task::INLINE_SIZE>(&called_at);
+    task moved(std::move(t));
+    moved();
+    BOOST_CHECK(is_stored_inline(moved, called_at));
+
+    // heap function objects stay where they are
+    task heap = SizedFunction<task::INLINE_SIZE + 1>(&called_at);
+    heap();
+    const void *heap_address = called_at;
+    task moved_heap(std::move(heap));
+    moved_heap();
+    BOOST_CHECK_EQUAL(called_at, heap_address);
+}
+
+BOOST_AUTO_TEST_CASE(checkMovedFromTasksAreEmpty) {
+    int num_alive = 0;
+    int num_calls = 0;
+    {
+        task moved;
+        {
+            task t(CountedFunction(&num_alive, &num_calls));
+            BOOST_CHECK_EQUAL(num_alive, 1);
+            moved = std::move(t);
+            BOOST_CHECK_EQUAL(num_alive, 1);
+            BOOST_CHECK(! t);
+            BOOST_CHECK_THROW(t(), std::bad_function_call);
+        }
+
+        // destroying a moved-from task leaves the function object alone
+        BOOST_CHECK_EQUAL(num_alive, 1);
+        moved();
+        BOOST_CHECK_EQUAL(num_calls, 1);
+
+        // a moved-from task can be given a new function object
+        task t(std::move(moved));
+        moved = task(CountedFunction(&num_alive, &num_calls));
+        BOOST_CHECK_EQUAL(num_alive, 2);
+        moved();
+        BOOST_CHECK_EQUAL(num_calls, 2);
+
+        // assigning to a task destroys its function object first
+        t = std::move(moved);
+        BOOST_CHECK_EQUAL(num_alive, 1);
+        BOOST_CHECK(! moved);
+        t();
+        BOOST_CHECK_EQUAL(num_calls, 3);
+
+        // moving a task onto itself keeps its function object
+        task& self = t;
+        t = std::move(self);
+        BOOST_CHECK(t);
+        BOOST_CHECK_EQUAL(num_alive, 1);
+    }
+    BOOST_CHECK_EQUAL(num_alive, 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,336 @@
+// ---------------------------------------------------------------------
+// pion:  a Boost C++ framework for building lightweight HTTP interfaces
+// ---------------------------------------------------------------------
+// Copyright (C) 2021 Wang Qiang  (https://github.com/dnybz/pion)
+// Copyright (C) 2007-2014 Splunk Inc.  (https://github.com/splunk/pion)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <pion/config.hpp>
+#include <pion/scheduler.hpp>
+#include <pion/tcp/connection.hpp>
+#include <pion/tcp/timing_wheel.hpp>
+#include <boost/test/unit_test.hpp>
+#include "net_tests.hpp"
+
+using namespace pion;
+
+
+///
+/// ManualWheel: timing wheel whose clock only moves when the test says so
+///
+class ManualWheel
+    : public tcp::timing_wheel
+{
+public:
+    virtual ~ManualWheel() {}
+
+    /**
+     * creates a wheel whose clock starts at a tick
+     *
+     * @param io_service the I/O service of the wheel's timer (which is never run)
+     * @param tick the current tick
+     */
+    ManualWheel(asio::io_service& io_service, uint64_t tick)
+        : tcp::timing_wheel(io_service), m_now(tick)
+    {}
+
+    /// moves the clock forward and expires the deadlines that are due
+    void advance_to(uint64_t tick) {
+        m_now = tick;
+        handle_tick(asio::error_code());
+    }
+
+
+protected:
+
+    /// returns the tick set by the test
+    virtual uint64_t get_current_tick(void) const { return m_now; }
+
+
+private:
+
+    /// the current tick
+    uint64_t    m_now;
+};
+
+
+///
+/// CountingEntry: deadline that counts how often it expired
+///
+class CountingEntry
+    : public tcp::timing_wheel::entry
+{
+public:
+    virtual ~CountingEntry() {}
+
+    /// constructs a deadline that is not armed
+    CountingEntry(void) : m_num_expired(0) {}
+
+    /// returns the number of times that the deadline expired
+    inline unsigned int get_num_expired(void) const { return m_num_expired; }
+
+
+protected:
+
+    /// counts the expiration
+    virtual void expired(void) { ++m_num_expired; }
+
+
+private:
+
+    /// number of times that the deadline expired
+    unsigned int    m_num_expired;
+};
+
+
+///
+/// SlowDeadlineOwner: owns a deadline that takes some time to expire and uses
+/// its owner while it does, as a connection's deadline does.  Like
+/// ~connection(), the destructor cancels the deadline before anything is freed
+///
+class SlowDeadlineOwner {
+public:
+
+    /**
+     * creates an owner whose deadline is not armed
+     *
+     * @param expiring set when the deadline starts to expire
+     * @param expired_before_destroyed set by the destructor if the deadline
+     *                                 had finished expiring by then
+     */
+    SlowDeadlineOwner(std::atomic<bool> *expiring, std::atomic<bool> *expired_before_destroyed)
+        : m_deadline(*this), m_expiring(expiring),
+        m_expired_before_destroyed(expired_before_destroyed), m_num_expired(0)
+    {}
+
+    /// cancels the deadline, then records whether it had finished expiring
+    ~SlowDeadlineOwner() {
+        m_deadline.cancel();
+        *m_expired_before_destroyed = (m_num_expired == 1);
+    }
+
+    /// returns the deadline
+    inline tcp::timing_wheel::entry& get_deadline(void) { return m_deadline; }
+
+
+private:
+
+    /// deadline that sleeps for 0.1 seconds, then counts the expiration
+    class deadline_type : public tcp::timing_wheel::entry {
+    public:
+        explicit deadline_type(SlowDeadlineOwner& owner) : m_owner(owner) {}
+    protected:
+        virtual void expired(void) {
+            *m_owner.m_expiring = true;
+            scheduler::sleep(0, 100000000);
+            ++m_owner.m_num_expired;
+        }
+    private:
+        SlowDeadlineOwner &     m_owner;
+    };
+
+    /// the owner's deadline
+    deadline_type           m_deadline;
+
+    /// set when the deadline starts to expire
+    std::atomic<bool> *     m_expiring;
+
+    /// set by the destructor if the deadline had finished expiring
+    std::atomic<bool> *     m_expired_before_destroyed;
+
+    /// number of times that the deadline expired
+    unsigned int            m_num_expired;
+};
+
+
+/**
+ * returns the milliseconds that make a deadline armed at tick now expire at
+ * tick now + ticks (arming rounds up and adds one tick for the current one)
+ */
+static uint32_t get_milliseconds(uint64_t ticks)
+{
+    return static_cast<uint32_t>((ticks - 1) * tcp::timing_wheel::TICK_MILLISECONDS);
+}
+
+
+// timing_wheel Test Cases
+
+BOOST_AUTO_TEST_SUITE(TimingWheelTests_S)
+
+BOOST_AUTO_TEST_CASE(checkDeadlinesExpireOnTimeAtEveryLevel) {
+    // the first level has 256 ticks and each of the three higher levels
+    // 64 slots, so these cross every boundary (and are armed together, so
+    // that the higher levels cascade while other deadlines are waiting)
+    static const uint64_t DELTAS[] = {
+        1, 2, 255, 256, 257,
+        (1 << 14) - 1, 1 << 14, (1 << 14) + 1,
+        (1 << 20) - 1, 1 << 20, (1 << 20) + 1,
+        (1 << 25) + 1
+    };
+    static const std::size_t NUM_DELTAS = sizeof(DELTAS) / sizeof(DELTAS[0]);
+
+    // start unaligned, and just before the second and third levels wrap around
+    static const uint64_t STARTS[] = { 300, (1 << 14) - 3, (1 << 20) - 3 };
+    for (std::size_t s = 0; s < sizeof(STARTS) / sizeof(STARTS[0]); ++s) {
+        const uint64_t start = STARTS[s];
+        BOOST_TEST_CHECKPOINT("starting at tick " << start);
+        asio::io_service io_service;
+        ManualWheel wheel(io_service, start);
+        std::vector<CountingEntry> entries(NUM_DELTAS);
+        for (std::size_t n = 0; n < NUM_DELTAS; ++n)
+            wheel.arm(entries[n], get_milliseconds(DELTAS[n]));
+        BOOST_CHECK_EQUAL(wheel.size(), NUM_DELTAS);
+
+        for (std::size_t n = 0; n < NUM_DELTAS; ++n) {
+            wheel.advance_to(start + DELTAS[n] - 1);
+            BOOST_CHECK_MESSAGE(entries[n].get_num_expired() == 0,
+                                "delta " << DELTAS[n] << " expired early (start " << start << ")");
+            BOOST_CHECK(entries[n].is_armed());
+            wheel.advance_to(start + DELTAS[n]);
+            BOOST_CHECK_MESSAGE(entries[n].get_num_expired() == 1,
+                                "delta " << DELTAS[n] << " did not expire (start " << start << ")");
+            BOOST_CHECK(! entries[n].is_armed());
+            BOOST_CHECK_EQUAL(wheel.size(), NUM_DELTAS - n - 1);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(checkCancelledDeadlinesDoNotExpire) {
+    asio::io_service io_service;
+    ManualWheel wheel(io_service, 1000);
+    CountingEntry near_entry, middle_entry, far_entry;
+    wheel.arm(near_entry, get_milliseconds(10));
+    wheel.arm(middle_entry, get_milliseconds(5000));
+    wheel.arm(far_entry, get_milliseconds(1 << 21));
+    BOOST_CHECK_EQUAL(wheel.size(), 3U);
+
+    middle_entry.cancel();
+    BOOST_CHECK(! middle_entry.is_armed());
+    BOOST_CHECK_EQUAL(wheel.size(), 2U);
+    wheel.cancel(middle_entry);     // cancelling twice does nothing
+    BOOST_CHECK_EQUAL(wheel.size(), 2U);
+
+    // arming again moves the deadline from the highest level to the first
+    wheel.arm(far_entry, get_milliseconds(20));
+    BOOST_CHECK_EQUAL(wheel.size(), 2U);
+    wheel.advance_to(1010);
+    BOOST_CHECK_EQUAL(near_entry.get_num_expired(), 1U);
+    BOOST_CHECK_EQUAL(far_entry.get_num_expired(), 0U);
+    wheel.advance_to(1020);
+    BOOST_CHECK_EQUAL(far_entry.get_num_expired(), 1U);
+    BOOST_CHECK_EQUAL(wheel.size(), 0U);
+
+    const uint64_t restart = 1000 + (1 << 21) + 1;
+    wheel.advance_to(restart);
+    BOOST_CHECK_EQUAL(middle_entry.get_num_expired(), 0U);
+    BOOST_CHECK_EQUAL(far_entry.get_num_expired(), 1U);
+
+    // a deadline that has expired can be armed again once the wheel is idle
+    wheel.arm(near_entry, get_milliseconds(300));
+    wheel.advance_to(restart + 299);
+    BOOST_CHECK_EQUAL(near_entry.get_num_expired(), 1U);
+    wheel.advance_to(restart + 300);
+    BOOST_CHECK_EQUAL(near_entry.get_num_expired(), 2U);
+}
+
+BOOST_AUTO_TEST_CASE(checkArmingWithAnotherWheelMovesTheDeadline) {
+    asio::io_service io_service;
+    ManualWheel first_wheel(io_service, 0);
+    ManualWheel second_wheel(io_service, 0);
+    CountingEntry e;
+    first_wheel.arm(e, get_milliseconds(300));
+    second_wheel.arm(e, get_milliseconds(10));
+    BOOST_CHECK_EQUAL(first_wheel.size(), 0U);
+    BOOST_CHECK_EQUAL(second_wheel.size(), 1U);
+    first_wheel.advance_to(300);
+    BOOST_CHECK_EQUAL(e.get_num_expired(), 0U);
+    second_wheel.advance_to(10);
+    BOOST_CHECK_EQUAL(e.get_num_expired(), 1U);
+}
+
+BOOST_AUTO_TEST_CASE(checkDeadlinesMayOutliveTheirWheel) {
+    CountingEntry armed_entry, expired_entry;
+    {
+        std::unique_ptr<asio::io_service> io_service_ptr(new asio::io_service);
+        tcp::timing_wheel& wheel = asio::use_service<tcp::timing_wheel>(*io_service_ptr);
+        wheel.arm(armed_entry, 60000);
+        BOOST_CHECK(armed_entry.is_armed());
+
+        ManualWheel manual_wheel(*io_service_ptr, 0);
+        manual_wheel.arm(expired_entry, get_milliseconds(1));
+        manual_wheel.advance_to(1);
+        BOOST_CHECK_EQUAL(expired_entry.get_num_expired(), 1U);
+    }
+
+    // the wheels are gone, and cancelling must not touch them
+    BOOST_CHECK(! armed_entry.is_armed());
+    BOOST_CHECK(! expired_entry.is_armed());
+    armed_entry.cancel();
+    expired_entry.cancel();
+}
+
+BOOST_AUTO_TEST_CASE(checkDestroyingAnExpiringDeadlineWaitsForIt) {
+    asio::io_service io_service;
+    ManualWheel wheel(io_service, 0);
+    std::atomic<bool> expiring(false);
+    std::atomic<bool> expired_before_destroyed(false);
+    std::unique_ptr<SlowDeadlineOwner> owner_ptr(new SlowDeadlineOwner(&expiring, &expired_before_destroyed));
+    wheel.arm(owner_ptr->get_deadline(), get_milliseconds(1));
+
+    // the deadline expires on another thread, and its owner is destroyed
+    // while it does: the destructor must wait until expired() has returned
+    std::thread tick_thread([&wheel]() { wheel.advance_to(1); });
+    BOOST_REQUIRE(test::wait_until([&expiring]() { return expiring.load(); }));
+    owner_ptr.reset();
+    BOOST_CHECK(expired_before_destroyed.load());
+    tick_thread.join();
+    BOOST_CHECK_EQUAL(wheel.size(), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(checkConnectionsMayBeDestroyedWhileTheirDeadlinesExpire) {
+    // the wheel's timer runs on several threads, as with a
+    // single_service_scheduler, while the connections whose deadlines it
+    // expires are destroyed on this one
+    single_service_scheduler sched;
+    sched.set_num_threads(4);
+    sched.startup();
+    asio::io_service& io_service = sched.get_io_service();
+    for (int n = 0; n < 20; ++n) {
+        std::vector<tcp::connection_ptr> connections;
+        for (int c = 0; c < 50; ++c) {
+            connections.push_back(std::make_shared<tcp::connection>(io_service));
+            connections.back()->arm_deadline(0);
+        }
+        scheduler::sleep(0, (n % 4) * 50000000);
+        connections.clear();
+    }
+    tcp::timing_wheel& wheel = asio::use_service<tcp::timing_wheel>(io_service);
+    BOOST_CHECK(test::wait_until([&wheel]() { return wheel.size() == 0; }));
+    sched.shutdown();
+}
+
+BOOST_AUTO_TEST_CASE(checkConnectionDeadlinesUseTheServiceWheel) {
+    asio::io_service io_service;
+    tcp::connection_ptr tcp_conn(std::make_shared<tcp::connection>(io_service));
+    tcp::timing_wheel& wheel = asio::use_service<tcp::timing_wheel>(io_service);
+    tcp_conn->arm_deadline(60000);
+    BOOST_CHECK_EQUAL(wheel.size(), 1U);
+    tcp_conn->arm_deadline(30000);
+    BOOST_CHECK_EQUAL(wheel.size(), 1U);
+    tcp_conn->arm_send_deadline(60000);
+    BOOST_CHECK_EQUAL(wheel.size(), 2U);
+    tcp_conn->disarm_deadline();
+    tcp_conn->disarm_send_deadline();
+    BOOST_CHECK_EQUAL(wheel.size(), 0U);
+    tcp_conn->disarm_deadline();
+    BOOST_CHECK_EQUAL(wheel.size(), 0U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
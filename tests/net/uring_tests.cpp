@@ -0,0 +1,274 @@
+// ---------------------------------------------------------------------
+// pion:  a Boost C++ framework for building lightweight HTTP interfaces
+// ---------------------------------------------------------------------
+// Copyright (C) 2021 Wang Qiang  (https://github.com/dnybz/pion)
+// Copyright (C) 2007-2014 Splunk Inc.  (https://github.com/splunk/pion)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include <pion/config.hpp>
+
+#ifdef PION_HAVE_IO_URING
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <pion/scheduler.hpp>
+#include <pion/tcp/uring_service.hpp>
+#include <boost/test/unit_test.hpp>
+#include "net_tests.hpp"
+
+using namespace pion;
+
+
+/// skips the tests if the kernel does not support io_uring (or forbids it)
+static boost::test_tools::assertion_result is_uring_supported(boost::unit_test::test_unit_id)
+{
+    boost::test_tools::assertion_result result(tcp::uring_service::is_supported());
+    result.message() << "io_uring is not supported by the kernel";
+    return result;
+}
+
+
+///
+/// LoopbackFixture: a connected pair of TCP sockets over loopback, and the
+/// io_uring service of their I/O service
+///
+class LoopbackFixture {
+public:
+
+    /// connects the sockets
+    LoopbackFixture(void)
+        : m_acceptor(m_io_service, asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0)),
+        m_client(m_io_service), m_server(m_io_service),
+        m_uring(asio::use_service<tcp::uring_service>(m_io_service))
+    {
+        m_client.connect(m_acceptor.local_endpoint());
+        m_acceptor.accept(m_server);
+    }
+
+    /// returns the file descriptor of the server's socket
+    inline int server_fd(void) { return m_server.native_handle(); }
+
+    asio::io_service            m_io_service;
+    asio::ip::tcp::acceptor     m_acceptor;
+    asio::ip::tcp::socket       m_client;
+    asio::ip::tcp::socket       m_server;
+    tcp::uring_service &        m_uring;
+};
+
+
+// uring_service Test Cases
+
+BOOST_FIXTURE_TEST_SUITE(UringServiceTests_S, LoopbackFixture,
+                         * boost::unit_test::precondition(is_uring_supported))
+
+BOOST_AUTO_TEST_CASE(checkReceiveAndSend) {
+    BOOST_REQUIRE(m_uring.is_available());
+    asio::write(m_client, asio::buffer("hello", 5));
+
+    char data[64];
+    asio::error_code receive_error(make_error_code(asio::error::fault));
+    std::size_t bytes_received = 0;
+    m_uring.async_receive(server_fd(), asio::buffer(data), -1,
+                          [&](const asio::error_code& ec, std::size_t bytes) {
+                              receive_error = ec;
+                              bytes_received = bytes;
+                          });
+
+    // a vector of buffers is sent in one operation
+    static const std::string FIRST("Hello ");
+    static const std::string SECOND("there!");
+    std::vector<asio::const_buffer> buffers;
+    buffers.push_back(asio::buffer(FIRST));
+    buffers.push_back(asio::buffer(SECOND));
+    asio::error_code send_error(make_error_code(asio::error::fault));
+    std::size_t bytes_sent = 0;
+    m_uring.async_send(server_fd(), buffers, [&](const asio::error_code& ec, std::size_t bytes) {
+        send_error = ec;
+        bytes_sent = bytes;
+    });
+
+    m_io_service.run();
+    BOOST_CHECK(! receive_error);
+    BOOST_CHECK_EQUAL(std::string(data, bytes_received), "hello");
+    BOOST_CHECK(! send_error);
+    BOOST_CHECK_EQUAL(bytes_sent, 12U);
+    char reply[12];
+    asio::read(m_client, asio::buffer(reply));
+    BOOST_CHECK_EQUAL(std::string(reply, sizeof(reply)), "Hello there!");
+    BOOST_CHECK_EQUAL(m_uring.size(), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(checkReceiveIntoRegisteredBuffer) {
+    std::vector<char> buffer(4096);
+    const int index = m_uring.register_buffer(&buffer[0], buffer.size());
+    BOOST_REQUIRE_GE(index, 0);
+    asio::write(m_client, asio::buffer("registered", 10));
+
+    std::size_t bytes_received = 0;
+    m_uring.async_receive(server_fd(), asio::buffer(&buffer[0], buffer.size()), index,
+                          [&](const asio::error_code& ec, std::size_t bytes) {
+                              BOOST_CHECK(! ec);
+                              bytes_received = bytes;
+                          });
+    m_io_service.run();
+    BOOST_CHECK_EQUAL(std::string(&buffer[0], bytes_received), "registered");
+    m_uring.unregister_buffer(index);
+}
+
+BOOST_AUTO_TEST_CASE(checkReceiveSeesTheEndOfTheStream) {
+    m_client.close();
+    char data[16];
+    asio::error_code receive_error;
+    m_uring.async_receive(server_fd(), asio::buffer(data), -1,
+                          [&](const asio::error_code& ec, std::size_t) { receive_error = ec; });
+    m_io_service.run();
+    BOOST_CHECK(receive_error == asio::error::eof);
+}
+
+BOOST_AUTO_TEST_CASE(checkCancelAbortsPendingOperations) {
+    char data[16];
+    asio::error_code receive_error;
+    asio::error_code wait_error;
+    m_uring.async_receive(server_fd(), asio::buffer(data), -1,
+                          [&](const asio::error_code& ec, std::size_t) { receive_error = ec; });
+    m_uring.async_wait_readable(server_fd(), [&](const asio::error_code& ec) { wait_error = ec; });
+    BOOST_CHECK_EQUAL(m_uring.size(), 2U);
+
+    // nothing arrives, so the operations only finish when they are cancelled
+    m_io_service.poll();
+    m_uring.cancel(server_fd());
+    m_io_service.run();
+    BOOST_CHECK(receive_error == asio::error::operation_aborted);
+    BOOST_CHECK(wait_error == asio::error::operation_aborted);
+    BOOST_CHECK_EQUAL(m_uring.size(), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(checkAcceptDeliversEachConnection) {
+    std::vector<int> accepted;
+    bool finished = false;
+    m_uring.async_accept(m_acceptor.native_handle(),
+                         [&](const asio::error_code& ec, int fd, bool more) {
+                             if (! ec && fd >= 0)
+                                 accepted.push_back(fd);
+                             if (! more)
+                                 finished = true;
+                         });
+
+    asio::ip::tcp::socket first(m_io_service), second(m_io_service);
+    first.connect(m_acceptor.local_endpoint());
+    second.connect(m_acceptor.local_endpoint());
+    BOOST_REQUIRE(test::wait_until([&]() { m_io_service.poll(); return accepted.size() >= 2; }));
+
+    // multishot accepting continues until it is cancelled
+    m_uring.cancel(m_acceptor.native_handle());
+    BOOST_REQUIRE(test::wait_until([&]() { m_io_service.poll(); return finished; }));
+    BOOST_CHECK_EQUAL(accepted.size(), 2U);
+    for (std::size_t n = 0; n < accepted.size(); ++n)
+        ::close(accepted[n]);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+
+///
+/// EngineRecordingServer: hello_http_server that records whether each
+/// request was read with io_uring
+///
+class EngineRecordingServer
+    : public test::hello_http_server
+{
+public:
+    virtual ~EngineRecordingServer() {}
+
+    /**
+     * creates a new EngineRecordingServer
+     *
+     * @param sched the scheduler that runs the server's connections
+     */
+    explicit EngineRecordingServer(scheduler& sched)
+        : test::hello_http_server(sched), m_num_uring(0), m_num_reactor(0)
+    {}
+
+    /// returns the number of requests read with io_uring
+    inline std::size_t get_num_uring(void) const { return m_num_uring; }
+
+    /// returns the number of requests read with the reactor
+    inline std::size_t get_num_reactor(void) const { return m_num_reactor; }
+
+    /// records the connection's engine, then responds
+    virtual void handle_hello(const http::request_ptr& http_request_ptr,
+                              const tcp::connection_ptr& tcp_conn)
+    {
+        if (tcp_conn->get_io_engine() == scheduler::IO_ENGINE_URING)
+            ++m_num_uring;
+        else
+            ++m_num_reactor;
+        test::hello_http_server::handle_hello(http_request_ptr, tcp_conn);
+    }
+
+
+private:
+
+    /// number of requests read with io_uring
+    std::atomic<std::size_t>    m_num_uring;
+
+    /// number of requests read with the reactor
+    std::atomic<std::size_t>    m_num_reactor;
+};
+
+
+// io_uring server Test Cases
+
+BOOST_AUTO_TEST_SUITE(UringServerTests_S, * boost::unit_test::precondition(is_uring_supported))
+
+BOOST_AUTO_TEST_CASE(checkServerAnswersKeepAliveRequestsWithUring) {
+    one_to_one_scheduler sched;
+    sched.set_num_threads(2);
+    sched.set_io_engine(scheduler::IO_ENGINE_URING);
+    EngineRecordingServer server(sched);
+    server.start();
+
+    // several connections (accepted by io_uring), each with several requests
+    const std::string request("GET /hello HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    for (int c = 0; c < 4; ++c) {
+        asio::io_service io_service;
+        tcp::connection tcp_conn(io_service);
+        BOOST_REQUIRE(! tcp_conn.connect(asio::ip::address::from_string("127.0.0.1"), server.get_port()));
+        for (int n = 0; n < 25; ++n) {
+            const std::string response(test::send_request(tcp_conn, request));
+            BOOST_REQUIRE_EQUAL(response.compare(0, 15, "HTTP/1.1 200 OK"), 0);
+            BOOST_REQUIRE(response.find("Hello there!") != std::string::npos);
+        }
+    }
+    BOOST_CHECK_EQUAL(server.get_num_uring(), 100U);
+    BOOST_CHECK_EQUAL(server.get_num_reactor(), 0U);
+
+    server.stop();
+    sched.shutdown();
+}
+
+BOOST_AUTO_TEST_CASE(checkServerStopsAcceptingWithUring) {
+    one_to_one_scheduler sched;
+    sched.set_num_threads(1);
+    sched.set_io_engine(scheduler::IO_ENGINE_URING);
+    test::hello_server server(sched);
+    server.start();
+    const unsigned int port = server.get_port();
+    BOOST_CHECK_EQUAL(test::read_greeting(port), "Hello there!\n");
+
+    // the multishot accept is cancelled, so the port no longer accepts
+    server.stop();
+    asio::io_service io_service;
+    tcp::connection tcp_conn(io_service);
+    BOOST_CHECK(tcp_conn.connect(asio::ip::address::from_string("127.0.0.1"), port));
+    sched.shutdown();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+#endif  // PION_HAVE_IO_URING
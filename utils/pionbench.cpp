@@ -0,0 +1,234 @@
+// ---------------------------------------------------------------------
+// pion:  a Boost C++ framework for building lightweight HTTP interfaces
+// ---------------------------------------------------------------------
+// Copyright (C) 2021 Wang Qiang  (https://github.com/dnybz/pion)
+// Copyright (C) 2007-2014 Splunk Inc.  (https://github.com/splunk/pion)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include <pion/config.hpp>
+#include <pion/scheduler.hpp>
+#include <pion/http/server.hpp>
+#include <pion/http/response_writer.hpp>
+#ifdef PION_HAVE_IO_URING
+    #include <pion/tcp/uring_service.hpp>
+#endif
+#include <asio.hpp>
+
+using namespace std;
+using namespace pion;
+
+
+/// HTTP server that responds to "/hello" with "Hello there!"
+class BenchServer : public http::server {
+public:
+    BenchServer(scheduler& sched) : http::server(sched, 0) {
+        add_resource("/hello", std::bind(&BenchServer::handle_hello, this,
+                                         std::placeholders::_1, std::placeholders::_2));
+    }
+    virtual ~BenchServer() {}
+private:
+    void handle_hello(const http::request_ptr& http_request_ptr, const tcp::connection_ptr& tcp_conn) {
+        http::response_writer_ptr writer(http::response_writer::create(tcp_conn, *http_request_ptr,
+                                                                       std::bind(&tcp::connection::finish, tcp_conn)));
+        writer->write_no_copy("Hello there!");
+        writer->send();
+    }
+};
+
+
+/// reads one response with a Content-Length; returns false if it failed
+template <typename Socket>
+static bool read_response(Socket& sock, std::string& response)
+{
+    asio::error_code ec;
+    char buffer[4096];
+    response.clear();
+    std::size_t end_of_headers = std::string::npos;
+    std::size_t content_length = 0;
+    for (;;) {
+        if (end_of_headers == std::string::npos) {
+            end_of_headers = response.find("\r\n\r\n");
+            if (end_of_headers != std::string::npos) {
+                end_of_headers += 4;
+                const std::size_t pos = response.find("Content-Length: ");
+                if (pos != std::string::npos && pos < end_of_headers)
+                    content_length = strtoul(response.c_str() + pos + 16, 0, 10);
+            }
+        }
+        if (end_of_headers != std::string::npos && response.size() >= end_of_headers + content_length)
+            return response.compare(0, 15, "HTTP/1.1 200 OK") == 0;
+        const std::size_t bytes_read = sock.read_some(asio::buffer(buffer), ec);
+        if (ec)
+            return false;
+        response.append(buffer, bytes_read);
+    }
+}
+
+
+/// sends keep-alive requests over one connection until the deadline passes
+template <typename Protocol>
+static void run_client(typename Protocol::endpoint endpoint, std::chrono::steady_clock::time_point deadline,
+                       std::atomic<uint64_t>& num_requests, std::atomic<uint64_t>& num_errors)
+{
+    static const std::string REQUEST("GET /hello HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    asio::io_service io_service;
+    typename Protocol::socket sock(io_service);
+    asio::error_code ec;
+    sock.connect(endpoint, ec);
+    if (ec) {
+        ++num_errors;
+        return;
+    }
+    std::string response;
+    uint64_t n = 0;
+    while (std::chrono::steady_clock::now() < deadline) {
+        asio::write(sock, asio::buffer(REQUEST), ec);
+        if (ec || ! read_response(sock, response)) {
+            ++num_errors;
+            break;
+        }
+        ++n;
+    }
+    num_requests += n;
+}
+
+
+/**
+ * runs the benchmark with one I/O engine and prints its results
+ *
+ * @param name the name printed with the results
+ * @param engine the I/O engine of the server's connections
+ * @param local_path Unix domain socket that the server listens on (empty = tcp over loopback)
+ * @param num_threads the number of server threads
+ * @param num_clients the number of client connections
+ * @param seconds the duration of the benchmark
+ */
+static void run_benchmark(const std::string& name, scheduler::io_engine_type engine,
+                          const std::string& local_path, uint32_t num_threads,
+                          uint32_t num_clients, uint32_t seconds)
+{
+    one_to_one_scheduler sched;
+    sched.set_num_threads(num_threads);
+    sched.set_io_engine(engine);
+    BenchServer server(sched);
+    if (! local_path.empty())
+        server.set_local_endpoint(asio::local::stream_protocol::endpoint(local_path));
+    server.start();
+
+    std::atomic<uint64_t> num_requests(0);
+    std::atomic<uint64_t> num_errors(0);
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    const std::chrono::steady_clock::time_point deadline = start + std::chrono::seconds(seconds);
+    std::vector<std::shared_ptr<std::thread> > clients;
+    for (uint32_t n = 0; n < num_clients; ++n) {
+        if (local_path.empty()) {
+            const asio::ip::tcp::endpoint endpoint(asio::ip::address_v4::loopback(), server.get_port());
+            clients.push_back(std::make_shared<std::thread>(std::bind(&run_client<asio::ip::tcp>, endpoint, deadline,
+                                                                      std::ref(num_requests), std::ref(num_errors))));
+        } else {
+            const asio::local::stream_protocol::endpoint endpoint(local_path);
+            clients.push_back(std::make_shared<std::thread>(std::bind(&run_client<asio::local::stream_protocol>,
+                                                                      endpoint, deadline,
+                                                                      std::ref(num_requests), std::ref(num_errors))));
+        }
+    }
+    for (std::size_t n = 0; n < clients.size(); ++n)
+        clients[n]->join();
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    server.stop();
+    sched.shutdown();
+
+    std::cout << name << (local_path.empty() ? " over tcp" : " over a Unix domain socket") << ": "
+              << num_requests << " requests in " << elapsed << " s = "
+              << static_cast<uint64_t>(num_requests / elapsed) << " req/s";
+    if (num_errors > 0)
+        std::cout << " (" << num_errors << " errors)";
+    std::cout << std::endl;
+}
+
+
+/// runs the benchmark with the selected I/O engines
+static void run_engines(const std::string& engine, const std::string& local_path,
+                        uint32_t num_threads, uint32_t num_clients, uint32_t seconds)
+{
+    if (engine != "uring")
+        run_benchmark("reactor (epoll)", scheduler::IO_ENGINE_REACTOR, local_path, num_threads, num_clients, seconds);
+    if (engine != "reactor") {
+#ifdef PION_HAVE_IO_URING
+        if (tcp::uring_service::is_supported())
+            run_benchmark("io_uring", scheduler::IO_ENGINE_URING, local_path, num_threads, num_clients, seconds);
+        else
+#endif
+            std::cout << "io_uring: not supported" << std::endl;
+    }
+}
+
+
+/// main control function
+int main (int argc, char *argv[])
+{
+    // parse command line
+    std::string engine("both");
+    uint32_t num_threads = 1;
+    uint32_t num_clients = 16;
+    uint32_t seconds = 5;
+    bool use_local_socket = false;
+    for (int argnum = 1; argnum < argc; ++argnum) {
+        if (strcmp(argv[argnum], "-engine") == 0 && argnum + 1 < argc) {
+            engine = argv[++argnum];
+        } else if (strcmp(argv[argnum], "-threads") == 0 && argnum + 1 < argc) {
+            num_threads = strtoul(argv[++argnum], 0, 10);
+        } else if (strcmp(argv[argnum], "-clients") == 0 && argnum + 1 < argc) {
+            num_clients = strtoul(argv[++argnum], 0, 10);
+        } else if (strcmp(argv[argnum], "-seconds") == 0 && argnum + 1 < argc) {
+            seconds = strtoul(argv[++argnum], 0, 10);
+        } else if (strcmp(argv[argnum], "-unix") == 0) {
+            use_local_socket = true;
+        } else {
+            engine.clear();
+            break;
+        }
+    }
+    if ((engine != "reactor" && engine != "uring" && engine != "both")
+        || num_threads == 0 || num_clients == 0 || seconds == 0)
+    {
+        std::cerr << "usage: pionbench [-engine reactor|uring|both] [-threads N] [-clients N] [-seconds N] [-unix]"
+                  << std::endl;
+        return 1;
+    }
+
+    // keep the server's logging out of the measurements
+    logger pion_log(PION_GET_LOGGER("pion"));
+    PION_LOG_SETLEVEL_ERROR(pion_log);
+    PION_LOG_CONFIG_BASIC;
+
+    std::cout << "keep-alive GET requests over loopback: " << num_threads << " server threads, "
+              << num_clients << " clients, " << seconds << " s" << std::endl;
+    try {
+        run_engines(engine, std::string(), num_threads, num_clients, seconds);
+        if (use_local_socket) {
+            // an abstract socket, so that nothing is left behind in the file system
+            const std::string local_path(std::string(1, '\0') + "pionbench." + std::to_string(::getpid()));
+            run_engines(engine, local_path, num_threads, num_clients, seconds);
+        }
+    } catch (std::exception& e) {
+        std::cerr << "exception: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -8,12 +8,16 @@
 // See http://www.boost.org/LICENSE_1_0.txt
 //
 
+#include <memory>
+#include <thread>
 #include <vector>
+#include <cstring>
 #include <iostream>
 #include <pion/error.hpp>
 #include <pion/plugin.hpp>
 #include <pion/process.hpp>
 #include <pion/http/plugin_server.hpp>
+#include <pion/tcp/listen_handoff.hpp>
 #include <asio.hpp>
 
 // these are used only when linking to static web service libraries
@@ -33,7 +37,7 @@ void argument_error(void)
 {
     std::cerr << "usage:   piond [OPTIONS] RESOURCE WEBSERVICE" << std::endl
               << "         piond [OPTIONS] -c SERVICE_CONFIG_FILE" << std::endl
-              << "options: [-ssl PEM_FILE] [-i IP] [-p PORT] [-d PLUGINS_DIR] [-o OPTION=VALUE] [-v]" << std::endl;
+              << "options: [-ssl PEM_FILE] [-i IP] [-p PORT] [-u SOCKET_PATH] [-d PLUGINS_DIR] [-o OPTION=VALUE] [-uring] [-ktls] [-handoff SOCKET_PATH] [-v]" << std::endl;
 }
 
 
@@ -53,8 +57,12 @@ int main (int argc, char *argv[])
     std::string resource_name;
     std::string service_name;
     std::string ssl_pem_file;
+    std::string local_path;
     bool ssl_flag = false;
     bool verbose_flag = false;
+    bool uring_flag = false;
+    bool ktls_flag = false;
+    std::string handoff_path;
     
     for (int argnum=1; argnum < argc; ++argnum) {
         if (argv[argnum][0] == '-') {
@@ -66,6 +74,9 @@ int main (int argc, char *argv[])
             } else if (argv[argnum][1] == 'i' && argv[argnum][2] == '\0' && argnum+1 < argc) {
                 // set ip address
                 cfg_endpoint.address(asio::ip::address::from_string(argv[++argnum]));
+            } else if (argv[argnum][1] == 'u' && argv[argnum][2] == '\0' && argnum+1 < argc) {
+                // listen on a Unix domain socket instead of a tcp port
+                local_path = argv[++argnum];
             } else if (argv[argnum][1] == 'c' && argv[argnum][2] == '\0' && argnum+1 < argc) {
                 service_config_file = argv[++argnum];
             } else if (argv[argnum][1] == 'd' && argv[argnum][2] == '\0' && argnum+1 < argc) {
@@ -91,6 +102,16 @@ int main (int argc, char *argv[])
                 ssl_flag = true;
                 ssl_pem_file = argv[++argnum];
 				cfg_endpoint.port(DEFAULT_SSL_PORT);
+            } else if (strcmp(argv[argnum], "-uring") == 0) {
+                // use the io_uring I/O engine instead of the reactor
+                uring_flag = true;
+            } else if (strcmp(argv[argnum], "-ktls") == 0) {
+                // let the kernel encrypt what SSL connections send
+                ktls_flag = true;
+            } else if (strcmp(argv[argnum], "-handoff") == 0 && argnum+1 < argc) {
+                // take over the listening sockets of a running piond, and
+                // hand them to the next one
+                handoff_path = argv[++argnum];
             } else if (argv[argnum][1] == 'v' && argv[argnum][2] == '\0') {
                 verbose_flag = true;
             } else {
@@ -152,11 +173,29 @@ int main (int argc, char *argv[])
             // configure server for SSL
             web_server.set_ssl_key_file(ssl_pem_file);
             PION_LOG_INFO(main_log, "SSL support enabled using key file: " << ssl_pem_file);
+            if (ktls_flag) {
+                web_server.set_ktls_flag();
+                PION_LOG_INFO(main_log, "Using kernel TLS for SSL connections where supported");
+            }
 #else
             PION_LOG_ERROR(main_log, "SSL support is not enabled");
 #endif
         }
         
+        if (! local_path.empty()) {
+#ifdef ASIO_HAS_LOCAL_SOCKETS
+            web_server.set_local_endpoint(asio::local::stream_protocol::endpoint(local_path));
+            PION_LOG_INFO(main_log, "Listening on Unix domain socket: " << local_path);
+#else
+            PION_LOG_ERROR(main_log, "Unix domain sockets are not supported");
+#endif
+        }
+
+        if (uring_flag) {
+            web_server.set_io_engine(scheduler::IO_ENGINE_URING);
+            PION_LOG_INFO(main_log, "Using the io_uring I/O engine");
+        }
+
         if (service_config_file.empty()) {
             // load a single web service using the command line arguments
             web_server.load_service(resource_name, service_name);
@@ -172,9 +211,56 @@ int main (int argc, char *argv[])
             web_server.load_service_config(service_config_file);
         }
 
+        // adopt the listening sockets of a running piond, or those passed
+        // by the service manager, instead of binding new ones
+        std::unique_ptr<tcp::listen_handoff> handoff_ptr;
+        std::vector<int> listen_fds;
+        if (! handoff_path.empty()) {
+            if (tcp::listen_handoff::is_supported()) {
+                handoff_ptr.reset(new tcp::listen_handoff(handoff_path));
+                if (handoff_ptr->take(listen_fds))
+                    PION_LOG_INFO(main_log, "Took over listening sockets from the piond at " << handoff_path);
+            } else {
+                PION_LOG_ERROR(main_log, "Handing off listening sockets is not supported");
+            }
+        }
+        if (listen_fds.empty())
+            listen_fds = process::get_listen_fds();
+        if (! listen_fds.empty())
+            web_server.set_listen_fds(listen_fds);
+
         // startup the server
         web_server.start();
+
+        // once this process accepts from the sockets, the previous one may stop
+        bool handed_off = false;
+        std::thread handoff_thread;
+        if (handoff_ptr) {
+            handoff_ptr->confirm();
+            handoff_thread = std::thread([&]() {
+                try {
+                    if (handoff_ptr->offer(web_server.get_listen_fds())) {
+                        handed_off = true;
+                        process::shutdown();
+                    }
+                } catch (std::exception& e) {
+                    PION_LOG_ERROR(main_log, "Unable to offer listening sockets at " << handoff_path << ": " << e.what());
+                }
+            });
+        }
         process::wait_for_shutdown();
+
+        if (handoff_ptr) {
+            handoff_ptr->cancel();
+            handoff_thread.join();
+        }
+        if (handed_off) {
+            // the next piond accepts from the sockets now: let the open
+            // connections finish
+            PION_LOG_INFO(main_log, "Handed off listening sockets; waiting for open connections to finish");
+            web_server.set_keep_local_socket();
+            web_server.stop(true);
+        }
         
     } catch (std::exception& e) {
         PION_LOG_FATAL(main_log, e.what());